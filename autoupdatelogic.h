@@ -3,20 +3,26 @@
 
 #include "globals.h"
 #include "customHttpLogging.h"
+#include "deltaupdate.h"
+#include "otaschedule.h"
 #include "oled_disply.h"
 
 // EEPROM address to store version string
 #define VERSION_ADDR 64
-String CURRENT_VERSION;
+#define VERSION_MAX_LEN 16   // "x.y.z" plus headroom; EEPROM slot is 32 bytes
+
+typedef FixedString<VERSION_MAX_LEN> VersionString;
+VersionString CURRENT_VERSION;
 
 
 // Save null-terminated string into EEPROM
-inline void saveVersionToEEPROM(const String& version) {
+inline void saveVersionToEEPROM(const char* version) {
+  size_t len = strlen(version);
   EEPROM.begin(EEPROM_SIZE);
-  for (int i = 0; i < version.length(); i++) {
+  for (size_t i = 0; i < len; i++) {
     EEPROM.write(VERSION_ADDR + i, version[i]);
   }
-  EEPROM.write(VERSION_ADDR + version.length(), '\0'); // null-terminate
+  EEPROM.write(VERSION_ADDR + len, '\0'); // null-terminate
   EEPROM.commit();
 }
 
@@ -44,7 +50,7 @@ inline void eraseCompleteMemory() {
   Serial.println("EEPROM version data wiped.");
 }
 
-inline String getVersionFromEEPROM() {
+inline VersionString getVersionFromEEPROM() {
   char version[32];
   int i = 0;
   char c;
@@ -59,7 +65,7 @@ inline String getVersionFromEEPROM() {
   } while (c != '\0' && i < 31);
   version[i] = '\0';
   
-  return String(version);
+  return VersionString(version);
 }
 
 
@@ -67,84 +73,116 @@ inline void initOTA() {
   CURRENT_VERSION = getVersionFromEEPROM();
   
   // If the string is empty, or contains garbage data (no decimal point) from a fresh chip
-  if (CURRENT_VERSION == "" || CURRENT_VERSION.indexOf('.') == -1 || CURRENT_VERSION.length() > 10) {
+  if (CURRENT_VERSION.isEmpty() || CURRENT_VERSION.view().indexOf('.') == -1 || CURRENT_VERSION.length() > 10) {
     Serial.println("EEPROM blank or corrupted. Setting default version 1.0.0");
     CURRENT_VERSION = "1.0.0"; 
-    saveVersionToEEPROM(CURRENT_VERSION); // Format the memory properly
+    saveVersionToEEPROM(CURRENT_VERSION.c_str()); // Format the memory properly
   } else {
-    Serial.println("Loaded Firmware Version from EEPROM: " + CURRENT_VERSION);
+    Serial.printf("Loaded Firmware Version from EEPROM: %s\n", CURRENT_VERSION.c_str());
   }
 }
 
-// Compare semver strings "x.y.z"
-inline bool isVersionNewer(String current, String latest) {
-  current.trim(); latest.trim();
-  int curMajor = 0, curMinor = 0, curPatch = 0;
-  int latMajor = 0, latMinor = 0, latPatch = 0;
-  sscanf(current.c_str(), "%d.%d.%d", &curMajor, &curMinor, &curPatch);
-  sscanf(latest.c_str(),  "%d.%d.%d", &latMajor, &latMinor, &latPatch);
-  if (latMajor > curMajor) return true;
-  if (latMajor < curMajor) return false;
-  if (latMinor > curMinor) return true;
-  if (latMinor < curMinor) return false;
-  return latPatch > curPatch;
-}
+uint32_t otaRetryAfterMs = 0;   // set when the server asks us to come back later
 
-inline void checkForOTAUpdate() {
+inline OtaCheckResult checkForOTAUpdate() {
   if (WiFi.status() != WL_CONNECTED) {
     printLog("OTA: WiFi not connected, skipping update check.");
-    return;
+    return OTA_CHECK_SKIPPED;
   }
 
-  WiFiClient client;
-  HTTPClient http;
   printLog("OTA: Checking for latest firmware version...");
-  String mac = WiFi.macAddress();
-  String versionCheckUrl = versionCheckBaseUrl + mac;
-  String firmwareBinUrl = firmwareBinBaseUrl + mac;
+  MacString mac = macAddressString();
+
+  FixedString<sizeof(versionCheckBaseUrl) + MAC_STRING_LEN> versionCheckUrl;
+  versionCheckUrl.append(versionCheckBaseUrl).append(mac);
+  FixedString<sizeof(firmwareBinBaseUrl) + MAC_STRING_LEN> firmwareBinUrl;
+  firmwareBinUrl.append(firmwareBinBaseUrl).append(mac);
 
-  Serial.println("http checking for:"+versionCheckUrl);
+  Serial.printf("http checking for:%s\n", versionCheckUrl.c_str());
   
-  http.begin(versionCheckUrl);
-  int httpCode = http.GET();
-  if (httpCode == 200) {
-    String payload = http.getString();
-    int dataIndex = payload.indexOf("\"data\":\"");
-    if (dataIndex != -1) {
-      int start = dataIndex + 8;
-      int end = payload.indexOf("\"", start);
-      String latestVersion = payload.substring(start, end);
-      bool canBeUpgradable = isVersionNewer(CURRENT_VERSION, latestVersion);
-      printLog("OTA: Current ver: " + CURRENT_VERSION + " Latest: " + latestVersion + " Upgradable: " + String(canBeUpgradable));
-      if (canBeUpgradable) {
-        printLog("OTA: Starting update...");
-        updatingFirmwareScreen();   // Show progress BEFORE the download starts
-        httpUpdate.rebootOnUpdate(false);
-        t_httpUpdate_return result = httpUpdate.update(client, firmwareBinUrl);
-        switch (result) {
-          case HTTP_UPDATE_FAILED:
-            Serial.printf("OTA: Update failed: %s\n", httpUpdate.getLastErrorString().c_str());
-            break;
-          case HTTP_UPDATE_NO_UPDATES:
-            printLog("OTA: No update available.");
-            break;
-          case HTTP_UPDATE_OK:
-            saveVersionToEEPROM(latestVersion);
-            printLog("OTA: Update successful. Rebooting...");
-            delay(500);
-            ESP.restart();
-            break;
-        }
-      } else {
-        printLog("OTA: Firmware up to date.");
-      }
-    } else {
-      printLog("OTA: Failed to parse version JSON.");
-    }
-  } else {
-    Serial.printf("OTA: Version fetch failed. HTTP code: %d\n", httpCode);
+  HttpLease lease = httpPoolBegin(versionCheckUrl.c_str());
+  if (!lease.http) return OTA_CHECK_FAILED;
+  HTTPClient &http = *lease.http;
+
+  // HTTP/1.0 keeps the server from chunk-encoding the reply, so the
+  // raw stream is exactly the JSON body and can be parsed in place.
+  // (It also closes the socket afterwards; the pool still saves the lookup.)
+  http.useHTTP10(true);
+  const char* wantedHeaders[] = { "Retry-After" };
+  http.collectHeaders(wantedHeaders, 1);
+  int httpCode = httpPoolGet(lease);
+
+  // Status, Retry-After and the body as otaschedule.h reads them
+  VersionString latestVersion;
+  Stream &body = http.getStream();
+  OtaCheckResult reply = otaReadReply(httpCode, http.header("Retry-After").c_str(), body,
+                                      http.getSize(), latestVersion, otaRetryAfterMs);
+  httpPoolEnd(lease);
+  if (reply == OTA_CHECK_THROTTLED) {
+    printLogf("OTA: Server busy (%d), retry after %lus", httpCode,
+              (unsigned long)(otaRetryAfterMs / 1000UL));
+    return reply;
+  }
+  if (reply != OTA_CHECK_UP_TO_DATE) {
+    if (httpCode != 200) Serial.printf("OTA: Version fetch failed. HTTP code: %d\n", httpCode);
+    else                 printLog("OTA: Failed to parse version JSON.");
+    return reply;
   }
-  http.end();
+
+  bool canBeUpgradable = isVersionNewer(CURRENT_VERSION.c_str(), latestVersion.c_str());
+  printLogf("OTA: Current ver: %s Latest: %s Upgradable: %d",
+            CURRENT_VERSION.c_str(), latestVersion.c_str(), canBeUpgradable);
+  if (!canBeUpgradable) {
+    printLog("OTA: Firmware up to date.");
+    return OTA_CHECK_UP_TO_DATE;
+  }
+
+  printLog("OTA: Starting update...");
+  updatingFirmwareScreen();   // Show progress BEFORE the download starts
+  if (!installFirmwareFrom(firmwareBinUrl.c_str(), CURRENT_VERSION.c_str())) {
+    return OTA_CHECK_FAILED;
+  }
+  saveVersionToEEPROM(latestVersion.c_str());
+  printLog("OTA: Update successful. Rebooting...");
+  delay(500);
+  ESP.restart();
+  return OTA_CHECK_UP_TO_DATE;
+}
+
+// -------------------
+// Check schedule (otaschedule.h)
+// -------------------
+Deadline    otaCheckAt;
+OtaSchedule otaSchedule;
+
+inline uint32_t otaRandomDelay(uint32_t maxMs) {
+  return maxMs ? (uint32_t)random(0, (long)maxMs) : 0;
+}
+
+inline void scheduleOTACheckIn(uint32_t delayMs) {
+  otaCheckAt.arm(msecs(delayMs));
+  Serial.printf("OTA: next check in %lus\n", (unsigned long)(delayMs / 1000UL));
+}
+
+inline void initOTASchedule() {
+  scheduleOTACheckIn(otaFirstCheckMs(otaSchedule, otaRandomDelay));
+}
+
+inline bool otaCheckDue() {
+  return otaCheckAt.expired();
+}
+
+// Runs the check if it's due and feeds the result back into the
+// schedule. Returns true if a check ran (the screen may have
+// been replaced by the update screen, so the caller redraws).
+inline bool handleOTASchedule() {
+  if (!otaCheckDue()) return false;
+
+  OtaCheckResult result = checkForOTAUpdate();
+  scheduleOTACheckIn(otaNextCheckMs(otaSchedule, result,
+                                    result == OTA_CHECK_THROTTLED ? otaRetryAfterMs : 0,
+                                    otaRandomDelay));
+  return true;
 }
 
 #endif // AUTO_UPDATE_LOGIC_H
\ No newline at end of file
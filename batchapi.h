@@ -0,0 +1,496 @@
+#ifndef BATCH_API_H
+#define BATCH_API_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <time.h>
+#include "globals.h"
+#include "fixedstring.h"
+#include "blelogic.h"
+#include "timerservice.h"
+#include "macrovm.h"
+
+// =============================================================
+// BATCHED COMMANDS AND DEVICE STATE
+// Automations used to drive the knob with one GET per action, and
+// the synchronous WebServer serves one request per loop() pass.
+// POST /api/batch (Content-Type: text/plain) takes several commands
+// in one request, one per line or separated by ';':
+//
+//   mode menu|volume|wake|timer|obs|doorlock|<macro name>
+//   stopwatch start|stop
+//   timer SECONDS [label]            countdown in the timer service
+//   message SECONDS text...          overlay, back to the mode after
+//   chord KEY [KEY...]               e.g. "chord gui alt shift k"
+//   media play|next|prev|stop|mute|volup|voldown
+//
+// All lines are parsed and checked (BLE up, a free timer, the
+// macro exists, ...) before anything runs. If one fails, nothing
+// is applied; otherwise all run back to back inside the same
+// handleClient() call, so no loop() pass sees half a batch.
+//
+// BLE starts on first use (blelogic.h). Checking has no side
+// effects, so a batch that is otherwise good but sends keys while
+// BLE is down starts it and is answered 503 "ble starting" with a
+// Retry-After: send it again once the host has reconnected.
+//
+// GET /api/state answers everything an automation would otherwise
+// poll endpoint by endpoint.
+// =============================================================
+
+#define BATCH_MAX_COMMANDS 16
+#define BATCH_MAX_BODY     1024
+#define BATCH_CHORD_MAX    6
+#define BATCH_CHORD_HOLD_MS 20       // same hold as the OBS combos
+#define BATCH_MAX_SECONDS  (7UL * 24 * 3600)
+#define BATCH_BLE_RETRY_S  3         // Retry-After for "ble starting"
+#define MESSAGE_MAX_SECONDS 3600
+
+extern MonoTime lastActivityTime;
+extern MonoTime lastDisplayUpdate;
+extern volatile int counter;
+extern void drawMenu(int yOffset, bool commit);
+extern void drawMessageScreen(const char* text);
+extern bool enterMenuItem(int item);
+extern void buzzerOff();
+
+const char* const appStateNames[] = {
+  "menu", "standby", "volume", "wake", "timer_set", "timer_running", "timer_paused",
+  "timer_ended", "obs", "doorlock", "stopwatch", "macro", "message",
+  "animating_to_standby", "animating_wake"
+};
+static_assert(sizeof(appStateNames) / sizeof(appStateNames[0]) == STATE_ANIMATING_WAKE + 1,
+              "appStateNames out of step with AppState");
+
+const char* const batchModeNames[MENU_BUILTIN_COUNT] = {
+  "volume", "wake", "timer", "obs", "doorlock"
+};
+
+struct BatchKeyName {
+  const char* name;
+  uint8_t     key;
+};
+
+const BatchKeyName batchKeyNames[] = {
+  { "ctrl", KEY_LEFT_CTRL },   { "shift", KEY_LEFT_SHIFT }, { "alt", KEY_LEFT_ALT },
+  { "gui", KEY_LEFT_GUI },     { "enter", KEY_RETURN },     { "esc", KEY_ESC },
+  { "tab", KEY_TAB },          { "space", ' ' },            { "backspace", KEY_BACKSPACE },
+  { "delete", KEY_DELETE },    { "insert", KEY_INSERT },    { "home", KEY_HOME },
+  { "end", KEY_END },          { "pageup", KEY_PAGE_UP },   { "pagedown", KEY_PAGE_DOWN },
+  { "up", KEY_UP_ARROW },      { "down", KEY_DOWN_ARROW },  { "left", KEY_LEFT_ARROW },
+  { "right", KEY_RIGHT_ARROW },
+  { "f1", KEY_F1 }, { "f2", KEY_F2 }, { "f3", KEY_F3 },   { "f4", KEY_F4 },
+  { "f5", KEY_F5 }, { "f6", KEY_F6 }, { "f7", KEY_F7 },   { "f8", KEY_F8 },
+  { "f9", KEY_F9 }, { "f10", KEY_F10 }, { "f11", KEY_F11 }, { "f12", KEY_F12 },
+};
+
+struct BatchMediaName {
+  const char*     name;
+  const uint8_t*  report;
+};
+
+const BatchMediaName batchMediaNames[] = {
+  { "play", KEY_MEDIA_PLAY_PAUSE },  { "next", KEY_MEDIA_NEXT_TRACK },
+  { "prev", KEY_MEDIA_PREVIOUS_TRACK }, { "stop", KEY_MEDIA_STOP },
+  { "mute", KEY_MEDIA_MUTE },        { "volup", KEY_MEDIA_VOLUME_UP },
+  { "voldown", KEY_MEDIA_VOLUME_DOWN },
+};
+
+enum BatchOp : uint8_t {
+  BATCH_MODE,
+  BATCH_STOPWATCH,
+  BATCH_TIMER,
+  BATCH_MESSAGE,
+  BATCH_CHORD,
+  BATCH_MEDIA,
+  BATCH_UNKNOWN
+};
+
+const char* const batchOpNames[] = {
+  "mode", "stopwatch", "timer", "message", "chord", "media", "unknown"
+};
+
+struct BatchCommand {
+  BatchOp  op;
+  int16_t  value;      // MODE: menu entry (-1 = menu); STOPWATCH: 1/0; MEDIA: table index
+  uint32_t seconds;    // TIMER, MESSAGE
+  uint8_t  keys[BATCH_CHORD_MAX];
+  uint8_t  keyCount;
+  StrView  text;       // TIMER label, MESSAGE text (points into the body)
+};
+
+struct BatchStats {
+  uint32_t batches;
+  uint32_t rejected;
+  uint32_t commands;
+  uint32_t lastApplyUs;
+  uint32_t maxApplyUs;
+};
+
+BatchStats batchStats = {};
+
+// -------------------
+// Mode changes shared with the single-purpose endpoints
+// -------------------
+// Let go of what the current mode holds before HTTP switches away
+inline void leaveModeForHttp() {
+  if (macroVm.loaded()) closeMacro();
+  if (currentState == STATE_TIMER_ENDED) buzzerOff();
+  enteredStandbyFromVolume   = false;
+  enteredStandbyFromDoorLock = false;
+  enteredStandbyFromOBS      = false;
+  enteredStandbyFromMacro    = false;
+}
+
+inline void goToMenu() {
+  leaveModeForHttp();
+  currentState      = STATE_MENU;
+  counter           = 0;
+  lastMenuSelection = -1;
+  lastActivityTime  = monoNow();
+  drawMenu(0, true);
+}
+
+inline void startStopwatch() {
+  leaveModeForHttp();
+  stopwatchElapsed     = 0;
+  stopwatchStartedAt   = monoNow();
+  stopwatchRunning     = true;
+  currentState         = STATE_STOPWATCH;
+  lastDisplayUpdate    = {};   // draw on the next pass
+}
+
+inline void stopStopwatch() {
+  stopwatchRunning = false;
+  stopwatchElapsed = 0;
+  goToMenu();
+}
+
+// Printable ASCII, with quotes/backslashes made JSON-safe
+inline void copyMessageText(StrView text) {
+  size_t n = 0;
+  for (size_t i = 0; i < text.len && n < MESSAGE_TEXT_MAX; i++) {
+    char c = text.ptr[i];
+    if (c < ' ' || c > '~') continue;
+    messageText[n++] = (c == '"' || c == '\\') ? '\'' : c;
+  }
+  messageText[n] = '\0';
+}
+
+inline void showMessage(StrView text, uint32_t seconds) {
+  copyMessageText(text);
+  messageEnd.arm(secs(seconds));
+  if (currentState != STATE_MESSAGE) {
+    bool animating = currentState == STATE_ANIMATING_TO_STANDBY ||
+                     currentState == STATE_ANIMATING_WAKE;
+    messageReturnState = animating ? postAnimState : currentState;
+    messageCounter     = counter;
+  }
+  if (currentState == STATE_TIMER_ENDED) buzzerOff();
+  currentState = STATE_MESSAGE;
+  drawMessageScreen(messageText);
+}
+
+// -------------------
+// Parsing
+// -------------------
+inline bool batchSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Next word of 'line' from pos; empty at the end
+inline StrView batchWord(StrView line, size_t &pos) {
+  while (pos < line.len && batchSpace(line.ptr[pos])) pos++;
+  size_t start = pos;
+  while (pos < line.len && !batchSpace(line.ptr[pos])) pos++;
+  return line.substr(start, pos - start);
+}
+
+// Everything after pos, trimmed
+inline StrView batchRest(StrView line, size_t pos) {
+  while (pos < line.len && batchSpace(line.ptr[pos])) pos++;
+  size_t end = line.len;
+  while (end > pos && batchSpace(line.ptr[end - 1])) end--;
+  return line.substr(pos, end - pos);
+}
+
+inline bool batchNumber(StrView word, uint32_t lo, uint32_t hi, uint32_t &out) {
+  if (word.len == 0 || word.len > 9) return false;
+  out = 0;
+  for (size_t i = 0; i < word.len; i++) {
+    if (word.ptr[i] < '0' || word.ptr[i] > '9') return false;
+    out = out * 10 + (word.ptr[i] - '0');
+  }
+  return out >= lo && out <= hi;
+}
+
+inline int batchMacroEntry(StrView name) {
+  for (int i = 0, count = macroCount(); i < count; i++) {
+    if (name.equals(macroSlots[macroSlotAt(i)].name)) return MENU_BUILTIN_COUNT + i;
+  }
+  return -1;
+}
+
+inline bool batchKey(StrView word, uint8_t &key) {
+  if (word.len == 1) {
+    key = (uint8_t)word.ptr[0];
+    return true;
+  }
+  for (const BatchKeyName &k : batchKeyNames) {
+    if (word.equals(k.name)) {
+      key = k.key;
+      return true;
+    }
+  }
+  return false;
+}
+
+// One line to a command; nullptr, or why it can't run
+inline const char* parseBatchLine(StrView line, BatchCommand &cmd) {
+  size_t pos = 0;
+  StrView verb = batchWord(line, pos);
+  cmd.op       = BATCH_UNKNOWN;
+  cmd.keyCount = 0;
+  cmd.seconds  = 0;
+  cmd.value    = 0;
+  cmd.text     = StrView();
+
+  if (verb.equals("mode")) {
+    cmd.op = BATCH_MODE;
+    StrView name = batchRest(line, pos);
+    if (name.equals("menu")) {
+      cmd.value = -1;
+      return nullptr;
+    }
+    for (int i = 0; i < MENU_BUILTIN_COUNT; i++) {
+      if (name.equals(batchModeNames[i])) {
+        cmd.value = i;
+        return nullptr;
+      }
+    }
+    cmd.value = batchMacroEntry(name);
+    return cmd.value < 0 ? "unknown mode" : nullptr;
+  }
+  if (verb.equals("stopwatch")) {
+    cmd.op = BATCH_STOPWATCH;
+    StrView arg = batchWord(line, pos);
+    if (arg.equals("start")) cmd.value = 1;
+    else if (!arg.equals("stop")) return "start or stop";
+    return nullptr;
+  }
+  if (verb.equals("timer")) {
+    cmd.op = BATCH_TIMER;
+    if (!batchNumber(batchWord(line, pos), 1, BATCH_MAX_SECONDS, cmd.seconds)) return "bad seconds";
+    cmd.text = batchRest(line, pos);
+    return nullptr;
+  }
+  if (verb.equals("message")) {
+    cmd.op = BATCH_MESSAGE;
+    if (!batchNumber(batchWord(line, pos), 1, MESSAGE_MAX_SECONDS, cmd.seconds)) return "bad seconds";
+    cmd.text = batchRest(line, pos);
+    if (cmd.text.len == 0) return "empty message";
+    if (cmd.text.len > MESSAGE_TEXT_MAX) return "message too long";
+    return nullptr;
+  }
+  if (verb.equals("chord")) {
+    cmd.op = BATCH_CHORD;
+    for (StrView key = batchWord(line, pos); key.len; key = batchWord(line, pos)) {
+      if (cmd.keyCount == BATCH_CHORD_MAX) return "too many keys";
+      if (!batchKey(key, cmd.keys[cmd.keyCount++])) return "unknown key";
+    }
+    if (cmd.keyCount == 0) return "no keys";
+    return nullptr;   // BLE is checked by runBatch()
+  }
+  if (verb.equals("media")) {
+    cmd.op = BATCH_MEDIA;
+    StrView name = batchWord(line, pos);
+    cmd.value = -1;
+    for (size_t i = 0; i < sizeof(batchMediaNames) / sizeof(batchMediaNames[0]); i++) {
+      if (name.equals(batchMediaNames[i].name)) cmd.value = i;
+    }
+    if (cmd.value < 0) return "unknown media key";
+    return nullptr;
+  }
+  return "unknown command";
+}
+
+// -------------------
+// Applying
+// -------------------
+// Returns the timer id for TIMER, else 0. Checked commands can't fail.
+inline TimerId applyBatchCommand(const BatchCommand &cmd) {
+  switch (cmd.op) {
+    case BATCH_MODE:
+      if (cmd.value < 0) {
+        goToMenu();
+      } else {
+        leaveModeForHttp();
+        enterMenuItem(cmd.value);
+      }
+      break;
+    case BATCH_STOPWATCH:
+      if (cmd.value) startStopwatch();
+      else           stopStopwatch();
+      break;
+    case BATCH_TIMER: {
+      FixedString<TIMER_LABEL_MAX> label(cmd.text.len ? cmd.text : StrView("Timer"));
+      return startCountdown(cmd.seconds * 1000UL, 0, label.c_str());
+    }
+    case BATCH_MESSAGE:
+      showMessage(cmd.text, cmd.seconds);
+      break;
+    case BATCH_CHORD:
+      for (uint8_t i = 0; i < cmd.keyCount; i++) bleKeyboard.press(cmd.keys[i]);
+      delay(BATCH_CHORD_HOLD_MS);
+      bleKeyboard.releaseAll();
+      break;
+    case BATCH_MEDIA:
+      bleKeyboard.write(batchMediaNames[cmd.value].report);
+      break;
+    case BATCH_UNKNOWN:
+      break;
+  }
+  return 0;
+}
+
+// Parse, check and (if all good) apply 'body'. Results go to json.
+// Returns the HTTP status.
+template<size_t N>
+inline int runBatch(StrView body, FixedString<N> &json) {
+  BatchCommand cmds[BATCH_MAX_COMMANDS];
+  const char*  errors[BATCH_MAX_COMMANDS];
+  uint8_t count = 0, timersNeeded = 0;
+  bool ok = true;
+
+  if (body.len > BATCH_MAX_BODY) {
+    json.append("{\"applied\":false,\"error\":\"body too large\"}");
+    return 413;
+  }
+  size_t start = 0;
+  for (size_t i = 0; i <= body.len; i++) {
+    if (i < body.len && body.ptr[i] != '\n' && body.ptr[i] != ';') continue;
+    StrView line = batchRest(body.substr(start, i - start), 0);
+    start = i + 1;
+    if (line.len == 0) continue;
+    if (count == BATCH_MAX_COMMANDS) {
+      json.append("{\"applied\":false,\"error\":\"too many commands\"}");
+      return 400;
+    }
+    errors[count] = parseBatchLine(line, cmds[count]);
+    if (!errors[count] && cmds[count].op == BATCH_TIMER) timersNeeded++;
+    ok &= (errors[count] == nullptr);
+    count++;
+  }
+  if (count == 0) {
+    json.append("{\"applied\":false,\"error\":\"no commands\"}");
+    return 400;
+  }
+  // The pool is the one resource a checked command can run out of
+  const TimerWheelStats &ts = timerWheel.stats();
+  if (ok && ts.active + timersNeeded > timerWheel.capacity()) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (cmds[i].op == BATCH_TIMER) errors[i] = "no free timer";
+    }
+    ok = false;
+  }
+
+  // BLE last, and only for a batch that would otherwise run:
+  // starting it is the one side effect checking may have
+  int status = 400;
+  if (ok) {
+    bool sendsKeys = false;
+    for (uint8_t i = 0; i < count; i++) {
+      sendsKeys |= cmds[i].op == BATCH_CHORD || cmds[i].op == BATCH_MEDIA;
+    }
+    const char* bleError = nullptr;
+    if (sendsKeys && !bleSubsys.up) {
+      bleUse();
+      bleError = "ble starting";
+      status   = 503;
+    } else if (sendsKeys && !bleUse()) {
+      bleError = "ble not connected";
+    }
+    if (bleError) {
+      for (uint8_t i = 0; i < count; i++) {
+        if (cmds[i].op == BATCH_CHORD || cmds[i].op == BATCH_MEDIA) errors[i] = bleError;
+      }
+      ok = false;
+    }
+  }
+
+  TimerId ids[BATCH_MAX_COMMANDS] = {};
+  uint32_t applyUs = 0;
+  if (ok) {
+    uint32_t t0 = micros();
+    for (uint8_t i = 0; i < count; i++) ids[i] = applyBatchCommand(cmds[i]);
+    applyUs = micros() - t0;
+    batchStats.batches++;
+    batchStats.commands   += count;
+    batchStats.lastApplyUs = applyUs;
+    if (applyUs > batchStats.maxApplyUs) batchStats.maxApplyUs = applyUs;
+  } else {
+    batchStats.rejected++;
+  }
+
+  json.appendf("{\"applied\":%s,\"applyUs\":%u,\"results\":[", ok ? "true" : "false",
+               (unsigned)applyUs);
+  for (uint8_t i = 0; i < count; i++) {
+    json.appendf("%s{\"cmd\":\"%s\",\"ok\":%s", i ? "," : "", batchOpNames[cmds[i].op],
+                 errors[i] ? "false" : "true");
+    if (errors[i]) json.appendf(",\"error\":\"%s\"", errors[i]);
+    if (ids[i])    json.appendf(",\"id\":%u", (unsigned)ids[i]);
+    json.append('}');
+  }
+  json.append("]}");
+  return ok ? 200 : status;
+}
+
+// -------------------
+// GET /api/state
+// -------------------
+template<size_t N>
+inline void deviceStateJson(FixedString<N> &json) {
+  AppState shown = currentState == STATE_MESSAGE ? messageReturnState : currentState;
+  json.appendf("{\"mode\":\"%s\",\"screen\":\"%s\",\"menuSelection\":%d,\"uptimeMs\":%llu,",
+               appStateNames[shown], appStateNames[currentState], menuSelection,
+               (unsigned long long)monoNow().ms());
+
+  time_t now = time(nullptr);
+  if (wallClockValid()) {
+    struct tm local;
+    localtime_r(&now, &local);
+    json.appendf("\"time\":\"%02d:%02d:%02d\",", local.tm_hour, local.tm_min, local.tm_sec);
+  } else {
+    json.append("\"time\":null,");
+  }
+
+  bool wifi = WiFi.status() == WL_CONNECTED;
+  json.appendf("\"wifi\":{\"connected\":%s,\"rssi\":%d},\"ble\":%s,",
+               wifi ? "true" : "false", wifi ? (int)WiFi.RSSI() : 0,
+               bleKeyboard.isConnected() ? "true" : "false");
+
+  unsigned long elapsed = stopwatchElapsed;
+  if (stopwatchRunning) elapsed += since(stopwatchStartedAt).toMs();
+  json.appendf("\"stopwatch\":{\"running\":%s,\"elapsedMs\":%lu},",
+               stopwatchRunning ? "true" : "false", elapsed);
+
+  int64_t left = knobTimerId ? timerRemainingMs(knobTimerId) : -1;
+  if (currentState == STATE_TIMER_PAUSED) left = (int64_t)timerRemainingMillis;
+  json.appendf("\"timer\":{\"remainingMs\":%lld,\"paused\":%s,\"ringing\":%s,\"active\":%u},",
+               (long long)left, currentState == STATE_TIMER_PAUSED ? "true" : "false",
+               currentState == STATE_TIMER_ENDED ? "true" : "false",
+               (unsigned)timerWheel.stats().active);
+
+  if (currentState == STATE_MESSAGE) {
+    json.appendf("\"message\":{\"text\":\"%s\",\"remainingMs\":%ld},", messageText,
+                 (long)messageEnd.remaining().toMs());
+  } else {
+    json.append("\"message\":null,");
+  }
+  if (macroVm.loaded()) json.appendf("\"macro\":\"%s\",", macroTitle);
+  else                  json.append("\"macro\":null,");
+
+  json.appendf("\"heapFree\":%u,\"batches\":%u,\"batchRejected\":%u,\"batchApplyUsMax\":%u}",
+               (unsigned)ESP.getFreeHeap(), (unsigned)batchStats.batches,
+               (unsigned)batchStats.rejected, (unsigned)batchStats.maxApplyUs);
+}
+
+#endif // BATCH_API_H
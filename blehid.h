@@ -0,0 +1,142 @@
+#ifndef BLE_HID_H
+#define BLE_HID_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEHIDDevice.h>
+#include <BLE2902.h>
+#include <BleKeyboard.h>   // KEY_* codes and MediaKeyReport only
+#include "hidreports.h"
+
+// =============================================================
+// BLE COMPOSITE HID (keyboard + media + dial)
+// Stands in for BleKeyboard, whose report map is fixed at keyboard
+// and media keys: same calls (press/release/write/releaseAll,
+// media reports, isConnected), plus the dial report from
+// hidreports.h for rotation.
+//
+// Every report still waits HID_REPORT_GAP_MS after the notify, as
+// BleKeyboard does, so hosts don't drop back-to-back reports. That
+// is where the dial pays off: a volume step as media keys is a
+// press and a release per detent; a dial report carries the whole
+// turn since the last loop() pass.
+//
+// Hosts cache the report map at bonding: after flashing this over
+// a BleKeyboard build, remove the knob on the host and pair again.
+//
+// end() takes Bluedroid and the controller down so their heap comes
+// back, and begin() may run again after it. The library keeps the
+// controller's static memory for that (deinit(false)), and the
+// GATT server and services it built can't be freed, so each cycle
+// leaves them behind; bonds stay in NVS either way.
+// =============================================================
+
+#define HID_REPORT_GAP_MS 7
+
+struct HidStats {
+  uint32_t keyboard;
+  uint32_t media;
+  uint32_t dial;
+};
+
+class BleKnobHid : public BLEServerCallbacks {
+ public:
+  BleKnobHid(const char* name, const char* manufacturer, uint8_t battery)
+    : name_(name), manufacturer_(manufacturer), battery_(battery), reports_(sendReport, this) {}
+
+  void begin() {
+    BLEDevice::init(name_);
+    BLEServer* server = BLEDevice::createServer();
+    server->setCallbacks(this);
+
+    hid_ = new BLEHIDDevice(server);
+    inputs_[HID_REPORT_KEYBOARD - 1] = hid_->inputReport(HID_REPORT_KEYBOARD);
+    inputs_[HID_REPORT_MEDIA - 1]    = hid_->inputReport(HID_REPORT_MEDIA);
+    inputs_[HID_REPORT_DIAL - 1]     = hid_->inputReport(HID_REPORT_DIAL);
+    hid_->outputReport(HID_REPORT_KEYBOARD);   // LEDs, ignored
+
+    hid_->manufacturer()->setValue(manufacturer_);
+    hid_->pnp(0x02, 0xe502, 0xa111, 0x0210);
+    hid_->hidInfo(0x00, 0x01);
+    hid_->reportMap((uint8_t*)hidReportMap, sizeof(hidReportMap));
+    hid_->startServices();
+
+    advertising_ = server->getAdvertising();
+    advertising_->setAppearance(HID_KEYBOARD);
+    advertising_->addServiceUUID(hid_->hidService()->getUUID());
+    advertising_->setScanResponse(false);
+    advertising_->start();
+    hid_->setBatteryLevel(battery_);
+  }
+
+  void end() {
+    stopping_ = true;   // no re-advertising from the disconnect it causes
+    if (advertising_) advertising_->stop();
+    BLEDevice::deinit(false);
+    delete hid_;
+    hid_         = nullptr;
+    advertising_ = nullptr;
+    for (BLECharacteristic* &c : inputs_) c = nullptr;
+    connected_ = false;
+    stopping_  = false;
+  }
+
+  bool isConnected() const { return connected_; }
+
+  size_t press(uint8_t k)                 { return reports_.press(k); }
+  size_t release(uint8_t k)               { return reports_.release(k); }
+  size_t write(uint8_t k)                 { return reports_.write(k); }
+  size_t write(const uint8_t* s, size_t n) { return reports_.write(s, n); }
+  size_t press(const MediaKeyReport m)    { return reports_.pressMedia(m); }
+  size_t release(const MediaKeyReport m)  { return reports_.releaseMedia(m); }
+  size_t write(const MediaKeyReport m)    { return reports_.writeMedia(m); }
+  void   releaseAll()                     { reports_.releaseAll(); }
+
+  uint8_t rotate(int32_t tenths) { return reports_.rotate(tenths); }
+  void    dialButton(bool down)  { reports_.dialButton(down); }
+
+  const HidStats &stats() const { return stats_; }
+
+  void onConnect(BLEServer*) override {
+    connected_ = true;
+    for (BLECharacteristic* c : inputs_) {
+      BLE2902* cccd = (BLE2902*)c->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+      if (cccd) cccd->setNotifications(true);
+    }
+  }
+
+  void onDisconnect(BLEServer*) override {
+    connected_ = false;
+    for (BLECharacteristic* c : inputs_) {
+      BLE2902* cccd = (BLE2902*)c->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+      if (cccd) cccd->setNotifications(false);
+    }
+    if (!stopping_) advertising_->start();
+  }
+
+ private:
+  static void sendReport(void* ctx, uint8_t id, const uint8_t* data, uint8_t len) {
+    BleKnobHid* self = (BleKnobHid*)ctx;
+    if (!self->connected_) return;
+    BLECharacteristic* input = self->inputs_[id - 1];
+    input->setValue((uint8_t*)data, len);
+    input->notify();
+    if (id == HID_REPORT_KEYBOARD)   self->stats_.keyboard++;
+    else if (id == HID_REPORT_MEDIA) self->stats_.media++;
+    else                             self->stats_.dial++;
+    delay(HID_REPORT_GAP_MS);
+  }
+
+  const char*        name_;
+  const char*        manufacturer_;
+  uint8_t            battery_;
+  HidReportState     reports_;
+  BLEHIDDevice*      hid_         = nullptr;
+  BLEAdvertising*    advertising_ = nullptr;
+  BLECharacteristic* inputs_[3]   = {};
+  volatile bool      connected_   = false;
+  volatile bool      stopping_    = false;
+  HidStats           stats_       = {};
+};
+
+#endif // BLE_HID_H
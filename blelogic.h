@@ -1,21 +1,75 @@
 #ifndef BLE_LOGIC_H
 #define BLE_LOGIC_H
 
-#include <BleKeyboard.h>
 #include "globals.h"
+#include "fixedstring.h"
+#include "knoblog.h"
+#include "blehid.h"
+#include "subsystems.h"
 
-BleKeyboard bleKeyboard("ESP32-C3 Knob", "Domestic Labs", 100);
+// BLE comes up the first time a mode or a request sends keys, not
+// at boot, and with BLE_IDLE_STOP_MS set goes down again once no
+// HID mode has been open and nothing was sent for that long.
+// Stopping drops the host's connection; entering a HID mode brings
+// it back in a second or two and the bond holds. Off by default:
+// each stop/start cycle leaks the GATT objects (blehid.h).
+#define BLE_LAZY_START    1
+#define BLE_IDLE_STOP_MS  0        // e.g. 600000 for ten minutes
 
-unsigned long lastKeySendTime = 0;
+BleKnobHid bleKeyboard("ESP32-C3 Knob", "Domestic Labs", 100);
+
+// Volume turns as media keys (every host) or as dial reports
+// (Windows' radial controller). POST /api/hid?dial=0|1
+bool     hidDialMode       = false;
+uint32_t hidVolumeTurns    = 0;
+uint32_t hidVolumeReports  = 0;
+
+MonoTime lastKeySendTime = {};
+
+Subsystem bleSubsys = { "ble" };
+MonoTime  bleLastUse = {};
 
 void initBLE() {
+  if (bleSubsys.up) return;
+  subsysStartBegin(bleSubsys);
   bleKeyboard.begin();
   
-  // Use working BLE stack
-  BLESecurity *pSecurity = new BLESecurity();
+  // Use working BLE stack. The parameters live in Bluedroid, so they
+  // go again after every begin(); the object itself only once.
+  static BLESecurity *pSecurity = new BLESecurity();
   pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
   pSecurity->setCapability(ESP_IO_CAP_NONE);
   pSecurity->setInitEncryptionKey(ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK);
+  subsysStartDone(bleSubsys);
+  KLOG_INFO(KLOG_TAG_BLE, "BLE started");
+}
+
+void stopBLE() {
+  if (!bleSubsys.up) return;
+  subsysStopBegin(bleSubsys);
+  bleKeyboard.releaseAll();
+  bleKeyboard.end();
+  subsysStopDone(bleSubsys);
+  KLOG_INFO(KLOG_TAG_BLE, "BLE stopped, idle");
+}
+
+// Before sending keys from outside a HID mode (batch, macros):
+// starts BLE if it is down. True if a host is connected.
+bool bleUse() {
+  bleLastUse = monoNow();
+  initBLE();
+  return bleKeyboard.isConnected();
+}
+
+// Once per loop() pass with whether the state sends keys
+void bleFollow(bool hidState) {
+  if (hidState) {
+    bleUse();
+    return;
+  }
+#if BLE_IDLE_STOP_MS
+  if (bleSubsys.up && since(bleLastUse) >= msecs(BLE_IDLE_STOP_MS)) stopBLE();
+#endif
 }
 
 char generateRandomLetter() {
@@ -25,30 +79,63 @@ char generateRandomLetter() {
 
 void handleWakeModeLogic() {
   if (bleKeyboard.isConnected()) { 
-    if (millis() - lastKeySendTime >= wakeModeKeyInterval) { 
+    if (since(lastKeySendTime) >= wakeModeKeyInterval) { 
       char randomLetter = generateRandomLetter();
       
       bleKeyboard.write(randomLetter);
-      Serial.print("Sent key: ");
-      Serial.println(randomLetter);
+      KLOG_INFO(KLOG_TAG_BLE, "Sent key: %c", randomLetter);
       
-      lastKeySendTime = millis();
+      lastKeySendTime = monoNow();
     }
   }
 }
 
-void sendVolumeUp() {
+// The encoder steps turned since the last loop() pass. Media keys
+// can only say up or down, so they send one tap (two reports) per
+// pass as before; the dial sends the whole turn in one report.
+void sendVolumeSteps(int steps) {
+  if (!bleKeyboard.isConnected() || !steps) return;
+  uint32_t before = bleKeyboard.stats().media + bleKeyboard.stats().dial;
+  if (hidDialMode) {
+    bleKeyboard.rotate((int32_t)steps * HID_DIAL_TENTHS_PER_STEP);
+  } else {
+    bleKeyboard.write(steps > 0 ? KEY_MEDIA_VOLUME_UP : KEY_MEDIA_VOLUME_DOWN);
+  }
+  hidVolumeTurns++;
+  hidVolumeReports += bleKeyboard.stats().media + bleKeyboard.stats().dial - before;
+  KLOG_DEBUG(KLOG_TAG_BLE, "Volume %+d (%s)", steps, hidDialMode ? "dial" : "keys");
+}
+
+void sendNextTrack() {
   if (bleKeyboard.isConnected()) {
-    bleKeyboard.write(KEY_MEDIA_VOLUME_UP);
-    Serial.println("Volume Up");
+    bleKeyboard.write(KEY_MEDIA_NEXT_TRACK);
+    KLOG_DEBUG(KLOG_TAG_BLE, "Next Track");
   }
 }
 
-void sendVolumeDown() {
+void sendPrevTrack() {
   if (bleKeyboard.isConnected()) {
-    bleKeyboard.write(KEY_MEDIA_VOLUME_DOWN);
-    Serial.println("Volume Down");
+    bleKeyboard.write(KEY_MEDIA_PREVIOUS_TRACK);
+    KLOG_DEBUG(KLOG_TAG_BLE, "Previous Track");
   }
 }
 
+void sendMute() {
+  if (bleKeyboard.isConnected()) {
+    bleKeyboard.write(KEY_MEDIA_MUTE);
+    KLOG_DEBUG(KLOG_TAG_BLE, "Mute");
+  }
+}
+
+template<size_t N>
+inline void hidStatsJson(FixedString<N> &json) {
+  const HidStats &st = bleKeyboard.stats();
+  uint32_t turns = hidVolumeTurns ? hidVolumeTurns : 1;
+  json.appendf("{\"dial\":%s,\"connected\":%s,\"reports\":{\"keyboard\":%u,\"media\":%u,"
+               "\"dial\":%u},\"volumeTurns\":%u,\"reportsPerTurnX10\":%u}",
+               hidDialMode ? "true" : "false", bleKeyboard.isConnected() ? "true" : "false",
+               (unsigned)st.keyboard, (unsigned)st.media, (unsigned)st.dial,
+               (unsigned)hidVolumeTurns, (unsigned)(hidVolumeReports * 10 / turns));
+}
+
 #endif
\ No newline at end of file
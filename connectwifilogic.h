@@ -5,11 +5,80 @@
 #include <WiFi.h>
 #include <WebServer.h>
 #include "globals.h"
+#include "fixedstring.h"
 
 // External server object defined in the main sketch
 extern WebServer server;
 bool configReceived = false;
 
+// "AA:BB:CC:DD:EE:FF"
+#define MAC_STRING_LEN 18
+typedef FixedString<MAC_STRING_LEN> MacString;
+
+inline MacString macAddressString() {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  MacString out;
+  out.appendf("%02X:%02X:%02X:%02X:%02X:%02X",
+              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return out;
+}
+
+// Scan results are copied into fixed slots once when the portal
+// starts, then streamed into the page on every request.
+#define PORTAL_MAX_NETWORKS 12
+
+struct PortalNetwork {
+  char ssid[33];
+  int  rssi;
+};
+PortalNetwork portalNetworks[PORTAL_MAX_NETWORKS];
+int portalNetworkCount = 0;
+
+const char PORTAL_PAGE_HEAD[] PROGMEM = R"rawliteral(
+<!DOCTYPE html>
+<html>
+<head>
+  <title>WiFi Config</title>
+  <meta name='viewport' content='width=device-width, initial-scale=1'>
+  <style>
+    body { font-family: Arial; background-color: #f4f4f4; padding: 20px; }
+    .container { background: #fff; padding: 20px; border-radius: 10px; box-shadow: 0 4px 8px rgba(0,0,0,0.1); max-width: 400px; margin: auto; }
+    h2 { text-align: center; color: #333; }
+    .mac { text-align: center; color: #666; font-size: 0.8em; margin-bottom: 20px; }
+    .networks { background: #eee; padding: 10px; border-radius: 5px; max-height: 150px; overflow-y: auto; margin-bottom: 20px; }
+    .networks ul { list-style: none; padding: 0; }
+    .networks li { padding: 5px 0; border-bottom: 1px solid #ddd; }
+    .networks a { color: #28a745; text-decoration: none; font-weight: bold; }
+    input { width: 100%; padding: 10px; margin: 10px 0; border: 1px solid #ccc; border-radius: 5px; box-sizing: border-box; }
+    input[type='submit'] { background: #28a745; color: white; border: none; cursor: pointer; font-size: 16px; }
+    input[type='submit']:hover { background: #218838; }
+  </style>
+  <script>
+    function fillSSID(ssid) {
+      document.getElementById('ssid').value = ssid;
+    }
+  </script>
+</head>
+<body>
+  <div class='container'>
+    <h2>WiFi Setup</h2>
+    <div class='mac'>Device MAC: )rawliteral";
+
+const char PORTAL_PAGE_MID[] PROGMEM = R"rawliteral(</div>
+    <h4>Available Networks (Click to select):</h4>
+    <div class='networks'>)rawliteral";
+
+const char PORTAL_PAGE_TAIL[] PROGMEM = R"rawliteral(</div>
+    <form action='/save' method='POST'>
+      <input type='text' name='ssid' id='ssid' placeholder='SSID' required>
+      <input type='password' name='pass' placeholder='Password' required>
+      <input type='submit' value='Save & Connect'>
+    </form>
+  </div>
+</body>
+</html>)rawliteral";
+
 /**
  * Attempts to connect to WiFi using saved credentials.
  * Returns true if connected, false if the config portal is needed.
@@ -21,9 +90,9 @@ bool connectToWiFi() {
   WiFi.begin(); // Uses credentials stored in NVS automatically
 
   Serial.println("Attempting to connect to saved WiFi...");
-  unsigned long startAttempt = millis();
+  MonoTime startAttempt = monoNow();
 
-  while (WiFi.status() != WL_CONNECTED && millis() - startAttempt < 10000) {
+  while (WiFi.status() != WL_CONNECTED && since(startAttempt) < 10_s) {
     delay(500);
     Serial.print(".");
   }
@@ -55,61 +124,39 @@ void setupConfigPortal() {
 
   // Scan for nearby networks
   int n = WiFi.scanNetworks();
-  String networkList = "<ul>";
-  if (n == 0) {
-    networkList += "<li>No networks found</li>";
-  } else {
-    for (int i = 0; i < n; ++i) {
-      String ssid = WiFi.SSID(i);
-      int rssi = WiFi.RSSI(i);
-      networkList += "<li><a href='#' onclick='fillSSID(\"" + ssid + "\")'>" + ssid + "</a> (" + String(rssi) + " dBm)</li>";
-    }
+  portalNetworkCount = 0;
+  for (int i = 0; i < n && portalNetworkCount < PORTAL_MAX_NETWORKS; ++i) {
+    PortalNetwork &net = portalNetworks[portalNetworkCount++];
+    strlcpy(net.ssid, WiFi.SSID(i).c_str(), sizeof(net.ssid));
+    net.rssi = WiFi.RSSI(i);
   }
-  networkList += "</ul>";
 
-  // --- Portal landing page ---
-  server.on("/", [networkList]() {
-    String mac = WiFi.macAddress();
-    String html = R"rawliteral(
-<!DOCTYPE html>
-<html>
-<head>
-  <title>WiFi Config</title>
-  <meta name='viewport' content='width=device-width, initial-scale=1'>
-  <style>
-    body { font-family: Arial; background-color: #f4f4f4; padding: 20px; }
-    .container { background: #fff; padding: 20px; border-radius: 10px; box-shadow: 0 4px 8px rgba(0,0,0,0.1); max-width: 400px; margin: auto; }
-    h2 { text-align: center; color: #333; }
-    .mac { text-align: center; color: #666; font-size: 0.8em; margin-bottom: 20px; }
-    .networks { background: #eee; padding: 10px; border-radius: 5px; max-height: 150px; overflow-y: auto; margin-bottom: 20px; }
-    .networks ul { list-style: none; padding: 0; }
-    .networks li { padding: 5px 0; border-bottom: 1px solid #ddd; }
-    .networks a { color: #28a745; text-decoration: none; font-weight: bold; }
-    input { width: 100%; padding: 10px; margin: 10px 0; border: 1px solid #ccc; border-radius: 5px; box-sizing: border-box; }
-    input[type='submit'] { background: #28a745; color: white; border: none; cursor: pointer; font-size: 16px; }
-    input[type='submit']:hover { background: #218838; }
-  </style>
-  <script>
-    function fillSSID(ssid) {
-      document.getElementById('ssid').value = ssid;
+  // --- Portal landing page (streamed in chunks, never built whole) ---
+  server.on("/", []() {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/html", "");
+    server.sendContent_P(PORTAL_PAGE_HEAD);
+    MacString mac = macAddressString();
+    server.sendContent(mac.c_str(), mac.length());
+    server.sendContent_P(PORTAL_PAGE_MID);
+
+    FixedString<128> item;
+    item = "<ul>";
+    if (portalNetworkCount == 0) {
+      item += "<li>No networks found</li>";
     }
-  </script>
-</head>
-<body>
-  <div class='container'>
-    <h2>WiFi Setup</h2>
-    <div class='mac'>Device MAC: )rawliteral" + mac + R"rawliteral(</div>
-    <h4>Available Networks (Click to select):</h4>
-    <div class='networks'>)rawliteral" + networkList + R"rawliteral(</div>
-    <form action='/save' method='POST'>
-      <input type='text' name='ssid' id='ssid' placeholder='SSID' required>
-      <input type='password' name='pass' placeholder='Password' required>
-      <input type='submit' value='Save & Connect'>
-    </form>
-  </div>
-</body>
-</html>)rawliteral";
-    server.send(200, "text/html", html);
+    server.sendContent(item.c_str(), item.length());
+    for (int i = 0; i < portalNetworkCount; ++i) {
+      const PortalNetwork &net = portalNetworks[i];
+      item.clear();
+      item.appendf("<li><a href='#' onclick='fillSSID(\"%s\")'>%s</a> (%d dBm)</li>",
+                   net.ssid, net.ssid, net.rssi);
+      server.sendContent(item.c_str(), item.length());
+    }
+    server.sendContent("</ul>", 5);
+
+    server.sendContent_P(PORTAL_PAGE_TAIL);
+    server.sendContent("", 0);   // terminate chunked response
   });
 
   // --- Credential save handler ---
@@ -127,8 +174,8 @@ void setupConfigPortal() {
     WiFi.mode(WIFI_STA);
     WiFi.begin(ssid.c_str(), pass.c_str());
 
-    unsigned long start = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - start < 15000) {
+    MonoTime start = monoNow();
+    while (WiFi.status() != WL_CONNECTED && since(start) < 15_s) {
       delay(500);
       Serial.print(".");
     }
@@ -0,0 +1,227 @@
+#ifndef CORO_CODE_H
+#define CORO_CODE_H
+
+#include <stdint.h>
+#include "monotime.h"
+
+// =============================================================
+// COROUTINES
+// Stackless cooperative coroutines for mode logic, so "press the
+// chord, wait 20 ms, release" reads as one sequence instead of a
+// delay() or another pair of flag + timestamp globals:
+//
+//   struct ObsChord : CoTask { int8_t dir; };
+//
+//   void obsChordBody(CoTask &t) {
+//     ObsChord &f = static_cast<ObsChord&>(t);
+//     CO_BEGIN(t);
+//     for (;;) {
+//       CO_AWAIT_INPUT(t);
+//       f.dir = coInput(t);
+//       pressChord(f.dir);
+//       CO_SLEEP(t, 20_ms);
+//       releaseAll();
+//     }
+//     CO_END(t);
+//   }
+//
+// The toolchain (GCC 8, gnu++17) has no C++20 coroutines, so
+// these are protothreads: a body is re-entered through a switch on
+// the line it last suspended at. Locals do not survive a suspend;
+// anything the body keeps goes in its frame, a CoTask subclass
+// allocated statically by its owner. The scheduler only keeps
+// pointers, so there is no heap and no stack per coroutine — a
+// frame is a few dozen bytes where a FreeRTOS task costs its TCB
+// plus a 3-4 KB stack.
+//
+// A suspended body waits for one of:
+//   CO_SLEEP(t, d) / CO_SLEEP_UNTIL(t, at)   the clock
+//   CO_AWAIT_INPUT(t)                        coPost() to this task
+//   CO_AWAIT_INPUT_FOR(t, d)                 either; coTimedOut(t)
+//   CO_YIELD(t)                              the next tick
+// and the body must not use switch itself across a suspend point.
+//
+// Pure C++ with no Arduino dependencies: modetasks.h runs the
+// knob's mode coroutines, tools/corobench.cpp checks the scheduler
+// and measures a resume.
+// =============================================================
+
+enum CoWait : uint8_t {
+  CO_STOPPED,     // not started, finished or stopped
+  CO_READY,       // resume at the next tick
+  CO_SLEEPING,    // until wakeAt
+  CO_INPUT,       // until an input is posted
+  CO_INPUT_OR_TIME
+};
+
+struct CoTask;
+typedef void (*CoBody)(CoTask &t);
+
+struct CoTask {
+  const char* name;
+  CoBody      body;
+  uint16_t    resumeLine    = 0;
+  CoWait      wait          = CO_STOPPED;
+  bool        inputPending  = false;
+  bool        timedOut      = false;
+  int16_t     input         = 0;
+  MonoTime    wakeAt        = {};
+  uint32_t    resumes       = 0;
+
+  CoTask(const char* n, CoBody b) : name(n), body(b) {}
+};
+
+inline int16_t coInput(const CoTask &t)   { return t.input; }
+inline bool    coTimedOut(const CoTask &t) { return t.timedOut; }
+
+// -------------------
+// Body macros
+// -------------------
+#define CO_BEGIN(t)  switch ((t).resumeLine) { case 0:
+#define CO_END(t)    } (t).resumeLine = 0; (t).wait = CO_STOPPED; return
+
+#define CO_SUSPEND_(t, w) \
+  (t).wait = (w); (t).resumeLine = __LINE__; return; case __LINE__:
+
+#define CO_YIELD(t) do { CO_SUSPEND_(t, CO_READY); } while (0)
+
+#define CO_SLEEP_UNTIL(t, at) do {       \
+    (t).wakeAt = (at);                   \
+    CO_SUSPEND_(t, CO_SLEEPING);         \
+  } while (0)
+
+#define CO_SLEEP(t, d) CO_SLEEP_UNTIL(t, monoNow() + (d))
+
+// An input posted while the body was busy is taken at once
+#define CO_AWAIT_INPUT(t) do {                          \
+    if (!(t).inputPending) { CO_SUSPEND_(t, CO_INPUT); } \
+    (t).inputPending = false;                           \
+  } while (0)
+
+#define CO_AWAIT_INPUT_FOR(t, d) do {                   \
+    (t).timedOut = false;                               \
+    if (!(t).inputPending) {                            \
+      (t).wakeAt = monoNow() + (d);                     \
+      CO_SUSPEND_(t, CO_INPUT_OR_TIME);                 \
+    }                                                   \
+    if ((t).inputPending) (t).inputPending = false;     \
+    else                  (t).timedOut = true;          \
+  } while (0)
+
+// -------------------
+// Scheduler
+// -------------------
+struct CoStats {
+  uint32_t ticks;
+  uint32_t resumes;
+  uint32_t posts;
+  uint32_t postsDropped;   // posted to a stopped task
+};
+
+template<uint8_t N>
+class CoScheduler {
+ public:
+  // (Re)start t from the top, with no input pending
+  bool start(CoTask &t) {
+    int8_t i = indexOf(t);
+    if (i < 0) {
+      if (count_ >= N) return false;
+      tasks_[count_++] = &t;
+    }
+    t.resumeLine   = 0;
+    t.inputPending = false;
+    t.timedOut     = false;
+    t.wait         = CO_READY;
+    resume(t);
+    return true;
+  }
+
+  // Safe from inside a body: the slot is freed at the end of tick()
+  void stop(CoTask &t) {
+    t.wait       = CO_STOPPED;
+    t.resumeLine = 0;
+  }
+
+  bool running(const CoTask &t) const { return t.wait != CO_STOPPED; }
+
+  // Hand t an input (the latest wins if it hasn't taken the last
+  // one yet). A task waiting for input runs before post() returns,
+  // so the action lands in the same loop pass as the event.
+  void post(CoTask &t, int16_t value) {
+    if (t.wait == CO_STOPPED) {
+      stats_.postsDropped++;
+      return;
+    }
+    stats_.posts++;
+    t.input        = value;
+    t.inputPending = true;
+    if (t.wait == CO_INPUT || t.wait == CO_INPUT_OR_TIME) resume(t);
+  }
+
+  // Resume every task whose wait is over; returns how many ran.
+  // A task that re-suspends runs again next tick at the earliest.
+  uint8_t tick(MonoTime now) {
+    stats_.ticks++;
+    uint8_t ran = 0;
+    for (uint8_t i = 0; i < count_; i++) {
+      CoTask &t = *tasks_[i];
+      if (!due(t, now)) continue;
+      resume(t);
+      ran++;
+    }
+    // Finished tasks leave the list
+    for (uint8_t i = 0; i < count_;) {
+      if (tasks_[i]->wait == CO_STOPPED) tasks_[i] = tasks_[--count_];
+      else i++;
+    }
+    return ran;
+  }
+
+  // Time until the earliest timed wake, or -1 with none (for sleep)
+  Duration idleFor(MonoTime now) const {
+    Duration best = { -1 };
+    for (uint8_t i = 0; i < count_; i++) {
+      const CoTask &t = *tasks_[i];
+      if (t.wait == CO_READY || (t.wait == CO_INPUT && t.inputPending)) return { 0 };
+      if (t.wait != CO_SLEEPING && t.wait != CO_INPUT_OR_TIME) continue;
+      Duration left = t.wakeAt - now;
+      if (left.us < 0) left = { 0 };
+      if (best.us < 0 || left < best) best = left;
+    }
+    return best;
+  }
+
+  uint8_t size() const { return count_; }
+  const CoTask &task(uint8_t i) const { return *tasks_[i]; }
+  const CoStats &stats() const { return stats_; }
+
+ private:
+  static bool due(const CoTask &t, MonoTime now) {
+    switch (t.wait) {
+      case CO_READY:         return true;
+      case CO_SLEEPING:      return now >= t.wakeAt;
+      case CO_INPUT:         return t.inputPending;
+      case CO_INPUT_OR_TIME: return t.inputPending || now >= t.wakeAt;
+      default:               return false;
+    }
+  }
+
+  void resume(CoTask &t) {
+    t.resumes++;
+    stats_.resumes++;
+    t.body(t);
+  }
+
+  int8_t indexOf(const CoTask &t) const {
+    for (uint8_t i = 0; i < count_; i++) {
+      if (tasks_[i] == &t) return i;
+    }
+    return -1;
+  }
+
+  CoTask* tasks_[N] = {};
+  uint8_t count_    = 0;
+  CoStats stats_    = {};
+};
+
+#endif // CORO_CODE_H
@@ -2,37 +2,42 @@
 #define HTTPLOGGING_H
 
 #include "globals.h"
+#include "fixedstring.h"
+#include "httppool.h"
 
 bool REMOTE_LOGGING = false;
 
+#define LOG_LINE_MAX 160   // longest single log line, including NUL
+
 
 // -------------------
 // HTTP logging function
 // -------------------
-int loggHttp(const String &value) {
-  HTTPClient http;
-
-
-  http.setTimeout(2000);  // 2-second timeout (recommended)
-  http.begin(baseLoggingUrl);
-  http.addHeader("Content-Type", "text/plain");
+int loggHttp(const char* value) {
+  HttpLease lease = httpPoolBegin(baseLoggingUrl, 2000);  // 2-second timeout (recommended)
+  if (!lease.http) {
+    Serial.println(value);
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  lease.http->addHeader("Content-Type", "text/plain");
 
-  int httpCode = http.POST(value);
+  int httpCode = httpPoolPost(lease, (const uint8_t*)value, strlen(value));
 
   if (httpCode == 200) {
-    Serial.println("Successfully logged: " + value);
+    Serial.print("Successfully logged: ");
+    Serial.println(value);
   } else {
-    Serial.println("Error logging: " + String(httpCode));
+    Serial.printf("Error logging: %d\n", httpCode);
   }
 
-  http.end();
+  httpPoolEnd(lease);
   return httpCode;
 }
 
 // -------------------
 // Unified print function
 // -------------------
-inline void printLog(const String &msg) {
+inline void printLog(const char* msg) {
   if (REMOTE_LOGGING) {
     int r = loggHttp(msg);
     // Optional: do something if r != 200
@@ -41,8 +46,21 @@ inline void printLog(const String &msg) {
   }
 }
 
-inline void printLogForce(const String &msg) {
+inline void printLogForce(const char* msg) {
     int r = loggHttp(msg);
 }
 
-#endif // GLOBALS_H
\ No newline at end of file
+// -------------------
+// Formatted variant — builds the line in a stack buffer
+// -------------------
+inline void printLogf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+inline void printLogf(const char* fmt, ...) {
+  FixedString<LOG_LINE_MAX> line;
+  va_list args;
+  va_start(args, fmt);
+  line.appendv(fmt, args);
+  va_end(args);
+  printLog(line.c_str());
+}
+
+#endif // GLOBALS_H
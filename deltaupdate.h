@@ -0,0 +1,362 @@
+#ifndef DELTA_UPDATE_H
+#define DELTA_UPDATE_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include "mbedtls/sha256.h"
+#include "customHttpLogging.h"
+#include "heatshrinkstream.h"
+#include "monotime.h"
+
+// =============================================================
+// STREAMING FIRMWARE INSTALL  (full image or delta)
+//
+// The firmware endpoint is asked for a delta against the running
+// version. The server answers either with a raw .bin or with a
+// delta (Content-Type: application/x-knob-delta) produced by
+// tools/mkdelta.cpp. Both are streamed into the update partition
+// through a single DELTA_CHUNK_SIZE buffer — the image is never
+// held in RAM. A SHA-256 of the bytes written is compared with
+// the expected digest before the partition is marked bootable.
+//
+// Either body may additionally be compressed for the transfer
+// (Content-Encoding: heatshrink-W-L). It is then decoded on the
+// fly by HeatshrinkStream; raw images must then also carry their
+// decoded size in X-Decoded-Length. Servers that don't compress
+// ignore our Accept-Encoding and we take the plain body.
+//
+// A delta only applies to the image it was made from, and the server
+// picks that from ?from=, which comes from the EEPROM version. The
+// header carries the base image's digest, and the first oldSize
+// bytes of the running partition are hashed and compared before
+// anything is written. On a mismatch, or any other delta failure,
+// the image is fetched again with deltas refused.
+//
+// Delta format (all integers little-endian):
+//   header  "KDL2"  u32 oldSize  u32 newSize  u8 oldSha256[32]  u8 newSha256[32]
+//   ops     'C' u32 offset u32 len   copy len bytes of the running image
+//           'A' u32 len  <len bytes> append literal bytes
+//           'E'                      end (must land exactly on newSize)
+// =============================================================
+
+#define DELTA_CONTENT_TYPE   "application/x-knob-delta"
+#define DELTA_MAGIC          "KDL2"
+#define DELTA_HEADER_SIZE    76
+#define DELTA_CHUNK_SIZE     1024
+#define FIRMWARE_SHA_HEADER  "X-Firmware-SHA256"   // optional, for raw images
+#define FIRMWARE_DECODED_LENGTH_HEADER "X-Decoded-Length"
+#define FIRMWARE_ACCEPT_ENCODING "heatshrink-10-4, identity"
+#define FIRMWARE_ACCEPT_DELTA    DELTA_CONTENT_TYPE ", application/octet-stream"
+#define FIRMWARE_ACCEPT_FULL     "application/octet-stream"
+#define FIRMWARE_HTTP_TIMEOUT_MS 15000
+
+static uint8_t firmwareChunk[DELTA_CHUNK_SIZE];
+
+// Last install, for logging/benchmarks
+struct FirmwareInstallStats {
+  bool     wasDelta;
+  bool     fellBackToFull;  // a delta failed and the full image was fetched
+  bool     wasCompressed;
+  uint32_t bytesReceived;   // over the wire (before transport decoding)
+  uint32_t bodyBytes;       // delta/raw bytes after transport decoding
+  uint32_t imageSize;       // bytes written to flash
+  uint32_t elapsedMs;
+};
+FirmwareInstallStats lastInstallStats = {};
+
+// -------------------
+// Writes to the update partition while hashing what was written.
+// -------------------
+class FirmwareWriter {
+ public:
+  bool begin(size_t imageSize) {
+    written_ = 0;
+    mbedtls_sha256_init(&sha_);
+    mbedtls_sha256_starts(&sha_, 0);   // 0 = SHA-256, not SHA-224
+    if (!Update.begin(imageSize)) {
+      printLogf("OTA: Update.begin failed: %s", Update.errorString());
+      return false;
+    }
+    return true;
+  }
+
+  bool write(uint8_t* data, size_t len) {
+    mbedtls_sha256_update(&sha_, data, len);
+    if (Update.write(data, len) != len) {
+      printLogf("OTA: flash write failed at %u: %s", (unsigned)written_, Update.errorString());
+      return false;
+    }
+    written_ += len;
+    return true;
+  }
+
+  // Verify and commit. expectedSha may be null when the server sent
+  // no digest (raw image without header) — ESP-IDF's own image
+  // validation in Update.end() still applies then.
+  bool finish(const uint8_t* expectedSha) {
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha_, digest);
+    mbedtls_sha256_free(&sha_);
+
+    if (expectedSha && memcmp(digest, expectedSha, sizeof(digest)) != 0) {
+      printLog("OTA: SHA-256 mismatch — image discarded.");
+      Update.abort();
+      return false;
+    }
+    if (!Update.end(true)) {
+      printLogf("OTA: Update.end failed: %s", Update.errorString());
+      return false;
+    }
+    return true;
+  }
+
+  void abort() {
+    mbedtls_sha256_free(&sha_);
+    Update.abort();
+  }
+
+  size_t written() const { return written_; }
+
+ private:
+  mbedtls_sha256_context sha_;
+  size_t written_ = 0;
+};
+
+// Read exactly len bytes (Stream timeout per byte). False on short read.
+inline bool readFully(Stream &in, uint8_t* dst, size_t len) {
+  while (len > 0) {
+    size_t got = in.readBytes(dst, len);
+    if (got == 0) return false;
+    dst += got;
+    len -= got;
+  }
+  return true;
+}
+
+inline bool readU32(Stream &in, uint32_t &out) {
+  uint8_t b[4];
+  if (!readFully(in, b, 4)) return false;
+  out = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+  return true;
+}
+
+inline bool parseHexDigest(const char* hex, uint8_t out[32]) {
+  if (strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    unsigned v;
+    if (sscanf(hex + 2 * i, "%2x", &v) != 1) return false;
+    out[i] = (uint8_t)v;
+  }
+  return true;
+}
+
+// SHA-256 of the first 'size' bytes of a partition
+inline bool hashPartition(const esp_partition_t* part, uint32_t size, uint8_t digest[32]) {
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  bool ok = true;
+  for (uint32_t at = 0; at < size && ok; at += DELTA_CHUNK_SIZE) {
+    size_t n = size - at < DELTA_CHUNK_SIZE ? size - at : DELTA_CHUNK_SIZE;
+    ok = esp_partition_read(part, at, firmwareChunk, n) == ESP_OK;
+    if (ok) mbedtls_sha256_update(&sha, firmwareChunk, n);
+  }
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  return ok;
+}
+
+// -------------------
+// Delta apply: old image comes from the running partition
+// -------------------
+inline bool applyDeltaStream(Stream &in, uint32_t &bytesIn, uint32_t &imageSize) {
+  uint8_t header[DELTA_HEADER_SIZE];
+  if (!readFully(in, header, sizeof(header)) || memcmp(header, DELTA_MAGIC, 4) != 0) {
+    printLog("OTA: bad delta header.");
+    return false;
+  }
+  uint32_t oldSize = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+  uint32_t newSize = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+  const uint8_t* oldSha = header + 12;
+  const uint8_t* newSha = header + 44;
+  bytesIn   = sizeof(header);
+  imageSize = newSize;
+
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  if (!running || oldSize > running->size) {
+    printLog("OTA: delta base does not fit the running partition.");
+    return false;
+  }
+  uint8_t runningSha[32];
+  if (!hashPartition(running, oldSize, runningSha) || memcmp(runningSha, oldSha, 32) != 0) {
+    printLog("OTA: delta made for another base image.");
+    return false;
+  }
+
+  FirmwareWriter writer;
+  if (!writer.begin(newSize)) return false;
+
+  for (;;) {
+    uint8_t op;
+    if (!readFully(in, &op, 1)) break;
+    bytesIn++;
+
+    if (op == 'E') {
+      if (writer.written() != newSize) break;
+      return writer.finish(newSha);
+    }
+
+    uint32_t offset = 0, len = 0;
+    if (op == 'C') {
+      if (!readU32(in, offset) || !readU32(in, len)) break;
+      bytesIn += 8;
+      if ((uint64_t)offset + len > oldSize) break;
+    } else if (op == 'A') {
+      if (!readU32(in, len)) break;
+      bytesIn += 4;
+    } else {
+      break;
+    }
+    if (writer.written() + len > newSize) break;
+
+    while (len > 0) {
+      size_t n = len < DELTA_CHUNK_SIZE ? len : DELTA_CHUNK_SIZE;
+      if (op == 'C') {
+        if (esp_partition_read(running, offset, firmwareChunk, n) != ESP_OK) break;
+        offset += n;
+      } else {
+        if (!readFully(in, firmwareChunk, n)) break;
+        bytesIn += n;
+      }
+      if (!writer.write(firmwareChunk, n)) break;
+      len -= n;
+    }
+    if (len > 0) break;
+  }
+
+  printLogf("OTA: delta stream corrupt or truncated after %u bytes.", (unsigned)bytesIn);
+  writer.abort();
+  return false;
+}
+
+// -------------------
+// Full image, streamed as-is
+// -------------------
+inline bool installRawStream(Stream &in, int contentLength, const uint8_t* expectedSha,
+                             uint32_t &bytesIn) {
+  bytesIn = 0;
+  if (contentLength <= 0) {
+    printLog("OTA: raw image without Content-Length refused.");
+    return false;
+  }
+  FirmwareWriter writer;
+  if (!writer.begin(contentLength)) return false;
+
+  uint32_t remaining = contentLength;
+  while (remaining > 0) {
+    size_t n = remaining < DELTA_CHUNK_SIZE ? remaining : DELTA_CHUNK_SIZE;
+    if (!readFully(in, firmwareChunk, n) || !writer.write(firmwareChunk, n)) {
+      printLogf("OTA: raw download stopped at %u/%d bytes.", (unsigned)bytesIn, contentLength);
+      writer.abort();
+      return false;
+    }
+    bytesIn   += n;
+    remaining -= n;
+  }
+  return writer.finish(expectedSha);
+}
+
+// -------------------
+// Fetch + install. fromVersion is sent so the server can pick a
+// delta base; servers that don't know about deltas ignore it and
+// reply with the full image.
+// -------------------
+inline bool fetchAndInstall(const char* requestUrl, bool acceptDelta, bool &isDelta) {
+  WiFiClient client;
+  HTTPClient http;
+  http.useHTTP10(true);
+  http.setTimeout(FIRMWARE_HTTP_TIMEOUT_MS);
+  http.begin(client, requestUrl);
+  http.addHeader("Accept", acceptDelta ? FIRMWARE_ACCEPT_DELTA : FIRMWARE_ACCEPT_FULL);
+  http.addHeader("Accept-Encoding", FIRMWARE_ACCEPT_ENCODING);
+  const char* wantedHeaders[] = {
+    "Content-Type", "Content-Encoding", FIRMWARE_SHA_HEADER, FIRMWARE_DECODED_LENGTH_HEADER
+  };
+  http.collectHeaders(wantedHeaders, 4);
+
+  MonoTime start = monoNow();
+  isDelta = false;
+  int httpCode = http.GET();
+  if (httpCode != 200) {
+    printLogf("OTA: firmware fetch failed. HTTP code: %d", httpCode);
+    http.end();
+    return false;
+  }
+
+  Stream &wire = http.getStream();
+  int wireLength = http.getSize();
+  isDelta = http.header("Content-Type").startsWith(DELTA_CONTENT_TYPE);
+  if (isDelta && !acceptDelta) {
+    printLog("OTA: server sent a delta after we refused one.");
+    http.end();
+    return false;
+  }
+
+  // Transport decoding: heatshrink if the server chose it, else as-is
+  uint8_t windowBits = 0, lookaheadBits = 0;
+  bool isCompressed = HeatshrinkStream::parseEncoding(http.header("Content-Encoding").c_str(),
+                                                      windowBits, lookaheadBits);
+  if (isCompressed && wireLength <= 0) {
+    printLog("OTA: compressed body without Content-Length refused.");
+    http.end();
+    return false;
+  }
+  HeatshrinkStream inflater(wire, isCompressed ? wireLength : 0, windowBits, lookaheadBits);
+  Stream &body = isCompressed ? (Stream &)inflater : wire;
+  int bodyLength = isCompressed ? atoi(http.header(FIRMWARE_DECODED_LENGTH_HEADER).c_str())
+                                : wireLength;
+
+  uint32_t bodyBytes = 0, imageSize = 0;
+  bool ok;
+  if (isDelta) {
+    ok = applyDeltaStream(body, bodyBytes, imageSize);
+  } else {
+    uint8_t sha[32];
+    bool haveSha = parseHexDigest(http.header(FIRMWARE_SHA_HEADER).c_str(), sha);
+    ok = installRawStream(body, bodyLength, haveSha ? sha : nullptr, bodyBytes);
+    imageSize = bodyBytes;
+  }
+  http.end();
+
+  lastInstallStats.wasDelta      = isDelta;
+  lastInstallStats.wasCompressed = isCompressed;
+  lastInstallStats.bytesReceived = isCompressed ? inflater.compressedBytesRead() : bodyBytes;
+  lastInstallStats.bodyBytes     = bodyBytes;
+  lastInstallStats.imageSize     = imageSize;
+  lastInstallStats.elapsedMs     = since(start).toMs();
+  printLogf("OTA: %s%s install %s — %u bytes received for %u byte image in %lu ms",
+            isDelta ? "delta" : "full", isCompressed ? "+heatshrink" : "",
+            ok ? "OK" : "FAILED",
+            (unsigned)lastInstallStats.bytesReceived, (unsigned)imageSize,
+            (unsigned long)lastInstallStats.elapsedMs);
+  return ok;
+}
+
+// A failed delta (wrong base, corrupt, short) is retried once as
+// the full image; a failed full image is left to the OTA backoff.
+inline bool installFirmwareFrom(const char* url, const char* fromVersion) {
+  FixedString<256> requestUrl;
+  requestUrl.append(url).append("&from=").append(fromVersion);
+
+  bool isDelta;
+  lastInstallStats.fellBackToFull = false;
+  if (fetchAndInstall(requestUrl.c_str(), true, isDelta)) return true;
+  if (!isDelta) return false;
+  printLog("OTA: delta failed, fetching the full image.");
+  lastInstallStats.fellBackToFull = true;
+  return fetchAndInstall(requestUrl.c_str(), false, isDelta);
+}
+
+#endif // DELTA_UPDATE_H
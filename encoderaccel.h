@@ -0,0 +1,102 @@
+#ifndef ENCODER_ACCEL_H
+#define ENCODER_ACCEL_H
+
+#include <stdint.h>
+
+// =============================================================
+// ENCODER ACCELERATION
+// Turns timestamped encoder steps into value changes with a
+// per-mode gain curve: slow turning moves one unit per step,
+// a fast spin up to maxGain units per step. Velocity is the
+// smoothed interval between steps, so one quick flick doesn't
+// jump and the gain ramps in over a couple of steps.
+//
+// Pure integer code with no Arduino dependencies: the same
+// header drives the device and tools/encodersim.cpp, so recorded
+// traces replay to identical values.
+//
+// The encoder makes two CLK edges per detent. EncoderDetent turns
+// edges into detents, and only detents are steps here: one click
+// moves the value once, and the interval is the time between
+// clicks.
+// =============================================================
+
+// The device defines ACCEL_IRAM as IRAM_ATTR: the encoder ISR
+// calls EncoderDetent::edge().
+#ifndef ACCEL_IRAM
+#define ACCEL_IRAM
+#endif
+
+// Edges in, detents out. A detent completes on the edge that puts
+// CLK back at its rest level with two edges the same way since the
+// last one; a turn reversed halfway gives nothing. Syncing on the
+// rest level means a missed edge costs one detent, not the phase.
+struct EncoderDetent {
+  int8_t half = 0;
+
+  // One CLK edge in direction dir; atRest: CLK is now at its level
+  // between detents. Returns +1 / -1 if a detent completed, else 0.
+  ACCEL_IRAM int8_t edge(int8_t dir, bool atRest) {
+    half += dir;
+    if (!atRest) return 0;
+    int8_t done = half >= 2 ? 1 : (half <= -2 ? -1 : 0);
+    half = 0;
+    return done;
+  }
+};
+
+struct AccelCurve {
+  uint16_t slowMs;    // detent interval at/above which gain = minGain
+  uint16_t fastMs;    // detent interval at/below which gain = maxGain
+  uint8_t  minGain;
+  uint8_t  maxGain;
+};
+
+//                                 slowMs fastMs min max
+const AccelCurve ACCEL_NONE   = {     0,     0,  1,  1 };   // volume, menu: 1:1
+const AccelCurve ACCEL_TIMER  = {   240,    50,  1, 10 };   // minutes: x1 .. x10
+
+#define ACCEL_IDLE_RESET_MS 400   // a pause this long starts a new gesture
+
+class EncoderAccel {
+ public:
+  void reset() {
+    haveLast_   = false;
+    lastDir_    = 0;
+    intervalMs_ = 0;
+  }
+
+  // One step at tMs (wrapping millis) in direction dir (+1 / -1).
+  // Returns the signed change to apply to the controlled value.
+  int step(uint32_t tMs, int8_t dir, const AccelCurve &curve) {
+    uint32_t dt = haveLast_ ? tMs - lastMs_ : ACCEL_IDLE_RESET_MS;
+    bool fresh = !haveLast_ || dir != lastDir_ || dt >= ACCEL_IDLE_RESET_MS;
+    haveLast_ = true;
+    lastMs_   = tMs;
+    lastDir_  = dir;
+
+    // Exponential smoothing, 1/4 weight for the new interval
+    if (fresh) intervalMs_ = ACCEL_IDLE_RESET_MS;
+    else       intervalMs_ = (3 * intervalMs_ + dt) / 4;
+
+    return dir * gainFor(intervalMs_, curve);
+  }
+
+  uint32_t smoothedIntervalMs() const { return intervalMs_; }
+
+  static int gainFor(uint32_t intervalMs, const AccelCurve &curve) {
+    if (curve.maxGain <= curve.minGain || intervalMs >= curve.slowMs) return curve.minGain;
+    if (intervalMs <= curve.fastMs) return curve.maxGain;
+    uint32_t span = curve.slowMs - curve.fastMs;
+    uint32_t into = curve.slowMs - intervalMs;   // 0 .. span
+    return curve.minGain + (int)(((uint32_t)(curve.maxGain - curve.minGain) * into + span / 2) / span);
+  }
+
+ private:
+  bool     haveLast_   = false;
+  int8_t   lastDir_    = 0;
+  uint32_t lastMs_     = 0;
+  uint32_t intervalMs_ = 0;
+};
+
+#endif // ENCODER_ACCEL_H
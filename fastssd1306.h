@@ -0,0 +1,322 @@
+#ifndef FAST_SSD1306_H
+#define FAST_SSD1306_H
+
+#include <Adafruit_SSD1306.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "spanfill.h"
+
+// =============================================================
+// SPAN-FILL SSD1306
+// Stock GFX fills rectangles one column at a time and the SSD1306
+// horizontal line sets one bit per pixel through a colour switch.
+// Our screens are mostly filled bars, separators and triangles
+// (which GFX draws as horizontal spans), so those primitives are
+// replaced here with fills over the page-major buffer: one mask
+// per 8-pixel page, whole bytes for full pages and 32-bit words
+// across the aligned middle of each span (spanfill.h).
+//
+// Output is pixel-identical to the stock library
+// (tools/spanfill.cpp checks). Rotated displays fall back to the
+// base implementation.
+//
+// ASYNC FLUSH
+// The stock display() pushes the whole 1 KB frame over I2C before
+// returning, so loop() (and the encoder) stalls on every frame.
+// After startAsyncFlush(), display() only latches the drawing
+// buffer into a pending frame and wakes a flush task. The task
+// sends the frame while loop() draws the next one; the I2C driver
+// is interrupt driven, so the task sleeps for most of a transfer.
+// A frame that is replaced before it was sent counts as dropped.
+//
+// The bus runs at 400 kHz, the SSD1306's rated Fast-mode clock.
+// Building with OLED_I2C_OVERCLOCK also tries 1 MHz and 800 kHz
+// first, keeping the fastest the panel ACKs. That is outside the
+// datasheet: an ACKed NOP doesn't prove long transfers survive the
+// wiring's rise times, so only use it on a board that was checked.
+// =============================================================
+
+static_assert(SSD1306_BLACK == SPAN_BLACK && SSD1306_WHITE == SPAN_WHITE &&
+              SSD1306_INVERSE == SPAN_INVERSE, "spanfill.h colours");
+
+#define OLED_FLUSH_TASK_STACK  3072
+#define OLED_FLUSH_TASK_PRIO   2     // above loop() so a latched frame starts at once
+#define OLED_I2C_DATA_CHUNK    127   // Wire buffer (128) minus the control byte
+#define OLED_I2C_PROBE_WRITES  8
+#define OLED_FRAME_OBSERVERS   2
+
+// Tried in order; the first one every probe write is ACKed at wins
+#ifdef OLED_I2C_OVERCLOCK
+const uint32_t OLED_I2C_CLOCKS[] = { 1000000UL, 800000UL, 400000UL };
+#else
+const uint32_t OLED_I2C_CLOCKS[] = { 400000UL };
+#endif
+
+struct OledFrameStats {
+  uint32_t submitted;       // display() calls
+  uint32_t flushed;         // frames that reached the panel
+  uint32_t dropped;         // replaced by a newer frame before sending
+  uint32_t busErrors;       // transfers with a NACK
+  uint32_t lastFlushUs;     // I2C time of the last frame
+  uint32_t maxFlushUs;
+  uint64_t totalFlushUs;
+  uint32_t maxLatencyUs;    // display() call -> frame fully on the panel
+  uint64_t totalLatencyUs;
+  uint32_t maxSubmitUs;     // time display() held up the caller
+  uint64_t bytesSent;       // GDDRAM bytes written
+  uint32_t i2cClock;
+};
+
+class FastSSD1306 : public Adafruit_SSD1306 {
+ public:
+  using Adafruit_SSD1306::Adafruit_SSD1306;
+
+  // Call after begin(). Falls back to blocking display() if the
+  // buffers or task can't be created.
+  bool startAsyncFlush() {
+    if (flushTask_ || !buffer || !wire || WIDTH != 128) return false;
+    frameBytes_ = WIDTH * ((HEIGHT + 7) / 8);
+    pending_ = (uint8_t*)malloc(frameBytes_);
+    front_   = (uint8_t*)malloc(frameBytes_);
+    frameLock_ = xSemaphoreCreateMutex();
+    busLock_   = xSemaphoreCreateMutex();
+    if (!pending_ || !front_ || !frameLock_ || !busLock_) {
+      releaseAsync();
+      return false;
+    }
+
+    // Adafruit's own command calls switch to wireClk and back to
+    // restoreClk — pin both to the probed clock.
+    stats_.i2cClock = probeClock();
+    wireClk    = stats_.i2cClock;
+    restoreClk = stats_.i2cClock;
+
+    if (xTaskCreate(flushTaskEntry, "oledFlush", OLED_FLUSH_TASK_STACK, this,
+                    OLED_FLUSH_TASK_PRIO, &flushTask_) != pdPASS) {
+      flushTask_ = nullptr;
+      releaseAsync();
+      return false;
+    }
+    return true;
+  }
+
+  // Hides Adafruit_SSD1306::display(): latch and return.
+  void display() {
+    displayPages(0, (HEIGHT + 7) / 8 - 1, 0);
+  }
+
+  // Send only pages [firstPage, lastPage] of the buffer, then set
+  // the display start line (GDDRAM row shown at the top). If a
+  // latched frame hasn't gone out yet, the page ranges merge.
+  void displayPages(uint8_t firstPage, uint8_t lastPage, uint8_t startLine) {
+    for (uint8_t i = 0; i < frameObserverCount_ && buffer; i++) {
+      frameObservers_[i](buffer, WIDTH * ((HEIGHT + 7) / 8), startLine);
+    }
+    if (!flushTask_) {
+      if (startLine != startLine_) {
+        sendCommand(SSD1306_SETSTARTLINE | startLine);
+        startLine_ = startLine;
+      }
+      if (firstPage == 0 && lastPage == (HEIGHT + 7) / 8 - 1) {
+        Adafruit_SSD1306::display();
+      } else if (WIDTH == 128 && buffer) {
+        sendPages(buffer, firstPage, lastPage);
+      }
+      return;
+    }
+    uint32_t start = micros();
+    xSemaphoreTake(frameLock_, portMAX_DELAY);
+    if (pendingFull_) {
+      stats_.dropped++;
+      if (pendingFirstPage_ < firstPage) firstPage = pendingFirstPage_;
+      if (pendingLastPage_ > lastPage)   lastPage  = pendingLastPage_;
+    }
+    memcpy(pending_, buffer, frameBytes_);
+    pendingFull_      = true;
+    pendingAt_        = start;
+    pendingFirstPage_ = firstPage;
+    pendingLastPage_  = lastPage;
+    pendingStartLine_ = startLine;
+    stats_.submitted++;
+    xSemaphoreGive(frameLock_);
+    xTaskNotifyGive(flushTask_);
+
+    uint32_t held = micros() - start;
+    if (held > stats_.maxSubmitUs) stats_.maxSubmitUs = held;
+  }
+
+  // Single command byte, serialised against the flush task.
+  void sendCommand(uint8_t c) {
+    if (busLock_) xSemaphoreTake(busLock_, portMAX_DELAY);
+    wire->beginTransmission(i2caddr);
+    wire->write((uint8_t)0x00);   // Co = 0, D/C = 0: command
+    wire->write(c);
+    if (wire->endTransmission() != 0) stats_.busErrors++;
+    if (busLock_) xSemaphoreGive(busLock_);
+  }
+
+  // Command with parameters, in one transaction so a frame can't
+  // land between the command and its arguments.
+  void sendCommands(const uint8_t* cmds, uint8_t n) {
+    if (busLock_) xSemaphoreTake(busLock_, portMAX_DELAY);
+    wire->beginTransmission(i2caddr);
+    wire->write((uint8_t)0x00);
+    wire->write(cmds, n);
+    if (wire->endTransmission() != 0) stats_.busErrors++;
+    if (busLock_) xSemaphoreGive(busLock_);
+  }
+
+  void setContrast(uint8_t level) {
+    const uint8_t cmds[] = { SSD1306_SETCONTRAST, level };
+    sendCommands(cmds, sizeof(cmds));
+  }
+
+  const OledFrameStats &frameStats() const { return stats_; }
+
+  // Sees every frame as it is latched, on the caller's thread (the
+  // input trace hashes them, the screen mirror copies them)
+  typedef void (*FrameObserver)(const uint8_t* frame, size_t len, uint8_t startLine);
+  bool addFrameObserver(FrameObserver fn) {
+    if (frameObserverCount_ >= OLED_FRAME_OBSERVERS) return false;
+    frameObservers_[frameObserverCount_++] = fn;
+    return true;
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    if (getRotation() != 0 || !buffer) {
+      Adafruit_SSD1306::fillRect(x, y, w, h, color);
+      return;
+    }
+    spanFillRect(buffer, WIDTH, HEIGHT, x, y, w, h, color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    if (getRotation() != 0 || !buffer) {
+      Adafruit_SSD1306::drawFastHLine(x, y, w, color);
+      return;
+    }
+    spanHLine(buffer, WIDTH, HEIGHT, x, y, w, color);
+  }
+
+ private:
+  static void flushTaskEntry(void* self) {
+    static_cast<FastSSD1306*>(self)->flushLoop();
+  }
+
+  void flushLoop() {
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+      xSemaphoreTake(frameLock_, portMAX_DELAY);
+      if (!pendingFull_) {
+        xSemaphoreGive(frameLock_);
+        continue;
+      }
+      uint8_t* frame = pending_;
+      pending_     = front_;
+      front_       = frame;
+      pendingFull_ = false;
+      uint32_t submittedAt = pendingAt_;
+      uint8_t  firstPage   = pendingFirstPage_;
+      uint8_t  lastPage    = pendingLastPage_;
+      uint8_t  startLine   = pendingStartLine_;
+      xSemaphoreGive(frameLock_);
+
+      uint32_t start = micros();
+      bool ok = sendPages(front_, firstPage, lastPage);
+      if (startLine != startLine_) {
+        sendCommand(SSD1306_SETSTARTLINE | startLine);
+        startLine_ = startLine;
+      }
+      uint32_t end = micros();
+      stats_.bytesSent += (lastPage - firstPage + 1) * WIDTH;
+
+      if (!ok) stats_.busErrors++;
+      stats_.flushed++;
+      stats_.lastFlushUs   = end - start;
+      stats_.totalFlushUs += stats_.lastFlushUs;
+      if (stats_.lastFlushUs > stats_.maxFlushUs) stats_.maxFlushUs = stats_.lastFlushUs;
+      uint32_t latency = end - submittedAt;
+      stats_.totalLatencyUs += latency;
+      if (latency > stats_.maxLatencyUs) stats_.maxLatencyUs = latency;
+    }
+  }
+
+  // Same addressing and data stream as Adafruit_SSD1306::display(),
+  // restricted to a page range.
+  bool sendPages(const uint8_t* frame, uint8_t firstPage, uint8_t lastPage) {
+    const uint8_t addressing[] = {
+      0x00,   // command stream
+      SSD1306_PAGEADDR, firstPage, lastPage,
+      SSD1306_COLUMNADDR, 0, (uint8_t)(WIDTH - 1)
+    };
+    bool ok = true;
+    if (busLock_) xSemaphoreTake(busLock_, portMAX_DELAY);
+    wire->beginTransmission(i2caddr);
+    wire->write(addressing, sizeof(addressing));
+    ok &= wire->endTransmission() == 0;
+
+    uint16_t end = (lastPage + 1) * WIDTH;
+    for (uint16_t sent = firstPage * WIDTH; sent < end; sent += OLED_I2C_DATA_CHUNK) {
+      uint16_t n = end - sent;
+      if (n > OLED_I2C_DATA_CHUNK) n = OLED_I2C_DATA_CHUNK;
+      wire->beginTransmission(i2caddr);
+      wire->write((uint8_t)0x40);   // data stream
+      wire->write(frame + sent, n);
+      ok &= wire->endTransmission() == 0;
+    }
+    if (busLock_) xSemaphoreGive(busLock_);
+    return ok;
+  }
+
+  // Undo a startAsyncFlush() that failed part way, so display() and
+  // the commands stay on the blocking path with no lock to take
+  void releaseAsync() {
+    free(pending_);
+    free(front_);
+    pending_ = nullptr;
+    front_   = nullptr;
+    if (frameLock_) vSemaphoreDelete(frameLock_);
+    if (busLock_)   vSemaphoreDelete(busLock_);
+    frameLock_ = nullptr;
+    busLock_   = nullptr;
+  }
+
+  // NOP commands at each candidate clock; keep the first that the
+  // panel ACKs every time.
+  uint32_t probeClock() {
+    for (uint32_t clock : OLED_I2C_CLOCKS) {
+      wire->setClock(clock);
+      bool ok = true;
+      for (int i = 0; i < OLED_I2C_PROBE_WRITES && ok; i++) {
+        wire->beginTransmission(i2caddr);
+        wire->write((uint8_t)0x00);
+        wire->write((uint8_t)0xE3);   // SSD1306 NOP
+        ok = wire->endTransmission() == 0;
+      }
+      if (ok) return clock;
+    }
+    uint32_t fallback = OLED_I2C_CLOCKS[sizeof(OLED_I2C_CLOCKS) / sizeof(OLED_I2C_CLOCKS[0]) - 1];
+    wire->setClock(fallback);
+    return fallback;
+  }
+
+  TaskHandle_t      flushTask_  = nullptr;
+  SemaphoreHandle_t frameLock_  = nullptr;   // pending_/pendingFull_
+  SemaphoreHandle_t busLock_    = nullptr;   // Wire, frame vs. commands
+  uint8_t*          pending_    = nullptr;   // latest latched frame
+  uint8_t*          front_      = nullptr;   // frame being sent
+  uint16_t          frameBytes_ = 0;
+  volatile bool     pendingFull_ = false;
+  uint32_t          pendingAt_  = 0;
+  uint8_t           pendingFirstPage_ = 0;
+  uint8_t           pendingLastPage_  = 0;
+  uint8_t           pendingStartLine_ = 0;
+  uint8_t           startLine_  = 0;     // as last sent to the panel
+  OledFrameStats    stats_      = {};
+  FrameObserver     frameObservers_[OLED_FRAME_OBSERVERS] = {};
+  uint8_t           frameObserverCount_ = 0;
+};
+
+#endif // FAST_SSD1306_H
@@ -0,0 +1,160 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// =============================================================
+// FIXED-CAPACITY STRINGS
+// Stack/static replacements for Arduino String on the network,
+// logging and OTA paths. Nothing here ever touches the heap, so
+// days of uptime can't fragment it. Appends that don't fit are
+// truncated (and flagged) instead of reallocating.
+//
+// No Arduino dependencies: tools/strsoak.cpp churns it on the host.
+// =============================================================
+
+// Non-owning view over a char range (not necessarily NUL-terminated).
+struct StrView {
+  const char* ptr;
+  size_t      len;
+
+  constexpr StrView() : ptr(""), len(0) {}
+  constexpr StrView(const char* p, size_t n) : ptr(p), len(n) {}
+  constexpr StrView(const char* s) : ptr(s), len(__builtin_strlen(s)) {}
+
+  bool empty() const { return len == 0; }
+
+  bool equals(StrView other) const {
+    return len == other.len && memcmp(ptr, other.ptr, len) == 0;
+  }
+
+  bool startsWith(StrView prefix) const {
+    return len >= prefix.len && memcmp(ptr, prefix.ptr, prefix.len) == 0;
+  }
+
+  // Index of the first 'c' at or after 'from', or -1.
+  int indexOf(char c, size_t from = 0) const {
+    for (size_t i = from; i < len; i++) {
+      if (ptr[i] == c) return (int)i;
+    }
+    return -1;
+  }
+
+  // Index of the first occurrence of 'needle' at or after 'from', or -1.
+  int indexOf(StrView needle, size_t from = 0) const {
+    if (needle.len > len) return -1;
+    for (size_t i = from; i + needle.len <= len; i++) {
+      if (memcmp(ptr + i, needle.ptr, needle.len) == 0) return (int)i;
+    }
+    return -1;
+  }
+
+  StrView substr(size_t start, size_t count = (size_t)-1) const {
+    if (start > len) start = len;
+    if (count > len - start) count = len - start;
+    return StrView(ptr + start, count);
+  }
+};
+
+template <size_t N>
+class FixedString {
+  static_assert(N > 1, "FixedString needs room for at least one char + NUL");
+
+ public:
+  FixedString() { clear(); }
+  FixedString(StrView v) { clear(); append(v); }
+  FixedString(const char* s) { clear(); append(s); }
+
+  void clear() {
+    len_       = 0;
+    truncated_ = false;
+    buf_[0]    = '\0';
+  }
+
+  FixedString& append(StrView v) {
+    size_t room = N - 1 - len_;
+    size_t n    = v.len;
+    if (n > room) {
+      n          = room;
+      truncated_ = true;
+    }
+    memcpy(buf_ + len_, v.ptr, n);
+    len_ += n;
+    buf_[len_] = '\0';
+    return *this;
+  }
+
+  FixedString& append(const char* s) { return append(StrView(s)); }
+
+  FixedString& append(char c) { return append(StrView(&c, 1)); }
+
+  // printf-style append. The format attribute makes GCC check the
+  // spec against the arguments at compile time (-Wformat).
+  FixedString& appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, fmt);
+    appendv(fmt, args);
+    va_end(args);
+    return *this;
+  }
+
+  FixedString& appendv(const char* fmt, va_list args) {
+    size_t room = N - len_;
+    int written = vsnprintf(buf_ + len_, room, fmt, args);
+    if (written < 0) {
+      buf_[len_] = '\0';
+      return *this;
+    }
+    if ((size_t)written >= room) {
+      truncated_ = true;
+      len_       = N - 1;
+    } else {
+      len_ += written;
+    }
+    return *this;
+  }
+
+  FixedString& operator=(StrView v) { clear(); return append(v); }
+  FixedString& operator=(const char* s) { clear(); return append(s); }
+  FixedString& operator+=(StrView v) { return append(v); }
+  FixedString& operator+=(const char* s) { return append(s); }
+  FixedString& operator+=(char c) { return append(c); }
+
+  bool operator==(StrView v) const { return view().equals(v); }
+  bool operator==(const char* s) const { return view().equals(StrView(s)); }
+  bool operator!=(const char* s) const { return !(*this == s); }
+
+  const char* c_str() const { return buf_; }
+  char*       data() { return buf_; }
+  size_t      length() const { return len_; }
+  bool        isEmpty() const { return len_ == 0; }
+  bool        truncated() const { return truncated_; }
+  static constexpr size_t capacity() { return N - 1; }
+
+  StrView view() const { return StrView(buf_, len_); }
+  operator StrView() const { return view(); }
+
+  // Drop everything past the first n chars.
+  void truncate(size_t n) {
+    if (n < len_) {
+      len_       = n;
+      buf_[len_] = '\0';
+    }
+  }
+
+  // Re-sync the length after writing into data() directly.
+  void syncLength() {
+    buf_[N - 1] = '\0';
+    len_        = strlen(buf_);
+  }
+
+ private:
+  char   buf_[N];
+  size_t len_;
+  bool   truncated_;
+};
+
+#endif // FIXED_STRING_H
@@ -0,0 +1,138 @@
+#ifndef GESTURE_CODE_H
+#define GESTURE_CODE_H
+
+#include <stdint.h>
+
+// =============================================================
+// BUTTON GESTURE RECOGNIZER (pure part)
+// Timestamped button edges and a periodic tick in, gestures out:
+//
+//   press-down   GESTURE_DOWN once the press is past the debounce
+//                time — for immediate feedback; the press may
+//                still turn into anything below
+//   click        GESTURE_CLICK on release (or after the double-
+//                click window, if the mask has GESTURE_DOUBLE)
+//   long press   GESTURE_LONG at the threshold, while held
+//   double-click GESTURE_DOUBLE on the second release
+//   hold-repeat  GESTURE_REPEAT every GESTURE_REPEAT_MS after
+//                GESTURE_REPEAT_DELAY_MS of holding
+//   chord        the knob turned while held (GESTURE_CHORD in the
+//                mask); the press then gives no click/long
+//
+// Each call returns the GESTURE_* bits that fired in it. No
+// Arduino dependencies: gestures.h runs it from a 10 ms esp_timer
+// and turns the bits into the flags loop() reads;
+// tools/gesturesim.cpp drives it with scripted edges.
+// =============================================================
+
+#define GESTURE_CLICK   0x01
+#define GESTURE_LONG    0x02
+#define GESTURE_DOUBLE  0x04
+#define GESTURE_REPEAT  0x08
+#define GESTURE_CHORD   0x10
+#define GESTURE_DOWN    0x20   // output only, always on
+
+#define GESTURE_DEBOUNCE_MS      20
+#define GESTURE_LONG_MS          2000
+#define GESTURE_DOUBLE_WINDOW_MS 250
+#define GESTURE_REPEAT_DELAY_MS  400
+#define GESTURE_REPEAT_MS        120
+
+struct GestureRecognizer {
+  // Set from loop(), read by the tick
+  volatile uint8_t mask     = GESTURE_CLICK | GESTURE_LONG;
+  volatile bool    consumed = false;   // the current press was used; no click/long on release
+
+  uint32_t chords = 0;   // presses that became chords
+
+  // One button edge at ms; counter is the encoder position then
+  uint8_t edge(uint32_t ms, bool isDown, int counter) {
+    if (isDown && !down)  return press(ms, counter);
+    if (!isDown && down)  return release(ms, counter);
+    return 0;
+  }
+
+  // Deadlines: call every few ms with the time and encoder position
+  uint8_t tick(uint32_t now, int counter) {
+    uint8_t fired = 0;
+    if (down) {
+      uint32_t held = now - downMs;
+      if (!downAnnounced && held >= GESTURE_DEBOUNCE_MS) {
+        downAnnounced = true;
+        fired |= GESTURE_DOWN;
+      }
+      bool chording = (counter != counterAtDown) && (mask & GESTURE_CHORD);
+      if (!longFired && !consumed && !chording && (mask & GESTURE_LONG) && held >= GESTURE_LONG_MS) {
+        longFired = true;
+        fired |= GESTURE_LONG;
+      }
+      if ((mask & GESTURE_REPEAT) && !longFired && !chording &&
+          (int32_t)(now - nextRepeatMs) >= 0) {
+        fired |= GESTURE_REPEAT;
+        nextRepeatMs += GESTURE_REPEAT_MS;
+      }
+    }
+
+    // Single click once the double-click window has passed
+    if (clickPending && !down && now - clickMs > GESTURE_DOUBLE_WINDOW_MS) {
+      clickPending = false;
+      if (mask & GESTURE_CLICK) fired |= GESTURE_CLICK;
+    }
+    return fired;
+  }
+
+ private:
+  uint8_t press(uint32_t ms, int counter) {
+    down          = true;
+    downMs        = ms;
+    downAnnounced = false;
+    longFired     = false;
+    counterAtDown = counter;
+    nextRepeatMs  = ms + GESTURE_REPEAT_DELAY_MS;
+    secondPress   = clickPending && ms - clickMs <= GESTURE_DOUBLE_WINDOW_MS;
+    return 0;
+  }
+
+  uint8_t release(uint32_t ms, int counter) {
+    uint32_t heldMs = ms - downMs;
+    down = false;
+    if (heldMs < GESTURE_DEBOUNCE_MS) return 0;   // bounce
+
+    bool chord = (counter != counterAtDown) && (mask & GESTURE_CHORD);
+    if (chord) chords++;
+    bool wasConsumed = consumed;
+    consumed = false;   // cleared on release: loop() may consume before our first tick
+    if (wasConsumed || longFired || chord) {
+      clickPending = false;
+      return 0;
+    }
+    if ((mask & GESTURE_REPEAT) && heldMs >= GESTURE_REPEAT_DELAY_MS) {
+      clickPending = false;   // the hold was the gesture
+      return 0;
+    }
+
+    if (secondPress) {
+      secondPress  = false;
+      clickPending = false;
+      return GESTURE_DOUBLE;
+    }
+    if (mask & GESTURE_DOUBLE) {
+      clickPending = true;
+      clickMs      = ms;
+      return 0;
+    }
+    return (mask & GESTURE_CLICK) ? GESTURE_CLICK : 0;
+  }
+
+  bool     down          = false;
+  uint32_t downMs        = 0;
+  bool     downAnnounced = false;
+  bool     longFired     = false;
+  int      counterAtDown = 0;
+  uint32_t nextRepeatMs  = 0;
+  bool     clickPending  = false;   // waiting for a possible second click
+  uint32_t clickMs       = 0;
+  bool     secondPress   = false;
+};
+
+#endif // GESTURE_CODE_H
@@ -0,0 +1,146 @@
+#ifndef GESTURES_H
+#define GESTURES_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "inputtrace.h"
+#include "gesturecode.h"
+
+// =============================================================
+// BUTTON GESTURES
+// The button ISR only timestamps edges into a ring. A 10 ms
+// esp_timer feeds them to the recognizer (gesturecode.h), so
+// gestures fire on time even while loop() is blocked (HTTP calls,
+// screen transitions). What it recognises becomes flags:
+//
+//   press-down   buttonDownEvent
+//   click        buttonPressed
+//   long press   buttonLongPressed
+//   double-click buttonDoubleClicked
+//   hold-repeat  buttonRepeatCount++
+//   chord        nothing; isButtonHeld() lets a mode route the turns
+//
+// Each mode declares the gestures it needs with setGestureMask();
+// without GESTURE_DOUBLE a click fires on release with no wait.
+// The flags stay the interface: loop() reads and clears them.
+// =============================================================
+
+#define GESTURE_TICK_US   10000
+#define BUTTON_EVENT_RING 16   // power of two
+
+struct ButtonEdge {
+  uint32_t ms;
+  bool     down;
+};
+
+volatile ButtonEdge buttonEdges[BUTTON_EVENT_RING];
+volatile uint8_t    buttonEdgeHead = 0;   // ISR
+uint8_t             buttonEdgeTail = 0;   // recognizer
+
+// Outputs (set by the recognizer, cleared by loop())
+volatile bool     buttonDownEvent     = false;
+volatile bool     buttonDoubleClicked = false;
+volatile uint16_t buttonRepeatCount   = 0;
+
+// Every click/long/double since the last takeGestureEvents(), as
+// GESTURE_* bits: for observers (MQTT) that must not eat the flags
+volatile uint8_t  gestureEvents       = 0;
+
+extern volatile bool buttonPressed;
+extern volatile bool buttonLongPressed;
+extern volatile int  counter;
+
+GestureRecognizer gestures;   // timer task, except mask/consumed
+static esp_timer_handle_t gestureTimer = nullptr;
+
+inline void setGestureMask(uint8_t mask) {
+  gestures.mask = mask;
+}
+
+// Raw pin, so a turn right after pressing is already a chord
+// before the recognizer's next tick.
+inline bool isButtonHeld() {
+  return digitalRead(ENCODER_SW) == LOW;
+}
+
+// The current press has been used (e.g. to wake the screen) —
+// its release must not also produce a click or long press.
+inline void consumeButtonPress() {
+  gestures.consumed = true;
+}
+
+inline void noteGesture(uint8_t bit) {
+  __atomic_fetch_or(&gestureEvents, bit, __ATOMIC_RELAXED);
+}
+
+inline uint8_t takeGestureEvents() {
+  return __atomic_exchange_n(&gestureEvents, 0, __ATOMIC_RELAXED);
+}
+
+inline void IRAM_ATTR recordButtonEdge(bool down) {
+  uint8_t slot = buttonEdgeHead & (BUTTON_EVENT_RING - 1);
+  buttonEdges[slot].ms   = monoNow().ms32();
+  buttonEdges[slot].down = down;
+  buttonEdgeHead++;
+}
+
+// Recognised gestures to the flags loop() reads
+inline void gestureRaise(uint8_t fired) {
+  if (fired & GESTURE_DOWN) {
+    buttonDownEvent = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_DOWN);
+  }
+  if (fired & GESTURE_LONG) {
+    buttonLongPressed = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_LONG);
+  }
+  if (fired & GESTURE_REPEAT) buttonRepeatCount++;
+  if (fired & GESTURE_DOUBLE) {
+    buttonDoubleClicked = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_DOUBLE);
+  }
+  if (fired & GESTURE_CLICK) {
+    buttonPressed = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_CLICK);
+  }
+  noteGesture(fired & (GESTURE_CLICK | GESTURE_LONG | GESTURE_DOUBLE));
+}
+
+inline void gestureTick(uint32_t now) {
+  // Edges in order, then the deadlines
+  while (buttonEdgeTail != buttonEdgeHead) {
+    uint8_t slot = buttonEdgeTail & (BUTTON_EVENT_RING - 1);
+    uint32_t ms = buttonEdges[slot].ms;
+    bool down   = buttonEdges[slot].down;
+    buttonEdgeTail++;
+    gestureRaise(gestures.edge(ms, down, counter));
+  }
+  gestureRaise(gestures.tick(now, counter));
+}
+
+static void gestureTimerCallback(void*) {
+  gestureTick(monoNow().ms32());
+}
+
+// Standby stops the 10 ms tick so the chip can stay asleep; edges
+// keep queueing and are classified on resume.
+inline void pauseGestures() {
+  if (gestureTimer) esp_timer_stop(gestureTimer);
+}
+
+inline void resumeGestures() {
+  if (gestureTimer) esp_timer_start_periodic(gestureTimer, GESTURE_TICK_US);
+}
+
+inline void initGestures() {
+  esp_timer_create_args_t args = {};
+  args.callback = gestureTimerCallback;
+  args.name     = "gestures";
+  if (esp_timer_create(&args, &gestureTimer) == ESP_OK) {
+    esp_timer_start_periodic(gestureTimer, GESTURE_TICK_US);
+  } else {
+    Serial.println("Gestures: timer unavailable");
+  }
+}
+
+#endif // GESTURES_H
@@ -5,87 +5,46 @@
 #include <HTTPClient.h>
 #include <HTTPUpdate.h>
 #include <EEPROM.h>
+#include "monotime.h"
+#include "knobstate.h"   // AppState and the state machine's variables
+#include "otaschedule.h"   // OTA_VERSION_PATH
 
 #define EEPROM_SIZE 1024
 #define BUZZER_PIN  5
 
-#define STANDBY_TIMEOUT_MS         10000UL  // Standby mode after 10 seconds
 #define CONFIG_PORTAL_TIMEOUT_MS   60000UL  // 60s timeout for WiFi config portal
 #define WIFI_RECONNECT_INTERVAL_MS 10000UL  // 10s between manual WiFi reconnect attempts
 
-const char* ipServer = "192.168.1.100";
+// Server URLs are assembled by the preprocessor (literal concatenation)
+// so they live in flash — no String building at static-init time.
+#define SERVER_HOST     "192.168.1.100"
+#define SERVER_BASE_URL "http://" SERVER_HOST ":8080"
 
-const String versionCheckBaseUrl = "http://" + String(ipServer) + ":8080/api/v1/device/firmware/version?macAddress=" ;
-const String firmwareBinBaseUrl = "http://" + String(ipServer) +":8080/api/v1/device/firmware?macAddress=";
-const String baseLoggingUrl = "http://" + String(ipServer) + ":8080/api/v1/device/logs";
+const char* ipServer = SERVER_HOST;
 
+const char versionCheckBaseUrl[] = SERVER_BASE_URL OTA_VERSION_PATH;
+const char firmwareBinBaseUrl[]  = SERVER_BASE_URL "/api/v1/device/firmware?macAddress=";
+const char baseLoggingUrl[]      = SERVER_BASE_URL "/api/v1/device/logs";
 
-const unsigned long wakeModeKeyInterval = 2 * 60 * 1000; // 2 minutes
+#define DOORLOCK_BASE_URL "http://doorlock.local"
+const char doorLockOpenUrl[] = DOORLOCK_BASE_URL "/open?password=149311&api=true";
+const char doorLockLockUrl[] = DOORLOCK_BASE_URL "/setMode?password=149311&mode=locked";
 
-const char* hostname = "knobcontroller"; // For mDNS: http://knobcontroller.local
-
-
-// --- State Machine Definitions ---
-enum AppState {
-  STATE_MENU,
-  STATE_STANDBY,       // Auto-activates after idle
-  STATE_VOLUME,
-  STATE_WAKE,
-  STATE_TIMER_SET,
-  STATE_TIMER_RUNNING,
-  STATE_TIMER_PAUSED,
-  STATE_TIMER_ENDED,
-  STATE_OBS,           // OBS Play/Pause control
-  STATE_DOORLOCK,      // Door Lock/Unlock control
-  STATE_STOPWATCH,     // Stopwatch triggered via HTTP endpoint
-  STATE_ANIMATING_TO_STANDBY,
-  STATE_ANIMATING_WAKE
-};
-
-AppState currentState = STATE_MENU;
-int menuSelection     = 0;
-int lastMenuSelection = -1;
+// MQTT broker on the LAN (mqttclient.h); an empty host turns MQTT off
+#define MQTT_BROKER_HOST "homeassistant.local"
+#define MQTT_BROKER_PORT 1883
+#define MQTT_BASE_TOPIC  "knob"
+// 1: DoorLock sends doorlock/cmd to a broker-side bridge, and falls
+// back to HTTP if no doorlock/result comes back in time. 0: HTTP only.
+#define MQTT_DOORLOCK    0
 
-int pauseSelection     = 0;
-int lastPauseSelection = -1;
 
-// --- Timer Variables ---
-int timerMinutes      = 1;
-int lastTimerMinutes  = -1;
-unsigned long timerEndTime         = 0;
-unsigned long timerRemainingMillis = 0;
+const Duration wakeModeKeyInterval = secs(2 * 60); // 2 minutes
 
-// --- Standby Tracking ---
-bool enteredStandbyFromVolume = false;
-bool enteredStandbyFromDoorLock = false;
-bool enteredStandbyFromOBS = false;
-
-// --- OBS Control Tracking ---
-bool obsKeySent              = false;   // true once combo is sent for current rotation
-int  obsLastDirection        = 0;       // 1 = right, -1 = left, 0 = idle
-unsigned long obsLastRotateTime = 0;    // millis() of last knob movement
-
-// --- DoorLock Control Tracking ---
-bool doorKeySent              = false;
-int  doorLastDirection        = 0;
-unsigned long doorLastRotateTime = 0;
-int  doorLastStatus           = 0;      // 0=idle, 1=unlocked, -1=locked, 2=error
+const char* hostname = "knobcontroller"; // For mDNS: http://knobcontroller.local
 
-// --- Stopwatch Variables (HTTP-triggered) ---
-bool stopwatchRunning       = false;   // true while counting up
-unsigned long stopwatchStartMillis = 0; // millis() when started
-unsigned long stopwatchElapsed     = 0; // accumulated elapsed ms
 
 // --- WiFi Tracking ---
 bool wifiConnectedAtBoot = false;
 
-// --- Animation Tracking ---
-int animYOffset = 0;
-unsigned long animLastFrameTime = 0;
-AppState postAnimState = STATE_STANDBY;
-AppState preAnimState  = STATE_MENU;
-int volumeAnimIndicator = 0;
-unsigned long volumeAnimTimer = 0;
-unsigned long lastVolAnimFrameTime = 0;
-
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include "customHttpLogging.h"
+#include "monotime.h"
+
+// =============================================================
+// HEAP FRAGMENTATION TRACKER
+// Samples free heap and the largest allocatable block. When the
+// largest block shrinks while total free stays put, the heap is
+// fragmenting. The first sample after boot is the baseline; each
+// report shows drift from it so a slow leak or fragmentation
+// trend is visible in the logs over days of uptime.
+// =============================================================
+
+#define HEAP_SAMPLE_INTERVAL_MS  10000UL     // sample every 10s
+#define HEAP_REPORT_INTERVAL_MS  3600000UL   // log a summary every hour
+
+struct HeapSample {
+  uint32_t freeBytes;
+  uint32_t largestBlock;
+  uint32_t minFreeEver;
+  uint8_t  fragmentationPct;  // 0 = one contiguous block
+};
+
+HeapSample heapBaseline   = {};
+HeapSample heapLast       = {};
+uint8_t    heapWorstFragPct = 0;
+uint32_t   heapLowestFree   = 0;
+
+inline HeapSample sampleHeap() {
+  HeapSample s;
+  s.freeBytes    = ESP.getFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  s.minFreeEver  = ESP.getMinFreeHeap();
+  s.fragmentationPct = (s.freeBytes == 0) ? 0
+    : (uint8_t)(100 - (uint64_t)s.largestBlock * 100 / s.freeBytes);
+  return s;
+}
+
+inline void logHeapSummary(const char* reason) {
+  printLogf("HEAP[%s]: free=%u (%+ld vs boot) largest=%u frag=%u%% worst=%u%% low=%u",
+            reason,
+            (unsigned)heapLast.freeBytes,
+            (long)heapLast.freeBytes - (long)heapBaseline.freeBytes,
+            (unsigned)heapLast.largestBlock,
+            (unsigned)heapLast.fragmentationPct,
+            (unsigned)heapWorstFragPct,
+            (unsigned)heapLowestFree);
+}
+
+// Call once setup() has finished allocating — later samples are
+// compared against this steady-state baseline.
+inline void initHeapMonitor() {
+  heapBaseline     = sampleHeap();
+  heapLast         = heapBaseline;
+  heapWorstFragPct = heapBaseline.fragmentationPct;
+  heapLowestFree   = heapBaseline.freeBytes;
+  logHeapSummary("boot");
+}
+
+inline void heapMonitorTick() {
+  static MonoTime lastSample = {};
+  static MonoTime lastReport = {};
+
+  if (since(lastSample) < msecs(HEAP_SAMPLE_INTERVAL_MS)) return;
+  lastSample = monoNow();
+
+  heapLast = sampleHeap();
+  if (heapLast.fragmentationPct > heapWorstFragPct) heapWorstFragPct = heapLast.fragmentationPct;
+  if (heapLast.freeBytes < heapLowestFree)          heapLowestFree   = heapLast.freeBytes;
+
+  if (since(lastReport) >= msecs(HEAP_REPORT_INTERVAL_MS)) {
+    lastReport = monoNow();
+    logHeapSummary("hourly");
+  }
+}
+
+#endif // HEAP_MONITOR_H
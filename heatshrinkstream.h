@@ -0,0 +1,162 @@
+#ifndef HEATSHRINK_STREAM_H
+#define HEATSHRINK_STREAM_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// =============================================================
+// STREAMING HEATSHRINK DECODER
+// Wraps the HTTP body stream and yields decompressed bytes, so
+// a compressed firmware image (or delta) can be fed straight into
+// the update partition. Memory is fixed: one 2^W byte window plus
+// a few counters — never a temporary full-image buffer.
+//
+// Bitstream (compatible with the heatshrink CLI, -w W -l L):
+//   1 <8 bits>               literal byte
+//   0 <W bits> <L bits>      back-reference: distance = v1 + 1,
+//                            length = v2 + 1, copied from the window
+// Bits are MSB-first; the last byte is zero-padded.
+//
+// Off the device (tools/hscompress.cpp) the includer provides
+// Stream, so the host benchmark decodes with this very class.
+// =============================================================
+
+#define HEATSHRINK_MAX_WINDOW_BITS 11   // 2 KB window, the largest we accept
+#define HEATSHRINK_MIN_WINDOW_BITS 4
+#define HEATSHRINK_ENCODING_PREFIX "heatshrink-"   // "heatshrink-<W>-<L>"
+
+// One decoder runs at a time (OTA), so the window is static
+// instead of living on the loop task's stack.
+static uint8_t heatshrinkWindow[1u << HEATSHRINK_MAX_WINDOW_BITS];
+
+class HeatshrinkStream : public Stream {
+ public:
+  // compressedLength: bytes of encoded input available on 'src'.
+  HeatshrinkStream(Stream &src, uint32_t compressedLength, uint8_t windowBits, uint8_t lookaheadBits)
+    : src_(src), srcRemaining_(compressedLength),
+      windowBits_(windowBits), lookaheadBits_(lookaheadBits),
+      mask_((1u << windowBits) - 1) {
+    memset(window_, 0, sizeof(heatshrinkWindow));
+  }
+
+  // Parse "heatshrink-10-4" style Content-Encoding values.
+  static bool parseEncoding(const char* encoding, uint8_t &windowBits, uint8_t &lookaheadBits) {
+    size_t prefixLen = strlen(HEATSHRINK_ENCODING_PREFIX);
+    if (strncmp(encoding, HEATSHRINK_ENCODING_PREFIX, prefixLen) != 0) return false;
+    int w = 0, l = 0;
+    if (sscanf(encoding + prefixLen, "%d-%d", &w, &l) != 2) return false;
+    if (w < HEATSHRINK_MIN_WINDOW_BITS || w > HEATSHRINK_MAX_WINDOW_BITS) return false;
+    if (l < 3 || l >= w) return false;
+    windowBits    = (uint8_t)w;
+    lookaheadBits = (uint8_t)l;
+    return true;
+  }
+
+  // Stream interface ------------------------------------------
+  int available() override {
+    if (copyRemaining_ > 0) return copyRemaining_;
+    return (srcRemaining_ > 0 || bitCount_ >= 9) ? 1 : 0;
+  }
+
+  int read() override {
+    if (peeked_ >= 0) {
+      int c = peeked_;
+      peeked_ = -1;
+      return c;
+    }
+    return decodeByte();
+  }
+
+  int peek() override {
+    if (peeked_ < 0) peeked_ = decodeByte();
+    return peeked_;
+  }
+
+  using Stream::readBytes;   // keep the uint8_t* overload visible
+  size_t readBytes(char* buffer, size_t length) override {
+    size_t n = 0;
+    if (length > 0 && peeked_ >= 0) {
+      buffer[n++] = (char)peeked_;
+      peeked_ = -1;
+    }
+    while (n < length) {
+      int c = decodeByte();
+      if (c < 0) break;
+      buffer[n++] = (char)c;
+    }
+    return n;
+  }
+
+  size_t write(uint8_t) override { return 0; }
+
+  uint32_t compressedBytesRead() const { return compressedRead_; }
+  uint32_t decodedBytes() const        { return decoded_; }
+
+ private:
+  // Next 'count' bits MSB-first, or -1 when the input is exhausted.
+  int32_t getBits(uint8_t count) {
+    while (bitCount_ < count) {
+      if (srcRemaining_ == 0) return -1;
+      uint8_t b;
+      if (src_.readBytes(&b, 1) != 1) {
+        srcRemaining_ = 0;
+        return -1;
+      }
+      srcRemaining_--;
+      compressedRead_++;
+      bitBuffer_ = (bitBuffer_ << 8) | b;
+      bitCount_ += 8;
+    }
+    bitCount_ -= count;
+    return (bitBuffer_ >> bitCount_) & ((1u << count) - 1);
+  }
+
+  int emit(uint8_t b) {
+    window_[head_] = b;
+    head_ = (head_ + 1) & mask_;
+    decoded_++;
+    return b;
+  }
+
+  int decodeByte() {
+    if (copyRemaining_ > 0) {
+      copyRemaining_--;
+      return emit(window_[(head_ - copyDistance_) & mask_]);
+    }
+
+    int32_t tag = getBits(1);
+    if (tag < 0) return -1;
+    if (tag) {
+      int32_t literal = getBits(8);
+      return (literal < 0) ? -1 : emit((uint8_t)literal);
+    }
+
+    int32_t index = getBits(windowBits_);
+    int32_t count = getBits(lookaheadBits_);
+    if (index < 0 || count < 0) return -1;   // zero padding at the end
+    copyDistance_  = index + 1;
+    copyRemaining_ = count;   // count + 1 bytes total, one emitted now
+    return emit(window_[(head_ - copyDistance_) & mask_]);
+  }
+
+  Stream  &src_;
+  uint32_t srcRemaining_;
+  uint32_t compressedRead_ = 0;
+  uint32_t decoded_        = 0;
+
+  uint8_t  windowBits_;
+  uint8_t  lookaheadBits_;
+  uint16_t mask_;
+  uint16_t head_          = 0;
+  uint16_t copyDistance_  = 0;
+  uint16_t copyRemaining_ = 0;
+
+  uint32_t bitBuffer_ = 0;
+  uint8_t  bitCount_  = 0;
+  int      peeked_    = -1;
+
+  uint8_t* window_ = heatshrinkWindow;
+};
+
+#endif // HEATSHRINK_STREAM_H
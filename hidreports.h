@@ -0,0 +1,311 @@
+#ifndef HID_REPORTS_H
+#define HID_REPORTS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// COMPOSITE HID REPORTS
+// One report map with three input reports:
+//
+//   id 1  keyboard   modifiers, reserved, six key slots (+ LED out)
+//   id 2  consumer   16 media-key bits, same order as BleKeyboard's
+//                    MediaKeyReport, so KEY_MEDIA_* constants work
+//   id 3  dial       System Multi-Axis Controller / puck: button
+//                    bit + 15-bit signed rotation in 0.1 degrees
+//                    (the Surface Dial layout Windows' radial
+//                    controller understands)
+//
+// A key or media tap is two reports (press, release). A dial
+// report is relative: one report carries any number of detents,
+// and there is no release. HidReportState keeps the key/media
+// state and hands finished reports to a sink, so the same code
+// feeds the BLE characteristics on the device and a counting
+// mock in tools/hidsim.cpp.
+//
+// Key codes follow the Arduino keyboard convention: ASCII below
+// 128, modifiers at 128..135 (KEY_LEFT_CTRL ...), other keys at
+// 136 + HID usage (KEY_UP_ARROW ...).
+// =============================================================
+
+#define HID_REPORT_KEYBOARD 1
+#define HID_REPORT_MEDIA    2
+#define HID_REPORT_DIAL     3
+
+#define HID_DIAL_MAX             3600   // 0.1 degrees, per report
+#define HID_DIAL_TENTHS_PER_STEP 50     // 10 degrees a detent: one Windows volume step
+
+#define HID_SHIFT 0x80   // in hidAsciiMap: needs shift
+
+const uint8_t hidReportMap[] = {
+  // Keyboard
+  0x05, 0x01,        // Usage Page (Generic Desktop)
+  0x09, 0x06,        // Usage (Keyboard)
+  0xA1, 0x01,        // Collection (Application)
+  0x85, HID_REPORT_KEYBOARD,
+  0x05, 0x07,        //   Usage Page (Keyboard)
+  0x19, 0xE0,        //   Usage Minimum (Left Control)
+  0x29, 0xE7,        //   Usage Maximum (Right GUI)
+  0x15, 0x00,        //   Logical Minimum (0)
+  0x25, 0x01,        //   Logical Maximum (1)
+  0x75, 0x01,        //   Report Size (1)
+  0x95, 0x08,        //   Report Count (8)
+  0x81, 0x02,        //   Input (Data, Var, Abs)      modifiers
+  0x95, 0x01,        //   Report Count (1)
+  0x75, 0x08,        //   Report Size (8)
+  0x81, 0x01,        //   Input (Const)               reserved
+  0x95, 0x05,        //   Report Count (5)
+  0x75, 0x01,        //   Report Size (1)
+  0x05, 0x08,        //   Usage Page (LEDs)
+  0x19, 0x01,        //   Usage Minimum (Num Lock)
+  0x29, 0x05,        //   Usage Maximum (Kana)
+  0x91, 0x02,        //   Output (Data, Var, Abs)     LEDs
+  0x95, 0x01,        //   Report Count (1)
+  0x75, 0x03,        //   Report Size (3)
+  0x91, 0x01,        //   Output (Const)              padding
+  0x95, 0x06,        //   Report Count (6)
+  0x75, 0x08,        //   Report Size (8)
+  0x15, 0x00,        //   Logical Minimum (0)
+  0x25, 0x65,        //   Logical Maximum (101)
+  0x05, 0x07,        //   Usage Page (Keyboard)
+  0x19, 0x00,        //   Usage Minimum (0)
+  0x29, 0x65,        //   Usage Maximum (101)
+  0x81, 0x00,        //   Input (Data, Array)         key slots
+  0xC0,              // End Collection
+
+  // Consumer control
+  0x05, 0x0C,        // Usage Page (Consumer)
+  0x09, 0x01,        // Usage (Consumer Control)
+  0xA1, 0x01,        // Collection (Application)
+  0x85, HID_REPORT_MEDIA,
+  0x15, 0x00,        //   Logical Minimum (0)
+  0x25, 0x01,        //   Logical Maximum (1)
+  0x75, 0x01,        //   Report Size (1)
+  0x95, 0x10,        //   Report Count (16)
+  0x09, 0xB5,        //   Scan Next Track
+  0x09, 0xB6,        //   Scan Previous Track
+  0x09, 0xB7,        //   Stop
+  0x09, 0xCD,        //   Play/Pause
+  0x09, 0xE2,        //   Mute
+  0x09, 0xE9,        //   Volume Increment
+  0x09, 0xEA,        //   Volume Decrement
+  0x0A, 0x23, 0x02,  //   WWW Home
+  0x0A, 0x94, 0x01,  //   My Computer
+  0x0A, 0x92, 0x01,  //   Calculator
+  0x0A, 0x2A, 0x02,  //   WWW Favorites
+  0x0A, 0x21, 0x02,  //   WWW Search
+  0x0A, 0x26, 0x02,  //   WWW Stop
+  0x0A, 0x24, 0x02,  //   WWW Back
+  0x0A, 0x83, 0x01,  //   Media Select
+  0x0A, 0x8A, 0x01,  //   Mail
+  0x81, 0x02,        //   Input (Data, Var, Abs)
+  0xC0,              // End Collection
+
+  // Dial
+  0x05, 0x01,        // Usage Page (Generic Desktop)
+  0x09, 0x0E,        // Usage (System Multi-Axis Controller)
+  0xA1, 0x01,        // Collection (Application)
+  0x85, HID_REPORT_DIAL,
+  0x05, 0x0D,        //   Usage Page (Digitizers)
+  0x09, 0x21,        //   Usage (Puck)
+  0xA1, 0x00,        //   Collection (Physical)
+  0x05, 0x09,        //     Usage Page (Button)
+  0x09, 0x01,        //     Usage (Button 1)
+  0x95, 0x01,        //     Report Count (1)
+  0x75, 0x01,        //     Report Size (1)
+  0x15, 0x00,        //     Logical Minimum (0)
+  0x25, 0x01,        //     Logical Maximum (1)
+  0x81, 0x02,        //     Input (Data, Var, Abs)    button
+  0x05, 0x01,        //     Usage Page (Generic Desktop)
+  0x09, 0x37,        //     Usage (Dial)
+  0x95, 0x01,        //     Report Count (1)
+  0x75, 0x0F,        //     Report Size (15)
+  0x55, 0x0F,        //     Unit Exponent (-1)
+  0x65, 0x14,        //     Unit (Degrees)
+  0x36, 0xF0, 0xF1,  //     Physical Minimum (-3600)
+  0x46, 0x10, 0x0E,  //     Physical Maximum (3600)
+  0x16, 0xF0, 0xF1,  //     Logical Minimum (-3600)
+  0x26, 0x10, 0x0E,  //     Logical Maximum (3600)
+  0x81, 0x06,        //     Input (Data, Var, Rel)    rotation
+  0xC0,              //   End Collection
+  0xC0               // End Collection
+};
+
+// ASCII to keyboard usage, HID_SHIFT set where shift is needed
+const uint8_t hidAsciiMap[128] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x2a, 0x2b, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x2c, 0x9e, 0xb4, 0xa0, 0xa1, 0xa2, 0xa4, 0x34,   //  !"#$%&'
+  0xa6, 0xa7, 0xa5, 0xae, 0x36, 0x2d, 0x37, 0x38,   // ()*+,-./
+  0x27, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24,   // 01234567
+  0x25, 0x26, 0xb3, 0x33, 0xb6, 0x2e, 0xb7, 0xb8,   // 89:;<=>?
+  0x9f, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a,   // @ABCDEFG
+  0x8b, 0x8c, 0x8d, 0x8e, 0x8f, 0x90, 0x91, 0x92,
+  0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+  0x9b, 0x9c, 0x9d, 0x2f, 0x31, 0x30, 0xa3, 0xad,   // XYZ[\]^_
+  0x35, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,   // `abcdefg
+  0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12,
+  0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a,
+  0x1b, 0x1c, 0x1d, 0xaf, 0xb1, 0xb0, 0xb5, 0x00,   // xyz{|}~
+};
+
+struct HidKeyReport {
+  uint8_t modifiers;
+  uint8_t reserved;
+  uint8_t keys[6];
+};
+
+// Dial report: bit 0 button, bits 1..15 rotation (two's complement)
+inline void hidPackDial(uint8_t out[2], bool button, int16_t tenths) {
+  uint16_t v = (uint16_t)(button ? 1 : 0) | (uint16_t)((uint16_t)tenths << 1);
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+}
+
+inline int16_t hidDialDelta(const uint8_t in[2]) {
+  uint16_t v = (uint16_t)(in[0] | (in[1] << 8));
+  return (int16_t)v >> 1;   // arithmetic shift keeps the sign
+}
+
+typedef void (*HidReportSink)(void* ctx, uint8_t reportId, const uint8_t* data, uint8_t len);
+
+class HidReportState {
+ public:
+  HidReportState(HidReportSink sink, void* ctx) : sink_(sink), ctx_(ctx) {}
+
+  // -------------------
+  // Keyboard
+  // -------------------
+  size_t press(uint8_t k) {
+    if (!usage(k)) return 0;
+    if (k) {
+      uint8_t* slot = nullptr;
+      for (uint8_t i = 0; i < 6; i++) {
+        if (keys_.keys[i] == k) return 1;   // already down
+        if (!slot && !keys_.keys[i]) slot = &keys_.keys[i];
+      }
+      if (!slot) return 0;   // six keys down already
+      *slot = k;
+    }
+    sendKeys();
+    return 1;
+  }
+
+  size_t release(uint8_t k) {
+    if (!usage(k, false)) return 0;
+    for (uint8_t i = 0; k && i < 6; i++) {
+      if (keys_.keys[i] == k) keys_.keys[i] = 0;
+    }
+    sendKeys();
+    return 1;
+  }
+
+  size_t write(uint8_t k) {
+    size_t n = press(k);
+    release(k);
+    return n;
+  }
+
+  size_t write(const uint8_t* text, size_t len) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (text[i] == '\r') continue;
+      if (!write(text[i])) break;
+      n++;
+    }
+    return n;
+  }
+
+  // -------------------
+  // Media keys (a 2-byte MediaKeyReport bit pattern)
+  // -------------------
+  size_t pressMedia(const uint8_t m[2]) {
+    media_[0] |= m[0];
+    media_[1] |= m[1];
+    sink_(ctx_, HID_REPORT_MEDIA, media_, 2);
+    return 1;
+  }
+
+  size_t releaseMedia(const uint8_t m[2]) {
+    media_[0] &= ~m[0];
+    media_[1] &= ~m[1];
+    sink_(ctx_, HID_REPORT_MEDIA, media_, 2);
+    return 1;
+  }
+
+  size_t writeMedia(const uint8_t m[2]) {
+    pressMedia(m);
+    return releaseMedia(m);
+  }
+
+  void releaseAll() {
+    memset(&keys_, 0, sizeof(keys_));
+    media_[0] = media_[1] = 0;
+    sendKeys();
+    sink_(ctx_, HID_REPORT_MEDIA, media_, 2);
+  }
+
+  // -------------------
+  // Dial
+  // -------------------
+  // Relative turn in 0.1 degrees; more than HID_DIAL_MAX is split.
+  // Returns the number of reports sent.
+  uint8_t rotate(int32_t tenths) {
+    uint8_t sent = 0;
+    while (tenths != 0) {
+      int32_t part = tenths > HID_DIAL_MAX ? HID_DIAL_MAX : (tenths < -HID_DIAL_MAX ? -HID_DIAL_MAX : tenths);
+      uint8_t r[2];
+      hidPackDial(r, dialDown_, (int16_t)part);
+      sink_(ctx_, HID_REPORT_DIAL, r, 2);
+      tenths -= part;
+      sent++;
+    }
+    return sent;
+  }
+
+  void dialButton(bool down) {
+    dialDown_ = down;
+    uint8_t r[2];
+    hidPackDial(r, down, 0);
+    sink_(ctx_, HID_REPORT_DIAL, r, 2);
+  }
+
+  const HidKeyReport &keys() const { return keys_; }
+
+ private:
+  // Arduino key code to a usage in k, modifiers into the report.
+  // False for a character with no key.
+  bool usage(uint8_t &k, bool down = true) {
+    uint8_t mod = 0;
+    if (k >= 136) {
+      k -= 136;
+    } else if (k >= 128) {
+      mod = 1 << (k - 128);
+      k = 0;
+    } else {
+      k = hidAsciiMap[k];
+      if (!k) return false;
+      if (k & HID_SHIFT) {
+        mod = 0x02;   // left shift
+        k &= ~HID_SHIFT;
+      }
+    }
+    if (down) keys_.modifiers |= mod;
+    else      keys_.modifiers &= ~mod;
+    return true;
+  }
+
+  void sendKeys() {
+    sink_(ctx_, HID_REPORT_KEYBOARD, (const uint8_t*)&keys_, sizeof(keys_));
+  }
+
+  HidReportSink sink_;
+  void*         ctx_;
+  HidKeyReport  keys_     = {};
+  uint8_t       media_[2] = { 0, 0 };
+  bool          dialDown_ = false;
+};
+
+#endif // HID_REPORTS_H
@@ -0,0 +1,434 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <ESPmDNS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "fixedstring.h"
+#include "inputtrace.h"
+#include "knoblog.h"
+#include "monotime.h"
+
+// =============================================================
+// POOLED HTTP CLIENT
+// Every outbound request used to build a fresh HTTPClient: resolve
+// the host (an mDNS query for doorlock.local), TCP handshake, one
+// request, close. The pool keeps a few connections alive instead:
+//
+//  - a host table (host:port) with a TTL resolution cache — mDNS
+//    for .local names, DNS otherwise — and per-host stats
+//  - connection slots, each a WiFiClient + HTTPClient pair. The
+//    pool opens the socket to the cached address itself; HTTPClient
+//    then finds it connected and reuses it (keep-alive), so it
+//    never resolves the name on its own
+//  - httpPoolPreconnect() resolves and connects from a background
+//    task, for modes that will probably send a request soon
+//
+// Usage:
+//   HttpLease lease = httpPoolBegin(url);
+//   lease.http->addHeader(...);            // optional
+//   int code = httpPoolGet(lease);          // or httpPoolPost()
+//   ... read lease.http ...
+//   httpPoolEnd(lease);                     // keeps the socket if reusable
+//
+// A GET that fails on a reused socket (server closed it while idle)
+// is retried once on a fresh connection. Servers that answer with
+// "Connection: close" or HTTP/1.0 still benefit from the cache and
+// pre-connect; the reuse ratio in /api/http shows which is which.
+// =============================================================
+
+#define HTTP_POOL_CONNS            4
+#define HTTP_POOL_HOSTS            5   // > HTTP_POOL_CONNS
+#define HTTP_POOL_HOST_LEN         40
+#define HTTP_POOL_TIMEOUT_MS       5000
+#define HTTP_POOL_CONNECT_TIMEOUT_MS 3000
+#define HTTP_DNS_TTL_MS            600000UL   // 10 min; lwIP doesn't expose the record TTL
+#define HTTP_MDNS_TTL_MS           120000UL   // mDNS A records are announced with 120 s
+#define HTTP_MDNS_QUERY_MS         1500
+#define HTTP_PRECONNECT_STACK      4096
+
+typedef FixedString<HTTP_POOL_HOST_LEN> HttpHostName;
+
+struct HttpHostStats {
+  uint32_t requests;
+  uint32_t reused;          // sent on a kept-alive socket
+  uint32_t preconnected;    // sent on a socket opened by httpPoolPreconnect()
+  uint32_t connects;        // sockets opened on demand
+  uint32_t connectAttempts; // incl. pre-connects and retries
+  uint32_t resolves;        // cache misses
+  uint32_t resolveFails;
+  uint32_t retries;         // stale keep-alive, resent on a new socket
+  uint32_t errors;          // negative HTTPClient codes
+  uint32_t resolveUsTotal;
+  uint32_t connectUsTotal;
+  uint64_t ttfbUsTotal;     // request sent -> response headers parsed
+  uint32_t ttfbUsMax;
+};
+
+struct HttpHost {
+  HttpHostName  name;
+  uint16_t      port;
+  IPAddress     ip;
+  MonoTime      resolvedAt;
+  uint32_t      ttlMs;      // 0 = not resolved
+  MonoTime      lastUsed;
+  HttpHostStats stats;
+};
+
+enum HttpConnState : uint8_t {
+  CONN_IDLE,          // free, possibly holding an open socket
+  CONN_LEASED,        // in use by a request
+  CONN_PRECONNECTING  // the background task is resolving/connecting
+};
+
+struct HttpConn {
+  WiFiClient    client;
+  HTTPClient    http;
+  int8_t        host = -1;
+  HttpConnState state = CONN_IDLE;
+  bool          preconnected = false;   // opened speculatively, not used yet
+  MonoTime      lastUsed = {};
+};
+
+struct HttpLease {
+  HTTPClient* http;       // nullptr if the request couldn't be started
+  int8_t      conn;
+  bool        reused;     // the socket was already open
+  bool        isGet;
+};
+
+HttpHost httpHosts[HTTP_POOL_HOSTS];
+HttpConn httpConns[HTTP_POOL_CONNS];
+static SemaphoreHandle_t httpPoolLock = nullptr;
+static TaskHandle_t      httpPreconnectTask = nullptr;
+static char              httpPreconnectUrl[128];
+
+// -------------------
+// Helpers
+// -------------------
+// "http://host[:port]/path" -> host, port, path. False for anything else.
+inline bool httpSplitUrl(const char* url, HttpHostName &host, uint16_t &port, const char* &path) {
+  const char* prefix = "http://";
+  if (strncmp(url, prefix, 7) != 0) return false;
+  const char* p = url + 7;
+  const char* hostEnd = p;
+  while (*hostEnd && *hostEnd != ':' && *hostEnd != '/') hostEnd++;
+  if (hostEnd == p || hostEnd - p >= HTTP_POOL_HOST_LEN) return false;
+  host = StrView(p, hostEnd - p);
+  port = 80;
+  path = hostEnd;
+  if (*path == ':') {
+    port = (uint16_t)atoi(path + 1);
+    while (*path && *path != '/') path++;
+  }
+  if (*path == '\0') path = "/";
+  return port != 0;
+}
+
+inline bool httpIsMdnsName(const HttpHostName &name) {
+  return name.length() > 6 && name.view().substr(name.length() - 6).equals(".local");
+}
+
+static void httpPoolLockInit() {
+  if (!httpPoolLock) httpPoolLock = xSemaphoreCreateMutex();
+}
+
+static bool httpHostBusy(int8_t host) {
+  for (HttpConn &c : httpConns) {
+    if (c.host == host && c.state != CONN_IDLE) return true;
+  }
+  return false;
+}
+
+// Under httpPoolLock. Finds or (LRU-)claims the host entry; hosts
+// with a request in flight are never evicted (there are more host
+// entries than connections, so one is always free).
+static int8_t httpFindHost(const HttpHostName &name, uint16_t port) {
+  int8_t lru = -1;
+  for (int8_t i = 0; i < HTTP_POOL_HOSTS; i++) {
+    if (httpHosts[i].port == port && httpHosts[i].name == name.view()) return i;
+    if (httpHostBusy(i)) continue;
+    if (lru < 0 || httpHosts[i].lastUsed < httpHosts[lru].lastUsed) lru = i;
+  }
+  // Evicting a host also orphans its idle sockets
+  for (HttpConn &c : httpConns) {
+    if (c.host == lru && c.state == CONN_IDLE) {
+      c.client.stop();
+      c.host = -1;
+    }
+  }
+  HttpHost &h = httpHosts[lru];
+  h = HttpHost();
+  h.name = name.view();
+  h.port = port;
+  return lru;
+}
+
+// Resolve through the cache. Not under the lock (mDNS can take a while).
+static bool httpResolve(HttpHost &h, IPAddress &ip) {
+  MonoTime now = monoNow();
+  if (h.ttlMs && now - h.resolvedAt < msecs(h.ttlMs)) {
+    ip = h.ip;
+    return true;
+  }
+  uint32_t start = micros();
+  bool ok;
+  if (httpIsMdnsName(h.name)) {
+    HttpHostName bare(StrView(h.name.c_str(), h.name.length() - 6));
+    ip = MDNS.queryHost(bare.c_str(), HTTP_MDNS_QUERY_MS);
+    ok = (uint32_t)ip != 0;
+  } else {
+    ok = WiFi.hostByName(h.name.c_str(), ip) == 1;
+  }
+  h.stats.resolves++;
+  h.stats.resolveUsTotal += micros() - start;
+  if (!ok) {
+    h.stats.resolveFails++;
+    h.ttlMs = 0;
+    return false;
+  }
+  h.ip         = ip;
+  h.resolvedAt = now;
+  h.ttlMs      = httpIsMdnsName(h.name) ? HTTP_MDNS_TTL_MS : HTTP_DNS_TTL_MS;
+  return true;
+}
+
+// Open c's socket to its host. A failure with a cached address
+// drops the cache entry and tries a fresh lookup once.
+static bool httpConnect(HttpConn &c) {
+  HttpHost &h = httpHosts[c.host];
+  for (int attempt = 0; attempt < 2; attempt++) {
+    IPAddress ip;
+    bool cached = h.ttlMs && since(h.resolvedAt) < msecs(h.ttlMs);
+    if (!httpResolve(h, ip)) return false;
+    uint32_t start = micros();
+    h.stats.connectAttempts++;
+    bool ok = c.client.connect(ip, h.port, HTTP_POOL_CONNECT_TIMEOUT_MS);
+    h.stats.connectUsTotal += micros() - start;
+    if (ok) {
+      c.client.setNoDelay(true);
+      return true;
+    }
+    if (!cached) return false;
+    h.ttlMs = 0;
+  }
+  return false;
+}
+
+// Under httpPoolLock: an idle slot for host, preferring an open
+// socket, then a dead one of the same host, then the LRU slot.
+static int8_t httpClaimConn(int8_t host) {
+  int8_t sameHost = -1, lru = -1;
+  for (int8_t i = 0; i < HTTP_POOL_CONNS; i++) {
+    HttpConn &c = httpConns[i];
+    if (c.state != CONN_IDLE) continue;
+    if (c.host == host) {
+      if (c.client.connected()) return i;
+      sameHost = i;
+    }
+    if (lru < 0 || c.lastUsed < httpConns[lru].lastUsed) lru = i;
+  }
+  if (sameHost >= 0) return sameHost;
+  if (lru >= 0) {
+    httpConns[lru].client.stop();
+    httpConns[lru].host = host;
+    httpConns[lru].preconnected = false;
+  }
+  return lru;
+}
+
+static void httpReleaseConn(HttpConn &c) {
+  xSemaphoreTake(httpPoolLock, portMAX_DELAY);
+  c.lastUsed = monoNow();
+  c.state    = CONN_IDLE;
+  xSemaphoreGive(httpPoolLock);
+}
+
+static bool httpHostPreconnecting(int8_t host) {
+  for (HttpConn &c : httpConns) {
+    if (c.host == host && c.state == CONN_PRECONNECTING) return true;
+  }
+  return false;
+}
+
+// -------------------
+// Requests
+// -------------------
+inline HttpLease httpPoolBegin(const char* url, uint32_t timeoutMs = HTTP_POOL_TIMEOUT_MS) {
+  HttpLease lease = { nullptr, -1, false, false };
+  HttpHostName name;
+  uint16_t port;
+  const char* path;
+  if (!httpSplitUrl(url, name, port, path)) {
+    KLOG_ERROR(KLOG_TAG_NET, "HTTP pool: unsupported URL %s", url);
+    return lease;
+  }
+  httpPoolLockInit();
+
+  // Let a pre-connect to this host finish rather than racing it
+  MonoTime waitStart = monoNow();
+  int8_t host, slot;
+  for (;;) {
+    xSemaphoreTake(httpPoolLock, portMAX_DELAY);
+    host = httpFindHost(name, port);
+    httpHosts[host].lastUsed = monoNow();
+    if (!httpHostPreconnecting(host) || since(waitStart) > msecs(timeoutMs)) break;
+    xSemaphoreGive(httpPoolLock);
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  slot = httpClaimConn(host);
+  if (slot >= 0) httpConns[slot].state = CONN_LEASED;
+  xSemaphoreGive(httpPoolLock);
+  if (slot < 0) {
+    KLOG_WARN(KLOG_TAG_NET, "HTTP pool: no free connection");
+    return lease;
+  }
+
+  HttpConn &c = httpConns[slot];
+  HttpHost &h = httpHosts[host];
+  lease.reused = c.client.connected();
+  if (lease.reused) {
+    if (c.preconnected) h.stats.preconnected++;
+    else                h.stats.reused++;
+  } else {
+    if (!httpConnect(c)) {
+      h.stats.errors++;
+      httpReleaseConn(c);
+      return lease;
+    }
+    h.stats.connects++;
+  }
+  c.preconnected = false;
+
+  // Per-request settings persist in HTTPClient — reset them
+  c.http.setReuse(true);
+  c.http.useHTTP10(false);
+  c.http.setTimeout(timeoutMs);
+  c.http.collectHeaders(nullptr, 0);
+  c.http.begin(c.client, h.name.c_str(), h.port, path);
+
+  lease.http = &c.http;
+  lease.conn = slot;
+  return lease;
+}
+
+static int httpPoolSend(HttpLease &lease, const uint8_t* body, size_t len) {
+  if (!lease.http) return HTTPC_ERROR_CONNECTION_REFUSED;
+  HttpConn &c = httpConns[lease.conn];
+  HttpHost &h = httpHosts[c.host];
+  lease.isGet = body == nullptr;
+
+  uint32_t start = micros();
+  int code = lease.isGet ? c.http.GET() : c.http.POST((uint8_t*)body, len);
+  // A kept-alive socket the server has since closed: reconnect, resend
+  if (code < 0 && lease.reused && lease.isGet) {
+    h.stats.retries++;
+    c.client.stop();
+    lease.reused = false;
+    if (httpConnect(c)) {
+      h.stats.connects++;
+      start = micros();
+      code = c.http.GET();
+    }
+  }
+  uint32_t ttfb = micros() - start;
+  traceRecord(TRACE_NET, code > 0 && code < 400, traceZigzag(code), ttfb / 1000);
+
+  h.stats.requests++;
+  if (code < 0) {
+    h.stats.errors++;
+  } else {
+    h.stats.ttfbUsTotal += ttfb;
+    if (ttfb > h.stats.ttfbUsMax) h.stats.ttfbUsMax = ttfb;
+  }
+  return code;
+}
+
+inline int httpPoolGet(HttpLease &lease) {
+  return httpPoolSend(lease, nullptr, 0);
+}
+
+inline int httpPoolPost(HttpLease &lease, const uint8_t* body, size_t len) {
+  return httpPoolSend(lease, body, len);
+}
+
+// HTTPClient::end() keeps the socket open if the reply allowed it.
+inline void httpPoolEnd(HttpLease &lease) {
+  if (!lease.http) return;
+  HttpConn &c = httpConns[lease.conn];
+  c.http.end();
+  httpReleaseConn(c);
+  lease.http = nullptr;
+}
+
+// -------------------
+// Speculative connect
+// -------------------
+static void httpPreconnectEntry(void*) {
+  HttpHostName name;
+  uint16_t port;
+  const char* path;
+  if (httpSplitUrl(httpPreconnectUrl, name, port, path)) {
+    xSemaphoreTake(httpPoolLock, portMAX_DELAY);
+    int8_t host = httpFindHost(name, port);
+    int8_t slot = httpClaimConn(host);
+    bool needed = slot >= 0 && !httpConns[slot].client.connected();
+    if (needed) httpConns[slot].state = CONN_PRECONNECTING;
+    xSemaphoreGive(httpPoolLock);
+
+    if (needed) {
+      HttpConn &c = httpConns[slot];
+      bool ok = httpConnect(c);
+      xSemaphoreTake(httpPoolLock, portMAX_DELAY);
+      c.preconnected = ok;
+      c.lastUsed     = monoNow();
+      c.state        = CONN_IDLE;
+      xSemaphoreGive(httpPoolLock);
+    }
+  }
+  httpPreconnectTask = nullptr;
+  vTaskDelete(nullptr);
+}
+
+// Resolve and connect to url's host in the background. Ignored if
+// a pre-connect is already running or WiFi is down.
+inline void httpPoolPreconnect(const char* url) {
+  if (httpPreconnectTask || WiFi.status() != WL_CONNECTED) return;
+  httpPoolLockInit();
+  strncpy(httpPreconnectUrl, url, sizeof(httpPreconnectUrl) - 1);
+  httpPreconnectUrl[sizeof(httpPreconnectUrl) - 1] = '\0';
+  xTaskCreate(httpPreconnectEntry, "httpPreconnect", HTTP_PRECONNECT_STACK, nullptr, 1,
+              &httpPreconnectTask);
+}
+
+// JSON array of per-host stats for /api/http
+template<size_t N>
+inline void httpPoolStatsJson(FixedString<N> &json) {
+  json.append('[');
+  bool first = true;
+  for (const HttpHost &h : httpHosts) {
+    if (h.name.length() == 0) continue;
+    const HttpHostStats &s = h.stats;
+    uint32_t ok = s.requests > s.errors ? s.requests - s.errors : 0;
+    json.appendf("%s{\"host\":\"%s:%u\",\"requests\":%u,\"reused\":%u,\"preconnected\":%u,"
+                 "\"reusePct\":%u,\"connects\":%u,\"resolves\":%u,\"resolveFails\":%u,"
+                 "\"retries\":%u,\"errors\":%u,\"resolveUsAvg\":%u,\"connectUsAvg\":%u,"
+                 "\"ttfbUsAvg\":%u,\"ttfbUsMax\":%u}",
+                 first ? "" : ",", h.name.c_str(), (unsigned)h.port,
+                 (unsigned)s.requests, (unsigned)s.reused, (unsigned)s.preconnected,
+                 (unsigned)(s.requests ? 100 * (s.reused + s.preconnected) / s.requests : 0),
+                 (unsigned)s.connects, (unsigned)s.resolves, (unsigned)s.resolveFails,
+                 (unsigned)s.retries, (unsigned)s.errors,
+                 (unsigned)(s.resolves ? s.resolveUsTotal / s.resolves : 0),
+                 (unsigned)(s.connectAttempts ? s.connectUsTotal / s.connectAttempts : 0),
+                 (unsigned)(ok ? s.ttfbUsTotal / ok : 0), (unsigned)s.ttfbUsMax);
+    first = false;
+  }
+  json.append(']');
+}
+
+#endif // HTTP_POOL_H
@@ -0,0 +1,92 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "fastssd1306.h"
+#include "fixedstring.h"
+
+#define TRACE_IRAM IRAM_ATTR
+#include "tracecode.h"
+
+// =============================================================
+// INPUT TRACE RECORDER
+// Always-on flight recorder for the state machine: the encoder
+// and button ISRs, the gesture recognizer, loop()'s state changes,
+// every frame sent to the OLED (as a hash), outbound HTTP results
+// and clock readings go into an 8 KB RAM ring (tracecode.h) with
+// microsecond timestamps. About 2-4 bytes per input event, so the
+// ring holds the last few minutes of use.
+//
+//   GET    /api/trace          download (tools/tracereplay.cpp)
+//   POST   /api/trace?on=0|1   pause / resume recording
+//   DELETE /api/trace          start over
+//
+// Writers run in ISRs, the gesture timer task, the HTTP task and
+// loop(), so each record is written under a spinlock; a record
+// costs a few microseconds, a frame hash about ten.
+// =============================================================
+
+#ifndef INPUT_TRACE_BYTES
+#define INPUT_TRACE_BYTES 8192   // 32 blocks
+#endif
+
+extern FastSSD1306 display;
+
+TraceRing    inputTrace;
+uint8_t      inputTraceMem[INPUT_TRACE_BYTES];
+portMUX_TYPE inputTraceMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool inputTraceOn = false;
+
+inline void IRAM_ATTR traceRecord(uint8_t type, uint8_t arg, uint32_t a = 0, uint32_t b = 0) {
+  if (!inputTraceOn) return;
+  portENTER_CRITICAL_SAFE(&inputTraceMux);
+  inputTrace.write((uint64_t)esp_timer_get_time(), type, arg, a, b);   // stamped inside: in order
+  portEXIT_CRITICAL_SAFE(&inputTraceMux);
+}
+
+// FastSSD1306 frame observer: what the panel is about to show
+inline void traceFrame(const uint8_t* frame, size_t len, uint8_t startLine) {
+  if (!inputTraceOn) return;
+  traceRecord(TRACE_FRAME, 0, startLine, traceHash(frame, len));
+}
+
+// Once per loop() pass: the state loop() acts on
+inline void traceStateTick(int state) {
+  static int traced = -1;
+  if (state == traced) return;
+  traced = state;
+  traceRecord(TRACE_STATE, 0, (uint32_t)state);
+}
+
+// Stop recording and wait out a writer that is mid-record
+inline bool pauseInputTrace() {
+  bool was = inputTraceOn;
+  inputTraceOn = false;
+  portENTER_CRITICAL(&inputTraceMux);
+  portEXIT_CRITICAL(&inputTraceMux);
+  return was;
+}
+
+inline void clearInputTrace() {
+  bool was = pauseInputTrace();
+  inputTrace.clear();
+  inputTraceOn = was;
+}
+
+template<size_t N>
+inline void inputTraceStatsJson(FixedString<N> &json) {
+  TraceFileHeader h = inputTrace.header();
+  json.appendf("{\"on\":%s,\"capacity\":%u,\"blocks\":%u,\"records\":%u,\"blocksDropped\":%u}",
+               inputTraceOn ? "true" : "false", (unsigned)inputTrace.capacityBytes(),
+               (unsigned)h.blocks, (unsigned)h.records, (unsigned)h.blocksDropped);
+}
+
+inline void initInputTrace() {
+  inputTrace.begin(inputTraceMem, sizeof(inputTraceMem));
+  display.addFrameObserver(traceFrame);
+  inputTraceOn = true;
+}
+
+#endif // INPUT_TRACE_H
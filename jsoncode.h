@@ -0,0 +1,375 @@
+#ifndef JSON_CODE_H
+#define JSON_CODE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "fixedstring.h"
+
+// =============================================================
+// STREAMING JSON READER
+// Pull-style tokenizer that parses straight off a Stream (e.g.
+// the WiFiClient behind HTTPClient) in fixed memory — the body
+// is never buffered. Each call to next() returns one token and
+// path() names where it sits, e.g. "data", "device.version" or
+// "items.2.name" (array elements are addressed by index).
+//
+// Strings longer than JSON_TEXT_MAX are truncated (textTruncated()
+// reports it) but still consumed, so the parse stays in sync.
+// Malformed input, nesting deeper than JSON_MAX_DEPTH or reading
+// past the byte limit yields JSON_ERROR, never a crash.
+//
+// No Arduino dependencies: the input is anything with available()
+// and readBytes(uint8_t*, size_t). jsonreader.h binds it to Stream;
+// tools/jsonfuzz.cpp runs it against a reference parser.
+// =============================================================
+
+#define JSON_MAX_DEPTH 8
+#define JSON_TEXT_MAX  64
+#define JSON_PATH_MAX  64
+#define JSON_READ_CHUNK 32
+
+enum JsonToken {
+  JSON_OBJECT_BEGIN,
+  JSON_OBJECT_END,
+  JSON_ARRAY_BEGIN,
+  JSON_ARRAY_END,
+  JSON_KEY,
+  JSON_STRING,
+  JSON_NUMBER,
+  JSON_TRUE,
+  JSON_FALSE,
+  JSON_NULL,
+  JSON_END,     // top-level value complete
+  JSON_ERROR
+};
+
+template <class In>
+class BasicJsonReader {
+ public:
+  // length: body size if known (Content-Length), -1 to read until
+  // the stream runs dry.
+  explicit BasicJsonReader(In &in, int32_t length = -1)
+    : in_(in), remaining_(length) {
+    pathLen_[0] = 0;
+  }
+
+  JsonToken next() {
+    if (expect_ == EXPECT_DONE)  return JSON_END;
+    if (expect_ == EXPECT_ERROR) return JSON_ERROR;
+
+    int c = skipWhitespace();
+
+    // Separators are consumed here so every returned token is a real one.
+    if (expect_ == EXPECT_COMMA_OR_END) {
+      if (c == ',') {
+        expect_ = inArray() ? EXPECT_VALUE : EXPECT_KEY;
+        c = skipWhitespace();
+      } else if (c != (inArray() ? ']' : '}')) {
+        return fail();
+      }
+    } else if (expect_ == EXPECT_COLON) {
+      if (c != ':') return fail();
+      expect_ = EXPECT_VALUE;
+      c = skipWhitespace();
+    }
+
+    if (c < 0) return fail();
+
+    // Container close
+    if (c == '}' || c == ']') {
+      bool isArray = (c == ']');
+      if (depth_ == 0 || inArray() != isArray) return fail();
+      // "{" followed by "}" or "[" by "]" is fine; "[1,]" is not.
+      if (expect_ == EXPECT_KEY && !justOpened_) return fail();
+      if (expect_ == EXPECT_VALUE && !justOpened_) return fail();
+      depth_--;
+      path_.truncate(pathLen_[depth_ + 1]);
+      finishValue();
+      return isArray ? JSON_ARRAY_END : JSON_OBJECT_END;
+    }
+
+    if (expect_ == EXPECT_KEY) {
+      if (c != '"' || !readString()) return fail();
+      path_.truncate(pathLen_[depth_]);
+      if (path_.length() > 0) path_ += '.';
+      path_ += text_.view();
+      expect_     = EXPECT_COLON;
+      justOpened_ = false;
+      return JSON_KEY;
+    }
+
+    // EXPECT_VALUE
+    if (inArray()) {
+      path_.truncate(pathLen_[depth_]);
+      if (path_.length() > 0) path_ += '.';
+      path_.appendf("%u", (unsigned)arrayIndex_[depth_ - 1]++);
+    }
+    justOpened_ = false;
+
+    switch (c) {
+      case '{':
+      case '[':
+        if (depth_ >= JSON_MAX_DEPTH) return fail();
+        if (c == '[') arrayMask_ |=  (1u << depth_);
+        else          arrayMask_ &= ~(1u << depth_);
+        arrayIndex_[depth_] = 0;
+        depth_++;
+        pathLen_[depth_] = path_.length();
+        expect_     = (c == '[') ? EXPECT_VALUE : EXPECT_KEY;
+        justOpened_ = true;
+        return (c == '[') ? JSON_ARRAY_BEGIN : JSON_OBJECT_BEGIN;
+      case '"':
+        if (!readString()) return fail();
+        finishValue();
+        return JSON_STRING;
+      case 't': return readLiteral("rue",  JSON_TRUE);
+      case 'f': return readLiteral("alse", JSON_FALSE);
+      case 'n': return readLiteral("ull",  JSON_NULL);
+      default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+          if (!readNumber(c)) return fail();
+          finishValue();
+          return JSON_NUMBER;
+        }
+        return fail();
+    }
+  }
+
+  // Text of the last KEY / STRING / NUMBER token (unescaped).
+  StrView     text() const          { return text_.view(); }
+  bool        textTruncated() const { return text_.truncated(); }
+  const char* path() const          { return path_.c_str(); }
+  uint8_t     depth() const         { return depth_; }
+  uint32_t    bytesRead() const     { return bytesRead_; }
+
+  // Advance to the value at 'path' and copy it out if it is a string.
+  // Stops reading as soon as it's found — the rest of the body is
+  // never pulled off the socket.
+  template <size_t N>
+  bool findString(const char* path, FixedString<N> &out) {
+    JsonToken t;
+    while ((t = next()) != JSON_END && t != JSON_ERROR) {
+      if (t == JSON_KEY) continue;
+      if (path_ == path) {
+        if (t != JSON_STRING) return false;
+        out = text_.view();
+        return !text_.truncated() && !out.truncated();
+      }
+    }
+    return false;
+  }
+
+  // Same, for numbers. Accepts integer JSON numbers only.
+  bool findInt(const char* path, long &out) {
+    JsonToken t;
+    while ((t = next()) != JSON_END && t != JSON_ERROR) {
+      if (t == JSON_KEY) continue;
+      if (path_ == path) {
+        if (t != JSON_NUMBER) return false;
+        char *end;
+        out = strtol(text_.c_str(), &end, 10);
+        return *end == '\0';
+      }
+    }
+    return false;
+  }
+
+ private:
+  enum Expect {
+    EXPECT_VALUE,
+    EXPECT_KEY,
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_END,
+    EXPECT_DONE,
+    EXPECT_ERROR
+  };
+
+  bool inArray() const { return depth_ > 0 && (arrayMask_ & (1u << (depth_ - 1))); }
+
+  JsonToken fail() {
+    expect_ = EXPECT_ERROR;
+    return JSON_ERROR;
+  }
+
+  // A value, or a container that just closed, is complete: the
+  // next close is only allowed after it, not after a ','
+  void finishValue() {
+    expect_     = (depth_ == 0) ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+    justOpened_ = false;
+  }
+
+  // Buffered byte pull. Returns -1 at end of body or on timeout.
+  int readByte() {
+    if (pos_ < fill_) return buf_[pos_++];
+    if (remaining_ == 0) return -1;
+
+    size_t want = JSON_READ_CHUNK;
+    if (remaining_ > 0 && (size_t)remaining_ < want) want = remaining_;
+    int avail = in_.available();
+    if (avail > 0 && (size_t)avail < want) want = avail;
+    // When nothing is buffered yet, wait (Stream timeout) for one byte
+    // rather than blocking until a whole chunk arrives.
+    if (avail <= 0) want = 1;
+
+    size_t got = in_.readBytes(buf_, want);
+    if (got == 0) return -1;
+    fill_ = got;
+    pos_  = 0;
+    if (remaining_ > 0) remaining_ -= got;
+    bytesRead_ += got;
+    return buf_[pos_++];
+  }
+
+  int skipWhitespace() {
+    int c;
+    do {
+      c = readByte();
+    } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    return c;
+  }
+
+  static int hexValue(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  void appendUtf8(uint32_t cp) {
+    if (cp < 0x80) {
+      text_ += (char)cp;
+    } else if (cp < 0x800) {
+      text_ += (char)(0xC0 | (cp >> 6));
+      text_ += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      text_ += (char)(0xE0 | (cp >> 12));
+      text_ += (char)(0x80 | ((cp >> 6) & 0x3F));
+      text_ += (char)(0x80 | (cp & 0x3F));
+    } else {
+      text_ += (char)(0xF0 | (cp >> 18));
+      text_ += (char)(0x80 | ((cp >> 12) & 0x3F));
+      text_ += (char)(0x80 | ((cp >> 6) & 0x3F));
+      text_ += (char)(0x80 | (cp & 0x3F));
+    }
+  }
+
+  bool readHex4(uint32_t &out) {
+    out = 0;
+    for (int i = 0; i < 4; i++) {
+      int v = hexValue(readByte());
+      if (v < 0) return false;
+      out = (out << 4) | v;
+    }
+    return true;
+  }
+
+  // Opening quote already consumed.
+  bool readString() {
+    text_.clear();
+    for (;;) {
+      int c = readByte();
+      if (c < 0)    return false;
+      if (c == '"') return true;
+      if (c < 0x20) return false;   // raw control chars are not allowed
+      if (c != '\\') {
+        text_ += (char)c;
+        continue;
+      }
+      c = readByte();
+      switch (c) {
+        case '"':  text_ += '"';  break;
+        case '\\': text_ += '\\'; break;
+        case '/':  text_ += '/';  break;
+        case 'b':  text_ += '\b'; break;
+        case 'f':  text_ += '\f'; break;
+        case 'n':  text_ += '\n'; break;
+        case 'r':  text_ += '\r'; break;
+        case 't':  text_ += '\t'; break;
+        case 'u': {
+          uint32_t cp;
+          if (!readHex4(cp)) return false;
+          if (cp >= 0xD800 && cp < 0xDC00) {
+            // High surrogate — must be followed by \uDC00..\uDFFF
+            uint32_t lo;
+            if (readByte() != '\\' || readByte() != 'u' || !readHex4(lo)) return false;
+            if (lo < 0xDC00 || lo > 0xDFFF) return false;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+          } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            return false;
+          }
+          appendUtf8(cp);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+  }
+
+  // First char already consumed. Validates the JSON number grammar.
+  bool readNumber(int c) {
+    text_.clear();
+    if (c == '-') {
+      text_ += '-';
+      c = readByte();
+    }
+    if (c == '0') {
+      text_ += '0';
+      c = readByte();
+    } else if (c >= '1' && c <= '9') {
+      while (c >= '0' && c <= '9') { text_ += (char)c; c = readByte(); }
+    } else {
+      return false;
+    }
+    if (c == '.') {
+      text_ += '.';
+      c = readByte();
+      if (c < '0' || c > '9') return false;
+      while (c >= '0' && c <= '9') { text_ += (char)c; c = readByte(); }
+    }
+    if (c == 'e' || c == 'E') {
+      text_ += 'e';
+      c = readByte();
+      if (c == '+' || c == '-') { text_ += (char)c; c = readByte(); }
+      if (c < '0' || c > '9') return false;
+      while (c >= '0' && c <= '9') { text_ += (char)c; c = readByte(); }
+    }
+    unreadByte(c);
+    return true;
+  }
+
+  JsonToken readLiteral(const char* rest, JsonToken token) {
+    for (const char* p = rest; *p; p++) {
+      if (readByte() != *p) return fail();
+    }
+    finishValue();
+    return token;
+  }
+
+  // Push back the byte that terminated a number.
+  void unreadByte(int c) {
+    if (c < 0) return;
+    // readByte() just returned buf_[pos_ - 1], so stepping back is safe.
+    pos_--;
+  }
+
+  In      &in_;
+  int32_t  remaining_;
+  uint32_t bytesRead_ = 0;
+
+  uint8_t  buf_[JSON_READ_CHUNK];
+  size_t   pos_  = 0;
+  size_t   fill_ = 0;
+
+  Expect   expect_     = EXPECT_VALUE;
+  bool     justOpened_ = false;
+  uint8_t  depth_      = 0;
+  uint16_t arrayMask_  = 0;                 // bit d set = container at depth d is an array
+  uint16_t arrayIndex_[JSON_MAX_DEPTH] = {};
+  uint8_t  pathLen_[JSON_MAX_DEPTH + 1];    // path_ length owned by each container
+
+  FixedString<JSON_PATH_MAX> path_;
+  FixedString<JSON_TEXT_MAX> text_;
+};
+
+#endif // JSON_CODE_H
@@ -0,0 +1,11 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <Arduino.h>
+#include "jsoncode.h"
+
+// The streaming JSON reader (jsoncode.h) over an Arduino Stream,
+// e.g. the WiFiClient behind HTTPClient
+typedef BasicJsonReader<Stream> JsonReader;
+
+#endif // JSON_READER_H
@@ -1,6 +1,7 @@
 #include "connectwifilogic.h"
 #include "autoupdatelogic.h"
 #include "webserver.h"
+#include "heapmonitor.h"
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
@@ -13,6 +14,8 @@ WebServer server(80);
 // Order matters: Include rotary before blelogic so 'display' is available
 #include "rotarycode.h"
 #include "blelogic.h"
+#include "slidetransition.h"
+#include "timerservice.h"
 
 // BUZZER_PIN is defined in globals.h
 
@@ -23,24 +26,13 @@ WebServer server(80);
 #define DST_OFFSET_SEC  0
 
 
-// --- Standby Tracking ---
-unsigned long lastActivityTime  = 0;
-unsigned long lastStandbyUpdate = 0;
-int lastStandbyCounter          = 0;
-
-
-
-unsigned long lastDisplayUpdate = 0;
-unsigned long lastBeepTime      = 0;
-bool beepState = false;
-
-// --- Hourly Chime Tracking ---
-int lastChimeHour = -1;
+// --- Standby Tracking (the rest is in knobstate.h) ---
+uint8_t lastStandbyLinks = 0;   // WiFi | BT << 1, as last drawn
 
 // --- NTP cache ---
 bool      ntpEverSynced  = false;
 struct tm cachedTimeinfo = {};
-unsigned long cachedTimeMillis = 0;
+MonoTime  cachedTimeAt   = {};
 
 // =============================================================
 // TIME HELPER  (cache-aware, never flickers back to "No Time")
@@ -48,17 +40,19 @@ unsigned long cachedTimeMillis = 0;
 bool getTime(struct tm &timeinfo) {
   if (getLocalTime(&timeinfo, 1000)) {
     cachedTimeinfo   = timeinfo;
-    cachedTimeMillis = millis();
+    cachedTimeAt     = monoNow();
     ntpEverSynced    = true;
+    traceRecord(TRACE_CLOCK, 1, (uint32_t)time(nullptr));
     return true;
   }
   if (ntpEverSynced) {
-    unsigned long elapsedSec = (millis() - cachedTimeMillis) / 1000UL;
+    unsigned long elapsedSec = since(cachedTimeAt) / 1_s;
     time_t cachedEpoch = mktime(&cachedTimeinfo);
     cachedEpoch += elapsedSec;
     localtime_r(&cachedEpoch, &timeinfo);
     cachedTimeinfo   = timeinfo;
-    cachedTimeMillis = millis();
+    cachedTimeAt     = monoNow();
+    traceRecord(TRACE_CLOCK, 0, (uint32_t)cachedEpoch);
     return true;
   }
   return false;
@@ -91,6 +85,10 @@ void playLongPressTone() {
   tone(BUZZER_PIN, 900, 60);
 }
 
+void buzzerOff() {
+  digitalWrite(BUZZER_PIN, LOW);
+}
+
 void playHourlyChime() {
   tone(BUZZER_PIN, 1047, 120); // C6
   delay(160);
@@ -110,28 +108,33 @@ void setup() {
 
   pinMode(BUZZER_PIN, OUTPUT);
   digitalWrite(BUZZER_PIN, LOW);
+  initInputTrace();   // records from the first boot frame on
 
   // PHASE 1: Display init — must come first so we can show progress
+  bootPhase("display");
   initDisplay();
   drawBootProgress("Starting up...", 5);
 
   // PHASE 2: Read firmware version from EEPROM
   drawBootProgress("Reading firmware...", 10);
+  bootPhase("storage");
   initOTA();
+  loadMacroDirectory();
+  initTimerService();
 
   // PHASE 3: WiFi connection (with config portal fallback)
   drawBootProgress("Connecting WiFi...", 20);
+  bootPhase("wifi");
   bool wifiOk = connectToWiFi();
 
   if (!wifiOk) {
     // Launch the captive portal and show instructions on the OLED.
     // If no one configures WiFi within the timeout, continue offline.
     setupConfigPortal();
-    unsigned long portalStart = millis();
+    Deadline portalEnd = Deadline::after(msecs(CONFIG_PORTAL_TIMEOUT_MS));
     int lastSec = -1;
-    while (!handleConfigPortalClient() &&
-           millis() - portalStart < CONFIG_PORTAL_TIMEOUT_MS) {
-      int remainingSec = (int)((CONFIG_PORTAL_TIMEOUT_MS - (millis() - portalStart)) / 1000);
+    while (!handleConfigPortalClient() && !portalEnd.expired()) {
+      int remainingSec = (int)(portalEnd.remaining() / 1_s);
       if (remainingSec != lastSec) {
         drawConfigPortalScreen(remainingSec);
         lastSec = remainingSec;
@@ -149,26 +152,32 @@ void setup() {
 
   wifiConnectedAtBoot = (WiFi.status() == WL_CONNECTED);
 
-  // PHASE 4: OTA firmware update check
-  drawBootProgress("Checking updates...", 50);
-  checkForOTAUpdate();
+  // PHASE 4: Schedule the OTA firmware check — staggered, runs from loop()
+  // once the jitter delay expires so a fleet-wide reboot doesn't
+  // stampede the update server.
+  drawBootProgress("Scheduling updates...", 50);
+  bootPhase("ota");
+  initOTASchedule();
 
-  // PHASE 5: Web server + mDNS
+  // PHASE 5: Web server + mDNS (listening only once WiFi is up)
   drawBootProgress("Starting services...", 65);
+  bootPhase("http");
   initWebserver();
+  webStackFollow(WiFi.status() == WL_CONNECTED);
 
   // PHASE 6: NTP time sync (skip if offline)
   if (WiFi.status() == WL_CONNECTED) {
     drawBootProgress("Syncing clock...", 75);
+    bootPhase("ntp");
     configureNTP();
     Serial.println("Waiting for NTP time sync...");
     struct tm timeinfo;
     if (getLocalTime(&timeinfo, 5000)) {
       Serial.println("NTP synced OK.");
       cachedTimeinfo   = timeinfo;
-      cachedTimeMillis = millis();
+      cachedTimeAt     = monoNow();
       ntpEverSynced    = true;
-      lastChimeHour    = timeinfo.tm_hour;
+      syncWallClockTimers();   // arm the hourly chime
     } else {
       Serial.println("NTP sync failed — cache helper will retry.");
     }
@@ -176,600 +185,296 @@ void setup() {
     Serial.println("No WiFi — NTP will start automatically once WiFi connects.");
   }
 
-  // PHASE 7: BLE keyboard
+  // PHASE 7: BLE keyboard (or on entering the first HID mode)
   drawBootProgress("Starting BLE...", 90);
+  bootPhase("ble");
+  initPowerSave();
+#if !BLE_LAZY_START
   initBLE();
+#endif
 
   // PHASE 8: Rotary encoder (ISRs attached last to avoid mid-init firing)
   drawBootProgress("Ready!", 100);
+  bootPhase("input");
   initRotary();
   delay(400); // Brief pause so the user sees "Ready!"
 
   counter          = 0;
-  lastActivityTime = millis();
+  lastActivityTime = monoNow();
 
   drawMenu();
+  bootReport(bleSubsys, httpSubsys);
+  initHeapMonitor();
 }
 
 // =============================================================
-// HOURLY CHIME CHECK
+// MAIN LOOP
 // =============================================================
-void checkHourlyChime() {
-  struct tm timeinfo;
-  if (!getTime(timeinfo)) return;
-
-  int currentHour = timeinfo.tm_hour;
-  if (timeinfo.tm_min == 0 && timeinfo.tm_sec == 0 && currentHour != lastChimeHour) {
-    lastChimeHour = currentHour;
-    playHourlyChime();
-    Serial.printf("Hourly chime: %02d:00\n", currentHour);
+
+// Standby once nothing woke it: seenEdges is inputEdges from
+// before the wake checks (see standbyIdle)
+void standbyPass(uint32_t seenEdges) {
+  // The clock shows HH:MM — redraw when the minute flips or a link
+  // icon changes, and sleep in between.
+  uint8_t links = (WiFi.status() == WL_CONNECTED ? 1 : 0) |
+                  (bleKeyboard.isConnected() ? 2 : 0);
+  bool minuteFlipped = standbyMinuteChanged();
+  if (lastStandbyUpdate == MonoTime{} || minuteFlipped || links != lastStandbyLinks) {
+    drawStandbyScreen();
+    lastStandbyUpdate = monoNow();
+    lastStandbyLinks  = links;
+    powerStats.redraws++;
   }
+  standbyIdle(seenEdges, timerServiceIdleMs());
 }
 
 // =============================================================
-// MAIN LOOP
+// MODE COROUTINES  (corocode.h, run by modetasks.h)
 // =============================================================
-void loop() {
-  server.handleClient();
-  checkHourlyChime();
-
-  // ── WiFi auto-reconnect + NTP (re)sync on connection ────────
-  // Fixes two interconnected issues:
-  //  1. Reconnect no longer gated by wifiConnectedAtBoot, so the
-  //     module connects even if it booted while the router was down.
-  //  2. NTP is (re)configured on every fresh connection, so the
-  //     clock works whenever WiFi comes up — not only at boot.
-  {
-    static unsigned long lastWifiCheck = 0;
-    static bool wifiWasConnected = false;
-    bool wifiNow = (WiFi.status() == WL_CONNECTED);
-
-    // Detect a fresh connection edge (boot-up OR reconnect)
-    if (wifiNow && !wifiWasConnected) {
-      Serial.println("WiFi connected — starting NTP sync.");
-      configureNTP();
-      lastChimeHour = -1;  // allow chime re-baseline after time re-syncs
-    }
-    wifiWasConnected = wifiNow;
 
-    // While disconnected, retry periodically (backup to driver auto-reconnect)
-    if (!wifiNow && millis() - lastWifiCheck >= WIFI_RECONNECT_INTERVAL_MS) {
-      lastWifiCheck = millis();
-      Serial.println("WiFi down. Attempting reconnect...");
-      // reconnect() reuses stored credentials; fall back to begin() if idle
-      if (!WiFi.reconnect()) {
-        WiFi.begin();
-      }
-    }
+// OBS: the first step of a turn presses Cmd+Opt+Shift+K (right,
+// Play) or J (left, Pause) for 20 ms; the rest of the turn sends
+// nothing, and 500 ms without a step ends it.
+void obsTurnBody(CoTask &t);
+
+struct ObsTurn : CoTask {
+  int8_t dir  = 0;
+  bool   held = false;   // chord down, released on stop too
+  ObsTurn() : CoTask("obs", obsTurnBody) {}
+} obsTurn;
+
+void obsTurnBody(CoTask &t) {
+  ObsTurn &f = static_cast<ObsTurn&>(t);
+  CO_BEGIN(t);
+  for (;;) {
+    CO_AWAIT_INPUT(t);
+    f.dir = coInput(t) > 0 ? 1 : -1;
+    obsLastDirection = f.dir;
+    if (bleKeyboard.isConnected()) {
+      bleKeyboard.press(KEY_LEFT_GUI);
+      bleKeyboard.press(KEY_LEFT_ALT);
+      bleKeyboard.press(KEY_LEFT_SHIFT);
+      bleKeyboard.press(f.dir == 1 ? 'k' : 'j');
+      f.held = true;
+      CO_SLEEP(t, 20_ms);
+      bleKeyboard.releaseAll();
+      f.held = false;
+      KLOG_INFO(KLOG_TAG_BLE, "OBS: Sent Cmd+Opt+Shift+%c (%s)", f.dir == 1 ? 'K' : 'J',
+                f.dir == 1 ? "Play" : "Pause");
+    }
+    drawOBSScreen(f.dir);
+
+    do {
+      CO_AWAIT_INPUT_FOR(t, 500_ms);
+    } while (!coTimedOut(t));
+    obsLastDirection = 0;
+    drawOBSScreen(0);
   }
+  CO_END(t);
+}
 
-  // ── NON-BLOCKING UI BUZZER LOGIC ────────────────────────────
-  // 1. Trigger the buzzer if a button is pressed (and we aren't in the alarm state)
-  if (currentState != STATE_TIMER_ENDED) {
-    if (buttonLongPressed && !uiBuzzerActive) {
-      digitalWrite(BUZZER_PIN, HIGH);
-      uiBuzzerEndTime = millis() + 150; // 150ms for a long press
-      uiBuzzerActive = true;
-    } 
-    else if (buttonPressed && !uiBuzzerActive) {
-      digitalWrite(BUZZER_PIN, HIGH);
-      uiBuzzerEndTime = millis() + 40;  // 40ms for a quick, snappy click
-      uiBuzzerActive = true;
-    }
-  }
+// Door lock: the first step of a turn opens (right) or locks (left),
+// over HTTP, or over MQTT with MQTT_DOORLOCK and the broker up
+// (mqttclient.h falls back to HTTP if the bridge doesn't answer);
+// 500 ms idle ends it.
+void doorLockHttp(int direction) {
+  if (WiFi.status() == WL_CONNECTED) {
+    HttpLease lease = httpPoolBegin(direction == 1 ? doorLockOpenUrl : doorLockLockUrl, 5000);
+    int httpCode = httpPoolGet(lease);
+    httpPoolEnd(lease);
 
-  // 2. Turn the buzzer off once the time has expired
-  if (uiBuzzerActive && millis() >= uiBuzzerEndTime) {
-    uiBuzzerActive = false;
-    // Safety check: ensure the alarm hasn't triggered in the exact same millisecond
-    if (currentState != STATE_TIMER_ENDED) {
-      digitalWrite(BUZZER_PIN, LOW);
+    if (httpCode > 0 && httpCode < 400) {
+      doorLastStatus = direction == 1 ? 1 : -1;
+      KLOG_INFO(KLOG_TAG_NET, "DoorLock: %s", direction == 1 ? "Opened" : "Locked");
+    } else {
+      doorLastStatus = 2;
+      KLOG_WARN(KLOG_TAG_NET, "DoorLock: %s failed (%d)", direction == 1 ? "Open" : "Lock", httpCode);
     }
+  } else {
+    doorLastStatus = 2;
+    KLOG_WARN(KLOG_TAG_NET, "DoorLock: No WiFi");
   }
-  // ────────────────────────────────────────────────────────────
-
-  // ── Long-press: always return to Main Menu (except during HTTP stopwatch) ──
-  if (buttonLongPressed && currentState != STATE_STOPWATCH) {
-    buttonLongPressed = false;
-    buttonPressed     = false;
-    digitalWrite(BUZZER_PIN, LOW);
-    currentState      = STATE_MENU;
-    counter           = 0;
-    lastMenuSelection = -1;
-    lastActivityTime  = millis();
-    enteredStandbyFromVolume = false;
-    enteredStandbyFromDoorLock = false;
-    enteredStandbyFromOBS = false;
-    drawMenu();
-  }
+}
 
-  // ── STATE: STANDBY ───────────────────────────────────────────
-  if (currentState == STATE_STANDBY) {
-    bool wokenByButton  = buttonPressed || buttonLongPressed;
-    bool wokenByEncoder = (counter != lastStandbyCounter);
-
-    if (wokenByButton || wokenByEncoder) {
-      buttonPressed     = false;
-      buttonLongPressed = false;
-      
-      currentState      = STATE_ANIMATING_WAKE;
-      animYOffset       = 0;
-      animLastFrameTime = millis();
-      preAnimState      = STATE_STANDBY;
-      
-      if (enteredStandbyFromVolume) {
-          postAnimState = STATE_VOLUME;
-      } else if (enteredStandbyFromDoorLock) {
-          postAnimState = STATE_DOORLOCK;
-      } else if (enteredStandbyFromOBS) {
-          postAnimState = STATE_OBS;
-      } else {
-          postAnimState = STATE_MENU;
-      }
-      
-      if (postAnimState == STATE_MENU) {
-          counter = 0;
-      } else {
-          // If returning to volume/doorlock, wait till animation ends to read new changes,
-          // but we preserve lastStandbyCounter to prevent jumping.
-          counter = lastStandbyCounter;
-      }
-      
-      lastMenuSelection = -1;
-      lastActivityTime  = millis();
-      return;
-    }
-    if (millis() - lastStandbyUpdate >= 1000) {
-      drawStandbyScreen();
-      lastStandbyUpdate = millis();
-    }
-    delay(10);
-    return;
+void doorLockSend(int direction) {
+  if (MQTT_DOORLOCK && mqttConnected()) {
+    // The door bridge answers on doorlock/result
+    mqttDoorLock(direction == 1);
+    doorLastStatus = 0;
+  } else {
+    doorLockHttp(direction);
   }
+}
 
-  // ── STATE: MAIN MENU ──────────────────────────────────────
-  if (currentState == STATE_MENU) {
-    menuSelection = abs(counter / 2) % MENU_ITEM_COUNT;
-
-    if (menuSelection != lastMenuSelection) {
-      lastActivityTime  = millis();
-      drawMenu();
-      lastMenuSelection = menuSelection;
-    }
-
-    if (buttonPressed) {
-      buttonPressed    = false;
-      lastActivityTime = millis();
-      counter          = 0;
-      lastDisplayedCounter = 0;
-
-      if (menuSelection == 0) {
-        currentState = STATE_VOLUME;
-        drawVolumeScreen();
-      } else if (menuSelection == 1) {
-        currentState    = STATE_WAKE;
-        lastKeySendTime = millis();
-        drawWakeScreen();
-      } else if (menuSelection == 2) {
-        currentState     = STATE_TIMER_SET;
-        counter          = timerMinutes * 2;
-        lastTimerMinutes = -1;
-      } else if (menuSelection == 3) {
-        currentState = STATE_OBS;
-        counter      = 0;
-        lastDisplayedCounter = 0;
-        obsKeySent       = false;
-        obsLastDirection  = 0;
-        obsLastRotateTime = millis();
-        drawOBSScreen(0);
-      } else if (menuSelection == 4) {
-        currentState = STATE_DOORLOCK;
-        counter      = 0;
-        lastDisplayedCounter = 0;
-        doorKeySent       = false;
-        doorLastDirection  = 0;
-        doorLastRotateTime = millis();
-        doorLastStatus     = 0;
-        drawDoorLockScreen(0);
-      }
-    }
+void doorTurnBody(CoTask &t);
 
-    // Enter standby after idle timeout — MENU
-    if (millis() - lastActivityTime >= STANDBY_TIMEOUT_MS) {
-      currentState       = STATE_ANIMATING_TO_STANDBY;
-      animYOffset        = 0;
-      animLastFrameTime  = millis();
-      preAnimState       = STATE_MENU;
-      postAnimState      = STATE_STANDBY;
-      enteredStandbyFromVolume = false;
-      enteredStandbyFromDoorLock = false;
-      enteredStandbyFromOBS = false;
-      lastStandbyCounter = counter;
-      lastStandbyUpdate  = 0;
-    }
-  }
+struct DoorTurn : CoTask {
+  DoorTurn() : CoTask("door", doorTurnBody) {}
+} doorTurn;
 
-  // ── STATE: VOLUME KNOB ────────────────────────────────────
-  else if (currentState == STATE_VOLUME) {
-    if (counter != lastDisplayedCounter) {
-      if (counter > lastDisplayedCounter) {
-          sendVolumeUp();
-          volumeAnimIndicator = 1;
-      } else {
-          sendVolumeDown();
-          volumeAnimIndicator = -1;
-      }
-      lastDisplayedCounter = counter;
-      lastActivityTime = millis();
-      volumeAnimTimer = millis() + 300; // animation duration
-      drawVolumeScreen();
-    }
-    
-    // Clear or play volume animation after timeout
-    if (volumeAnimIndicator != 0) {
-      if (millis() >= volumeAnimTimer) {
-        volumeAnimIndicator = 0;
-        drawVolumeScreen();
-      } else if (millis() - lastVolAnimFrameTime >= 20) { 
-        lastVolAnimFrameTime = millis();
-        drawVolumeScreen();
-      }
-    }
-    if (buttonPressed) {
-      buttonPressed     = false;
-      currentState      = STATE_MENU;
-      counter           = 0;
-      lastMenuSelection = -1;
-      lastActivityTime  = millis();
-    }
+void doorTurnBody(CoTask &t) {
+  CO_BEGIN(t);
+  for (;;) {
+    CO_AWAIT_INPUT(t);
+    doorLastDirection = coInput(t) > 0 ? 1 : -1;
+    doorLockSend(doorLastDirection);
+    drawDoorLockScreen(doorLastStatus);
 
-    // Inactivity timeout logic for Volume Screen
-    if (millis() - lastActivityTime >= STANDBY_TIMEOUT_MS) {
-      currentState       = STATE_ANIMATING_TO_STANDBY;
-      animYOffset        = 0;
-      animLastFrameTime  = millis();
-      preAnimState       = STATE_VOLUME;
-      postAnimState      = STATE_STANDBY;
-      enteredStandbyFromVolume = true;
-      enteredStandbyFromDoorLock = false;
-      enteredStandbyFromOBS = false;
-      lastStandbyCounter = counter;
-      lastStandbyUpdate  = 0;
-    }
+    do {
+      CO_AWAIT_INPUT_FOR(t, 500_ms);
+    } while (!coTimedOut(t));
+    doorLastDirection = 0;
   }
+  CO_END(t);
+}
 
-  // ── STATE: WAKE MODE ──────────────────────────────────────
-  else if (currentState == STATE_WAKE) {
-    handleWakeModeLogic();
-    if (buttonPressed) {
-      buttonPressed     = false;
-      currentState      = STATE_MENU;
-      counter           = 0;
-      lastMenuSelection = -1;
-      lastActivityTime  = millis();
-    }
+// TIME UP: buzzer on and off every 500 ms until the state changes
+void alarmBeepBody(CoTask &t);
+
+struct AlarmBeep : CoTask {
+  bool     on = false;
+  MonoTime next;
+  AlarmBeep() : CoTask("beep", alarmBeepBody) {}
+} alarmBeep;
+
+void alarmBeepBody(CoTask &t) {
+  AlarmBeep &f = static_cast<AlarmBeep&>(t);
+  CO_BEGIN(t);
+  f.on   = true;
+  f.next = monoNow();
+  for (;;) {
+    digitalWrite(BUZZER_PIN, f.on ? HIGH : LOW);
+    f.next = f.next + 500_ms;   // from the last edge, so the beat doesn't drift
+    CO_SLEEP_UNTIL(t, f.next);
+    f.on = !f.on;
   }
+  CO_END(t);
+}
 
-  // ── STATE: TIMER SET ──────────────────────────────────────
-  else if (currentState == STATE_TIMER_SET) {
-    timerMinutes = max(1, min(99, counter / 2));
-    if (timerMinutes != lastTimerMinutes) {
-      drawTimerSetScreen();
-      lastTimerMinutes = timerMinutes;
-    }
-    if (buttonPressed) {
-      buttonPressed        = false;
-      timerRemainingMillis = timerMinutes * 60UL * 1000UL;
-      timerEndTime         = millis() + timerRemainingMillis;
-      currentState         = STATE_TIMER_RUNNING;
-      lastDisplayUpdate    = 0;
-    }
-  }
+// Each coroutine runs while its state is current, whoever changed
+// the state (loop, HTTP, a timeout)
+void modeTasksFollow(AppState state) {
+  bool obs  = state == STATE_OBS;
+  bool door = state == STATE_DOORLOCK;
+  bool beep = state == STATE_TIMER_ENDED;
 
-  // ── STATE: TIMER RUNNING ──────────────────────────────────
-  else if (currentState == STATE_TIMER_RUNNING) {
-    if (millis() >= timerEndTime) {
-      currentState = STATE_TIMER_ENDED;
-      lastBeepTime = millis();
-      beepState    = true;
-      digitalWrite(BUZZER_PIN, HIGH);
-      drawTimerEndedScreen();
+  if (obs != modeTasks.running(obsTurn)) {
+    if (obs) {
+      modeTasks.start(obsTurn);
     } else {
-      if (millis() - lastDisplayUpdate >= 1000) {
-        int remainingSeconds = (timerEndTime - millis()) / 1000;
-        drawTimerRunningScreen(remainingSeconds);
-        lastDisplayUpdate = millis();
-      }
-    }
-    if (buttonPressed) {
-      buttonPressed        = false;
-      timerRemainingMillis = timerEndTime - millis();
-      currentState         = STATE_TIMER_PAUSED;
-      counter              = 0;
-      pauseSelection       = 0;
-      lastPauseSelection   = -1;
+      modeTasks.stop(obsTurn);
+      if (obsTurn.held) bleKeyboard.releaseAll();
+      obsTurn.held     = false;
+      obsLastDirection = 0;
     }
   }
-
-  // ── STATE: TIMER PAUSED ───────────────────────────────────
-  else if (currentState == STATE_TIMER_PAUSED) {
-    pauseSelection = abs(counter / 2) % 2;
-    if (pauseSelection != lastPauseSelection) {
-      drawTimerPausedScreen();
-      lastPauseSelection = pauseSelection;
-    }
-    if (buttonPressed) {
-      buttonPressed = false;
-      if (pauseSelection == 0) {
-        timerEndTime      = millis() + timerRemainingMillis;
-        currentState      = STATE_TIMER_RUNNING;
-        lastDisplayUpdate = 0;
-      } else {
-        currentState      = STATE_MENU;
-        counter           = 0;
-        lastMenuSelection = -1;
-        lastActivityTime  = millis();
-      }
+  if (door != modeTasks.running(doorTurn)) {
+    if (door) {
+      modeTasks.start(doorTurn);
+    } else {
+      modeTasks.stop(doorTurn);
+      doorLastDirection = 0;
     }
   }
-
-  // ── STATE: TIMER ENDED (ALARM) ────────────────────────────
-  else if (currentState == STATE_TIMER_ENDED) {
-    if (millis() - lastBeepTime >= 500) {
-      beepState = !beepState;
-      digitalWrite(BUZZER_PIN, beepState ? HIGH : LOW);
-      lastBeepTime = millis();
-    }
-    if (buttonPressed) {
-      buttonPressed     = false;
+  if (beep != modeTasks.running(alarmBeep)) {
+    if (beep) {
+      modeTasks.start(alarmBeep);
+    } else {
+      modeTasks.stop(alarmBeep);
       digitalWrite(BUZZER_PIN, LOW);
-      currentState      = STATE_MENU;
-      counter           = 0;
-      lastMenuSelection = -1;
-      lastActivityTime  = millis();
     }
   }
+}
 
-  // ── STATE: OBS CONTROL ────────────────────────────────────
-  else if (currentState == STATE_OBS) {
-    // Reset after 500ms of no rotation
-    if (obsKeySent && millis() - obsLastRotateTime >= 500) {
-      obsKeySent       = false;
-      obsLastDirection = 0;
-      drawOBSScreen(0);
-    }
-
-    if (counter != lastDisplayedCounter) {
-      int direction = (counter > lastDisplayedCounter) ? 1 : -1;
-      obsLastRotateTime = millis();
-
-      // Only send the combo once until 500ms idle reset
-      if (!obsKeySent) {
-        obsKeySent       = true;
-        obsLastDirection = direction;
-
-        if (bleKeyboard.isConnected()) {
-          if (direction == 1) {
-            // Knob RIGHT → CMD+OPTION+SHIFT+K (Play)
-            bleKeyboard.press(KEY_LEFT_GUI);
-            bleKeyboard.press(KEY_LEFT_ALT);
-            bleKeyboard.press(KEY_LEFT_SHIFT);
-            bleKeyboard.press('k');
-            delay(20);
-            bleKeyboard.releaseAll();
-            Serial.println("OBS: Sent Cmd+Opt+Shift+K (Play)");
-          } else {
-            // Knob LEFT → CMD+OPTION+SHIFT+J (Pause)
-            bleKeyboard.press(KEY_LEFT_GUI);
-            bleKeyboard.press(KEY_LEFT_ALT);
-            bleKeyboard.press(KEY_LEFT_SHIFT);
-            bleKeyboard.press('j');
-            delay(20);
-            bleKeyboard.releaseAll();
-            Serial.println("OBS: Sent Cmd+Opt+Shift+J (Pause)");
-          }
-        }
-        drawOBSScreen(direction);
-      }
-
-      lastDisplayedCounter = counter;
-      lastActivityTime     = millis();
-    }
+// The per-state steps (knobsteps.h): after the coroutines and
+// screens they drive
+#include "knobsteps.h"
 
-    if (buttonPressed) {
-      buttonPressed     = false;
-      obsKeySent        = false;
-      obsLastDirection  = 0;
-      currentState      = STATE_MENU;
-      counter           = 0;
-      lastMenuSelection = -1;
-      lastActivityTime  = millis();
-      enteredStandbyFromOBS = false;
-    }
 
-    // Inactivity timeout logic for OBS Screen
-    if (millis() - lastActivityTime >= STANDBY_TIMEOUT_MS) {
-      currentState       = STATE_ANIMATING_TO_STANDBY;
-      animYOffset        = 0;
-      animLastFrameTime  = millis();
-      preAnimState       = STATE_OBS;
-      postAnimState      = STATE_STANDBY;
-      enteredStandbyFromOBS      = true;
-      enteredStandbyFromVolume   = false;
-      enteredStandbyFromDoorLock = false;
-      lastStandbyCounter = counter;
-      lastStandbyUpdate  = 0;
-    }
-  }
+// States whose knob turns and clicks go out as HID reports
+bool stateSendsKeys(AppState state) {
+  return state == STATE_VOLUME || state == STATE_WAKE || state == STATE_OBS ||
+         state == STATE_MACRO;
+}
 
-  // ── STATE: DOOR LOCK CONTROL ──────────────────────────────
-  else if (currentState == STATE_DOORLOCK) {
-    // Reset after 500ms of no rotation
-    if (doorKeySent && millis() - doorLastRotateTime >= 500) {
-      doorKeySent       = false;
-      doorLastDirection  = 0;
-    }
+void loop() {
+  loopMonitorTick(currentState == STATE_STANDBY);
+  setGestureMask(gesturesForState(currentState));
+  traceStateTick(currentState);
 
-    if (counter != lastDisplayedCounter) {
-      int direction = (counter > lastDisplayedCounter) ? 1 : -1;
-      doorLastRotateTime = millis();
-
-      // Only send the HTTP request once until 500ms idle reset
-      if (!doorKeySent) {
-        doorKeySent       = true;
-        doorLastDirection  = direction;
-
-        if (WiFi.status() == WL_CONNECTED) {
-          HTTPClient http;
-          int httpCode;
-
-          if (direction == 1) {
-            // Knob RIGHT → Open/Unlock
-            http.begin("http://doorlock.local/open?password=149311&api=true");
-            http.setTimeout(5000);
-            httpCode = http.GET();
-            http.end();
-
-            if (httpCode > 0 && httpCode < 400) {
-              doorLastStatus = 1;
-              Serial.println("DoorLock: Opened");
-            } else {
-              doorLastStatus = 2;
-              Serial.printf("DoorLock: Open failed (%d)\n", httpCode);
-            }
-          } else {
-            // Knob LEFT → Lock
-            http.begin("http://doorlock.local/setMode?password=149311&mode=locked");
-            http.setTimeout(5000);
-            httpCode = http.GET();
-            http.end();
-
-            if (httpCode > 0 && httpCode < 400) {
-              doorLastStatus = -1;
-              Serial.println("DoorLock: Locked");
-            } else {
-              doorLastStatus = 2;
-              Serial.printf("DoorLock: Lock failed (%d)\n", httpCode);
-            }
-          }
-        } else {
-          doorLastStatus = 2;
-          Serial.println("DoorLock: No WiFi");
-        }
-
-        drawDoorLockScreen(doorLastStatus);
-      }
+  server.handleClient();
+  timerServiceTick();   // countdowns, alarms and the hourly chime
+  bleFollow(stateSendsKeys(currentState));   // BLE up before the mode sends
+  modeTasksFollow(currentState);
+  modeTasksTick();      // chord release, turn idle, the TIME UP beep
+  mqttTick();           // broker connection, events out, commands in
+  mirrorTick();         // keyframe for a new screen-mirror viewer
+  klogDrain();          // deferred log lines, as the UART has room
+  heapMonitorTick();
 
-      lastDisplayedCounter = counter;
-      lastActivityTime     = millis();
-    }
+  // ── WiFi auto-reconnect + NTP (re)sync on connection ────────
+  // Fixes two interconnected issues:
+  //  1. Reconnect no longer gated by wifiConnectedAtBoot, so the
+  //     module connects even if it booted while the router was down.
+  //  2. NTP is (re)configured on every fresh connection, so the
+  //     clock works whenever WiFi comes up — not only at boot.
+  {
+    static MonoTime lastWifiCheck = {};
+    static bool wifiWasConnected = false;
+    bool wifiNow = (WiFi.status() == WL_CONNECTED);
 
-    if (buttonPressed) {
-      buttonPressed      = false;
-      doorKeySent        = false;
-      doorLastDirection   = 0;
-      doorLastStatus     = 0;
-      currentState       = STATE_MENU;
-      counter            = 0;
-      lastMenuSelection  = -1;
-      lastActivityTime   = millis();
-      enteredStandbyFromDoorLock = false;
+    // Detect a fresh connection edge (boot-up OR reconnect)
+    if (wifiNow && !wifiWasConnected) {
+      KLOG_INFO(KLOG_TAG_NET, "WiFi connected, starting NTP sync");
+      configureNTP();   // the timers' clock watch re-aims the chime once it syncs
     }
+    wifiWasConnected = wifiNow;
+    webStackFollow(wifiNow);
 
-    // Inactivity timeout logic for DoorLock Screen
-    if (millis() - lastActivityTime >= STANDBY_TIMEOUT_MS) {
-      currentState       = STATE_ANIMATING_TO_STANDBY;
-      animYOffset        = 0;
-      animLastFrameTime  = millis();
-      preAnimState       = STATE_DOORLOCK;
-      postAnimState      = STATE_STANDBY;
-      enteredStandbyFromDoorLock = true;
-      enteredStandbyFromVolume   = false;
-      enteredStandbyFromOBS      = false;
-      lastStandbyCounter = counter;
-      lastStandbyUpdate  = 0;
+    // While disconnected, retry periodically (backup to driver auto-reconnect)
+    if (!wifiNow && since(lastWifiCheck) >= msecs(WIFI_RECONNECT_INTERVAL_MS)) {
+      lastWifiCheck = monoNow();
+      KLOG_WARN(KLOG_TAG_NET, "WiFi down, reconnecting");
+      // reconnect() reuses stored credentials; fall back to begin() if idle
+      if (!WiFi.reconnect()) {
+        WiFi.begin();
+      }
     }
   }
 
-
-
-  // ── STATE: STOPWATCH (HTTP-triggered, counts up) ───────────
-  else if (currentState == STATE_STOPWATCH) {
-    // Consume button presses — stopwatch is HTTP-controlled only
-    buttonPressed     = false;
-    buttonLongPressed = false;
-
-    // Refresh display every second to update the counter
-    if (millis() - lastDisplayUpdate >= 1000) {
-      drawStopwatchScreen();
-      lastDisplayUpdate = millis();
+  // ── Staggered OTA check (only while idle on menu/standby) ──
+  if (currentState == STATE_MENU || currentState == STATE_STANDBY) {
+    if (handleOTASchedule()) {
+      // The check may have shown the update screen — force a redraw
+      lastMenuSelection = -1;
+      lastStandbyUpdate = {};
     }
   }
 
-
-
-  // ── STATE: ANIMATING TO STANDBY ───────────────────────────
-  else if (currentState == STATE_ANIMATING_TO_STANDBY) {
-    if (millis() - animLastFrameTime >= 15) { 
-      animYOffset += 6; 
-      if (animYOffset >= 64) {
-        animYOffset = 64;
-        currentState = postAnimState;
-        drawStandbyScreen();
-      } else {
-        display.clearDisplay();
-        if (preAnimState == STATE_VOLUME) {
-          drawVolumeScreen(animYOffset, false);
-        } else if (preAnimState == STATE_DOORLOCK) {
-          drawDoorLockScreen(doorLastStatus, animYOffset, false);
-        } else if (preAnimState == STATE_OBS) {
-          drawOBSScreen(obsLastDirection, animYOffset, false);
-        } else {
-          drawMenu(animYOffset, false);
-        }
-        drawStandbyScreen(animYOffset - 64, false);
-        display.display();
-      }
-      animLastFrameTime = millis();
+  // ── NON-BLOCKING UI BUZZER LOGIC ────────────────────────────
+  // 1. Trigger the buzzer on press-down (and long press), unless in the alarm state.
+  //    Clicking on press-down rather than release makes the knob feel immediate.
+  if (currentState != STATE_TIMER_ENDED) {
+    if (buttonLongPressed && !uiBuzzerOff.armed()) {
+      digitalWrite(BUZZER_PIN, HIGH);
+      uiBuzzerOff.arm(150_ms); // 150ms for a long press
+    } 
+    else if (buttonDownEvent && !uiBuzzerOff.armed()) {
+      digitalWrite(BUZZER_PIN, HIGH);
+      uiBuzzerOff.arm(40_ms);  // 40ms for a quick, snappy click
     }
   }
+  buttonDownEvent = false;
 
-  // ── STATE: ANIMATING WAKE ─────────────────────────────────
-  else if (currentState == STATE_ANIMATING_WAKE) {
-    if (millis() - animLastFrameTime >= 15) {
-      animYOffset -= 8; 
-      if (animYOffset <= -64) {
-        animYOffset = 0;
-        currentState = postAnimState;
-        if (postAnimState == STATE_VOLUME) {
-          drawVolumeScreen();
-        } else if (postAnimState == STATE_DOORLOCK) {
-          drawDoorLockScreen(doorLastStatus);
-        } else if (postAnimState == STATE_OBS) {
-          drawOBSScreen(obsLastDirection);
-        } else {
-          enteredStandbyFromVolume = false;
-          enteredStandbyFromDoorLock = false;
-          enteredStandbyFromOBS = false;
-          drawMenu();
-        }
-      } else {
-        display.clearDisplay();
-        drawStandbyScreen(animYOffset, false); 
-        if (postAnimState == STATE_VOLUME) {
-          drawVolumeScreen(animYOffset + 64, false); 
-        } else if (postAnimState == STATE_DOORLOCK) {
-          drawDoorLockScreen(doorLastStatus, animYOffset + 64, false);
-        } else if (postAnimState == STATE_OBS) {
-          drawOBSScreen(obsLastDirection, animYOffset + 64, false);
-        } else {
-          drawMenu(animYOffset + 64, false);
-        }
-        display.display();
-      }
-      animLastFrameTime = millis();
+  // 2. Turn the buzzer off once the time has expired
+  if (uiBuzzerOff.expired()) {
+    uiBuzzerOff.cancel();
+    // Safety check: ensure the alarm hasn't triggered in the exact same millisecond
+    if (currentState != STATE_TIMER_ENDED) {
+      digitalWrite(BUZZER_PIN, LOW);
     }
   }
+  // ────────────────────────────────────────────────────────────
 
-  delay(10);
+  if (knobStep()) delay(10);
 }
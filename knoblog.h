@@ -0,0 +1,256 @@
+#ifndef KNOB_LOG_H
+#define KNOB_LOG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "fixedstring.h"
+#include "knoblogcode.h"
+#include "monotime.h"
+
+// =============================================================
+// LEVELLED, DEFERRED LOGGING
+// Serial.println() on a hot path can block loop() until the UART
+// drains: ~87 us per character at 115200 baud once its TX buffer
+// is full. KLOG_* calls never touch the UART:
+//
+//   KLOG_INFO(KLOG_TAG_BLE, "Sent key: %c", letter);
+//
+//  - a level above KLOG_LEVEL, or a tag outside KLOG_TAGS, drops
+//    the call at compile time (if constexpr): no code, and the
+//    arguments aren't evaluated
+//  - otherwise the call site's address and the raw arguments go
+//    into a RAM ring (knoblogcode.h): a few bytes, a few us
+//  - klogDrain() in loop() turns records into text and prints
+//    only what the UART can take without waiting
+//
+// Set KLOG_SERIAL to 0 to keep the records for GET /api/log?raw=1
+// and decode them on a PC (tools/logdecode.cpp, with the ELF).
+// GET /api/log reports the bytes saved per message and the worst
+// time a call took. %s copies at most KLOG_STR_MAX chars.
+// =============================================================
+
+#ifndef KLOG_LEVEL
+#define KLOG_LEVEL KLOG_LEVEL_INFO
+#endif
+
+#ifndef KLOG_TAGS
+#define KLOG_TAGS 0xFF
+#endif
+
+#ifndef KLOG_SERIAL
+#define KLOG_SERIAL 1
+#endif
+
+#define KLOG_RING_BYTES    2048   // power of two
+#define KLOG_DRAIN_MAX     4      // records printed per loop() pass
+#define KLOG_LINE_MAX      160
+#define KLOG_FILE_MAGIC    0x474F4C4BUL   // "KLOG"
+#define KLOG_FILE_VERSION  1
+
+// Never called: lets the compiler check the format against the args
+inline void klogCheckFormat(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void klogCheckFormat(const char*, ...) {}
+
+#define KLOG(level, tag, fmt, ...)                                  \
+  do {                                                              \
+    if constexpr ((level) <= KLOG_LEVEL && ((tag) & (KLOG_TAGS))) { \
+      static const KlogSite klogSite_ = { fmt, level, tag };        \
+      klogWrite(&klogSite_, ##__VA_ARGS__);                         \
+      if (false) klogCheckFormat(fmt, ##__VA_ARGS__);               \
+    }                                                               \
+  } while (0)
+
+#define KLOG_ERROR(tag, fmt, ...) KLOG(KLOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#define KLOG_WARN(tag, fmt, ...)  KLOG(KLOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#define KLOG_INFO(tag, fmt, ...)  KLOG(KLOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#define KLOG_DEBUG(tag, fmt, ...) KLOG(KLOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+// Download header for ?raw=1, little-endian, records follow
+struct KlogFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t anchor;   // address of klogAnchor: checks the ELF matches
+  uint32_t bytes;
+};
+
+struct KlogStats {
+  uint32_t records;
+  uint32_t overwritten;     // pushed out before they were printed
+  uint32_t tooLong;
+  uint32_t missed;          // logged while a download had the ring
+  uint32_t recordBytes;
+  uint32_t printed;
+  uint32_t printedRecordBytes;
+  uint32_t printedTextBytes;  // what Serial.println() would have sent
+  uint32_t maxCallCycles;
+  uint64_t totalCallCycles;
+};
+
+const KlogSite klogAnchor = { "knoblog anchor", 0, 0 };
+
+uint8_t      klogRing[KLOG_RING_BYTES];
+uint32_t     klogHead  = 0;   // free-running byte counters
+uint32_t     klogTail  = 0;   // oldest record
+uint32_t     klogPrint = 0;   // next record for the UART
+portMUX_TYPE klogMux   = portMUX_INITIALIZER_UNLOCKED;
+KlogStats    klogStats = {};
+volatile bool klogHeld = false;
+
+inline uint8_t klogByteAt(uint32_t pos) {
+  return klogRing[pos & (KLOG_RING_BYTES - 1)];
+}
+
+// Copy a finished record in, pushing out the oldest ones for room.
+// klogHeld is checked again under the lock: a writer that passed the
+// check in klogWrite() before klogHold() must not land in a held ring.
+inline void klogCommit(const uint8_t* rec, uint8_t len, uint32_t startCycles) {
+  portENTER_CRITICAL_SAFE(&klogMux);
+  if (klogHeld) {
+    klogStats.missed++;
+    portEXIT_CRITICAL_SAFE(&klogMux);
+    return;
+  }
+  while (klogHead + len - klogTail > KLOG_RING_BYTES) {
+    if (klogTail == klogPrint) {
+      klogPrint += klogByteAt(klogPrint);
+      klogStats.overwritten++;
+    }
+    klogTail += klogByteAt(klogTail);
+  }
+  for (uint8_t i = 0; i < len; i++) klogRing[(klogHead + i) & (KLOG_RING_BYTES - 1)] = rec[i];
+  klogHead += len;
+  klogStats.records++;
+  klogStats.recordBytes += len;
+  uint32_t took = ESP.getCycleCount() - startCycles;
+  klogStats.totalCallCycles += took;
+  if (took > klogStats.maxCallCycles) klogStats.maxCallCycles = took;
+  portEXIT_CRITICAL_SAFE(&klogMux);
+}
+
+template<typename... Args>
+inline void klogWrite(const KlogSite* site, Args... args) {
+  uint32_t start = ESP.getCycleCount();
+  if (klogHeld) {   // early out; klogCommit() checks again under the lock
+    klogStats.missed++;
+    return;
+  }
+  size_t len = KLOG_HEADER_BYTES + klogArgsBytes(args...);
+  if (len > KLOG_RECORD_MAX) {
+    klogStats.tooLong++;
+    return;
+  }
+  uint8_t rec[KLOG_RECORD_MAX];
+  rec[0] = (uint8_t)len;
+  klogPutLE(rec + 1, (uint32_t)(uintptr_t)site, 4);
+  klogPutLE(rec + 5, monoNow().ms32(), 4);
+  klogPutArgs(rec + KLOG_HEADER_BYTES, args...);
+  klogCommit(rec, (uint8_t)len, start);
+}
+
+// Next unprinted record into rec; 0 if there is none.
+// at gets the record's position, for klogDrain() to check that
+// klogCommit() didn't push it out (and move klogPrint) meanwhile.
+inline uint8_t klogTakeForPrint(uint8_t* rec, uint32_t* at) {
+  portENTER_CRITICAL_SAFE(&klogMux);
+  uint8_t len = 0;
+  *at = klogPrint;
+  if (klogPrint != klogHead) {
+    len = klogByteAt(klogPrint);
+    for (uint8_t i = 0; i < len; i++) rec[i] = klogByteAt(klogPrint + i);
+  }
+  portEXIT_CRITICAL_SAFE(&klogMux);
+  return len;
+}
+
+// "[    12.345] I ble: text" for a record taken from this device;
+// prefix gets the length before the text
+inline size_t klogFormat(const uint8_t* rec, uint8_t len, char* out, size_t cap, size_t* prefix) {
+  const KlogSite* site = (const KlogSite*)(uintptr_t)klogGetLE(rec + 1, 4);
+  uint32_t ms = (uint32_t)klogGetLE(rec + 5, 4);
+  int n = snprintf(out, cap, "[%6lu.%03lu] %c %s: ", (unsigned long)(ms / 1000),
+                   (unsigned long)(ms % 1000), klogLevelLetters[site->level],
+                   klogTagName(site->tag));
+  if (n < 0 || (size_t)n >= cap) n = 0;
+  *prefix = n;
+  return n + klogExpand(site->fmt, rec + KLOG_HEADER_BYTES, len - KLOG_HEADER_BYTES,
+                        out + n, cap - n);
+}
+
+// Once per loop() pass: print what the UART can take right now
+inline void klogDrain() {
+#if KLOG_SERIAL
+  uint8_t rec[KLOG_RECORD_MAX];
+  char line[KLOG_LINE_MAX];
+  for (uint8_t i = 0; i < KLOG_DRAIN_MAX; i++) {
+    uint32_t at;
+    uint8_t len = klogTakeForPrint(rec, &at);
+    if (!len) return;
+    size_t prefix;
+    size_t n = klogFormat(rec, len, line, sizeof(line) - 2, &prefix);
+    line[n++] = '\r';
+    line[n++] = '\n';
+    if ((size_t)Serial.availableForWrite() < n) return;   // try again next pass
+    Serial.write((const uint8_t*)line, n);
+
+    portENTER_CRITICAL_SAFE(&klogMux);
+    if (klogPrint == at) klogPrint += len;   // else pushed out meanwhile, klogPrint already moved on
+    klogStats.printed++;
+    klogStats.printedRecordBytes += len;
+    klogStats.printedTextBytes   += n - prefix;
+    portEXIT_CRITICAL_SAFE(&klogMux);
+  }
+#endif
+}
+
+// For GET /api/log?raw=1: stop writers, so the ring can be sent
+// straight from RAM. Taking the lock once waits out a commit in
+// progress; any later one sees klogHeld and drops its record.
+inline KlogFileHeader klogHold() {
+  klogHeld = true;
+  portENTER_CRITICAL(&klogMux);
+  KlogFileHeader h = { KLOG_FILE_MAGIC, KLOG_FILE_VERSION, 0,
+                       (uint32_t)(uintptr_t)&klogAnchor, klogHead - klogTail };
+  portEXIT_CRITICAL(&klogMux);
+  return h;
+}
+
+// The held ring from the oldest record, as up to two spans
+template<typename Fn>
+inline void klogForEachSpan(Fn fn) {
+  uint32_t from = klogTail & (KLOG_RING_BYTES - 1);
+  uint32_t used = klogHead - klogTail;
+  uint32_t first = used < KLOG_RING_BYTES - from ? used : KLOG_RING_BYTES - from;
+  if (first) fn(klogRing + from, first);
+  if (used > first) fn(klogRing, used - first);
+}
+
+inline void klogRelease() {
+  klogHeld = false;
+}
+
+template<size_t N>
+inline void klogStatsJson(FixedString<N> &json) {
+  portENTER_CRITICAL_SAFE(&klogMux);
+  KlogStats st = klogStats;
+  uint32_t used = klogHead - klogTail;
+  portEXIT_CRITICAL_SAFE(&klogMux);
+
+  uint32_t mhz = getCpuFrequencyMhz();
+  uint32_t records = st.records ? st.records : 1;
+  uint32_t printed = st.printed ? st.printed : 1;
+  json.appendf("{\"level\":%d,\"tags\":%u,\"serial\":%s,\"records\":%u,\"overwritten\":%u,"
+               "\"tooLong\":%u,\"missed\":%u,\"ringUsed\":%u,\"ringBytes\":%u,"
+               "\"recordBytesAvg\":%u,"
+               "\"printed\":%u,\"textBytesAvg\":%u,\"bytesSavedPerMsg\":%d,"
+               "\"callNsAvg\":%u,\"callUsMax\":%u}",
+               KLOG_LEVEL, (unsigned)KLOG_TAGS, KLOG_SERIAL ? "true" : "false",
+               (unsigned)st.records, (unsigned)st.overwritten, (unsigned)st.tooLong,
+               (unsigned)st.missed, (unsigned)used, (unsigned)KLOG_RING_BYTES, (unsigned)(st.recordBytes / records),
+               (unsigned)st.printed, (unsigned)(st.printedTextBytes / printed),
+               (int)((int32_t)(st.printedTextBytes - st.printedRecordBytes) / (int32_t)printed),
+               (unsigned)(st.totalCallCycles * 1000 / records / mhz),
+               (unsigned)((st.maxCallCycles + mhz - 1) / mhz));
+}
+
+#endif // KNOB_LOG_H
@@ -0,0 +1,228 @@
+#ifndef KNOB_LOG_CODE_H
+#define KNOB_LOG_CODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+// =============================================================
+// DEFERRED LOG RECORDS
+// A log call stores no text. It stores the address of its call
+// site (a KlogSite with the format string, level and tag) and the
+// raw arguments, each with a one-byte type. Text is made later:
+// on the device by knoblog.h, once the UART has room, or on a PC by
+// tools/logdecode.cpp, which finds the call sites in the firmware
+// ELF.
+//
+// Record, little-endian:
+//   u8  length of the whole record
+//   u32 KlogSite address
+//   u32 millis()
+//   args: u8 KlogArgType, then 4 or 8 bytes, or for a string
+//         u8 n and n bytes (cut at KLOG_STR_MAX)
+//
+// Pure C++ with no Arduino dependencies, so the host decoder
+// expands records with this same code.
+// =============================================================
+
+#define KLOG_HEADER_BYTES 9
+#define KLOG_RECORD_MAX   255
+#define KLOG_STR_MAX      32
+
+#define KLOG_LEVEL_OFF   0
+#define KLOG_LEVEL_ERROR 1
+#define KLOG_LEVEL_WARN  2
+#define KLOG_LEVEL_INFO  3
+#define KLOG_LEVEL_DEBUG 4
+
+// Tags, one bit each
+#define KLOG_TAG_SYS   0x01
+#define KLOG_TAG_BLE   0x02
+#define KLOG_TAG_UI    0x04
+#define KLOG_TAG_NET   0x08
+#define KLOG_TAG_TIMER 0x10
+#define KLOG_TAG_WEB   0x20
+
+const char* const klogLevelLetters = "-EWID";
+const char* const klogTagNames[] = { "sys", "ble", "ui", "net", "timer", "web" };
+
+struct KlogSite {
+  const char* fmt;
+  uint8_t     level;
+  uint8_t     tag;
+};
+
+enum KlogArgType : uint8_t {
+  KLOG_ARG_I32,
+  KLOG_ARG_U32,
+  KLOG_ARG_I64,
+  KLOG_ARG_U64,
+  KLOG_ARG_F64,
+  KLOG_ARG_STR
+};
+
+inline const char* klogTagName(uint8_t tag) {
+  for (uint8_t i = 0; i < sizeof(klogTagNames) / sizeof(klogTagNames[0]); i++) {
+    if (tag & (1 << i)) return klogTagNames[i];
+  }
+  return "?";
+}
+
+inline void klogPutLE(uint8_t* p, uint64_t v, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline uint64_t klogGetLE(const uint8_t* p, uint8_t n) {
+  uint64_t v = 0;
+  for (uint8_t i = 0; i < n; i++) v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+// -------------------
+// Packing (sizes first, so the writer can reserve room)
+// -------------------
+template<typename T>
+inline size_t klogArgBytes(T) {
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                "klog: numbers, enums and C strings only");
+  return 1 + (sizeof(T) > 4 || std::is_floating_point<T>::value ? 8 : 4);
+}
+
+inline size_t klogStrBytes(const char* s) {
+  size_t n = s ? strnlen(s, KLOG_STR_MAX) : 0;
+  return 2 + n;
+}
+inline size_t klogArgBytes(const char* s) { return klogStrBytes(s); }
+inline size_t klogArgBytes(char* s)       { return klogStrBytes(s); }
+
+template<typename T>
+inline uint8_t* klogPutArg(uint8_t* p, T v) {
+  if constexpr (std::is_floating_point<T>::value) {
+    double d = (double)v;
+    uint64_t bits;
+    memcpy(&bits, &d, 8);
+    *p++ = KLOG_ARG_F64;
+    klogPutLE(p, bits, 8);
+    return p + 8;
+  } else {
+    const bool wide = sizeof(T) > 4;
+    const bool sign = std::is_signed<T>::value;
+    *p++ = wide ? (sign ? KLOG_ARG_I64 : KLOG_ARG_U64) : (sign ? KLOG_ARG_I32 : KLOG_ARG_U32);
+    klogPutLE(p, (uint64_t)(int64_t)v, wide ? 8 : 4);
+    return p + (wide ? 8 : 4);
+  }
+}
+
+inline uint8_t* klogPutStr(uint8_t* p, const char* s) {
+  uint8_t n = s ? (uint8_t)strnlen(s, KLOG_STR_MAX) : 0;
+  *p++ = KLOG_ARG_STR;
+  *p++ = n;
+  memcpy(p, s, n);
+  return p + n;
+}
+inline uint8_t* klogPutArg(uint8_t* p, const char* s) { return klogPutStr(p, s); }
+inline uint8_t* klogPutArg(uint8_t* p, char* s)       { return klogPutStr(p, s); }
+
+inline size_t klogArgsBytes() { return 0; }
+template<typename T, typename... Rest>
+inline size_t klogArgsBytes(T v, Rest... rest) {
+  return klogArgBytes(v) + klogArgsBytes(rest...);
+}
+
+inline uint8_t* klogPutArgs(uint8_t* p) { return p; }
+template<typename T, typename... Rest>
+inline uint8_t* klogPutArgs(uint8_t* p, T v, Rest... rest) {
+  return klogPutArgs(klogPutArg(p, v), rest...);
+}
+
+// -------------------
+// Expanding
+// -------------------
+// printf 'fmt' with the packed args into out (always terminated).
+// Each conversion takes the next argument as it was stored, so a
+// %d given a 64-bit value still prints right. Returns the length.
+inline size_t klogExpand(const char* fmt, const uint8_t* args, size_t len, char* out, size_t cap) {
+  size_t n = 0, pos = 0;
+  auto room = [&]() { return n < cap ? cap - n : 0; };
+  auto add  = [&](int w) { if (w > 0) n += (size_t)w < room() ? (size_t)w : (room() ? room() - 1 : 0); };
+
+  for (const char* f = fmt; *f && room() > 1; f++) {
+    if (*f != '%') {
+      out[n++] = *f;
+      continue;
+    }
+    if (f[1] == '%') {
+      out[n++] = '%';
+      f++;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion
+    char spec[24] = "%";
+    size_t s = 1;
+    const char* p = f + 1;
+    while (*p && strchr("-+ #0123456789.", *p) && s < sizeof(spec) - 4) spec[s++] = *p++;
+    while (*p && strchr("hlLqjzt", *p)) p++;   // the stored type decides the length
+    char conv = *p ? *p : 'd';
+    f = *p ? p : p - 1;
+
+    if (pos >= len) {
+      add(snprintf(out + n, room(), "<?>"));
+      continue;
+    }
+    uint8_t type = args[pos++];
+    if (type == KLOG_ARG_STR) {
+      uint8_t sl = pos < len ? args[pos++] : 0;
+      if (pos + sl > len) sl = 0;
+      char str[KLOG_STR_MAX + 1];
+      memcpy(str, args + pos, sl);
+      str[sl] = '\0';
+      pos += sl;
+      spec[s++] = 's';
+      spec[s]   = '\0';
+      add(snprintf(out + n, room(), spec, str));
+      continue;
+    }
+    uint8_t width = (type == KLOG_ARG_I32 || type == KLOG_ARG_U32) ? 4 : 8;
+    if (pos + width > len) {
+      pos = len;
+      continue;
+    }
+    uint64_t raw = klogGetLE(args + pos, width);
+    pos += width;
+    if (type == KLOG_ARG_F64) {
+      double d;
+      memcpy(&d, &raw, 8);
+      spec[s++] = strchr("fFeEgGaA", conv) ? conv : 'g';
+      spec[s]   = '\0';
+      add(snprintf(out + n, room(), spec, d));
+      continue;
+    }
+    bool sign = type == KLOG_ARG_I32 || type == KLOG_ARG_I64;
+    if (conv == 'p') {
+      add(snprintf(out + n, room(), "0x%08llx", (unsigned long long)raw));
+      continue;
+    }
+    if (conv == 'c') {
+      spec[s++] = 'c';
+      spec[s]   = '\0';
+      add(snprintf(out + n, room(), spec, (int)(char)raw));
+      continue;
+    }
+    if (!strchr("diuxXo", conv)) conv = sign ? 'd' : 'u';
+    spec[s++] = 'l';
+    spec[s++] = 'l';
+    spec[s++] = conv;
+    spec[s]   = '\0';
+    if (conv == 'd' || conv == 'i') {
+      long long v = type == KLOG_ARG_I32 ? (long long)(int32_t)raw : (long long)raw;
+      add(snprintf(out + n, room(), spec, v));
+    } else {
+      add(snprintf(out + n, room(), spec, (unsigned long long)raw));   // 32-bit: zero-extended
+    }
+  }
+  if (cap) out[n < cap ? n : cap - 1] = '\0';
+  return n;
+}
+
+#endif // KNOB_LOG_CODE_H
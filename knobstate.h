@@ -0,0 +1,89 @@
+#ifndef KNOB_STATE_H
+#define KNOB_STATE_H
+
+#include "monotime.h"
+
+// =============================================================
+// STATE MACHINE DATA
+// The modes and the variables loop() steps them with. No Arduino
+// dependencies: knobsteps.h (the per-state logic) runs on the
+// device and, under a virtual clock, in tools/tracereplay.cpp.
+// =============================================================
+
+#define STANDBY_TIMEOUT_MS         10000UL  // Standby mode after 10 seconds
+#define VOLUME_ANIM_MS             300      // ring around the volume icon after a step
+
+// --- State Machine Definitions ---
+enum AppState {
+  STATE_MENU,
+  STATE_STANDBY,       // Auto-activates after idle
+  STATE_VOLUME,
+  STATE_WAKE,
+  STATE_TIMER_SET,
+  STATE_TIMER_RUNNING,
+  STATE_TIMER_PAUSED,
+  STATE_TIMER_ENDED,
+  STATE_OBS,           // OBS Play/Pause control
+  STATE_DOORLOCK,      // Door Lock/Unlock control
+  STATE_STOPWATCH,     // Stopwatch triggered via HTTP endpoint
+  STATE_MACRO,         // User-defined mode (macrovm.h)
+  STATE_MESSAGE,       // Text pushed over HTTP (batchapi.h), then back
+  STATE_ANIMATING_TO_STANDBY,
+  STATE_ANIMATING_WAKE
+};
+
+AppState currentState = STATE_MENU;
+#define MENU_BUILTIN_COUNT 5   // main-menu modes; stored macros follow these
+int menuSelection     = 0;
+int lastMenuSelection = -1;
+
+int pauseSelection     = 0;
+int lastPauseSelection = -1;
+
+// --- Timer Variables ---
+int timerMinutes      = 1;
+int lastTimerMinutes  = -1;
+uint32_t knobTimerId               = 0;   // timer service id while counting down, 0 = none
+unsigned long timerRemainingMillis = 0;   // kept while paused
+
+// --- Standby Tracking ---
+bool enteredStandbyFromVolume = false;
+bool enteredStandbyFromDoorLock = false;
+bool enteredStandbyFromOBS = false;
+bool enteredStandbyFromMacro = false;
+
+// --- OBS Control Tracking ---
+int  obsLastDirection        = 0;       // 1 = right, -1 = left, 0 = idle
+
+// --- DoorLock Control Tracking ---
+int  doorLastDirection        = 0;
+int  doorLastStatus           = 0;      // 0=idle, 1=unlocked, -1=locked, 2=error
+
+// --- Stopwatch Variables (HTTP-triggered) ---
+bool stopwatchRunning       = false;   // true while counting up
+MonoTime stopwatchStartedAt = {};       // when (re)started
+unsigned long stopwatchElapsed     = 0; // accumulated elapsed ms
+
+// --- Message Overlay (HTTP-triggered) ---
+#define MESSAGE_TEXT_MAX 96
+char messageText[MESSAGE_TEXT_MAX + 1] = "";
+Deadline messageEnd;                         // when it goes away
+AppState messageReturnState   = STATE_MENU;   // mode underneath
+int messageCounter            = 0;            // its encoder count, held meanwhile
+
+// --- Animation Tracking ---
+int animYOffset = 0;
+MonoTime animLastFrameTime = {};
+AppState postAnimState = STATE_STANDBY;
+AppState preAnimState  = STATE_MENU;
+int volumeAnimIndicator = 0;
+Deadline volumeAnimEnd;
+MonoTime lastVolAnimFrameTime = {};
+
+// --- Activity / Standby Tracking ---
+MonoTime lastActivityTime  = {};
+MonoTime lastStandbyUpdate = {};   // {} = redraw at the next pass
+int lastStandbyCounter     = 0;
+MonoTime lastDisplayUpdate = {};
+
+#endif // KNOB_STATE_H
@@ -0,0 +1,637 @@
+#ifndef KNOB_STEPS_H
+#define KNOB_STEPS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "monotime.h"
+#include "knobstate.h"
+#include "gesturecode.h"
+#include "encoderaccel.h"
+#include "tracecode.h"
+
+// =============================================================
+// STATE MACHINE STEP
+// The per-state part of loop(): long-press back to the menu, TIME
+// UP, then the current state's inputs, draws and timeouts. loop()
+// keeps the hardware around it (HTTP, WiFi, buzzer, BLE follow).
+//
+// No Arduino includes: the sketch includes this once everything
+// below exists, and tools/tracereplay.cpp includes it after its
+// own stand-ins, to replay recorded input through the same steps
+// under a virtual clock (KNOB_VIRTUAL_CLOCK).
+//
+// The including file provides:
+//   inputs    counter, lastDisplayedCounter, inputEdges, buttonPressed,
+//             buttonLongPressed, buttonDoubleClicked, isButtonHeld(),
+//             consumeButtonPress(), EncoderEvent, popEncoderEvent(),
+//             flushEncoderEvents(), encoderEventTail, encoderAccel
+//   screens   display.clearDisplay()/display(), drawMenu() and the
+//             other draw*Screen() of oled_disply.h,
+//             slideCaptureFrom/Begin/Step(), SLIDE_UP/SLIDE_DOWN
+//   modes     sendVolumeSteps(), sendNextTrack(), sendPrevTrack(),
+//             sendMute(), handleWakeModeLogic(), lastKeySendTime,
+//             modeTasks.post() with obsTurn/doorTurn, macroVm,
+//             MACRO_EVENT_*, macroTick(), macroScreenDirty,
+//             openMacro(), closeMacro(), macroSlotAt(),
+//             menuItemCount(), httpPoolPreconnect(), doorLockOpenUrl
+//   timers    startCountdown(), cancelTimer(), timerRemainingMs(),
+//             TIMER_KIND_KNOB, timerAlarmPending, timerAlarmLabel
+//   device    traceRecord(), buzzerOff(), updatePowerSave(),
+//             standbyPass()
+// =============================================================
+
+// Draw the screen a slide animation moves in or out, unscrolled
+// and into the current buffer (no clear, no display()).
+void drawAnimScreen(AppState state) {
+  if (state == STATE_VOLUME) {
+    drawVolumeScreen(0, false);
+  } else if (state == STATE_DOORLOCK) {
+    drawDoorLockScreen(doorLastStatus, 0, false);
+  } else if (state == STATE_OBS) {
+    drawOBSScreen(obsLastDirection, 0, false);
+  } else if (state == STATE_MACRO) {
+    drawMacroScreen(0, false);
+  } else {
+    drawMenu(0, false);
+  }
+}
+
+// Timer minutes from a clean slate: steps turned before this don't
+// count. The trace gets the starting value for tracereplay.
+void beginTimerSet() {
+  currentState     = STATE_TIMER_SET;
+  lastTimerMinutes = -1;
+  flushEncoderEvents();
+  traceRecord(TRACE_VALUE, TRACE_VALUE_TIMER_MINUTES, timerMinutes, encoderEventTail);
+}
+
+// Full redraw of 'state' as it is now, e.g. coming back from a
+// message. Modes that draw on change get their "last" reset.
+void redrawState(AppState state) {
+  if (state == STATE_VOLUME || state == STATE_DOORLOCK || state == STATE_OBS ||
+      state == STATE_MACRO) {
+    display.clearDisplay();
+    drawAnimScreen(state);
+    display.display();
+  } else if (state == STATE_MENU) {
+    lastMenuSelection = -1;
+  } else if (state == STATE_WAKE) {
+    drawWakeScreen();
+  } else if (state == STATE_TIMER_SET) {
+    beginTimerSet();
+  } else if (state == STATE_TIMER_RUNNING || state == STATE_STOPWATCH) {
+    lastDisplayUpdate = {};
+  } else if (state == STATE_TIMER_PAUSED) {
+    lastPauseSelection = -1;
+  } else if (state == STATE_TIMER_ENDED) {
+    drawTimerEndedScreen(timerAlarmLabel);
+  } else if (state == STATE_STANDBY) {
+    lastStandbyUpdate = {};
+  }
+}
+
+// Open main-menu entry 'item' (built-ins, then stored macros), as
+// a press on it would. False if there is no such entry.
+bool enterMenuItem(int item) {
+  lastActivityTime     = monoNow();
+  counter              = 0;
+  lastDisplayedCounter = 0;
+
+  if (item == 0) {
+    currentState = STATE_VOLUME;
+    drawVolumeScreen();
+  } else if (item == 1) {
+    currentState    = STATE_WAKE;
+    lastKeySendTime = monoNow();
+    drawWakeScreen();
+  } else if (item == 2) {
+    if (knobTimerId) {
+      // Still counting down from an earlier visit
+      currentState      = STATE_TIMER_RUNNING;
+      lastDisplayUpdate = {};
+    } else {
+      beginTimerSet();
+    }
+  } else if (item == 3) {
+    currentState = STATE_OBS;
+    counter      = 0;
+    lastDisplayedCounter = 0;
+    obsLastDirection = 0;
+    drawOBSScreen(0);
+  } else if (item == 4) {
+    currentState = STATE_DOORLOCK;
+    httpPoolPreconnect(doorLockOpenUrl);   // the first turn will likely send a request
+    counter      = 0;
+    lastDisplayedCounter = 0;
+    doorLastDirection = 0;
+    doorLastStatus    = 0;
+    drawDoorLockScreen(0);
+  } else if (openMacro(macroSlotAt(item - MENU_BUILTIN_COUNT))) {
+    currentState = STATE_MACRO;
+    drawMacroScreen();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Gestures each state listens for. Double-click costs every click
+// the double-click window, so only modes that use it pay for it.
+uint8_t gesturesForState(AppState state) {
+  switch (state) {
+    case STATE_VOLUME:
+      return GESTURE_CLICK | GESTURE_LONG | GESTURE_DOUBLE | GESTURE_CHORD;
+    default:
+      return GESTURE_CLICK | GESTURE_LONG;
+  }
+}
+
+// One pass over the state machine. False when loop() must not
+// sleep its 10 ms: standby sleeps on its own, and a wake starts
+// its slide at once.
+bool knobStep() {
+  // ── Long-press: always return to Main Menu (except during HTTP stopwatch) ──
+  if (buttonLongPressed && currentState != STATE_STOPWATCH) {
+    buttonLongPressed   = false;
+    buttonPressed       = false;
+    buttonDoubleClicked = false;
+    buzzerOff();
+    if (macroVm.loaded()) closeMacro();   // also under a message or in standby
+    currentState      = STATE_MENU;
+    counter           = 0;
+    lastMenuSelection = -1;
+    lastActivityTime  = monoNow();
+    enteredStandbyFromVolume = false;
+    enteredStandbyFromDoorLock = false;
+    enteredStandbyFromOBS = false;
+    enteredStandbyFromMacro = false;
+    drawMenu();
+  }
+
+  // ── A countdown or alarm went off: TIME UP over whatever is showing ──
+  if (timerAlarmPending && currentState != STATE_ANIMATING_TO_STANDBY &&
+      currentState != STATE_ANIMATING_WAKE) {
+    timerAlarmPending = false;
+    if (macroVm.loaded()) closeMacro();
+    enteredStandbyFromVolume   = false;
+    enteredStandbyFromDoorLock = false;
+    enteredStandbyFromOBS      = false;
+    enteredStandbyFromMacro    = false;
+    currentState     = STATE_TIMER_ENDED;   // alarmBeep takes the buzzer from here
+    lastActivityTime = monoNow();
+    drawTimerEndedScreen(timerAlarmLabel);
+  }
+
+  // Low-power standby follows the state, whoever changed it (loop or HTTP)
+  updatePowerSave(currentState == STATE_STANDBY);
+
+  // ── STATE: STANDBY ───────────────────────────────────────────
+  if (currentState == STATE_STANDBY) {
+    uint32_t seenEdges = inputEdges;   // before checking, so no edge is missed
+    // Wake on press-down; the rest of that press is used up
+    bool wokenByButton  = isButtonHeld() || buttonPressed || buttonLongPressed;
+    bool wokenByEncoder = (counter != lastStandbyCounter);
+
+    if (wokenByButton || wokenByEncoder) {
+      if (isButtonHeld()) consumeButtonPress();
+      buttonPressed     = false;
+      buttonLongPressed = false;
+      
+      currentState      = STATE_ANIMATING_WAKE;
+      animYOffset       = 0;
+      animLastFrameTime = monoNow();
+      preAnimState      = STATE_STANDBY;
+      
+      if (enteredStandbyFromVolume) {
+          postAnimState = STATE_VOLUME;
+      } else if (enteredStandbyFromDoorLock) {
+          postAnimState = STATE_DOORLOCK;
+          httpPoolPreconnect(doorLockOpenUrl);   // warm up during the wake slide
+      } else if (enteredStandbyFromOBS) {
+          postAnimState = STATE_OBS;
+      } else if (enteredStandbyFromMacro) {
+          postAnimState = STATE_MACRO;
+      } else {
+          postAnimState = STATE_MENU;
+      }
+      
+      if (postAnimState == STATE_MENU) {
+          // Keep the half detent that woke it, so its second edge
+          // lands on a whole detent and the menu still moves on the
+          // second edge of each
+          counter = counter - lastStandbyCounter;
+      } else {
+          // If returning to volume/doorlock, wait till animation ends to read new changes,
+          // but we preserve lastStandbyCounter to prevent jumping.
+          counter = lastStandbyCounter;
+      }
+      
+      lastMenuSelection = -1;
+      lastActivityTime  = monoNow();
+      return false;
+    }
+    // Redraw when due, then sleep until input or a timer
+    standbyPass(seenEdges);
+    return false;
+  }
+
+  // ── STATE: MAIN MENU ──────────────────────────────────────
+  if (currentState == STATE_MENU) {
+    menuSelection = abs(counter / 2) % menuItemCount();
+
+    if (menuSelection != lastMenuSelection) {
+      lastActivityTime  = monoNow();
+      drawMenu();
+      lastMenuSelection = menuSelection;
+    }
+
+    if (buttonPressed) {
+      buttonPressed    = false;
+      lastActivityTime = monoNow();
+      if (!enterMenuItem(menuSelection)) {
+        lastMenuSelection = -1;   // slot vanished (erased over HTTP); redraw
+      }
+    }
+
+    // Enter standby after idle timeout — MENU
+    if (since(lastActivityTime) >= msecs(STANDBY_TIMEOUT_MS)) {
+      currentState       = STATE_ANIMATING_TO_STANDBY;
+      animYOffset        = 0;
+      animLastFrameTime  = monoNow();
+      preAnimState       = STATE_MENU;
+      postAnimState      = STATE_STANDBY;
+      enteredStandbyFromVolume = false;
+      enteredStandbyFromDoorLock = false;
+      enteredStandbyFromOBS = false;
+      enteredStandbyFromMacro = false;
+      lastStandbyCounter = counter;
+      lastStandbyUpdate  = {};
+    }
+  }
+
+  // ── STATE: VOLUME KNOB ────────────────────────────────────
+  else if (currentState == STATE_VOLUME) {
+    // Chord: turning while the button is held skips a track per
+    // detent (two counter steps); a half-turned detent waits
+    if (isButtonHeld()) {
+      int detents = (counter - lastDisplayedCounter) / 2;
+      for (int i = 0; i < abs(detents); i++) {
+        if (detents > 0) sendNextTrack();
+        else             sendPrevTrack();
+      }
+      if (detents) {
+        lastDisplayedCounter += detents * 2;
+        lastActivityTime = monoNow();
+      }
+    }
+    else if (counter != lastDisplayedCounter) {
+      sendVolumeSteps(counter - lastDisplayedCounter);
+      volumeAnimIndicator = (counter > lastDisplayedCounter) ? 1 : -1;
+      lastDisplayedCounter = counter;
+      lastActivityTime = monoNow();
+      volumeAnimEnd.arm(msecs(VOLUME_ANIM_MS));
+      drawVolumeScreen();
+    }
+    
+    // Clear or play volume animation after timeout
+    if (volumeAnimIndicator != 0) {
+      if (volumeAnimEnd.expired()) {
+        volumeAnimIndicator = 0;
+        drawVolumeScreen();
+      } else if (since(lastVolAnimFrameTime) >= 20_ms) { 
+        lastVolAnimFrameTime = monoNow();
+        drawVolumeScreen();
+      }
+    }
+    if (buttonDoubleClicked) {
+      buttonDoubleClicked = false;
+      sendMute();
+      lastActivityTime = monoNow();
+    }
+    if (buttonPressed) {
+      buttonPressed     = false;
+      currentState      = STATE_MENU;
+      counter           = 0;
+      lastMenuSelection = -1;
+      lastActivityTime  = monoNow();
+    }
+
+    // Inactivity timeout logic for Volume Screen
+    if (since(lastActivityTime) >= msecs(STANDBY_TIMEOUT_MS)) {
+      currentState       = STATE_ANIMATING_TO_STANDBY;
+      animYOffset        = 0;
+      animLastFrameTime  = monoNow();
+      preAnimState       = STATE_VOLUME;
+      postAnimState      = STATE_STANDBY;
+      enteredStandbyFromVolume = true;
+      enteredStandbyFromDoorLock = false;
+      enteredStandbyFromOBS = false;
+      enteredStandbyFromMacro = false;
+      lastStandbyCounter = counter;
+      lastStandbyUpdate  = {};
+    }
+  }
+
+  // ── STATE: WAKE MODE ──────────────────────────────────────
+  else if (currentState == STATE_WAKE) {
+    handleWakeModeLogic();
+    if (buttonPressed) {
+      buttonPressed     = false;
+      currentState      = STATE_MENU;
+      counter           = 0;
+      lastMenuSelection = -1;
+      lastActivityTime  = monoNow();
+    }
+  }
+
+  // ── STATE: TIMER SET ──────────────────────────────────────
+  else if (currentState == STATE_TIMER_SET) {
+    // Accelerated, per detent: slow turns step 1 min, fast spins up to 10
+    EncoderEvent ev;
+    while (popEncoderEvent(ev)) {
+      timerMinutes += encoderAccel.step(MonoTime{ ev.us }.ms32(), ev.dir, ACCEL_TIMER);
+      timerMinutes = std::max(1, std::min(99, timerMinutes));
+    }
+    if (timerMinutes != lastTimerMinutes) {
+      // With the steps used so far, so tracereplay can re-run the acceleration
+      traceRecord(TRACE_VALUE, TRACE_VALUE_TIMER_MINUTES, timerMinutes, encoderEventTail);
+      drawTimerSetScreen();
+      lastTimerMinutes = timerMinutes;
+    }
+    if (buttonPressed) {
+      buttonPressed = false;
+      knobTimerId   = startCountdown(timerMinutes * 60UL * 1000UL, 0, "Timer", TIMER_KIND_KNOB);
+      if (knobTimerId) {
+        currentState      = STATE_TIMER_RUNNING;
+        lastDisplayUpdate = {};
+      }
+    }
+  }
+
+  // ── STATE: TIMER RUNNING ──────────────────────────────────
+  // The countdown itself is in the timer service; TIME UP comes
+  // through timerAlarmPending like any other timer.
+  else if (currentState == STATE_TIMER_RUNNING) {
+    int64_t remainingMs = timerRemainingMs(knobTimerId);
+    if (remainingMs >= 0 && since(lastDisplayUpdate) >= 1000_ms) {
+      drawTimerRunningScreen((int)(remainingMs / 1000));
+      lastDisplayUpdate = monoNow();
+    }
+    if (buttonPressed && remainingMs >= 0) {
+      buttonPressed        = false;
+      timerRemainingMillis = (unsigned long)remainingMs;
+      cancelTimer(knobTimerId);
+      currentState         = STATE_TIMER_PAUSED;
+      counter              = 0;
+      pauseSelection       = 0;
+      lastPauseSelection   = -1;
+    }
+  }
+
+  // ── STATE: TIMER PAUSED ───────────────────────────────────
+  else if (currentState == STATE_TIMER_PAUSED) {
+    pauseSelection = abs(counter / 2) % 2;
+    if (pauseSelection != lastPauseSelection) {
+      drawTimerPausedScreen();
+      lastPauseSelection = pauseSelection;
+    }
+    if (buttonPressed) {
+      buttonPressed = false;
+      if (pauseSelection == 0) {
+        knobTimerId       = startCountdown(timerRemainingMillis, 0, "Timer", TIMER_KIND_KNOB);
+        currentState      = STATE_TIMER_RUNNING;
+        lastDisplayUpdate = {};
+        if (!knobTimerId) beginTimerSet();   // no free timer: set it again
+      } else {
+        currentState      = STATE_MENU;
+        counter           = 0;
+        lastMenuSelection = -1;
+        lastActivityTime  = monoNow();
+      }
+    }
+  }
+
+  // ── STATE: TIMER ENDED (ALARM) ────────────────────────────
+  else if (currentState == STATE_TIMER_ENDED) {
+    if (buttonPressed) {
+      buttonPressed     = false;
+      buzzerOff();
+      currentState      = STATE_MENU;
+      counter           = 0;
+      lastMenuSelection = -1;
+      lastActivityTime  = monoNow();
+    }
+  }
+
+  // ── STATE: OBS CONTROL ────────────────────────────────────
+  else if (currentState == STATE_OBS) {
+    // obsTurn sends the chord and redraws; whole detents only, so
+    // a half-turned detent sends nothing
+    int detents = (counter - lastDisplayedCounter) / 2;
+    if (detents) {
+      modeTasks.post(obsTurn, detents > 0 ? 1 : -1);
+      lastDisplayedCounter += detents * 2;
+      lastActivityTime      = monoNow();
+    }
+
+    if (buttonPressed) {
+      buttonPressed     = false;
+      currentState      = STATE_MENU;
+      counter           = 0;
+      lastMenuSelection = -1;
+      lastActivityTime  = monoNow();
+      enteredStandbyFromOBS = false;
+    }
+
+    // Inactivity timeout logic for OBS Screen
+    if (since(lastActivityTime) >= msecs(STANDBY_TIMEOUT_MS)) {
+      currentState       = STATE_ANIMATING_TO_STANDBY;
+      animYOffset        = 0;
+      animLastFrameTime  = monoNow();
+      preAnimState       = STATE_OBS;
+      postAnimState      = STATE_STANDBY;
+      enteredStandbyFromOBS      = true;
+      enteredStandbyFromVolume   = false;
+      enteredStandbyFromDoorLock = false;
+      enteredStandbyFromMacro    = false;
+      lastStandbyCounter = counter;
+      lastStandbyUpdate  = {};
+    }
+  }
+
+  // ── STATE: DOOR LOCK CONTROL ──────────────────────────────
+  else if (currentState == STATE_DOORLOCK) {
+    // doorTurn sends the request and redraws; as OBS, a half-turned
+    // detent doesn't open the door
+    int detents = (counter - lastDisplayedCounter) / 2;
+    if (detents) {
+      modeTasks.post(doorTurn, detents > 0 ? 1 : -1);
+      lastDisplayedCounter += detents * 2;
+      lastActivityTime      = monoNow();
+    }
+
+    if (buttonPressed) {
+      buttonPressed      = false;
+      doorLastStatus     = 0;
+      currentState       = STATE_MENU;
+      counter            = 0;
+      lastMenuSelection  = -1;
+      lastActivityTime   = monoNow();
+      enteredStandbyFromDoorLock = false;
+    }
+
+    // Inactivity timeout logic for DoorLock Screen
+    if (since(lastActivityTime) >= msecs(STANDBY_TIMEOUT_MS)) {
+      currentState       = STATE_ANIMATING_TO_STANDBY;
+      animYOffset        = 0;
+      animLastFrameTime  = monoNow();
+      preAnimState       = STATE_DOORLOCK;
+      postAnimState      = STATE_STANDBY;
+      enteredStandbyFromDoorLock = true;
+      enteredStandbyFromVolume   = false;
+      enteredStandbyFromOBS      = false;
+      enteredStandbyFromMacro    = false;
+      lastStandbyCounter = counter;
+      lastStandbyUpdate  = {};
+    }
+  }
+
+
+
+  // ── STATE: MACRO (user-defined, see macrovm.h) ────────────
+  else if (currentState == STATE_MACRO) {
+    // Whole detents only (two counter steps each); a half-turned
+    // detent waits for its second edge
+    int detents = (counter - lastDisplayedCounter) / 2;
+    if (detents) {
+      macroVm.post(detents > 0 ? MACRO_EVENT_RIGHT : MACRO_EVENT_LEFT, (int16_t)abs(detents));
+      lastDisplayedCounter += detents * 2;
+      lastActivityTime      = monoNow();
+    }
+
+    if (buttonPressed) {
+      buttonPressed    = false;
+      lastActivityTime = monoNow();
+      if (macroVm.hasHandler(MACRO_EVENT_PRESS)) {
+        macroVm.post(MACRO_EVENT_PRESS, 0);
+      } else {
+        closeMacro();
+        currentState      = STATE_MENU;
+        counter           = 0;
+        lastMenuSelection = -1;
+        enteredStandbyFromMacro = false;
+      }
+    }
+
+    if (currentState == STATE_MACRO) {
+      macroTick();
+      if (macroScreenDirty) drawMacroScreen();
+
+      // Inactivity timeout — the program stays loaded for the wake
+      if (!macroVm.busy() && since(lastActivityTime) >= msecs(STANDBY_TIMEOUT_MS)) {
+        currentState       = STATE_ANIMATING_TO_STANDBY;
+        animYOffset        = 0;
+        animLastFrameTime  = monoNow();
+        preAnimState       = STATE_MACRO;
+        postAnimState      = STATE_STANDBY;
+        enteredStandbyFromMacro    = true;
+        enteredStandbyFromVolume   = false;
+        enteredStandbyFromDoorLock = false;
+        enteredStandbyFromOBS      = false;
+        lastStandbyCounter = counter;
+        lastStandbyUpdate  = {};
+      }
+    }
+  }
+
+  // ── STATE: STOPWATCH (HTTP-triggered, counts up) ───────────
+  else if (currentState == STATE_STOPWATCH) {
+    // Consume button presses — stopwatch is HTTP-controlled only
+    buttonPressed       = false;
+    buttonLongPressed   = false;
+    buttonDoubleClicked = false;
+
+    // Refresh display every second to update the counter
+    if (since(lastDisplayUpdate) >= 1000_ms) {
+      drawStopwatchScreen();
+      lastDisplayUpdate = monoNow();
+    }
+  }
+
+
+
+  // ── STATE: MESSAGE (HTTP-triggered overlay, see batchapi.h) ──
+  else if (currentState == STATE_MESSAGE) {
+    counter = messageCounter;   // turns don't leak into the mode underneath
+    if (buttonPressed || messageEnd.expired()) {
+      buttonPressed    = false;
+      currentState     = messageReturnState;
+      lastActivityTime = monoNow();
+      redrawState(currentState);
+    }
+  }
+
+  // ── STATE: ANIMATING TO STANDBY ───────────────────────────
+  else if (currentState == STATE_ANIMATING_TO_STANDBY) {
+    if (since(animLastFrameTime) >= 15_ms) { 
+      if (animYOffset == 0) {
+        // Render both screens once; frames only move the start line
+        display.clearDisplay();
+        drawAnimScreen(preAnimState);
+        slideCaptureFrom();
+        drawStandbyScreen(0, false);
+        slideBegin(SLIDE_DOWN);
+      }
+      animYOffset += 6; 
+      if (animYOffset >= 64) {
+        animYOffset = 64;
+        currentState = postAnimState;
+        drawStandbyScreen();
+      } else {
+        slideStep(animYOffset);
+      }
+      animLastFrameTime = monoNow();
+    }
+  }
+
+  // ── STATE: ANIMATING WAKE ─────────────────────────────────
+  else if (currentState == STATE_ANIMATING_WAKE) {
+    if (since(animLastFrameTime) >= 15_ms) {
+      if (animYOffset == 0) {
+        display.clearDisplay();
+        drawStandbyScreen(0, false);
+        slideCaptureFrom();
+        drawAnimScreen(postAnimState);
+        slideBegin(SLIDE_UP);
+      }
+      animYOffset -= 8; 
+      if (animYOffset <= -64) {
+        animYOffset = 0;
+        currentState = postAnimState;
+        if (postAnimState == STATE_VOLUME) {
+          drawVolumeScreen();
+        } else if (postAnimState == STATE_DOORLOCK) {
+          drawDoorLockScreen(doorLastStatus);
+        } else if (postAnimState == STATE_OBS) {
+          drawOBSScreen(obsLastDirection);
+        } else if (postAnimState == STATE_MACRO) {
+          drawMacroScreen();
+        } else {
+          enteredStandbyFromVolume = false;
+          enteredStandbyFromDoorLock = false;
+          enteredStandbyFromOBS = false;
+          enteredStandbyFromMacro = false;
+          drawMenu();
+        }
+      } else {
+        slideStep(-animYOffset);
+      }
+      animLastFrameTime = monoNow();
+    }
+  }
+
+  return true;
+}
+
+#endif // KNOB_STEPS_H
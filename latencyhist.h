@@ -0,0 +1,73 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// LATENCY HISTOGRAM
+// Fixed-width buckets for a stream of durations too long to keep
+// sample by sample: loop() periods, encoder step to loop pass.
+// Percentiles come back as the upper edge of their bucket, so they
+// are within one bucket width (and never optimistic); the exact
+// maximum is kept separately, as is anything past the last bucket.
+//
+// No Arduino dependencies: loopmonitor.h fills one on the device,
+// tools/loadtest.cpp the same on its simulated loop.
+// =============================================================
+
+template<uint16_t Buckets>
+class LatencyHist {
+ public:
+  explicit LatencyHist(uint32_t bucketUs) : bucketUs_(bucketUs) { reset(); }
+
+  void reset() {
+    memset(counts_, 0, sizeof(counts_));
+    total_   = 0;
+    over_    = 0;
+    maxUs_   = 0;
+    sumUs_   = 0;
+  }
+
+  void add(uint32_t us) {
+    uint32_t b = us / bucketUs_;
+    if (b < Buckets) counts_[b]++;
+    else             over_++;
+    total_++;
+    sumUs_ += us;
+    if (us > maxUs_) maxUs_ = us;
+  }
+
+  // perMille: 500 = p50, 990 = p99, 999 = p99.9. Past the last
+  // bucket the answer is the maximum.
+  uint32_t percentileUs(uint16_t perMille) const {
+    if (total_ == 0) return 0;
+    uint64_t rank = ((uint64_t)total_ * perMille + 999) / 1000;   // 1-based
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (uint16_t b = 0; b < Buckets; b++) {
+      seen += counts_[b];
+      if (seen >= rank) {
+        uint32_t edge = (b + 1) * bucketUs_;
+        return edge < maxUs_ ? edge : maxUs_;
+      }
+    }
+    return maxUs_;
+  }
+
+  uint32_t count() const    { return total_; }
+  uint32_t overflow() const { return over_; }
+  uint32_t maxUs() const    { return maxUs_; }
+  uint32_t avgUs() const    { return total_ ? (uint32_t)(sumUs_ / total_) : 0; }
+  uint32_t bucketUs() const { return bucketUs_; }
+
+ private:
+  uint32_t counts_[Buckets];
+  uint32_t bucketUs_;
+  uint32_t total_;
+  uint32_t over_;
+  uint32_t maxUs_;
+  uint64_t sumUs_;
+};
+
+#endif // LATENCY_HIST_H
@@ -0,0 +1,149 @@
+#ifndef LOOP_MONITOR_H
+#define LOOP_MONITOR_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "fixedstring.h"
+#include "latencyhist.h"
+#include "monotime.h"
+#include "rotarycode.h"
+
+// =============================================================
+// LOOP MONITOR
+// How steadily loop() comes round while HTTP clients hammer the
+// web server (which runs inside it), and what that does to the
+// knob: GET /api/loop for tools/loadtest.cpp.
+//
+//  - period: time between loop() passes, standby passes left out
+//    (they block on purpose)
+//  - encoder: each step's time from its ISR to the pass that sees
+//    it; "late" past LOOP_STEP_LATE_MS, "missed" when more steps
+//    came between two passes than the event ring holds, so the
+//    oldest were overwritten before the mode could read them
+//  - probe: the same for synthetic steps an esp_timer injects at a
+//    fixed rate (POST /api/loop?probe=hz), so a load test measures
+//    step handling without someone turning the knob. Probe steps
+//    go to their own ring and never reach the UI.
+// =============================================================
+
+#define LOOP_HIST_BUCKETS    100
+#define LOOP_HIST_BUCKET_US  500      // 0.5 ms buckets, 0..50 ms
+#define LOOP_STEP_LATE_MS    50       // a step the UI sees later than this lags visibly
+#define LOOP_PROBE_MAX_HZ    1000
+
+struct LoopStepStats {
+  uint32_t steps;
+  uint32_t late;
+  uint32_t missed;
+};
+
+LatencyHist<LOOP_HIST_BUCKETS> loopPeriodHist(LOOP_HIST_BUCKET_US);
+LatencyHist<LOOP_HIST_BUCKETS> loopStepLagHist(LOOP_HIST_BUCKET_US);
+LatencyHist<LOOP_HIST_BUCKETS> loopProbeLagHist(LOOP_HIST_BUCKET_US);
+LoopStepStats loopStepStats  = {};
+LoopStepStats loopProbeStats = {};
+
+MonoTime loopLastPass        = {};
+bool     loopLastPassStandby = true;   // no period for the first pass
+uint8_t  loopSeenStepHead    = 0;
+
+volatile int64_t loopProbeRing[ENCODER_EVENT_RING];
+volatile uint8_t loopProbeHead = 0;   // written by the probe timer
+uint8_t          loopProbeTail = 0;
+esp_timer_handle_t loopProbeTimer = nullptr;
+uint16_t           loopProbeHz    = 0;
+
+static void loopProbeCallback(void*) {
+  uint8_t slot = loopProbeHead & (ENCODER_EVENT_RING - 1);
+  loopProbeRing[slot] = monoNow().us;
+  loopProbeHead++;
+}
+
+// Steps seen..head of a ring of ENCODER_EVENT_RING stamps
+template<class StampAt>
+static void loopTakeSteps(uint8_t head, uint8_t &seen, MonoTime now, bool record,
+                          LoopStepStats &stats, LatencyHist<LOOP_HIST_BUCKETS> &hist,
+                          StampAt stampAt) {
+  uint8_t n = head - seen;
+  seen = head;
+  if (n == 0 || !record) return;
+  if (n > ENCODER_EVENT_RING) {
+    stats.missed += n - ENCODER_EVENT_RING;
+    n = ENCODER_EVENT_RING;
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    uint8_t slot = (uint8_t)(head - n + i) & (ENCODER_EVENT_RING - 1);
+    int64_t lagUs = (now - MonoTime{ stampAt(slot) }).toUs();
+    if (lagUs < 0) lagUs = 0;   // landed after 'now' was read
+    hist.add(lagUs > UINT32_MAX ? UINT32_MAX : (uint32_t)lagUs);
+    stats.steps++;
+    if (lagUs > LOOP_STEP_LATE_MS * 1000LL) stats.late++;
+  }
+}
+
+// First thing in every loop() pass
+inline void loopMonitorTick(bool standby) {
+  MonoTime now = monoNow();
+  bool record = !standby && !loopLastPassStandby;
+  if (record) {
+    int64_t us = (now - loopLastPass).toUs();
+    loopPeriodHist.add(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+  }
+  loopLastPass        = now;
+  loopLastPassStandby = standby;
+
+  loopTakeSteps(encoderEventHead, loopSeenStepHead, now, record, loopStepStats, loopStepLagHist,
+                [](uint8_t slot) { return (int64_t)encoderEvents[slot].us; });
+  loopTakeSteps(loopProbeHead, loopProbeTail, now, true, loopProbeStats, loopProbeLagHist,
+                [](uint8_t slot) { return (int64_t)loopProbeRing[slot]; });
+}
+
+inline void loopMonitorReset() {
+  loopPeriodHist.reset();
+  loopStepLagHist.reset();
+  loopProbeLagHist.reset();
+  loopStepStats       = {};
+  loopProbeStats      = {};
+  loopLastPassStandby = true;
+}
+
+// 0 stops the probe
+inline bool loopProbeStart(uint16_t hz) {
+  if (loopProbeTimer) {
+    esp_timer_stop(loopProbeTimer);
+  } else if (hz) {
+    esp_timer_create_args_t args = {};
+    args.callback = loopProbeCallback;
+    args.name     = "loopProbe";
+    if (esp_timer_create(&args, &loopProbeTimer) != ESP_OK) return false;
+  }
+  if (hz > LOOP_PROBE_MAX_HZ) hz = LOOP_PROBE_MAX_HZ;
+  loopProbeHz = hz;
+  if (hz) esp_timer_start_periodic(loopProbeTimer, 1000000UL / hz);
+  return true;
+}
+
+template<size_t N, uint16_t B>
+inline void loopHistJson(FixedString<N> &json, const char* key, const LatencyHist<B> &h) {
+  json.appendf("\"%s\":{\"n\":%u,\"avg\":%u,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}", key,
+               (unsigned)h.count(), (unsigned)h.avgUs(), (unsigned)h.percentileUs(500),
+               (unsigned)h.percentileUs(990), (unsigned)h.percentileUs(999), (unsigned)h.maxUs());
+}
+
+// Durations in microseconds
+template<size_t N>
+inline void loopStatsJson(FixedString<N> &json) {
+  json.append("{");
+  loopHistJson(json, "periodUs", loopPeriodHist);
+  json.appendf(",\"steps\":%u,\"stepsLate\":%u,\"stepsMissed\":%u,",
+               (unsigned)loopStepStats.steps, (unsigned)loopStepStats.late,
+               (unsigned)loopStepStats.missed);
+  loopHistJson(json, "stepLagUs", loopStepLagHist);
+  json.appendf(",\"probeHz\":%u,\"probeSteps\":%u,\"probeLate\":%u,\"probeMissed\":%u,",
+               (unsigned)loopProbeHz, (unsigned)loopProbeStats.steps, (unsigned)loopProbeStats.late,
+               (unsigned)loopProbeStats.missed);
+  loopHistJson(json, "probeLagUs", loopProbeLagHist);
+  json.appendf(",\"lateMs\":%u}", (unsigned)LOOP_STEP_LATE_MS);
+}
+
+#endif // LOOP_MONITOR_H
@@ -0,0 +1,381 @@
+#ifndef MACRO_CODE_H
+#define MACRO_CODE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// MACRO BYTECODE
+// User-defined modes are small programs: one handler per knob
+// event (enter, rotate left/right, press), each a run of compact
+// instructions — HID keys and chords, typed text, delays, HTTP
+// GETs, screen lines and a few integer registers for counters and
+// toggles.
+//
+// This header is the format, the verifier and the interpreter. It
+// has no Arduino dependencies: macrovm.h binds it to BLE, the OLED
+// and the HTTP pool; tools/macroasm.cpp assembles programs and
+// benchmarks dispatch with the same interpreter.
+//
+// The interpreter never blocks. tick() runs at most a budget of
+// instructions and returns; DELAY, chords and HTTP calls park the
+// handler until their time/result comes, and loop() carries on.
+// A handler that runs MACRO_STEPS_PER_EVENT instructions without
+// finishing is aborted.
+//
+// Image layout (little-endian):
+//   'K' 'M' version nameLen name[nameLen]
+//   u16 handler[MACRO_EVENT_COUNT]   code offsets, 0xFFFF = none
+//   code...
+//
+// Instructions (operands after the opcode byte):
+//   END                       end of handler
+//   KEY k / DOWN k / UP k     tap / press / release a key
+//   RELEASE                   release everything
+//   CHORD n k1..kn            press all, hold 20 ms, release
+//   MEDIA lo hi               tap a media key (BleKeyboard report)
+//   TYPE n chars              type text
+//   DELAY u16                 wait ms
+//   HTTP n url                GET url; R3 = status (negative = error)
+//   LINE l n chars            screen line l = text
+//   LINEREG l r               append register r to line l
+//   CLEAR                     blank all lines
+//   SET r i16 / ADD r i8      register arithmetic
+//   JMP a / JZ r a / JNZ r a  jumps to code offset a (u16)
+//
+// R0 holds the event argument (rotation steps, 1 for a press);
+// R1/R2 persist while the mode is open; R3 is the last HTTP status.
+// =============================================================
+
+#define MACRO_MAGIC0          'K'
+#define MACRO_MAGIC1          'M'
+#define MACRO_VERSION         1
+#define MACRO_NAME_MAX        10    // menu/header width at text size 2
+#define MACRO_MAX_PROGRAM     222   // whole image, header included
+#define MACRO_REGS            4
+#define MACRO_LINES           4
+#define MACRO_LINE_LEN        21
+#define MACRO_CHORD_MAX       6     // HID boot report: 6 keys
+#define MACRO_URL_MAX         96
+#define MACRO_CHORD_HOLD_MS   20
+#define MACRO_STEPS_PER_TICK  32    // per loop() pass
+#define MACRO_STEPS_PER_EVENT 2000
+#define MACRO_EVENT_QUEUE     4     // power of two
+#define MACRO_NO_HANDLER      0xFFFF
+
+enum MacroEvent : uint8_t {
+  MACRO_EVENT_ENTER,
+  MACRO_EVENT_LEFT,
+  MACRO_EVENT_RIGHT,
+  MACRO_EVENT_PRESS,
+  MACRO_EVENT_COUNT
+};
+
+enum MacroOp : uint8_t {
+  MOP_END     = 0x00,
+  MOP_KEY     = 0x01,
+  MOP_DOWN    = 0x02,
+  MOP_UP      = 0x03,
+  MOP_RELEASE = 0x04,
+  MOP_CHORD   = 0x05,
+  MOP_MEDIA   = 0x06,
+  MOP_TYPE    = 0x07,
+  MOP_DELAY   = 0x08,
+  MOP_HTTP    = 0x09,
+  MOP_LINE    = 0x0A,
+  MOP_LINEREG = 0x0B,
+  MOP_CLEAR   = 0x0C,
+  MOP_SET     = 0x0D,
+  MOP_ADD     = 0x0E,
+  MOP_JMP     = 0x0F,
+  MOP_JZ      = 0x10,
+  MOP_JNZ     = 0x11,
+  MOP_COUNT
+};
+
+// A verified image; code/name point into it.
+struct MacroProgram {
+  const uint8_t* code;
+  uint16_t       codeLen;
+  uint16_t       handlers[MACRO_EVENT_COUNT];
+  const char*    name;
+  uint8_t        nameLen;
+};
+
+inline uint16_t macroU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Size of the instruction at p (remaining bytes left in the code),
+// or 0 if it is malformed. Checks operand ranges too, so the
+// interpreter can trust everything but jump targets.
+inline uint16_t macroInstructionSize(const uint8_t* p, uint16_t remaining) {
+  if (remaining == 0) return 0;
+  uint16_t size;
+  switch (p[0]) {
+    case MOP_END: case MOP_RELEASE: case MOP_CLEAR:
+      size = 1; break;
+    case MOP_KEY: case MOP_DOWN: case MOP_UP:
+      size = 2; break;
+    case MOP_MEDIA: case MOP_DELAY: case MOP_JMP:
+      size = 3; break;
+    case MOP_CHORD:
+      if (remaining < 2 || p[1] == 0 || p[1] > MACRO_CHORD_MAX) return 0;
+      size = 2 + p[1]; break;
+    case MOP_TYPE:
+      if (remaining < 2 || p[1] == 0) return 0;
+      size = 2 + p[1]; break;
+    case MOP_HTTP:
+      if (remaining < 2 || p[1] < 8 || p[1] >= MACRO_URL_MAX) return 0;
+      size = 2 + p[1];
+      if (remaining >= size && memcmp(p + 2, "http://", 7) != 0) return 0;
+      break;
+    case MOP_LINE:
+      if (remaining < 3 || p[1] >= MACRO_LINES || p[2] > MACRO_LINE_LEN) return 0;
+      size = 3 + p[2]; break;
+    case MOP_LINEREG:
+      if (remaining < 3 || p[1] >= MACRO_LINES || p[2] >= MACRO_REGS) return 0;
+      size = 3; break;
+    case MOP_SET: case MOP_JZ: case MOP_JNZ:
+      if (remaining < 2 || p[1] >= MACRO_REGS) return 0;
+      size = 4; break;
+    case MOP_ADD:
+      if (remaining < 2 || p[1] >= MACRO_REGS) return 0;
+      size = 3; break;
+    default:
+      return 0;
+  }
+  return size <= remaining ? size : 0;
+}
+
+// Check a whole image: header, every instruction, and that jumps
+// and handlers land on instruction boundaries. nullptr if valid.
+inline const char* macroVerify(const uint8_t* image, uint16_t len, MacroProgram &out) {
+  if (len < 4 || len > MACRO_MAX_PROGRAM) return "bad size";
+  if (image[0] != MACRO_MAGIC0 || image[1] != MACRO_MAGIC1) return "bad magic";
+  if (image[2] != MACRO_VERSION) return "unsupported version";
+  uint8_t nameLen = image[3];
+  if (nameLen == 0 || nameLen > MACRO_NAME_MAX) return "bad name";
+  // Printable and JSON-safe, as copyTimerLabel(): the name goes into
+  // the macro and batch JSON unescaped
+  for (uint8_t i = 0; i < nameLen; i++) {
+    uint8_t c = image[4 + i];
+    if (c < ' ' || c > '~' || c == '"' || c == '\\') return "bad name";
+  }
+  uint16_t codeStart = 4 + nameLen + 2 * MACRO_EVENT_COUNT;
+  if (len <= codeStart) return "no code";
+
+  out.name     = (const char*)image + 4;
+  out.nameLen  = nameLen;
+  out.code     = image + codeStart;
+  out.codeLen  = len - codeStart;
+  for (int e = 0; e < MACRO_EVENT_COUNT; e++) {
+    out.handlers[e] = macroU16(image + 4 + nameLen + 2 * e);
+  }
+
+  uint8_t boundary[(MACRO_MAX_PROGRAM + 7) / 8] = {};
+  for (uint16_t pc = 0; pc < out.codeLen;) {
+    uint16_t size = macroInstructionSize(out.code + pc, out.codeLen - pc);
+    if (size == 0) return "bad instruction";
+    boundary[pc >> 3] |= 1 << (pc & 7);
+    pc += size;
+  }
+  auto onBoundary = [&](uint16_t at) {
+    return at < out.codeLen && (boundary[at >> 3] & (1 << (at & 7)));
+  };
+  for (uint16_t pc = 0; pc < out.codeLen;) {
+    const uint8_t* p = out.code + pc;
+    if (p[0] == MOP_JMP && !onBoundary(macroU16(p + 1))) return "bad jump";
+    if ((p[0] == MOP_JZ || p[0] == MOP_JNZ) && !onBoundary(macroU16(p + 2))) return "bad jump";
+    pc += macroInstructionSize(p, out.codeLen - pc);
+  }
+  for (int e = 0; e < MACRO_EVENT_COUNT; e++) {
+    if (out.handlers[e] != MACRO_NO_HANDLER && !onBoundary(out.handlers[e])) return "bad handler";
+  }
+  return nullptr;
+}
+
+struct MacroStats {
+  uint32_t events;      // handlers started
+  uint32_t coalesced;   // rotations merged into a queued event
+  uint32_t dropped;     // events lost to a full queue
+  uint32_t aborted;     // handlers stopped at MACRO_STEPS_PER_EVENT
+  uint32_t steps;       // instructions executed
+  uint32_t budgetHits;  // ticks that used the whole budget
+  uint32_t httpCalls;
+};
+
+// Host must provide:
+//   void keyTap(uint8_t) / keyDown(uint8_t) / keyUp(uint8_t) / releaseAll()
+//   void media(uint8_t lo, uint8_t hi)
+//   void type(const char* text, uint8_t n)
+//   void httpStart(const char* url, uint8_t n)
+//   bool httpPoll(int16_t &status)        true once the result is in
+//   void setLine(uint8_t line, const char* text, uint8_t n)
+//   void appendLine(uint8_t line, int16_t value)
+//   void clearLines()
+template<class Host>
+class MacroMachine {
+ public:
+  explicit MacroMachine(Host &host) : host_(host) {}
+
+  void load(const MacroProgram &program) {
+    program_ = program;
+    loaded_  = true;
+    reset();
+  }
+
+  void unload() {
+    reset();
+    loaded_ = false;
+  }
+
+  void reset() {
+    if (running_) host_.releaseAll();
+    memset(regs_, 0, sizeof(regs_));
+    running_   = false;
+    wait_      = WAIT_NONE;
+    queueHead_ = queueTail_ = 0;
+  }
+
+  bool loaded() const { return loaded_; }
+  bool busy() const { return running_ || queueHead_ != queueTail_; }
+  const MacroStats &stats() const { return stats_; }
+
+  bool hasHandler(MacroEvent ev) const {
+    return loaded_ && program_.handlers[ev] != MACRO_NO_HANDLER;
+  }
+
+  // Queue an event. False if the program doesn't handle it. A
+  // rotation queued behind one of the same direction merges into it.
+  bool post(MacroEvent ev, int16_t arg) {
+    if (!hasHandler(ev)) return false;
+    if (queueHead_ != queueTail_) {
+      QueuedEvent &last = queue_[(queueHead_ - 1) & (MACRO_EVENT_QUEUE - 1)];
+      if (last.ev == ev && (ev == MACRO_EVENT_LEFT || ev == MACRO_EVENT_RIGHT)) {
+        int32_t sum = (int32_t)last.arg + arg;
+        last.arg = sum > INT16_MAX ? INT16_MAX : (int16_t)sum;
+        stats_.coalesced++;
+        return true;
+      }
+    }
+    if ((uint8_t)(queueHead_ - queueTail_) >= MACRO_EVENT_QUEUE) {
+      stats_.dropped++;
+      return true;
+    }
+    queue_[queueHead_ & (MACRO_EVENT_QUEUE - 1)] = { ev, arg };
+    queueHead_++;
+    return true;
+  }
+
+  // Run up to budget instructions; returns how many ran.
+  uint16_t tick(uint32_t nowMs, uint16_t budget = MACRO_STEPS_PER_TICK) {
+    uint16_t executed = 0;
+    while (executed < budget) {
+      if (!running_ && !startNext()) break;
+      if (wait_ != WAIT_NONE && !waitOver(nowMs)) break;
+      if (eventSteps_ >= MACRO_STEPS_PER_EVENT) {
+        stats_.aborted++;
+        host_.releaseAll();
+        running_ = false;
+        continue;
+      }
+      step(nowMs);
+      executed++;
+      eventSteps_++;
+    }
+    stats_.steps += executed;
+    if (executed == budget) stats_.budgetHits++;
+    return executed;
+  }
+
+ private:
+  enum Wait : uint8_t { WAIT_NONE, WAIT_TIME, WAIT_CHORD, WAIT_HTTP };
+
+  struct QueuedEvent {
+    MacroEvent ev;
+    int16_t    arg;
+  };
+
+  bool startNext() {
+    if (!loaded_ || queueHead_ == queueTail_) return false;
+    QueuedEvent next = queue_[queueTail_ & (MACRO_EVENT_QUEUE - 1)];
+    queueTail_++;
+    regs_[0]    = next.arg;
+    pc_         = program_.handlers[next.ev];
+    eventSteps_ = 0;
+    running_    = true;
+    stats_.events++;
+    return true;
+  }
+
+  bool waitOver(uint32_t nowMs) {
+    if (wait_ == WAIT_HTTP) {
+      int16_t status;
+      if (!host_.httpPoll(status)) return false;
+      regs_[3] = status;
+    } else {
+      if ((int32_t)(nowMs - waitUntil_) < 0) return false;
+      if (wait_ == WAIT_CHORD) host_.releaseAll();
+    }
+    wait_ = WAIT_NONE;
+    return true;
+  }
+
+  void step(uint32_t nowMs) {
+    if (pc_ >= program_.codeLen) {
+      running_ = false;
+      return;
+    }
+    const uint8_t* p = program_.code + pc_;
+    uint16_t next = pc_ + macroInstructionSize(p, program_.codeLen - pc_);
+    switch (p[0]) {
+      case MOP_END:     running_ = false; return;
+      case MOP_KEY:     host_.keyTap(p[1]); break;
+      case MOP_DOWN:    host_.keyDown(p[1]); break;
+      case MOP_UP:      host_.keyUp(p[1]); break;
+      case MOP_RELEASE: host_.releaseAll(); break;
+      case MOP_CHORD:
+        for (uint8_t i = 0; i < p[1]; i++) host_.keyDown(p[2 + i]);
+        wait_      = WAIT_CHORD;
+        waitUntil_ = nowMs + MACRO_CHORD_HOLD_MS;
+        break;
+      case MOP_MEDIA:   host_.media(p[1], p[2]); break;
+      case MOP_TYPE:    host_.type((const char*)p + 2, p[1]); break;
+      case MOP_DELAY:
+        wait_      = WAIT_TIME;
+        waitUntil_ = nowMs + macroU16(p + 1);
+        break;
+      case MOP_HTTP:
+        host_.httpStart((const char*)p + 2, p[1]);
+        wait_ = WAIT_HTTP;
+        stats_.httpCalls++;
+        break;
+      case MOP_LINE:    host_.setLine(p[1], (const char*)p + 3, p[2]); break;
+      case MOP_LINEREG: host_.appendLine(p[1], regs_[p[2]]); break;
+      case MOP_CLEAR:   host_.clearLines(); break;
+      case MOP_SET:     regs_[p[1]] = (int16_t)macroU16(p + 2); break;
+      case MOP_ADD:     regs_[p[1]] += (int8_t)p[2]; break;
+      case MOP_JMP:     next = macroU16(p + 1); break;
+      case MOP_JZ:      if (regs_[p[1]] == 0) next = macroU16(p + 2); break;
+      case MOP_JNZ:     if (regs_[p[1]] != 0) next = macroU16(p + 2); break;
+    }
+    pc_ = next;
+  }
+
+  Host        &host_;
+  MacroProgram program_ = {};
+  bool         loaded_  = false;
+  bool         running_ = false;
+  Wait         wait_    = WAIT_NONE;
+  uint32_t     waitUntil_ = 0;
+  uint16_t     pc_ = 0;
+  uint16_t     eventSteps_ = 0;
+  int16_t      regs_[MACRO_REGS] = {};
+  QueuedEvent  queue_[MACRO_EVENT_QUEUE] = {};
+  uint8_t      queueHead_ = 0;
+  uint8_t      queueTail_ = 0;
+  MacroStats   stats_ = {};
+};
+
+#endif // MACRO_CODE_H
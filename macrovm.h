@@ -0,0 +1,289 @@
+#ifndef MACRO_VM_H
+#define MACRO_VM_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "globals.h"
+#include "blelogic.h"
+#include "httppool.h"
+#include "fixedstring.h"
+#include "macrocode.h"
+
+// =============================================================
+// MACRO MODES
+// User-defined modes (see macrocode.h for the bytecode) shown in
+// the main menu after the built-in ones. Programs are uploaded as
+// hex over HTTP (POST /api/macros?slot=N, made by
+// tools/macroasm.cpp), verified, and stored in fixed EEPROM slots
+// after the firmware version. Only the open mode's image is in
+// RAM; the menu keeps just the names.
+//
+// The VM's effects: BLE keys/media/text through bleKeyboard,
+// screen lines into a small text model that drawMacroScreen()
+// renders, and HTTP GETs on a one-shot task through the pool so a
+// slow host never blocks loop().
+// =============================================================
+
+#define MACRO_SLOTS        4
+#define MACRO_EEPROM_ADDR  128                          // after VERSION_ADDR's 32 bytes
+#define MACRO_SLOT_BYTES   (2 + MACRO_MAX_PROGRAM)      // u16 length + image
+#define MACRO_HTTP_STACK   4096
+
+static_assert(MACRO_EEPROM_ADDR + MACRO_SLOTS * MACRO_SLOT_BYTES <= EEPROM_SIZE,
+              "macro slots don't fit in EEPROM");
+
+struct MacroSlotInfo {
+  uint16_t size;                          // 0 = empty
+  char     name[MACRO_NAME_MAX + 1];
+};
+
+MacroSlotInfo macroSlots[MACRO_SLOTS];
+
+// Screen model for the open macro
+FixedString<MACRO_LINE_LEN + 1> macroLines[MACRO_LINES];
+char macroTitle[MACRO_NAME_MAX + 1] = "";
+bool macroScreenDirty = false;
+
+// Tick timing, for /api/macros
+uint32_t macroTickUsMax   = 0;
+uint64_t macroTickUsTotal = 0;
+
+static uint8_t macroImage[MACRO_MAX_PROGRAM];
+static int8_t  macroOpenSlot = -1;
+
+// -------------------
+// HTTP worker (one request at a time)
+// -------------------
+static char             macroHttpUrl[MACRO_URL_MAX];
+static volatile bool    macroHttpBusy   = false;
+static volatile bool    macroHttpDone   = false;
+static volatile int16_t macroHttpStatus = 0;
+
+static void macroHttpEntry(void*) {
+  HttpLease lease = httpPoolBegin(macroHttpUrl);
+  int code = httpPoolGet(lease);
+  httpPoolEnd(lease);
+  macroHttpStatus = (int16_t)code;
+  macroHttpDone   = true;
+  macroHttpBusy   = false;
+  vTaskDelete(nullptr);
+}
+
+// -------------------
+// VM host binding
+// -------------------
+struct MacroDeviceHost {
+  void keyTap(uint8_t k)  { if (bleKeyboard.isConnected()) bleKeyboard.write(k); }
+  void keyDown(uint8_t k) { if (bleKeyboard.isConnected()) bleKeyboard.press(k); }
+  void keyUp(uint8_t k)   { if (bleKeyboard.isConnected()) bleKeyboard.release(k); }
+  void releaseAll()       { if (bleKeyboard.isConnected()) bleKeyboard.releaseAll(); }
+
+  void media(uint8_t lo, uint8_t hi) {
+    if (!bleKeyboard.isConnected()) return;
+    MediaKeyReport report = { lo, hi };
+    bleKeyboard.write(report);
+  }
+
+  void type(const char* text, uint8_t n) {
+    if (bleKeyboard.isConnected()) bleKeyboard.write((const uint8_t*)text, n);
+  }
+
+  // Fails straight to a negative status if WiFi is down or the
+  // previous request (from a mode since closed) is still running.
+  void httpStart(const char* url, uint8_t n) {
+    macroHttpDone = false;
+    if (macroHttpBusy || WiFi.status() != WL_CONNECTED) {
+      macroHttpStatus = HTTPC_ERROR_CONNECTION_REFUSED;
+      macroHttpDone   = true;
+      return;
+    }
+    memcpy(macroHttpUrl, url, n);
+    macroHttpUrl[n] = '\0';
+    macroHttpBusy = true;
+    if (xTaskCreate(macroHttpEntry, "macroHttp", MACRO_HTTP_STACK, nullptr, 1, nullptr) != pdPASS) {
+      macroHttpBusy   = false;
+      macroHttpStatus = HTTPC_ERROR_CONNECTION_REFUSED;
+      macroHttpDone   = true;
+    }
+  }
+
+  bool httpPoll(int16_t &status) {
+    if (!macroHttpDone) return false;
+    status = macroHttpStatus;
+    return true;
+  }
+
+  void setLine(uint8_t line, const char* text, uint8_t n) {
+    macroLines[line] = StrView(text, n);
+    macroScreenDirty = true;
+  }
+
+  void appendLine(uint8_t line, int16_t value) {
+    macroLines[line].appendf("%d", value);
+    macroScreenDirty = true;
+  }
+
+  void clearLines() {
+    for (auto &line : macroLines) line.clear();
+    macroScreenDirty = true;
+  }
+};
+
+MacroDeviceHost macroHost;
+MacroMachine<MacroDeviceHost> macroVm(macroHost);
+
+// -------------------
+// EEPROM slots
+// -------------------
+inline uint16_t macroReadSlot(uint8_t slot, uint8_t* image) {
+  int base = MACRO_EEPROM_ADDR + slot * MACRO_SLOT_BYTES;
+  EEPROM.begin(EEPROM_SIZE);
+  uint16_t size = EEPROM.read(base) | (EEPROM.read(base + 1) << 8);
+  if (size == 0 || size > MACRO_MAX_PROGRAM) return 0;   // 0xFFFF = never written
+  for (uint16_t i = 0; i < size; i++) image[i] = EEPROM.read(base + 2 + i);
+  return size;
+}
+
+inline void macroWriteSlot(uint8_t slot, const uint8_t* image, uint16_t size) {
+  int base = MACRO_EEPROM_ADDR + slot * MACRO_SLOT_BYTES;
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.write(base, size & 0xFF);
+  EEPROM.write(base + 1, size >> 8);
+  for (uint16_t i = 0; i < size; i++) EEPROM.write(base + 2 + i, image[i]);
+  EEPROM.commit();
+}
+
+// Re-read names for the menu. Slots that fail verification (e.g.
+// written by a newer firmware) are treated as empty.
+inline void loadMacroDirectory() {
+  for (uint8_t slot = 0; slot < MACRO_SLOTS; slot++) {
+    MacroSlotInfo &info = macroSlots[slot];
+    info.size = macroReadSlot(slot, macroImage);
+    MacroProgram program;
+    if (info.size && macroVerify(macroImage, info.size, program) != nullptr) info.size = 0;
+    if (info.size) {
+      memcpy(info.name, program.name, program.nameLen);
+      info.name[program.nameLen] = '\0';
+    } else {
+      info.name[0] = '\0';
+    }
+  }
+  macroOpenSlot = -1;   // macroImage was reused above
+  macroVm.unload();
+}
+
+inline int macroCount() {
+  int n = 0;
+  for (const MacroSlotInfo &info : macroSlots) n += info.size ? 1 : 0;
+  return n;
+}
+
+// Slot of the index-th stored macro (menu order), or -1
+inline int8_t macroSlotAt(int index) {
+  for (int8_t slot = 0; slot < MACRO_SLOTS; slot++) {
+    if (macroSlots[slot].size && index-- == 0) return slot;
+  }
+  return -1;
+}
+
+// -------------------
+// Mode lifecycle
+// -------------------
+inline bool openMacro(int8_t slot) {
+  if (slot < 0 || slot >= MACRO_SLOTS || !macroSlots[slot].size) return false;
+  uint16_t size = macroReadSlot(slot, macroImage);
+  MacroProgram program;
+  if (!size || macroVerify(macroImage, size, program) != nullptr) return false;
+
+  macroOpenSlot = slot;
+  memcpy(macroTitle, program.name, program.nameLen);
+  macroTitle[program.nameLen] = '\0';
+  for (auto &line : macroLines) line.clear();
+  macroVm.load(program);
+  macroVm.post(MACRO_EVENT_ENTER, 0);
+  macroScreenDirty = true;
+  return true;
+}
+
+inline void closeMacro() {
+  macroVm.unload();
+  macroOpenSlot = -1;
+}
+
+// One loop() pass worth of interpreting.
+inline void macroTick() {
+  if (!macroVm.loaded()) return;
+  uint32_t start = micros();
+  macroVm.tick(monoNow().ms32());
+  uint32_t took = micros() - start;
+  macroTickUsTotal += took;
+  if (took > macroTickUsMax) macroTickUsMax = took;
+}
+
+// -------------------
+// HTTP management
+// -------------------
+// Decode hex (whitespace ignored), verify and store. nullptr on
+// success, else the reason.
+inline const char* installMacroHex(uint8_t slot, const char* hex, size_t hexLen) {
+  if (slot >= MACRO_SLOTS) return "bad slot";
+  if (macroOpenSlot == (int8_t)slot) closeMacro();
+
+  uint8_t image[MACRO_MAX_PROGRAM];
+  uint16_t size = 0;
+  int high = -1;
+  for (size_t i = 0; i < hexLen; i++) {
+    char c = hex[i];
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+    int v = (c >= '0' && c <= '9') ? c - '0'
+          : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+          : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+    if (v < 0) return "bad hex";
+    if (high < 0) {
+      high = v;
+      continue;
+    }
+    if (size >= MACRO_MAX_PROGRAM) return "too large";
+    image[size++] = (uint8_t)((high << 4) | v);
+    high = -1;
+  }
+  if (high >= 0) return "odd hex length";
+
+  MacroProgram program;
+  const char* err = macroVerify(image, size, program);
+  if (err) return err;
+  macroWriteSlot(slot, image, size);
+  loadMacroDirectory();
+  return nullptr;
+}
+
+inline void eraseMacro(uint8_t slot) {
+  if (slot >= MACRO_SLOTS) return;
+  if (macroOpenSlot == (int8_t)slot) closeMacro();
+  uint8_t none = 0;
+  macroWriteSlot(slot, &none, 0);
+  loadMacroDirectory();
+}
+
+template<size_t N>
+inline void macroStatsJson(FixedString<N> &json) {
+  const MacroStats &st = macroVm.stats();
+  json.append("{\"slots\":[");
+  for (uint8_t slot = 0; slot < MACRO_SLOTS; slot++) {
+    const MacroSlotInfo &info = macroSlots[slot];
+    json.appendf("%s{\"slot\":%u,\"name\":\"%s\",\"size\":%u}", slot ? "," : "",
+                 (unsigned)slot, info.name, (unsigned)info.size);
+  }
+  json.appendf("],\"open\":%d,\"events\":%u,\"coalesced\":%u,\"dropped\":%u,\"aborted\":%u,"
+               "\"steps\":%u,\"budgetHits\":%u,\"httpCalls\":%u,\"stepsPerTick\":%u,"
+               "\"tickUsMax\":%u,\"nsPerStep\":%u}",
+               (int)macroOpenSlot, (unsigned)st.events, (unsigned)st.coalesced,
+               (unsigned)st.dropped, (unsigned)st.aborted, (unsigned)st.steps,
+               (unsigned)st.budgetHits, (unsigned)st.httpCalls, (unsigned)MACRO_STEPS_PER_TICK,
+               (unsigned)macroTickUsMax,
+               (unsigned)(st.steps ? macroTickUsTotal * 1000 / st.steps : 0));
+}
+
+#endif // MACRO_VM_H
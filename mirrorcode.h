@@ -0,0 +1,163 @@
+#ifndef MIRROR_CODE_H
+#define MIRROR_CODE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// SCREEN MIRROR ENCODING
+// A frame is the SSD1306 buffer: 8 pages of 128 bytes, one byte
+// per column, bit 0 the top row of the page. Messages carry the
+// frame XORed with the previous one (a keyframe: with a blank
+// frame), and only the pages that changed:
+//
+//   u8  type        MIRROR_KEY / MIRROR_DELTA
+//   u8  startLine   display start line (slide transitions scroll it)
+//   u8  pageMask    bit p: page p follows
+//   u16 length      payload bytes, little endian
+//   ... per page in the mask, tokens covering its 128 bytes:
+//       0nnnnnnn      n+1 zero bytes (unchanged)
+//       10nnnnnn      n+1 literal bytes follow
+//       11nnnnnn b    n+2 copies of b
+//
+// Pure C++ with no Arduino dependencies: screenmirror.h streams
+// it, tools/mirrorsim.cpp checks it, and the /mirror page decodes
+// the same format in JavaScript.
+// =============================================================
+
+#define MIRROR_WIDTH        128
+#define MIRROR_HEIGHT       64
+#define MIRROR_PAGES        (MIRROR_HEIGHT / 8)
+#define MIRROR_FRAME_BYTES  (MIRROR_WIDTH * MIRROR_PAGES)
+#define MIRROR_HEADER_BYTES 5
+#define MIRROR_LITERAL_MAX  64
+// Worst case a page is all literals: two tokens plus 128 bytes
+#define MIRROR_MSG_MAX      (MIRROR_HEADER_BYTES + MIRROR_PAGES * (MIRROR_WIDTH + 2))
+
+enum MirrorType : uint8_t {
+  MIRROR_KEY   = 0,
+  MIRROR_DELTA = 1
+};
+
+// Tokens for n bytes of XOR data; returns the bytes written
+inline size_t mirrorEncodeRun(const uint8_t* x, size_t n, uint8_t* out) {
+  size_t o = 0;
+  for (size_t i = 0; i < n;) {
+    size_t run = 1;
+    if (x[i] == 0) {
+      while (i + run < n && run < 128 && x[i + run] == 0) run++;
+      out[o++] = (uint8_t)(run - 1);
+      i += run;
+      continue;
+    }
+    while (i + run < n && run < 65 && x[i + run] == x[i]) run++;
+    if (run >= 3) {
+      out[o++] = (uint8_t)(0xC0 | (run - 2));
+      out[o++] = x[i];
+      i += run;
+      continue;
+    }
+    // Literals up to a run that pays for its own token: two zeros or
+    // four equal bytes. Stopping for less would only add tokens, and
+    // this keeps a page within two bytes of its raw size.
+    size_t lit = 1;
+    while (i + lit < n && lit < MIRROR_LITERAL_MAX) {
+      const uint8_t* p = x + i + lit;
+      size_t left = n - i - lit;
+      if (p[0] == 0 && left >= 2 && p[1] == 0) break;
+      if (left >= 4 && p[1] == p[0] && p[2] == p[0] && p[3] == p[0]) break;
+      lit++;
+    }
+    out[o++] = (uint8_t)(0x80 | (lit - 1));
+    memcpy(out + o, x + i, lit);
+    o += lit;
+    i += lit;
+  }
+  return o;
+}
+
+// A message for frame; prev nullptr makes a keyframe. Returns its
+// length in out (at least MIRROR_MSG_MAX bytes); a delta with no
+// changed page still has a header, for the start line.
+inline size_t mirrorEncode(const uint8_t* frame, const uint8_t* prev, uint8_t startLine,
+                           uint8_t* out) {
+  uint8_t mask = 0;
+  size_t  o = MIRROR_HEADER_BYTES;
+  uint8_t x[MIRROR_WIDTH];
+  for (uint8_t p = 0; p < MIRROR_PAGES; p++) {
+    const uint8_t* cur = frame + p * MIRROR_WIDTH;
+    if (prev) {
+      const uint8_t* old = prev + p * MIRROR_WIDTH;
+      if (memcmp(cur, old, MIRROR_WIDTH) == 0) continue;
+      for (int i = 0; i < MIRROR_WIDTH; i++) x[i] = cur[i] ^ old[i];
+      o += mirrorEncodeRun(x, MIRROR_WIDTH, out + o);
+    } else {
+      o += mirrorEncodeRun(cur, MIRROR_WIDTH, out + o);
+    }
+    mask |= (uint8_t)(1 << p);
+  }
+  size_t payload = o - MIRROR_HEADER_BYTES;
+  out[0] = prev ? MIRROR_DELTA : MIRROR_KEY;
+  out[1] = startLine;
+  out[2] = mask;
+  out[3] = (uint8_t)(payload & 0xFF);
+  out[4] = (uint8_t)(payload >> 8);
+  return o;
+}
+
+// Applies one whole message to frame (a keyframe clears it first).
+// False if the message is malformed.
+inline bool mirrorDecode(const uint8_t* msg, size_t len, uint8_t* frame, uint8_t &startLine) {
+  if (len < MIRROR_HEADER_BYTES || msg[0] > MIRROR_DELTA) return false;
+  size_t payload = msg[3] | (msg[4] << 8);
+  if (MIRROR_HEADER_BYTES + payload != len) return false;
+  if (msg[0] == MIRROR_KEY) memset(frame, 0, MIRROR_FRAME_BYTES);
+  startLine = msg[1] & (MIRROR_HEIGHT - 1);
+  size_t i = MIRROR_HEADER_BYTES;
+  for (uint8_t p = 0; p < MIRROR_PAGES; p++) {
+    if (!(msg[2] & (1 << p))) continue;
+    uint8_t* dst = frame + p * MIRROR_WIDTH;
+    size_t col = 0;
+    while (col < MIRROR_WIDTH) {
+      if (i >= len) return false;
+      uint8_t t = msg[i++];
+      size_t n;
+      if (!(t & 0x80)) {
+        n = (t & 0x7F) + 1;
+        if (col + n > MIRROR_WIDTH) return false;
+      } else if (!(t & 0x40)) {
+        n = (t & 0x3F) + 1;
+        if (col + n > MIRROR_WIDTH || i + n > len) return false;
+        for (size_t k = 0; k < n; k++) dst[col + k] ^= msg[i + k];
+        i += n;
+      } else {
+        n = (t & 0x3F) + 2;
+        if (col + n > MIRROR_WIDTH || i >= len) return false;
+        uint8_t b = msg[i++];
+        for (size_t k = 0; k < n; k++) dst[col + k] ^= b;
+      }
+      col += n;
+    }
+  }
+  return i == len;
+}
+
+// Pixel (x, y) as the panel shows it: GDDRAM row (y + startLine)
+inline bool mirrorPixel(const uint8_t* frame, uint8_t startLine, int x, int y) {
+  int row = (y + startLine) & (MIRROR_HEIGHT - 1);
+  return (frame[(row >> 3) * MIRROR_WIDTH + x] >> (row & 7)) & 1;
+}
+
+// One row of a binary PBM (P4): 16 bytes, MSB leftmost. PBM's 1 is
+// black, so unlit pixels are 1 and the image looks like the panel.
+inline void mirrorPbmRow(const uint8_t* frame, uint8_t startLine, int y, uint8_t* out) {
+  for (int b = 0; b < MIRROR_WIDTH / 8; b++) {
+    uint8_t v = 0;
+    for (int k = 0; k < 8; k++) v = (uint8_t)((v << 1) | !mirrorPixel(frame, startLine, b * 8 + k, y));
+    out[b] = v;
+  }
+}
+
+#define MIRROR_PBM_HEADER "P4\n128 64\n"
+
+#endif // MIRROR_CODE_H
@@ -0,0 +1,59 @@
+#ifndef MODE_TASKS_H
+#define MODE_TASKS_H
+
+#include <Arduino.h>
+#include "fixedstring.h"
+#include "corocode.h"
+
+// =============================================================
+// MODE COROUTINES
+// The scheduler the modes' coroutines (corocode.h) run on: the OBS
+// chord and its idle release, the door lock turn, the TIME UP
+// beep. Their bodies live next to their states in the sketch, and
+// start and stop as the state changes (modeTasksFollow), so a mode
+// left from HTTP or a timeout doesn't keep a chord held or the
+// buzzer going.
+//
+// Resumed from loop(), like the timer service: a body that waits
+// costs a compare per pass, not a stack.
+// =============================================================
+
+#define MODE_TASKS_MAX 4
+
+CoScheduler<MODE_TASKS_MAX> modeTasks;
+uint32_t modeTasksTickUsMax = 0;
+
+// Once per loop() pass
+inline void modeTasksTick() {
+  uint32_t start = micros();
+  modeTasks.tick(monoNow());
+  uint32_t took = micros() - start;
+  if (took > modeTasksTickUsMax) modeTasksTickUsMax = took;
+}
+
+inline const char* coWaitName(CoWait w) {
+  switch (w) {
+    case CO_READY:         return "ready";
+    case CO_SLEEPING:      return "sleeping";
+    case CO_INPUT:         return "input";
+    case CO_INPUT_OR_TIME: return "input-or-time";
+    default:               return "stopped";
+  }
+}
+
+template<size_t N>
+inline void modeTasksJson(FixedString<N> &json) {
+  const CoStats &s = modeTasks.stats();
+  json.appendf("{\"ticks\":%u,\"resumes\":%u,\"posts\":%u,\"postsDropped\":%u,"
+               "\"tickUsMax\":%u,\"taskBytes\":%u,\"tasks\":[",
+               (unsigned)s.ticks, (unsigned)s.resumes, (unsigned)s.posts,
+               (unsigned)s.postsDropped, (unsigned)modeTasksTickUsMax, (unsigned)sizeof(CoTask));
+  for (uint8_t i = 0; i < modeTasks.size(); i++) {
+    const CoTask &t = modeTasks.task(i);
+    json.appendf("%s{\"name\":\"%s\",\"wait\":\"%s\",\"resumes\":%u}", i ? "," : "", t.name,
+                 coWaitName(t.wait), (unsigned)t.resumes);
+  }
+  json.append("]}");
+}
+
+#endif // MODE_TASKS_H
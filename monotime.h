@@ -0,0 +1,131 @@
+#ifndef MONOTIME_H
+#define MONOTIME_H
+
+#include <stdint.h>
+
+// =============================================================
+// MONOTONIC TIME
+// One time base for every module: a 64-bit microsecond count since
+// boot (esp_timer), which would take 292,000 years to wrap. 32-bit
+// millis() wraps after 49.7 days, and a desk knob stays up that
+// long: absolute tests like "millis() >= endTime" then fire at once
+// or never. Millisecond ticks are also too coarse to measure an ISR
+// to the action it causes.
+//
+//   Duration   a signed span:    500_ms, 2_s, msecs(STANDBY_TIMEOUT_MS)
+//   MonoTime   a point in time:  monoNow(), t + 150_ms, b - a (a Duration)
+//   Deadline   armed or not:     d.arm(300_ms); if (d.expired()) ...
+//
+//   if (since(lastDisplayUpdate) >= 1000_ms) { ... lastDisplayUpdate = monoNow(); }
+//
+// Comparisons go through the signed difference, so they stay right
+// even on a clock that does wrap. monoNow() is safe in ISRs.
+//
+// Pure modules that take a 32-bit ms "now" (macro VM, MQTT outbox,
+// encoder acceleration) get MonoTime::ms32(); they only subtract,
+// which survives the wrap.
+//
+// With KNOB_VIRTUAL_CLOCK defined the clock only moves when told to
+// (monoAdvance), for host tools: tools/clocksim.cpp runs the knob's
+// timing patterns across 2^32 ms.
+// =============================================================
+
+#ifndef KNOB_VIRTUAL_CLOCK
+#include <esp_timer.h>
+#endif
+
+struct Duration {
+  int64_t us;
+
+  constexpr int64_t toUs() const { return us; }
+  constexpr int64_t toMs() const { return us / 1000; }
+
+  constexpr Duration operator+(Duration d) const { return { us + d.us }; }
+  constexpr Duration operator-(Duration d) const { return { us - d.us }; }
+  constexpr Duration operator*(int64_t k) const  { return { us * k }; }
+  constexpr Duration operator/(int64_t k) const  { return { us / k }; }
+  constexpr int64_t  operator/(Duration d) const { return us / d.us; }
+
+  constexpr bool operator<(Duration d) const  { return us < d.us; }
+  constexpr bool operator<=(Duration d) const { return us <= d.us; }
+  constexpr bool operator>(Duration d) const  { return us > d.us; }
+  constexpr bool operator>=(Duration d) const { return us >= d.us; }
+  constexpr bool operator==(Duration d) const { return us == d.us; }
+  constexpr bool operator!=(Duration d) const { return us != d.us; }
+};
+
+constexpr Duration usecs(int64_t v) { return { v }; }
+constexpr Duration msecs(int64_t v) { return { v * 1000 }; }
+constexpr Duration secs(int64_t v)  { return { v * 1000000 }; }
+
+constexpr Duration operator"" _us(unsigned long long v) { return { (int64_t)v }; }
+constexpr Duration operator"" _ms(unsigned long long v) { return { (int64_t)v * 1000 }; }
+constexpr Duration operator"" _s(unsigned long long v)  { return { (int64_t)v * 1000000 }; }
+
+struct MonoTime {
+  int64_t us;   // since boot; 0 also serves as "never"/"long ago"
+
+  constexpr MonoTime operator+(Duration d) const { return { us + d.us }; }
+  constexpr MonoTime operator-(Duration d) const { return { us - d.us }; }
+  constexpr Duration operator-(MonoTime t) const { return { (int64_t)((uint64_t)us - (uint64_t)t.us) }; }
+
+  constexpr bool operator<(MonoTime t) const  { return (*this - t).us < 0; }
+  constexpr bool operator<=(MonoTime t) const { return (*this - t).us <= 0; }
+  constexpr bool operator>(MonoTime t) const  { return (*this - t).us > 0; }
+  constexpr bool operator>=(MonoTime t) const { return (*this - t).us >= 0; }
+  constexpr bool operator==(MonoTime t) const { return us == t.us; }
+  constexpr bool operator!=(MonoTime t) const { return us != t.us; }
+
+  constexpr uint64_t ms() const   { return (uint64_t)us / 1000; }
+  constexpr uint32_t ms32() const { return (uint32_t)ms(); }   // for ms interfaces: differences only
+};
+
+// -------------------
+// Clock
+// -------------------
+#ifdef KNOB_VIRTUAL_CLOCK
+inline int64_t monoVirtualUs = 0;
+
+inline MonoTime monoNow() { return { monoVirtualUs }; }
+inline void monoAdvance(Duration d) { monoVirtualUs += d.us; }
+inline void monoSet(MonoTime t) { monoVirtualUs = t.us; }
+#else
+inline MonoTime monoNow() { return { (int64_t)esp_timer_get_time() }; }
+#endif
+
+inline Duration since(MonoTime t) { return monoNow() - t; }
+
+// -------------------
+// Deadline
+// -------------------
+class Deadline {
+ public:
+  constexpr Deadline() : at_{ 0 }, armed_(false) {}
+
+  static Deadline after(Duration d) {
+    Deadline dl;
+    dl.arm(d);
+    return dl;
+  }
+
+  void arm(Duration d)      { at_ = monoNow() + d; armed_ = true; }
+  void armAt(MonoTime t)    { at_ = t; armed_ = true; }
+  void cancel()             { armed_ = false; }
+
+  bool     armed() const    { return armed_; }
+  MonoTime at() const       { return at_; }
+  // Armed and reached
+  bool     expired() const  { return armed_ && monoNow() >= at_; }
+  // Time left, 0 once reached (or not armed)
+  Duration remaining() const {
+    if (!armed_) return { 0 };
+    Duration left = at_ - monoNow();
+    return left.us > 0 ? left : Duration{ 0 };
+  }
+
+ private:
+  MonoTime at_;
+  bool     armed_;
+};
+
+#endif // MONOTIME_H
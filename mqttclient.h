@@ -0,0 +1,421 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "globals.h"
+#include "fixedstring.h"
+#include "gestures.h"
+#include "batchapi.h"
+#include "knoblog.h"
+#include "mqttcode.h"
+
+// =============================================================
+// MQTT CLIENT
+// One persistent connection to the broker in globals.h instead of
+// an HTTP request per action. Topics under MQTT_BASE_TOPIC:
+//
+//   published
+//     status             online / offline (retained, last will)
+//     state              {"state":"volume"} on mode changes (QoS 1, retained)
+//     knob               {"delta":3,"counter":17,"state":"volume"},
+//                        turns coalesced to one per MQTT_KNOB_MS
+//     gesture            click / long / double (QoS 1)
+//     doorlock/cmd       open / lock, for a broker-side door bridge
+//                        (only with MQTT_DOORLOCK, globals.h)
+//     cmd/result         the batch result JSON for each cmd
+//     pong               echo of ping, for latency measurements
+//   subscribed
+//     cmd                batch commands (batchapi.h syntax): stopwatch,
+//                        timers, messages, modes, chords, media
+//     doorlock/result    opened / locked / failed
+//     ping               anything; echoed to pong at once
+//
+// Events go through a bounded outbox (mqttcode.h), so what happens
+// while the broker is away is sent after the reconnect. The TCP
+// connect (DNS/mDNS included) runs in a short-lived task, so a dead
+// broker never stalls loop(); everything else runs from mqttTick()
+// in loop(). GET /api/mqtt has the counters, including the queue
+// to PUBACK time for QoS 1 and the door-lock round trip.
+//
+// A door command with no doorlock/result within MQTT_DOOR_TIMEOUT_MS
+// (no bridge running, broker gone) is sent again over HTTP.
+// =============================================================
+
+#define MQTT_KEEPALIVE_S        30
+#define MQTT_CONNECT_TIMEOUT_MS 3000
+#define MQTT_CONNACK_TIMEOUT_MS 5000
+#define MQTT_BACKOFF_MIN_MS     1000
+#define MQTT_BACKOFF_MAX_MS     60000
+#define MQTT_RETRY_MS           5000   // QoS 1 without PUBACK goes again
+#define MQTT_KNOB_MS            100    // knob turns coalesced to this rate
+#define MQTT_OUTBOX_SLOTS       12
+#define MQTT_SEND_PER_TICK      4
+#define MQTT_READ_PER_TICK      1024   // bytes
+#define MQTT_REPLY_MAX          1200   // direct publishes (cmd/result)
+#define MQTT_CONNECT_STACK      4096
+#define MQTT_DOOR_TIMEOUT_MS    1500   // then the door goes over HTTP
+
+#define MQTT_TOPIC(sub) MQTT_BASE_TOPIC "/" sub
+
+extern volatile int counter;
+extern void redrawState(AppState state);
+extern void doorLockHttp(int direction);
+
+enum MqttConnState : uint8_t {
+  MQTT_DOWN,
+  MQTT_TCP_CONNECTING,
+  MQTT_WAIT_CONNACK,
+  MQTT_UP
+};
+
+struct MqttStats {
+  uint32_t connects;
+  uint32_t connectFails;
+  uint32_t drops;
+  uint32_t published;
+  uint32_t received;
+  uint32_t commands;
+  uint32_t knobEvents;
+  uint32_t knobSteps;
+  uint32_t upMs;          // connected time before the current session
+  uint32_t doorMsLast;    // doorlock/cmd queued to doorlock/result
+  uint32_t doorMsMax;
+  uint32_t doorFallbacks; // no doorlock/result in time, sent over HTTP
+};
+
+WiFiClient              mqttSocket;
+MqttParser              mqttIn;
+MqttOutbox<MQTT_OUTBOX_SLOTS> mqttOutbox;
+MqttStats               mqttStats = {};
+volatile MqttConnState  mqttState = MQTT_DOWN;
+volatile int8_t         mqttTcpResult = 0;   // connect task: 1 ok, -1 failed
+uint32_t mqttRetryAt    = 0;
+uint32_t mqttBackoffMs  = MQTT_BACKOFF_MIN_MS;
+uint32_t mqttStateSince = 0;
+uint32_t mqttLastSend   = 0;
+uint32_t mqttLastRecv   = 0;
+uint32_t mqttDoorSentMs = 0;   // 0: no door command waiting for its result
+bool     mqttDoorOpen   = false;
+uint16_t mqttSubId      = 0;
+char     mqttClientId[24] = "";
+
+inline bool mqttEnabled() {
+  return MQTT_BROKER_HOST[0] != '\0';
+}
+
+inline bool mqttConnected() {
+  return mqttState == MQTT_UP;
+}
+
+// -------------------
+// Wire
+// -------------------
+inline bool mqttWrite(MqttPacket p) {
+  if (!p.len || mqttSocket.write(p.data, p.len) != p.len) return false;
+  mqttLastSend = monoNow().ms32();
+  return true;
+}
+
+inline void mqttDrop(const char* why) {
+  if (mqttState == MQTT_UP) mqttStats.upMs += monoNow().ms32() - mqttStateSince;
+  if (mqttState >= MQTT_WAIT_CONNACK) {
+    mqttStats.drops++;
+    KLOG_WARN(KLOG_TAG_NET, "MQTT: connection lost (%s)", why);
+  }
+  mqttSocket.stop();
+  mqttIn.reset();
+  mqttState   = MQTT_DOWN;
+  mqttRetryAt = monoNow().ms32() + mqttBackoffMs;
+  mqttBackoffMs = mqttBackoffMs * 2 > MQTT_BACKOFF_MAX_MS ? MQTT_BACKOFF_MAX_MS : mqttBackoffMs * 2;
+}
+
+// Straight onto the wire, not through the outbox (replies that only
+// mean something on this connection)
+inline void mqttPublishNow(const char* topic, const char* payload, size_t len) {
+  if (mqttState != MQTT_UP) return;
+  static uint8_t buf[MQTT_REPLY_MAX];
+  if (!mqttWrite(mqttPublishPacket(buf, sizeof(buf), topic, (const uint8_t*)payload, len, 0, false, 0))) {
+    mqttDrop("write");
+    return;
+  }
+  mqttStats.published++;
+}
+
+// Queue a publish; sent on the next mqttTick() if connected
+inline bool mqttPublish(const char* topic, const char* payload, uint8_t qos = 0, bool retain = false) {
+  if (!mqttEnabled()) return false;
+  return mqttOutbox.push(topic, (const uint8_t*)payload, strlen(payload), qos, retain, monoNow().ms32());
+}
+
+inline void mqttFlushOutbox() {
+  uint8_t buf[MQTT_TOPIC_MAX + MQTT_PAYLOAD_MAX + 16];
+  uint32_t now = monoNow().ms32();
+  for (uint8_t i = 0; i < MQTT_SEND_PER_TICK && mqttState == MQTT_UP; i++) {
+    MqttOutMsg* m = mqttOutbox.next(now, MQTT_RETRY_MS);
+    if (!m) return;
+    MqttPacket p = mqttPublishPacket(buf, sizeof(buf), m->topic, m->payload, m->len, m->qos,
+                                     m->retain, m->id, m->dup || m->sent);
+    if (!mqttWrite(p)) {
+      mqttDrop("write");
+      return;
+    }
+    mqttOutbox.markSent(m, now);
+    mqttStats.published++;
+  }
+}
+
+// -------------------
+// Connecting
+// -------------------
+static void mqttConnectEntry(void*) {
+  bool ok = mqttSocket.connect(MQTT_BROKER_HOST, MQTT_BROKER_PORT, MQTT_CONNECT_TIMEOUT_MS);
+  if (ok) mqttSocket.setNoDelay(true);
+  mqttTcpResult = ok ? 1 : -1;
+  vTaskDelete(nullptr);
+}
+
+inline void mqttStartConnect() {
+  if (!mqttClientId[0]) {
+    snprintf(mqttClientId, sizeof(mqttClientId), "knob-%012llx", (unsigned long long)ESP.getEfuseMac());
+  }
+  mqttTcpResult  = 0;
+  mqttState      = MQTT_TCP_CONNECTING;
+  mqttStateSince = monoNow().ms32();
+  if (xTaskCreate(mqttConnectEntry, "mqttConnect", MQTT_CONNECT_STACK, nullptr, 1, nullptr) != pdPASS) {
+    mqttState = MQTT_DOWN;
+    mqttRetryAt = monoNow().ms32() + mqttBackoffMs;
+  }
+}
+
+inline void mqttSubscribe(const char* filter, uint8_t qos) {
+  uint8_t buf[MQTT_TOPIC_MAX + 16];
+  if (++mqttSubId == 0) mqttSubId = 1;
+  mqttWrite(mqttSubscribePacket(buf, sizeof(buf), mqttSubId, filter, qos));
+}
+
+inline void mqttOnConnack(uint8_t code) {
+  if (code != 0) {
+    KLOG_ERROR(KLOG_TAG_NET, "MQTT: broker refused (%u)", code);
+    mqttStats.connectFails++;
+    mqttDrop("refused");
+    return;
+  }
+  mqttState      = MQTT_UP;
+  mqttStateSince = monoNow().ms32();
+  mqttBackoffMs  = MQTT_BACKOFF_MIN_MS;
+  mqttStats.connects++;
+  mqttSubscribe(MQTT_TOPIC("cmd"), 1);
+  mqttSubscribe(MQTT_TOPIC("doorlock/result"), 1);
+  mqttSubscribe(MQTT_TOPIC("ping"), 0);
+  mqttOutbox.resendAll();
+  mqttPublish(MQTT_TOPIC("status"), "online", 1, true);
+  KLOG_INFO(KLOG_TAG_NET, "MQTT: connected to %s", MQTT_BROKER_HOST);
+}
+
+// -------------------
+// Incoming
+// -------------------
+inline void mqttOnDoorResult(StrView text) {
+  if (text.equals("opened"))      doorLastStatus = 1;
+  else if (text.equals("locked")) doorLastStatus = -1;
+  else                            doorLastStatus = 2;
+  if (mqttDoorSentMs) {
+    mqttStats.doorMsLast = monoNow().ms32() - mqttDoorSentMs;
+    if (mqttStats.doorMsLast > mqttStats.doorMsMax) mqttStats.doorMsMax = mqttStats.doorMsLast;
+    mqttDoorSentMs = 0;
+  }
+  if (currentState == STATE_DOORLOCK) redrawState(STATE_DOORLOCK);
+}
+
+inline void mqttOnPublish(const MqttPublish &msg) {
+  uint8_t buf[8];
+  if (msg.qos == 1) mqttWrite(mqttIdPacket(buf, sizeof(buf), MQTT_PUBACK, msg.id));
+  mqttStats.received++;
+
+  StrView topic(msg.topic, msg.topicLen);
+  StrView payload((const char*)msg.payload, msg.payloadLen);
+  if (topic.equals(MQTT_TOPIC("ping"))) {
+    mqttPublishNow(MQTT_TOPIC("pong"), payload.ptr, payload.len);
+  } else if (topic.equals(MQTT_TOPIC("cmd"))) {
+    static FixedString<1024> result;   // as /api/batch; off loop()'s stack
+    static FixedString<MQTT_REPLY_MAX - MQTT_TOPIC_MAX - 16> reply;
+    result.clear();
+    int status = runBatch(payload, result);
+    reply.clear();
+    reply.appendf("{\"status\":%d,\"result\":", status);
+    reply.append(StrView(result.c_str(), result.length()));
+    reply.append('}');
+    mqttStats.commands++;
+    mqttPublishNow(MQTT_TOPIC("cmd/result"), reply.c_str(), reply.length());
+  } else if (topic.equals(MQTT_TOPIC("doorlock/result"))) {
+    mqttOnDoorResult(payload);
+  }
+}
+
+inline void mqttRead() {
+  int avail = mqttSocket.available();
+  uint8_t chunk[128];
+  for (int total = 0; avail > 0 && total < MQTT_READ_PER_TICK; avail = mqttSocket.available()) {
+    int n = mqttSocket.read(chunk, avail < (int)sizeof(chunk) ? avail : (int)sizeof(chunk));
+    if (n <= 0) break;
+    total += n;
+    mqttLastRecv = monoNow().ms32();
+    for (int i = 0; i < n; i++) {
+      if (!mqttIn.feed(chunk[i])) continue;
+      switch (mqttIn.type()) {
+        case MQTT_CONNACK:
+          if (mqttState == MQTT_WAIT_CONNACK) mqttOnConnack(mqttIn.length() >= 2 ? mqttIn.body()[1] : 0xFF);
+          break;
+        case MQTT_PUBLISH: {
+          MqttPublish msg;
+          if (mqttParsePublish(mqttIn, msg)) mqttOnPublish(msg);
+          break;
+        }
+        case MQTT_PUBACK:
+          mqttOutbox.ack(mqttIn.id(), monoNow().ms32());
+          break;
+        default:   // SUBACK, PINGRESP: mqttLastRecv is all they're for
+          break;
+      }
+      if (mqttState == MQTT_DOWN) return;
+    }
+  }
+}
+
+// -------------------
+// Events
+// -------------------
+inline void mqttCollectEvents() {
+  static int      lastState   = -1;
+  static int      lastCounter = 0;
+  static uint32_t lastKnobMs  = 0;
+  uint32_t now = monoNow().ms32();
+  char json[96];
+
+  // Mode changes (the transitions between them aren't modes)
+  if (currentState != lastState && currentState != STATE_ANIMATING_TO_STANDBY &&
+      currentState != STATE_ANIMATING_WAKE) {
+    lastState = currentState;
+    snprintf(json, sizeof(json), "{\"state\":\"%s\"}", appStateNames[currentState]);
+    mqttPublish(MQTT_TOPIC("state"), json, 1, true);
+  }
+
+  int c = counter;
+  if (c != lastCounter && now - lastKnobMs >= MQTT_KNOB_MS) {
+    snprintf(json, sizeof(json), "{\"delta\":%d,\"counter\":%d,\"state\":\"%s\"}", c - lastCounter,
+             c, appStateNames[currentState]);
+    mqttPublish(MQTT_TOPIC("knob"), json);
+    mqttStats.knobEvents++;
+    mqttStats.knobSteps += abs(c - lastCounter);
+    lastCounter = c;
+    lastKnobMs  = now;
+  }
+
+  uint8_t g = takeGestureEvents();
+  if (g & GESTURE_CLICK)  mqttPublish(MQTT_TOPIC("gesture"), "click", 1);
+  if (g & GESTURE_LONG)   mqttPublish(MQTT_TOPIC("gesture"), "long", 1);
+  if (g & GESTURE_DOUBLE) mqttPublish(MQTT_TOPIC("gesture"), "double", 1);
+}
+
+// DoorLock over MQTT: the result comes back on doorlock/result
+inline void mqttDoorLock(bool open) {
+  mqttDoorSentMs = monoNow().ms32() | 1;   // never 0
+  mqttDoorOpen   = open;
+  mqttPublish(MQTT_TOPIC("doorlock/cmd"), open ? "open" : "lock", 1);
+}
+
+// No result in time: the bridge isn't there (or the broker went
+// away with the command queued), so drive the door over HTTP
+inline void mqttDoorTimeout() {
+  if (!mqttDoorSentMs || monoNow().ms32() - mqttDoorSentMs < MQTT_DOOR_TIMEOUT_MS) return;
+  mqttDoorSentMs = 0;
+  mqttStats.doorFallbacks++;
+  KLOG_WARN(KLOG_TAG_NET, "MQTT: no doorlock/result, using HTTP");
+  doorLockHttp(mqttDoorOpen ? 1 : -1);
+  if (currentState == STATE_DOORLOCK) redrawState(STATE_DOORLOCK);
+}
+
+// -------------------
+// Once per loop() pass
+// -------------------
+inline void mqttTick() {
+  if (!mqttEnabled()) return;
+  mqttCollectEvents();
+  mqttDoorTimeout();
+  uint32_t now = monoNow().ms32();
+  uint8_t buf[MQTT_TOPIC_MAX + 48];
+
+  switch (mqttState) {
+    case MQTT_DOWN:
+      if (WiFi.status() == WL_CONNECTED && (int32_t)(now - mqttRetryAt) >= 0) mqttStartConnect();
+      return;
+
+    case MQTT_TCP_CONNECTING:
+      if (mqttTcpResult == 0) return;
+      if (mqttTcpResult < 0) {
+        mqttStats.connectFails++;
+        mqttDrop("connect");
+        return;
+      }
+      mqttState      = MQTT_WAIT_CONNACK;
+      mqttStateSince = now;
+      mqttLastRecv   = now;
+      if (!mqttWrite(mqttConnectPacket(buf, sizeof(buf), mqttClientId, MQTT_KEEPALIVE_S,
+                                       MQTT_TOPIC("status"), "offline"))) {
+        mqttDrop("write");
+      }
+      return;
+
+    case MQTT_WAIT_CONNACK:
+      mqttRead();
+      if (mqttState == MQTT_WAIT_CONNACK && now - mqttStateSince > MQTT_CONNACK_TIMEOUT_MS) {
+        mqttStats.connectFails++;
+        mqttDrop("no connack");
+      }
+      return;
+
+    case MQTT_UP:
+      if (!mqttSocket.connected()) {
+        mqttDrop("closed");
+        return;
+      }
+      mqttRead();
+      if (mqttState != MQTT_UP) return;
+      mqttFlushOutbox();
+      if (mqttState != MQTT_UP) return;
+      // Keep-alive: ping when idle; nothing heard for 1.5x means dead
+      if (now - mqttLastRecv > MQTT_KEEPALIVE_S * 1500UL) {
+        mqttDrop("keepalive");
+      } else if (now - mqttLastSend > MQTT_KEEPALIVE_S * 500UL) {
+        mqttWrite(mqttEmptyPacket(buf, sizeof(buf), MQTT_PINGREQ));
+      }
+      return;
+  }
+}
+
+template<size_t N>
+inline void mqttStatsJson(FixedString<N> &json) {
+  static const char* const stateNames[] = { "down", "connecting", "handshake", "up" };
+  const MqttOutboxStats &ob = mqttOutbox.stats();
+  uint32_t upMs = mqttStats.upMs + (mqttState == MQTT_UP ? monoNow().ms32() - mqttStateSince : 0);
+  json.appendf("{\"enabled\":%s,\"broker\":\"%s:%u\",\"state\":\"%s\",\"connects\":%u,"
+               "\"connectFails\":%u,\"drops\":%u,\"upMs\":%u,\"published\":%u,\"received\":%u,"
+               "\"commands\":%u,\"knobEvents\":%u,\"knobSteps\":%u,\"outbox\":%u,"
+               "\"outboxCap\":%u,\"queued\":%u,\"dropped\":%u,\"rejected\":%u,\"resent\":%u,"
+               "\"acked\":%u,\"ackMsAvg\":%u,\"ackMsMax\":%u,\"doorMsLast\":%u,\"doorMsMax\":%u,\"doorFallbacks\":%u}",
+               mqttEnabled() ? "true" : "false", MQTT_BROKER_HOST, (unsigned)MQTT_BROKER_PORT,
+               stateNames[mqttState], (unsigned)mqttStats.connects, (unsigned)mqttStats.connectFails,
+               (unsigned)mqttStats.drops, (unsigned)upMs, (unsigned)mqttStats.published,
+               (unsigned)mqttStats.received, (unsigned)mqttStats.commands,
+               (unsigned)mqttStats.knobEvents, (unsigned)mqttStats.knobSteps,
+               (unsigned)mqttOutbox.size(), (unsigned)MQTT_OUTBOX_SLOTS, (unsigned)ob.queued,
+               (unsigned)ob.dropped, (unsigned)ob.rejected, (unsigned)ob.resent,
+               (unsigned)ob.acked, (unsigned)(ob.acked ? ob.ackMsTotal / ob.acked : 0),
+               (unsigned)ob.ackMsMax, (unsigned)mqttStats.doorMsLast, (unsigned)mqttStats.doorMsMax,
+               (unsigned)mqttStats.doorFallbacks);
+}
+
+#endif // MQTT_CLIENT_H
@@ -0,0 +1,394 @@
+#ifndef MQTT_CODE_H
+#define MQTT_CODE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// MQTT 3.1.1 PACKETS AND OUTBOX
+// The part of MQTT the knob needs: CONNECT (with a last will),
+// PUBLISH at QoS 0/1, PUBACK, SUBSCRIBE, PINGREQ, DISCONNECT, an
+// incremental parser for whatever the broker sends, topic filter
+// matching and a bounded outbox.
+//
+// The outbox holds publishes until they're on the wire (QoS 0) or
+// acknowledged (QoS 1), so events raised while the broker is
+// unreachable go out after the reconnect. It has a fixed number of
+// slots; when full, the oldest QoS 0 message is dropped first,
+// then the oldest QoS 1.
+//
+// Pure C++ with no Arduino dependencies: the device client
+// (mqttclient.h) and tools/mqttbench.cpp (a broker stand-in and
+// load test) share it.
+// =============================================================
+
+#define MQTT_PACKET_MAX   512   // incoming packets are cut to this
+#define MQTT_TOPIC_MAX    64
+#define MQTT_PAYLOAD_MAX  192   // queued payloads; direct replies may be longer
+
+enum MqttType : uint8_t {
+  MQTT_CONNECT    = 1,
+  MQTT_CONNACK    = 2,
+  MQTT_PUBLISH    = 3,
+  MQTT_PUBACK     = 4,
+  MQTT_SUBSCRIBE  = 8,
+  MQTT_SUBACK     = 9,
+  MQTT_PINGREQ    = 12,
+  MQTT_PINGRESP   = 13,
+  MQTT_DISCONNECT = 14
+};
+
+struct MqttPacket {
+  const uint8_t* data;
+  size_t         len;   // 0: didn't fit the buffer
+};
+
+// -------------------
+// Writing
+// -------------------
+// Builds a packet in buf: the body first (after 5 bytes reserved
+// for the fixed header), then finish() puts the header in front.
+class MqttWriter {
+ public:
+  MqttWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap), pos_(5) {}
+
+  void u8(uint8_t v) {
+    if (pos_ < cap_) buf_[pos_] = v;
+    pos_++;
+  }
+  void u16(uint16_t v) {
+    u8(v >> 8);
+    u8(v & 0xFF);
+  }
+  void raw(const void* p, size_t n) {
+    if (pos_ + n <= cap_) memcpy(buf_ + pos_, p, n);
+    pos_ += n;
+  }
+  void str(const char* s, size_t n) {
+    u16((uint16_t)n);
+    raw(s, n);
+  }
+  void str(const char* s) { str(s, strlen(s)); }
+
+  MqttPacket finish(uint8_t first) {
+    if (pos_ > cap_) return { buf_, 0 };
+    size_t len = pos_ - 5;
+    uint8_t hdr[5];
+    uint8_t n = 0;
+    hdr[n++] = first;
+    do {
+      uint8_t b = len % 128;
+      len /= 128;
+      hdr[n++] = len ? (b | 0x80) : b;
+    } while (len);
+    uint8_t* start = buf_ + 5 - n;
+    memcpy(start, hdr, n);
+    return { start, pos_ - 5 + n };
+  }
+
+ private:
+  uint8_t* buf_;
+  size_t   cap_;
+  size_t   pos_;
+};
+
+inline MqttPacket mqttConnectPacket(uint8_t* buf, size_t cap, const char* clientId,
+                                    uint16_t keepAliveS, const char* willTopic = nullptr,
+                                    const char* willPayload = nullptr) {
+  MqttWriter w(buf, cap);
+  w.str("MQTT");
+  w.u8(4);   // protocol level 3.1.1
+  uint8_t flags = 0x02;   // clean session
+  if (willTopic) flags |= 0x04 | 0x20;   // will, QoS 0, retained
+  w.u8(flags);
+  w.u16(keepAliveS);
+  w.str(clientId);
+  if (willTopic) {
+    w.str(willTopic);
+    w.str(willPayload ? willPayload : "");
+  }
+  return w.finish(MQTT_CONNECT << 4);
+}
+
+inline MqttPacket mqttPublishPacket(uint8_t* buf, size_t cap, const char* topic,
+                                    const uint8_t* payload, size_t len, uint8_t qos,
+                                    bool retain, uint16_t id, bool dup = false) {
+  MqttWriter w(buf, cap);
+  w.str(topic);
+  if (qos) w.u16(id);
+  w.raw(payload, len);
+  return w.finish((MQTT_PUBLISH << 4) | (dup ? 0x08 : 0) | (qos << 1) | (retain ? 1 : 0));
+}
+
+inline MqttPacket mqttSubscribePacket(uint8_t* buf, size_t cap, uint16_t id,
+                                      const char* filter, uint8_t qos) {
+  MqttWriter w(buf, cap);
+  w.u16(id);
+  w.str(filter);
+  w.u8(qos);
+  return w.finish((MQTT_SUBSCRIBE << 4) | 0x02);
+}
+
+// PUBACK (and any other packet that is just an id)
+inline MqttPacket mqttIdPacket(uint8_t* buf, size_t cap, uint8_t type, uint16_t id) {
+  MqttWriter w(buf, cap);
+  w.u16(id);
+  return w.finish(type << 4);
+}
+
+inline MqttPacket mqttEmptyPacket(uint8_t* buf, size_t cap, uint8_t type) {
+  MqttWriter w(buf, cap);
+  return w.finish(type << 4);
+}
+
+// -------------------
+// Reading
+// -------------------
+class MqttParser {
+ public:
+  // One byte from the socket; true when it completes a packet,
+  // which stays readable until the next feed().
+  bool feed(uint8_t b) {
+    switch (state_) {
+      case HEADER:
+        first_ = b;
+        length_ = 0;
+        shift_ = 0;
+        got_ = 0;
+        state_ = LENGTH;
+        return false;
+      case LENGTH:
+        length_ |= (uint32_t)(b & 0x7F) << shift_;
+        shift_ += 7;
+        if (b & 0x80) {
+          if (shift_ > 21) state_ = HEADER;   // malformed: more than 4 length bytes
+          return false;
+        }
+        if (length_ == 0) {
+          state_ = HEADER;
+          return true;
+        }
+        state_ = BODY;
+        return false;
+      case BODY:
+        if (got_ < MQTT_PACKET_MAX) body_[got_] = b;
+        got_++;
+        if (got_ < length_) return false;
+        state_ = HEADER;
+        return true;
+    }
+    return false;
+  }
+
+  void reset() { state_ = HEADER; }
+
+  uint8_t        type() const      { return first_ >> 4; }
+  uint8_t        flags() const     { return first_ & 0x0F; }
+  const uint8_t* body() const      { return body_; }
+  size_t         length() const    { return length_ < MQTT_PACKET_MAX ? length_ : MQTT_PACKET_MAX; }
+  bool           truncated() const { return length_ > MQTT_PACKET_MAX; }
+
+  uint16_t id() const { return length() >= 2 ? (uint16_t)((body_[0] << 8) | body_[1]) : 0; }
+
+ private:
+  enum State : uint8_t { HEADER, LENGTH, BODY };
+  State    state_  = HEADER;
+  uint8_t  first_  = 0;
+  uint32_t length_ = 0;
+  uint8_t  shift_  = 0;
+  uint32_t got_    = 0;
+  uint8_t  body_[MQTT_PACKET_MAX];
+};
+
+struct MqttPublish {
+  const char*    topic;
+  uint16_t       topicLen;
+  const uint8_t* payload;
+  size_t         payloadLen;
+  uint8_t        qos;
+  bool           retain;
+  uint16_t       id;
+};
+
+inline bool mqttParsePublish(const MqttParser &p, MqttPublish &out) {
+  if (p.type() != MQTT_PUBLISH || p.length() < 2 || p.truncated()) return false;
+  const uint8_t* b = p.body();
+  size_t len = p.length();
+  out.topicLen = (uint16_t)((b[0] << 8) | b[1]);
+  out.topic    = (const char*)b + 2;
+  out.qos      = (p.flags() >> 1) & 3;
+  out.retain   = p.flags() & 1;
+  size_t pos   = 2 + out.topicLen;
+  if (pos > len || out.qos > 1) return false;
+  out.id = 0;
+  if (out.qos) {
+    if (pos + 2 > len) return false;
+    out.id = (uint16_t)((b[pos] << 8) | b[pos + 1]);
+    pos += 2;
+  }
+  out.payload    = b + pos;
+  out.payloadLen = len - pos;
+  return true;
+}
+
+// Topic filter with + (one level) and # (the rest)
+inline bool mqttTopicMatches(const char* filter, const char* topic, size_t topicLen) {
+  size_t t = 0;
+  for (const char* f = filter; *f; f++) {
+    if (*f == '#') return true;
+    if (*f == '+') {
+      while (t < topicLen && topic[t] != '/') t++;
+      continue;
+    }
+    if (t >= topicLen || topic[t] != *f) return false;
+    t++;
+  }
+  return t == topicLen;
+}
+
+// -------------------
+// Outbox
+// -------------------
+struct MqttOutMsg {
+  char     topic[MQTT_TOPIC_MAX];
+  uint8_t  payload[MQTT_PAYLOAD_MAX];
+  uint16_t len;
+  uint8_t  qos;
+  bool     retain;
+  bool     used;
+  bool     sent;       // QoS 1 on the wire, waiting for PUBACK
+  bool     dup;
+  uint16_t id;
+  uint32_t seq;        // queue order
+  uint32_t queuedMs;
+  uint32_t sentMs;
+};
+
+struct MqttOutboxStats {
+  uint32_t queued;
+  uint32_t dropped;     // pushed out by newer messages
+  uint32_t rejected;    // topic or payload too long
+  uint32_t resent;
+  uint32_t acked;
+  uint32_t ackMsTotal;  // queue to PUBACK
+  uint32_t ackMsMax;
+};
+
+template<uint8_t N>
+class MqttOutbox {
+ public:
+  bool push(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain,
+            uint32_t nowMs) {
+    size_t tl = strlen(topic);
+    if (tl >= MQTT_TOPIC_MAX || len > MQTT_PAYLOAD_MAX) {
+      stats_.rejected++;
+      return false;
+    }
+    MqttOutMsg* m = freeSlot();
+    if (!m) {
+      m = oldest(true);   // a QoS 0 message, if any
+      if (!m) m = oldest(false);
+      stats_.dropped++;
+    }
+    memcpy(m->topic, topic, tl + 1);
+    memcpy(m->payload, payload, len);
+    m->len      = (uint16_t)len;
+    m->qos      = qos;
+    m->retain   = retain;
+    m->used     = true;
+    m->sent     = false;
+    m->dup      = false;
+    m->id       = qos ? nextId() : 0;
+    m->seq      = seq_++;
+    m->queuedMs = nowMs;
+    stats_.queued++;
+    return true;
+  }
+
+  // Oldest message due on the wire: never sent, or a QoS 1 that has
+  // waited retryMs for its PUBACK (sent again with DUP)
+  MqttOutMsg* next(uint32_t nowMs, uint32_t retryMs) {
+    MqttOutMsg* best = nullptr;
+    for (MqttOutMsg &m : slots_) {
+      if (!m.used) continue;
+      bool due = !m.sent || nowMs - m.sentMs >= retryMs;
+      if (due && (!best || (int32_t)(m.seq - best->seq) < 0)) best = &m;
+    }
+    return best;
+  }
+
+  void markSent(MqttOutMsg* m, uint32_t nowMs) {
+    if (m->sent) {
+      m->dup = true;
+      stats_.resent++;
+    }
+    if (m->qos == 0) {
+      m->used = false;
+      return;
+    }
+    m->sent   = true;
+    m->sentMs = nowMs;
+  }
+
+  // PUBACK for id; false if nothing was waiting for it
+  bool ack(uint16_t id, uint32_t nowMs) {
+    for (MqttOutMsg &m : slots_) {
+      if (!m.used || !m.sent || m.id != id) continue;
+      uint32_t ms = nowMs - m.queuedMs;
+      stats_.acked++;
+      stats_.ackMsTotal += ms;
+      if (ms > stats_.ackMsMax) stats_.ackMsMax = ms;
+      m.used = false;
+      return true;
+    }
+    return false;
+  }
+
+  // New connection: unacknowledged QoS 1 messages go again, with DUP
+  void resendAll() {
+    for (MqttOutMsg &m : slots_) {
+      if (m.used && m.sent) {
+        m.sent = false;
+        m.dup  = true;
+        stats_.resent++;
+      }
+    }
+  }
+
+  uint8_t size() const {
+    uint8_t n = 0;
+    for (const MqttOutMsg &m : slots_) n += m.used;
+    return n;
+  }
+
+  const MqttOutboxStats &stats() const { return stats_; }
+
+ private:
+  MqttOutMsg* freeSlot() {
+    for (MqttOutMsg &m : slots_) {
+      if (!m.used) return &m;
+    }
+    return nullptr;
+  }
+
+  MqttOutMsg* oldest(bool qos0Only) {
+    MqttOutMsg* best = nullptr;
+    for (MqttOutMsg &m : slots_) {
+      if (!m.used || (qos0Only && m.qos)) continue;
+      if (!best || (int32_t)(m.seq - best->seq) < 0) best = &m;
+    }
+    return best;
+  }
+
+  uint16_t nextId() {
+    if (++id_ == 0) id_ = 1;
+    return id_;
+  }
+
+  MqttOutMsg      slots_[N] = {};
+  uint32_t        seq_      = 0;
+  uint16_t        id_       = 0;
+  MqttOutboxStats stats_    = {};
+};
+
+#endif // MQTT_CODE_H
@@ -12,6 +12,8 @@
 #include "globals.h"
 #include "rotarycode.h"
 #include "blelogic.h"
+#include "screenlayers.h"
+#include "macrovm.h"
 
 // Forward declaration — getTime() is defined in the main sketch.
 // Uses a cache so the standby clock never flickers to "No Time"
@@ -190,25 +192,32 @@ inline void drawStandbyScreen(int yOffset = 0, bool commit = true) {
 //   y  34   → item slot 2
 //   y  48   → item slot 3
 // =============================================================
-#define MENU_ITEM_COUNT 5
-#define MENU_VISIBLE    3
+#define MENU_VISIBLE       3
+#define MENU_LABEL_MAX     20
 
-inline void drawMenu(int yOffset = 0, bool commit = true) {
-  if (commit) display.clearDisplay();
+inline int menuItemCount() {
+  return MENU_BUILTIN_COUNT + macroCount();
+}
 
-  // ── Header ────────────────────────────────────────────
+// ── Header ────────────────────────────────────────────
+inline void drawMenuStatic(int yOffset) {
   display.setTextSize(2);
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(10, 0 + yOffset);
   display.print("MAIN MENU");
 
   display.drawFastHLine(0, 16 + yOffset, 128, SSD1306_WHITE);
+}
+
+inline void drawMenu(int yOffset = 0, bool commit = true) {
+  beginScreen(LAYER_MENU, drawMenuStatic, yOffset, commit);
 
   // ── Scrolling window ──────────────────────────────────
-  const char* labels[MENU_ITEM_COUNT] = {
+  const char* labels[MENU_BUILTIN_COUNT] = {
     "1. Volume Knob", "2. Wake Mode", "3. Timer",
     "4. OBS Control", "5. DoorLock"
   };
+  const int itemCount = menuItemCount();
   const int yPos[MENU_VISIBLE] = { 20, 34, 48 };
 
   // Calculate scroll offset to keep selection visible
@@ -220,7 +229,7 @@ inline void drawMenu(int yOffset = 0, bool commit = true) {
   display.setTextSize(1);
   for (int slot = 0; slot < MENU_VISIBLE; slot++) {
     int itemIdx = scrollTop + slot;
-    if (itemIdx >= MENU_ITEM_COUNT) break;
+    if (itemIdx >= itemCount) break;
 
     if (itemIdx == menuSelection) {
       display.fillRect(0, yPos[slot] - 1 + yOffset, 128, 10, SSD1306_WHITE);
@@ -229,7 +238,14 @@ inline void drawMenu(int yOffset = 0, bool commit = true) {
       display.setTextColor(SSD1306_WHITE);
     }
     display.setCursor(6, yPos[slot] + yOffset);
-    display.print(labels[itemIdx]);
+    if (itemIdx < MENU_BUILTIN_COUNT) {
+      display.print(labels[itemIdx]);
+    } else {
+      FixedString<MENU_LABEL_MAX> label;
+      label.appendf("%d. %s", itemIdx + 1,
+                    macroSlots[macroSlotAt(itemIdx - MENU_BUILTIN_COUNT)].name);
+      display.print(label.c_str());
+    }
   }
 
   // ── Scroll indicators ─────────────────────────────────
@@ -238,7 +254,7 @@ inline void drawMenu(int yOffset = 0, bool commit = true) {
     // Up arrow indicator
     display.fillTriangle(120, 19 + yOffset, 124, 19 + yOffset, 122, 17 + yOffset, SSD1306_WHITE);
   }
-  if (scrollTop + MENU_VISIBLE < MENU_ITEM_COUNT) {
+  if (scrollTop + MENU_VISIBLE < itemCount) {
     // Down arrow indicator
     display.fillTriangle(120, 57 + yOffset, 124, 57 + yOffset, 122, 59 + yOffset, SSD1306_WHITE);
   }
@@ -268,8 +284,12 @@ inline void drawWelcomeScreen(){
 // Shows a progress bar and phase label during startup so the
 // user always knows the device is alive and what it's doing.
 // =============================================================
-inline void drawBootProgress(const char* phase, int percent) {
-  display.clearDisplay();
+#define BOOT_BAR_X 10
+#define BOOT_BAR_Y 28
+#define BOOT_BAR_W 108
+#define BOOT_BAR_H 10
+
+inline void drawBootProgressStatic(int) {
   display.setTextColor(SSD1306_WHITE);
 
   // Title
@@ -280,9 +300,16 @@ inline void drawBootProgress(const char* phase, int percent) {
   // Separator
   display.drawFastHLine(0, 20, 128, SSD1306_WHITE);
 
-  // Progress bar
-  int barX = 10, barY = 28, barW = 108, barH = 10;
-  display.drawRect(barX, barY, barW, barH, SSD1306_WHITE);
+  // Progress bar frame
+  display.drawRect(BOOT_BAR_X, BOOT_BAR_Y, BOOT_BAR_W, BOOT_BAR_H, SSD1306_WHITE);
+}
+
+inline void drawBootProgress(const char* phase, int percent) {
+  beginScreen(LAYER_BOOT, drawBootProgressStatic, 0, true);
+  display.setTextColor(SSD1306_WHITE);
+
+  // Progress bar fill
+  int barX = BOOT_BAR_X, barY = BOOT_BAR_Y, barW = BOOT_BAR_W, barH = BOOT_BAR_H;
   int fillW = ((barW - 4) * percent) / 100;
   if (fillW > 0) {
     display.fillRect(barX + 2, barY + 2, fillW, barH - 4, SSD1306_WHITE);
@@ -309,9 +336,7 @@ inline void drawBootProgress(const char* phase, int percent) {
 // Shown on the OLED while the WiFi captive portal is active,
 // so the user knows what to do and sees a countdown timer.
 // =============================================================
-inline void drawConfigPortalScreen(int remainingSec) {
-  display.clearDisplay();
-
+inline void drawConfigPortalStatic(int) {
   // Header bar (inverted)
   display.fillRect(0, 0, 128, 12, SSD1306_WHITE);
   display.setTextColor(SSD1306_BLACK);
@@ -331,8 +356,14 @@ inline void drawConfigPortalScreen(int remainingSec) {
 
   display.setCursor(0, 49);
   display.print("Go to: 10.10.10.10");
+}
+
+inline void drawConfigPortalScreen(int remainingSec) {
+  beginScreen(LAYER_PORTAL, drawConfigPortalStatic, 0, true);
 
   // Countdown
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(1);
   char buf[18];
   snprintf(buf, sizeof(buf), "Auto-skip: %ds", remainingSec);
   display.setCursor(0, 57);
@@ -350,17 +381,18 @@ inline void drawArc(int cx, int cy, int radius, int startDeg, int endDeg, int th
   }
 }
 
-inline void drawVolumeScreen(int yOffset = 0, bool commit = true) {
-  if (commit) display.clearDisplay();
-  
+#define VOLUME_ICON_CX 64
+#define VOLUME_ICON_CY 34
+
+inline void drawVolumeStatic(int yOffset) {
   // Minimal contextual text
   display.setTextColor(SSD1306_WHITE);
   display.setTextSize(1);
   display.setCursor(0, 0 + yOffset);
   display.println("< Back");
 
-  int cx = 64;
-  int cy = 34 + yOffset;
+  int cx = VOLUME_ICON_CX;
+  int cy = VOLUME_ICON_CY + yOffset;
 
   // Traditional side-facing speaker icon
   int rW = 8;  // Rectangle width
@@ -379,37 +411,44 @@ inline void drawVolumeScreen(int yOffset = 0, bool commit = true) {
   display.fillTriangle(sX + rW, cy + rH / 2,
                        sX + rW + cW, cy - cH / 2,
                        sX + rW + cW, cy + cH / 2, SSD1306_WHITE);
+}
+
+inline void drawVolumeScreen(int yOffset = 0, bool commit = true) {
+  beginScreen(LAYER_VOLUME, drawVolumeStatic, yOffset, commit);
+
+  int cx = VOLUME_ICON_CX;
+  int cy = VOLUME_ICON_CY + yOffset;
 
   if (volumeAnimIndicator != 0) {
-    long elapsed = 300 - (volumeAnimTimer - millis());
+    long elapsed = VOLUME_ANIM_MS - (long)volumeAnimEnd.remaining().toMs();
     if (elapsed < 0) elapsed = 0;
-    if (elapsed > 300) elapsed = 300;
+    if (elapsed > VOLUME_ANIM_MS) elapsed = VOLUME_ANIM_MS;
 
     int baseRadius = 22;
-    int thickness = 3 - (elapsed * 3) / 300;
+    int thickness = 3 - (elapsed * 3) / VOLUME_ANIM_MS;
     if (thickness < 1) thickness = 1;
 
     if (volumeAnimIndicator > 0) {
       // CW / Increase -> Right arc expanding
-      int r = baseRadius + (elapsed * 10) / 300;
+      int r = baseRadius + (elapsed * 10) / VOLUME_ANIM_MS;
       drawArc(cx, cy, r, -45, 45, thickness);
       
       // Secondary trailing arc
-      if (elapsed > 100) {
-         int r2 = baseRadius + ((elapsed - 100) * 10) / 300;
-         int thick2 = 2 - ((elapsed - 100) * 2) / 300;
+      if (elapsed > VOLUME_ANIM_MS / 3) {
+         int r2 = baseRadius + ((elapsed - VOLUME_ANIM_MS / 3) * 10) / VOLUME_ANIM_MS;
+         int thick2 = 2 - ((elapsed - VOLUME_ANIM_MS / 3) * 2) / VOLUME_ANIM_MS;
          if (thick2 < 1) thick2 = 1;
          drawArc(cx, cy, r2, -35, 35, thick2);
       }
     } else {
       // CCW / Decrease -> Left arc retracting (reverse motion)
       // Reverse motion: starts far and comes inwards towards speaker
-      int r = baseRadius + 10 - (elapsed * 10) / 300;
+      int r = baseRadius + 10 - (elapsed * 10) / VOLUME_ANIM_MS;
       drawArc(cx, cy, r, 135, 225, thickness);
       
-      if (elapsed > 100) {
-         int r2 = baseRadius + 10 - ((elapsed - 100) * 10) / 300;
-         int thick2 = 2 - ((elapsed - 100) * 2) / 300;
+      if (elapsed > VOLUME_ANIM_MS / 3) {
+         int r2 = baseRadius + 10 - ((elapsed - VOLUME_ANIM_MS / 3) * 10) / VOLUME_ANIM_MS;
+         int thick2 = 2 - ((elapsed - VOLUME_ANIM_MS / 3) * 2) / VOLUME_ANIM_MS;
          if (thick2 < 1) thick2 = 1;
          drawArc(cx, cy, r2, 145, 215, thick2);
       }
@@ -431,8 +470,7 @@ inline void drawVolumeScreen(int yOffset = 0, bool commit = true) {
 //
 // obsAction: 0 = idle, 1 = play (sent 'k'), -1 = pause (sent 'j')
 // =============================================================
-inline void drawOBSScreen(int obsAction = 0, int yOffset = 0, bool commit = true) {
-  if (commit) display.clearDisplay();
+inline void drawOBSStatic(int yOffset) {
   display.setTextColor(SSD1306_WHITE);
 
   // ── Nav hint ──────────────────────────────────────────
@@ -449,6 +487,18 @@ inline void drawOBSScreen(int obsAction = 0, int yOffset = 0, bool commit = true
   display.setCursor(28, 15 + yOffset);
   display.print("OBS");
 
+  // ── Bottom instruction ────────────────────────────────
+  display.setTextSize(1);
+  display.setCursor(4, 56 + yOffset);
+  display.print("L:Pause");
+  display.setCursor(76, 56 + yOffset);
+  display.print("R:Play");
+}
+
+inline void drawOBSScreen(int obsAction = 0, int yOffset = 0, bool commit = true) {
+  beginScreen(LAYER_OBS, drawOBSStatic, yOffset, commit);
+  display.setTextColor(SSD1306_WHITE);
+
   // ── Center icon area ──────────────────────────────────
   int cx = 64;
   int cy = 44 + yOffset;
@@ -485,13 +535,31 @@ inline void drawOBSScreen(int obsAction = 0, int yOffset = 0, bool commit = true
     display.print("/");
   }
 
-  // ── Bottom instruction ────────────────────────────────
-  display.setTextSize(1);
-  display.setCursor(4, 56 + yOffset);
-  display.print("L:Pause");
-  display.setCursor(76, 56 + yOffset);
-  display.print("R:Play");
+  if (commit) display.display();
+}
+
+// =============================================================
+// MACRO MODE SCREEN
+//
+// Whatever the open macro put in its text lines (macrovm.h):
+//   y  0-15   → macro name (textSize 2)
+//   y  16     → separator
+//   y  20..53 → four lines of 21 chars
+// =============================================================
+inline void drawMacroScreen(int yOffset = 0, bool commit = true) {
+  if (commit) display.clearDisplay();
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(2);
+  display.setCursor(0, 0 + yOffset);
+  display.print(macroTitle);
+  display.drawFastHLine(0, 16 + yOffset, 128, SSD1306_WHITE);
 
+  display.setTextSize(1);
+  for (int line = 0; line < MACRO_LINES; line++) {
+    display.setCursor(0, 20 + line * 11 + yOffset);
+    display.print(macroLines[line].c_str());
+  }
+  macroScreenDirty = false;
   if (commit) display.display();
 }
 
@@ -507,8 +575,7 @@ inline void drawOBSScreen(int obsAction = 0, int yOffset = 0, bool commit = true
 //
 // doorStatus: 0 = idle, 1 = unlocked, -1 = locked, 2 = error
 // =============================================================
-inline void drawDoorLockScreen(int doorStatus = 0, int yOffset = 0, bool commit = true) {
-  if (commit) display.clearDisplay();
+inline void drawDoorLockStatic(int yOffset) {
   display.setTextColor(SSD1306_WHITE);
 
   // ── Nav hint ──────────────────────────────────────────
@@ -524,6 +591,18 @@ inline void drawDoorLockScreen(int doorStatus = 0, int yOffset = 0, bool commit
   display.setCursor(10, 14 + yOffset);
   display.print("DOOR LOCK");
 
+  // ── Bottom instruction ────────────────────────────────
+  display.setTextSize(1);
+  display.setCursor(4, 56 + yOffset);
+  display.print("L:Lock");
+  display.setCursor(80, 56 + yOffset);
+  display.print("R:Open");
+}
+
+inline void drawDoorLockScreen(int doorStatus = 0, int yOffset = 0, bool commit = true) {
+  beginScreen(LAYER_DOORLOCK, drawDoorLockStatic, yOffset, commit);
+  display.setTextColor(SSD1306_WHITE);
+
   // ── Center icon area ──────────────────────────────────
   int cx = 64;
   int cy = 44 + yOffset;
@@ -570,13 +649,6 @@ inline void drawDoorLockScreen(int doorStatus = 0, int yOffset = 0, bool commit
     display.fillCircle(cx, cy + 2, 2, SSD1306_WHITE);
   }
 
-  // ── Bottom instruction ────────────────────────────────
-  display.setTextSize(1);
-  display.setCursor(4, 56 + yOffset);
-  display.print("L:Lock");
-  display.setCursor(80, 56 + yOffset);
-  display.print("R:Open");
-
   if (commit) display.display();
 }
 
@@ -655,18 +727,50 @@ inline void drawTimerPausedScreen() {
   display.display();
 }
 
-inline void drawTimerEndedScreen() {
+inline void drawTimerEndedScreen(const char* label = "") {
   display.clearDisplay();
   display.setTextColor(SSD1306_WHITE);
   display.setTextSize(2);
   display.setCursor(10, 16);
   display.println("TIME UP!");
   display.setTextSize(1);
+  if (label[0]) {
+    display.setCursor(10, 36);
+    display.print(label);
+  }
   display.setCursor(10, 50);
   display.println("Press Btn to Stop");
   display.display();
 }
 
+// Text pushed over HTTP (batchapi.h), word-wrapped to 21 columns
+inline void drawMessageScreen(const char* text) {
+  display.clearDisplay();
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(1);
+  display.setCursor(0, 0);
+  display.print("MESSAGE");
+  display.drawLine(0, 10, 127, 10, SSD1306_WHITE);
+
+  const int cols = 21;
+  int y = 14;
+  while (*text && y <= 54) {
+    while (*text == ' ') text++;
+    int len = strlen(text);
+    int take = len;
+    if (len > cols) {
+      take = cols;
+      while (take > 0 && text[take] != ' ') take--;
+      if (take == 0) take = cols;   // one long word: hard break
+    }
+    display.setCursor(0, y);
+    display.write((const uint8_t*)text, take);
+    text += take;
+    y += 10;
+  }
+  display.display();
+}
+
 // =============================================================
 // STOPWATCH SCREEN (HTTP-triggered, counts UP from 00:00)
 //
@@ -676,14 +780,25 @@ inline void drawTimerEndedScreen() {
 //   y  18-55 → Big MM:SS stopwatch counter (textSize 3), centred
 //   y  57-63 → "Stopwatch" label
 // =============================================================
+inline void drawStopwatchStatic(int) {
+  // Lock/Unlock icon (leftmost)
+  drawLockIcon(0, 1);
+
+  // Separator
+  display.drawFastHLine(0, 15, 128, SSD1306_WHITE);
+
+  // Bottom label
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextSize(1);
+  display.setCursor(34, 56);
+  display.print("Focus Mode");
+}
+
 inline void drawStopwatchScreen() {
-  display.clearDisplay();
+  beginScreen(LAYER_STOPWATCH, drawStopwatchStatic, 0, true);
   display.setTextColor(SSD1306_WHITE);
 
   // ── Top status bar ────────────────────────────────────
-  // Lock/Unlock icon (leftmost)
-  drawLockIcon(0, 1);
-
   // WiFi icon
   bool wifiOn = (WiFi.status() == WL_CONNECTED);
   drawWifiIcon(18, 1, wifiOn);
@@ -709,13 +824,10 @@ inline void drawStopwatchScreen() {
     display.print(ampm);
   }
 
-  // Separator
-  display.drawFastHLine(0, 15, 128, SSD1306_WHITE);
-
   // ── Stopwatch counter (MM:SS) ─────────────────────────
   unsigned long elapsed = stopwatchElapsed;
   if (stopwatchRunning) {
-    elapsed += (millis() - stopwatchStartMillis);
+    elapsed += since(stopwatchStartedAt).toMs();
   }
   int totalSec = elapsed / 1000;
   int mins = totalSec / 60;
@@ -728,17 +840,11 @@ inline void drawStopwatchScreen() {
   display.setCursor(19, 25);
   display.print(swBuf);
 
-  // ── Bottom label ──────────────────────────────────────
-  display.setTextSize(1);
-  display.setCursor(34, 56);
-  display.print("Focus Mode");
-
   display.display();
 }
 
 // --- UI Buzzer Variables ---
-unsigned long uiBuzzerEndTime = 0;
-bool uiBuzzerActive = false;
+Deadline uiBuzzerOff;   // armed while the UI click/long-press beep sounds
 
 inline void initDisplay(){
   Wire.begin(I2C_SDA, I2C_SCL);
@@ -747,12 +853,14 @@ inline void initDisplay(){
     Serial.println(F("SSD1306 allocation failed. Check wiring!"));
     for(;;); 
   }
+  if (!display.startAsyncFlush()) {
+    Serial.println("OLED: async flush unavailable, using blocking display()");
+  }
+  Serial.printf("OLED: I2C clock %lu Hz\n", (unsigned long)display.frameStats().i2cClock);
   delay(100);
 }
 
-inline void updatingFirmwareScreen() {
-  display.clearDisplay();
-
+inline void drawUpdatingFirmwareStatic(int) {
   // --- Header Bar ---
   display.fillRect(0, 0, 128, 14, SSD1306_WHITE);     // Solid title bar
   display.setTextColor(SSD1306_BLACK);                // Inverted text for bar
@@ -775,7 +883,10 @@ inline void updatingFirmwareScreen() {
   display.drawRect(10, 58, 108, 4, SSD1306_WHITE);     // outline
   // To animate: draw filled rect during update routine
   // display.fillRect(12, 60, progressWidth, 2, SSD1306_WHITE);
+}
 
+inline void updatingFirmwareScreen() {
+  beginScreen(LAYER_FIRMWARE, drawUpdatingFirmwareStatic, 0, true);
   display.display();
 }
 
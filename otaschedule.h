@@ -0,0 +1,119 @@
+#ifndef OTA_SCHEDULE_H
+#define OTA_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "jsoncode.h"
+
+// =============================================================
+// STAGGERED CHECK SCHEDULE
+// After a power cut every knob boots at once. Instead of all of
+// them hitting the version endpoint in the same second, each
+// unit waits a random slice of OTA_BOOT_JITTER_MAX_MS, then
+// re-checks every OTA_RECHECK_INTERVAL_MS (also jittered).
+// Failures back off exponentially with "full jitter" (base/2 plus
+// uniform in [0, min(cap, base * 2^n)], never past the cap) so
+// retries don't re-synchronise, and a server Retry-After always
+// wins.
+//
+// No Arduino dependencies: autoupdatelogic.h runs it with
+// random(), tools/fleetsim.cpp runs it for a fleet of knobs
+// against a simulated server. The reply side of the version check
+// (status, Retry-After, the JSON body) is here too, so fleetsim
+// reads its mock server's answers the way the knob does.
+// =============================================================
+#define OTA_BOOT_JITTER_MAX_MS    120000UL              // first check within 2 min of boot
+#define OTA_RECHECK_INTERVAL_MS   (6UL * 3600UL * 1000UL) // then every ~6 h
+#define OTA_RECHECK_JITTER_MS     (30UL * 60UL * 1000UL)  // ± up to 30 min
+#define OTA_BACKOFF_BASE_MS       30000UL
+#define OTA_BACKOFF_MAX_MS        (60UL * 60UL * 1000UL)
+
+// Version check: GET SERVER_BASE_URL OTA_VERSION_PATH <MAC>
+#define OTA_VERSION_PATH          "/api/v1/device/firmware/version?macAddress="
+
+// Outcome of one version check — drives the retry schedule below.
+enum OtaCheckResult {
+  OTA_CHECK_UP_TO_DATE,    // server answered, nothing newer
+  OTA_CHECK_FAILED,        // network/parse/download failure — back off
+  OTA_CHECK_THROTTLED,     // server said 429/503 — honour Retry-After
+  OTA_CHECK_SKIPPED        // WiFi down
+};
+
+struct OtaSchedule {
+  uint8_t failures = 0;
+};
+
+// randomMs(max) returns a uniform delay in [0, max), 0 for max 0
+
+// Delay from boot to the first check
+template<class RandomMs>
+inline uint32_t otaFirstCheckMs(OtaSchedule &s, RandomMs randomMs) {
+  s.failures = 0;
+  return randomMs(OTA_BOOT_JITTER_MAX_MS);
+}
+
+// Delay to the next check after one ended with 'result'.
+// retryAfterMs: the server's Retry-After, 0 if it gave none.
+template<class RandomMs>
+inline uint32_t otaNextCheckMs(OtaSchedule &s, OtaCheckResult result, uint32_t retryAfterMs,
+                               RandomMs randomMs) {
+  switch (result) {
+    case OTA_CHECK_UP_TO_DATE:
+      s.failures = 0;
+      return OTA_RECHECK_INTERVAL_MS - OTA_RECHECK_JITTER_MS + randomMs(2 * OTA_RECHECK_JITTER_MS);
+    case OTA_CHECK_THROTTLED:
+      if (retryAfterMs > 0) {
+        // Spread the herd over a window after the server's hint too
+        return retryAfterMs + randomMs(retryAfterMs / 2);
+      }
+      // No hint: treat it as a failure
+      [[fallthrough]];
+    case OTA_CHECK_FAILED:
+    case OTA_CHECK_SKIPPED:
+    default: {
+      if (s.failures < 16) s.failures++;
+      uint8_t  shift  = s.failures - 1 < 7 ? s.failures - 1 : 7;
+      uint32_t window = OTA_BACKOFF_BASE_MS << shift;
+      if (window > OTA_BACKOFF_MAX_MS) window = OTA_BACKOFF_MAX_MS;
+      uint32_t wait   = OTA_BACKOFF_BASE_MS / 2 + randomMs(window);
+      return wait < OTA_BACKOFF_MAX_MS ? wait : OTA_BACKOFF_MAX_MS;
+    }
+  }
+}
+
+// Compare semver strings "x.y.z"
+// (sscanf skips leading whitespace and stops at trailing junk.)
+inline bool isVersionNewer(const char* current, const char* latest) {
+  int curMajor = 0, curMinor = 0, curPatch = 0;
+  int latMajor = 0, latMinor = 0, latPatch = 0;
+  sscanf(current, "%d.%d.%d", &curMajor, &curMinor, &curPatch);
+  sscanf(latest,  "%d.%d.%d", &latMajor, &latMinor, &latPatch);
+  if (latMajor > curMajor) return true;
+  if (latMajor < curMajor) return false;
+  if (latMinor > curMinor) return true;
+  if (latMinor < curMinor) return false;
+  return latPatch > curPatch;
+}
+
+// The version endpoint's reply. 429/503 is THROTTLED, with the
+// Retry-After seconds (nullptr or "" for none) in retryAfterMs; any
+// other status but 200, or a body without a "data" string, FAILED.
+// Otherwise the server's version is in 'latest' and the result is
+// UP_TO_DATE: whether it is newer is the caller's to decide. The
+// body (at most 'length' bytes, -1 to its end) is read for a 200 only.
+template<class In, size_t N>
+inline OtaCheckResult otaReadReply(int httpCode, const char* retryAfter, In &body, int32_t length,
+                                   FixedString<N> &latest, uint32_t &retryAfterMs) {
+  retryAfterMs = 0;
+  if (httpCode == 429 || httpCode == 503) {
+    long secs = retryAfter ? atol(retryAfter) : 0;
+    if (secs > 0) retryAfterMs = (uint32_t)secs * 1000UL;
+    return OTA_CHECK_THROTTLED;
+  }
+  if (httpCode != 200) return OTA_CHECK_FAILED;
+  BasicJsonReader<In> json(body, length);
+  return json.findString("data", latest) ? OTA_CHECK_UP_TO_DATE : OTA_CHECK_FAILED;
+}
+
+#endif // OTA_SCHEDULE_H
@@ -0,0 +1,84 @@
+#ifndef POWER_MODEL_H
+#define POWER_MODEL_H
+
+#include <stdint.h>
+
+// =============================================================
+// STANDBY POWER MODEL
+// The standby schedule and the energy estimate, kept free of
+// Arduino dependencies so tools/standbysim.cpp runs the exact
+// same schedule on the host.
+//
+// Currents are rough figures for an ESP32-C3 board with a 0.96"
+// SSD1306 showing the standby clock (~20% of pixels lit). Measure
+// your own board and adjust — the ratios matter more than the
+// absolute values.
+// =============================================================
+
+struct PowerProfile {
+  uint32_t activeUa;        // CPU running, radios in modem sleep
+  uint32_t idleUa;          // blocked in delay(), 160 MHz
+  uint32_t idleLowClockUa;  // blocked in delay(), 80 MHz
+  uint32_t lightSleepUa;    // auto light sleep, averaged over DTIM/BLE events
+  uint32_t oledFullUa;      // standby screen at normal contrast
+  uint32_t oledDimUa;       // standby screen at STANDBY_CONTRAST
+};
+
+const PowerProfile POWER_PROFILE_C3 = {
+  /* activeUa       */ 28000,
+  /* idleUa         */ 20000,
+  /* idleLowClockUa */ 14000,
+  /* lightSleepUa   */  2200,
+  /* oledFullUa     */  9000,
+  /* oledDimUa      */  2500,
+};
+
+#define POWER_SUPPLY_MV         3300
+#define STANDBY_REDRAW_MS       60000   // the clock shows HH:MM
+#define STANDBY_REDRAW_GUARD_MS 20      // wake just after the minute flips
+#define STANDBY_POLL_MS         500     // upper bound, keeps HTTP/WiFi serviced
+
+// How the idle part of standby is spent
+enum StandbyIdleMode {
+  IDLE_BUSY_WAIT,       // old loop: delay(10), full clock
+  IDLE_LOW_CLOCK,       // no power management: CPU at 80 MHz, modem sleep
+  IDLE_LIGHT_SLEEP      // esp_pm automatic light sleep
+};
+
+// How long loop() may block before the next pass, given how far we
+// are into the current wall-clock minute.
+inline uint32_t standbyWaitMs(uint32_t msIntoMinute, uint32_t pollMs) {
+  uint32_t toRedraw = STANDBY_REDRAW_MS - (msIntoMinute % STANDBY_REDRAW_MS) +
+                      STANDBY_REDRAW_GUARD_MS;
+  return toRedraw < pollMs ? toRedraw : pollMs;
+}
+
+struct PowerResidency {
+  uint64_t activeUs;   // running (loop passes, redraws)
+  uint64_t idleUs;     // blocked waiting for the next pass or a touch
+};
+
+inline uint32_t idleCurrentUa(StandbyIdleMode mode, const PowerProfile &p) {
+  switch (mode) {
+    case IDLE_LIGHT_SLEEP: return p.lightSleepUa;
+    case IDLE_LOW_CLOCK:   return p.idleLowClockUa;
+    default:               return p.idleUa;
+  }
+}
+
+// Average supply current over the residency, display included.
+inline uint32_t averageCurrentUa(const PowerResidency &r, StandbyIdleMode mode,
+                                 bool dimmed, const PowerProfile &p) {
+  uint64_t total = r.activeUs + r.idleUs;
+  uint32_t oled  = dimmed ? p.oledDimUa : p.oledFullUa;
+  if (total == 0) return oled + idleCurrentUa(mode, p);
+  uint64_t charge = r.activeUs * p.activeUa + r.idleUs * idleCurrentUa(mode, p);
+  return (uint32_t)(charge / total) + oled;
+}
+
+// µA at the supply voltage, for one hour -> µWh
+inline uint32_t energyPerHourUwh(uint32_t averageUa) {
+  return (uint32_t)((uint64_t)averageUa * POWER_SUPPLY_MV / 1000);
+}
+
+#endif // POWER_MODEL_H
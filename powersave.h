@@ -0,0 +1,267 @@
+#ifndef POWER_SAVE_H
+#define POWER_SAVE_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <BLEDevice.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <soc/gpio_struct.h>
+#include <sys/time.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+#include "rotarycode.h"
+#include "powermodel.h"
+
+// =============================================================
+// LOW-POWER STANDBY
+// Standby used to spin loop() every 10 ms at full clock and redraw
+// the clock every second. Now, while in STATE_STANDBY:
+//
+//  - loop() blocks in waitForInput() between passes: until the
+//    clock's minute flips, at most STANDBY_POLL_MS (so HTTP and
+//    WiFi reconnects are still serviced)
+//  - with CONFIG_PM_ENABLE, esp_pm drops into automatic light
+//    sleep while blocked; the encoder CLK and button pins are
+//    armed as level wake-up sources. Without it, the CPU runs at
+//    80 MHz and WiFi stays in modem sleep
+//  - the gesture tick is paused, the OLED dimmed, and the BLE HID
+//    link asked for a longer interval with slave latency, so the
+//    bond stays up but the radio wakes far less often
+//
+// Any encoder or button edge wakes loop() from its ISR, and the
+// next pass restores full clock, contrast and BLE parameters, so
+// the wake animation starts within one frame of the touch.
+//
+// The light-sleep build needs CONFIG_PM_ENABLE and tickless idle
+// in sdkconfig; if esp_pm refuses the config we fall back to the
+// low-clock path. A BLE controller without modem sleep holds a
+// PM lock and limits the gain to frequency scaling.
+// =============================================================
+
+#define STANDBY_CONTRAST  0x08
+#define NORMAL_CONTRAST   0xCF   // Adafruit's value for SSD1306_SWITCHCAPVCC
+#define ACTIVE_CPU_MHZ    160
+#define STANDBY_CPU_MHZ   80     // lowest clock that keeps WiFi up
+#define PM_MIN_CPU_MHZ    40     // XTAL, while light sleep is enabled
+
+// BLE connection parameters (interval in 1.25 ms, timeout in 10 ms)
+#define BLE_ACTIVE_INTERVAL_MIN   6     //   7.5 ms
+#define BLE_ACTIVE_INTERVAL_MAX   12    //  15 ms
+#define BLE_ACTIVE_LATENCY        0
+#define BLE_STANDBY_INTERVAL_MIN  80    // 100 ms
+#define BLE_STANDBY_INTERVAL_MAX  120   // 150 ms
+#define BLE_STANDBY_LATENCY       4     // may skip 4 events (~750 ms)
+#define BLE_SUPERVISION_TIMEOUT   600   //   6 s  > 2 * (1 + latency) * interval
+
+struct PowerStats {
+  uint32_t standbyEntries;
+  uint32_t wakes;
+  uint32_t passes;            // loop passes while in standby
+  uint32_t redraws;
+  uint64_t activeUs;          // standby time spent running
+  uint64_t idleUs;            // standby time blocked (asleep with light sleep)
+  uint32_t lastWakeLatencyUs; // input edge -> loop() running again
+  uint32_t maxWakeLatencyUs;
+  uint16_t bleInterval;       // as last negotiated, 1.25 ms units
+  uint16_t bleLatency;
+  uint32_t bleUpdates;
+  bool     lightSleep;        // esp_pm accepted the light-sleep config
+};
+
+PowerStats powerStats = {};
+
+static bool          powerStandby      = false;
+static MonoTime      powerSegmentStart = {};
+static uint32_t      powerLastMinute   = 0xFFFFFFFF;
+static esp_bd_addr_t blePeer;
+static volatile bool blePeerValid      = false;
+
+// DRAM: read from the input ISR, which may run with flash cache off
+DRAM_ATTR const uint8_t POWER_WAKE_PINS[] = { ENCODER_CLK, ENCODER_SW };
+
+// -------------------
+// BLE connection parameters
+// -------------------
+static void powerGattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t,
+                              esp_ble_gatts_cb_param_t* param) {
+  if (event == ESP_GATTS_CONNECT_EVT) {
+    memcpy(blePeer, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+    blePeerValid = true;
+  } else if (event == ESP_GATTS_DISCONNECT_EVT) {
+    blePeerValid = false;
+  }
+}
+
+static void powerGapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+  if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT &&
+      param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+    powerStats.bleInterval = param->update_conn_params.conn_int;
+    powerStats.bleLatency  = param->update_conn_params.latency;
+    powerStats.bleUpdates++;
+  }
+}
+
+// The central has the final say; what it granted shows up in
+// powerStats via the GAP handler.
+inline void requestBleParams(bool standby) {
+  if (!blePeerValid) return;
+  esp_ble_conn_update_params_t params = {};
+  memcpy(params.bda, blePeer, sizeof(esp_bd_addr_t));
+  params.min_int = standby ? BLE_STANDBY_INTERVAL_MIN : BLE_ACTIVE_INTERVAL_MIN;
+  params.max_int = standby ? BLE_STANDBY_INTERVAL_MAX : BLE_ACTIVE_INTERVAL_MAX;
+  params.latency = standby ? BLE_STANDBY_LATENCY : BLE_ACTIVE_LATENCY;
+  params.timeout = BLE_SUPERVISION_TIMEOUT;
+  esp_ble_gap_update_conn_params(&params);
+}
+
+// -------------------
+// Clock and sleep configuration
+// -------------------
+inline bool configurePm(bool standby) {
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32c3_t cfg = {};
+  cfg.max_freq_mhz       = ACTIVE_CPU_MHZ;
+  cfg.min_freq_mhz       = standby ? PM_MIN_CPU_MHZ : ACTIVE_CPU_MHZ;
+  cfg.light_sleep_enable = standby;
+  return esp_pm_configure(&cfg) == ESP_OK;
+#else
+  (void)standby;
+  return false;
+#endif
+}
+
+// Light sleep only wakes on GPIO levels: arm each pin for the
+// level it isn't at. A level interrupt keeps firing while the pin
+// stays there, so the first ISR must put the pins back to edges
+// before loop() gets to run. The gpio driver calls take a spinlock
+// and live in flash, so the ISR hook writes the two pin-register
+// fields directly; disarmGpioWake() then does the same through the
+// driver from task context once the wait is over.
+static void IRAM_ATTR gpioWakeFromIsr() {
+  inputWakeHook = nullptr;
+  for (uint8_t pin : POWER_WAKE_PINS) {
+    GPIO.pin[pin].wakeup_enable = 0;
+    GPIO.pin[pin].int_type      = GPIO_INTR_ANYEDGE;
+  }
+}
+
+static void disarmGpioWake() {
+  inputWakeHook = nullptr;
+  for (uint8_t pin : POWER_WAKE_PINS) {
+    gpio_wakeup_disable((gpio_num_t)pin);
+    gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_ANYEDGE);
+  }
+}
+
+static void armGpioWake() {
+  for (uint8_t pin : POWER_WAKE_PINS) {
+    gpio_wakeup_enable((gpio_num_t)pin,
+                       digitalRead(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  }
+  inputWakeHook = gpioWakeFromIsr;
+}
+
+// ms since the wall-clock minute started (uptime before NTP sync)
+inline uint32_t msIntoMinute() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < 1600000000) return monoNow().ms() % STANDBY_REDRAW_MS;
+  return (uint32_t)(tv.tv_sec % 60) * 1000 + tv.tv_usec / 1000;
+}
+
+inline uint32_t currentMinute() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < 1600000000) return monoNow().ms() / STANDBY_REDRAW_MS;
+  return (uint32_t)(tv.tv_sec / 60);
+}
+
+// True once per wall-clock minute
+inline bool standbyMinuteChanged() {
+  uint32_t minute = currentMinute();
+  if (minute == powerLastMinute) return false;
+  powerLastMinute = minute;
+  return true;
+}
+
+// -------------------
+// Standby entry / exit
+// -------------------
+inline void enterPowerSave() {
+  powerStandby = true;
+  powerStats.standbyEntries++;
+  display.setContrast(STANDBY_CONTRAST);
+  requestBleParams(true);
+  pauseGestures();
+  WiFi.setSleep(true);
+  powerStats.lightSleep = configurePm(true);
+  if (!powerStats.lightSleep) setCpuFrequencyMhz(STANDBY_CPU_MHZ);
+  powerLastMinute   = currentMinute();
+  powerSegmentStart = monoNow();
+}
+
+inline void exitPowerSave() {
+  powerStats.activeUs += since(powerSegmentStart).toUs();
+  if (powerStats.lightSleep) {
+    disarmGpioWake();
+    configurePm(false);
+  } else {
+    setCpuFrequencyMhz(ACTIVE_CPU_MHZ);
+  }
+  resumeGestures();
+  display.setContrast(NORMAL_CONTRAST);
+  requestBleParams(false);
+  powerStandby = false;
+  powerStats.wakes++;
+}
+
+// Call every pass with whether the device is in standby.
+inline void updatePowerSave(bool standby) {
+  if (standby && !powerStandby)      enterPowerSave();
+  else if (!standby && powerStandby) exitPowerSave();
+}
+
+// End a standby pass: block until the next redraw/poll or input.
+// seenEdges is inputEdges as sampled before checking for input.
+inline bool standbyIdle(uint32_t seenEdges, uint32_t maxWaitMs = UINT32_MAX) {
+  MonoTime start = monoNow();
+  powerStats.activeUs += (start - powerSegmentStart).toUs();
+  powerStats.passes++;
+
+  if (powerStats.lightSleep) armGpioWake();
+  uint32_t waitMs = standbyWaitMs(msIntoMinute(), STANDBY_POLL_MS);
+  if (maxWaitMs < waitMs) waitMs = maxWaitMs;
+  bool woke = waitForInput(waitMs, seenEdges);
+  if (powerStats.lightSleep) disarmGpioWake();
+
+  MonoTime end = monoNow();
+  powerStats.idleUs += (end - start).toUs();
+  powerSegmentStart  = end;
+  if (woke) {
+    powerStats.lastWakeLatencyUs = (uint32_t)(end - MonoTime{ lastInputEdgeUs }).toUs();
+    if (powerStats.lastWakeLatencyUs > powerStats.maxWakeLatencyUs) {
+      powerStats.maxWakeLatencyUs = powerStats.lastWakeLatencyUs;
+    }
+  }
+  return woke;
+}
+
+inline uint32_t standbyAverageCurrentUa() {
+  PowerResidency r = { powerStats.activeUs, powerStats.idleUs };
+  return averageCurrentUa(r, powerStats.lightSleep ? IDLE_LIGHT_SLEEP : IDLE_LOW_CLOCK,
+                          true, POWER_PROFILE_C3);
+}
+
+// Before initBLE(): the handlers only record, BleKeyboard keeps its own.
+inline void initPowerSave() {
+  BLEDevice::setCustomGattsHandler(powerGattsHandler);
+  BLEDevice::setCustomGapHandler(powerGapHandler);
+#if CONFIG_PM_ENABLE
+  esp_sleep_enable_gpio_wakeup();
+  configurePm(false);
+#endif
+}
+
+#endif // POWER_SAVE_H
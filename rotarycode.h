@@ -3,6 +3,11 @@
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include "fastssd1306.h"
+#define ACCEL_IRAM IRAM_ATTR
+#include "encoderaccel.h"
+#include "inputtrace.h"
+#include "monotime.h"
 #include <Wire.h>
 
 // --- OLED Configuration ---
@@ -15,7 +20,7 @@
 #define I2C_SDA 8
 #define I2C_SCL 9
 
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+FastSSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
 // --- Rotary Encoder Pins ---
 #define ENCODER_CLK 2
@@ -26,52 +31,116 @@ Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 volatile int counter = 0;
 volatile int lastClk = HIGH;
 
-volatile unsigned long buttonDownTime = 0;
 volatile bool buttonPressed = false;     // Short press flag
 volatile bool buttonLongPressed = false; // Long press flag
 
 int lastDisplayedCounter = -9999; 
 
+#include "gestures.h"   // needs ENCODER_SW and the flags above
+
+// --- Timestamped encoder steps (ISR -> loop, for acceleration) ---
+// One step per detent (counter moves two per detent, one per CLK
+// edge; EncoderDetent in encoderaccel.h pairs them up).
+// Single producer (ISR) / single consumer (loop). When the loop
+// isn't draining (modes without acceleration) old steps are
+// simply overwritten; consumers flush on entry.
+#define ENCODER_EVENT_RING 32   // power of two
+#define ENCODER_CLK_REST   HIGH // CLK level between detents
+
+struct EncoderEvent {
+  int64_t us;    // monoNow() at the detent
+  int8_t  dir;
+};
+
+volatile EncoderEvent encoderEvents[ENCODER_EVENT_RING];
+volatile uint8_t encoderEventHead = 0;   // written by ISR
+uint8_t          encoderEventTail = 0;   // read position, loop only
+EncoderDetent    encoderDetent;          // ISR only
+
+EncoderAccel encoderAccel;
+
+inline bool popEncoderEvent(EncoderEvent &ev) {
+  uint8_t head = encoderEventHead;
+  if ((uint8_t)(head - encoderEventTail) > ENCODER_EVENT_RING) {
+    encoderEventTail = head - ENCODER_EVENT_RING;   // overrun: keep the newest
+  }
+  if (encoderEventTail == head) return false;
+  uint8_t slot = encoderEventTail & (ENCODER_EVENT_RING - 1);
+  ev.us  = encoderEvents[slot].us;
+  ev.dir = encoderEvents[slot].dir;
+  encoderEventTail++;
+  return true;
+}
+
+// Drop pending steps and start a fresh acceleration gesture.
+inline void flushEncoderEvents() {
+  encoderEventTail = encoderEventHead;
+  encoderAccel.reset();
+}
+
+// --- Input wake-up (ISR -> blocked loop) ---
+// In standby loop() blocks in waitForInput() instead of polling;
+// the first encoder or button edge wakes it straight away.
+// inputWakeHook lets powersave.h undo its sleep wake-up config
+// from the first ISR; it runs in the ISR, so it must be IRAM_ATTR
+// and must not call flash-resident driver code.
+volatile uint32_t     inputEdges       = 0;
+volatile int64_t      lastInputEdgeUs  = 0;   // monoNow() of the last edge
+volatile TaskHandle_t inputWaitTask    = nullptr;
+void (*volatile inputWakeHook)()       = nullptr;
+
+inline void IRAM_ATTR notifyInputEdge() {
+  inputEdges++;
+  lastInputEdgeUs = monoNow().us;
+  void (*hook)() = inputWakeHook;
+  if (hook) hook();
+  TaskHandle_t task = inputWaitTask;
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+
+// Block for up to ms, or until an edge newer than seenEdges (a
+// snapshot of inputEdges taken before checking for input).
+// Returns true if woken by input.
+inline bool waitForInput(uint32_t ms, uint32_t seenEdges) {
+  inputWaitTask = xTaskGetCurrentTaskHandle();
+  bool woke = inputEdges != seenEdges ||
+              ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)) != 0;
+  inputWaitTask = nullptr;
+  return woke;
+}
+
 // --- Interrupt Service Routine for Encoder ---
 void IRAM_ATTR readEncoder() {
+  notifyInputEdge();
   int clkValue = digitalRead(ENCODER_CLK);
   int dtValue = digitalRead(ENCODER_DT);
   
   if (clkValue != lastClk) {
-    if (clkValue != dtValue) {
-      counter++;
-    } else {
-      counter--;
-    }
+    int8_t dir = (clkValue != dtValue) ? 1 : -1;
+    counter += dir;
     lastClk = clkValue;
+
+    int8_t detent = encoderDetent.edge(dir, clkValue == ENCODER_CLK_REST);
+    if (!detent) return;
+    traceRecord(TRACE_ENCODER, (detent > 0) | ((encoderEventHead & 7) << 1));
+    uint8_t slot = encoderEventHead & (ENCODER_EVENT_RING - 1);
+    encoderEvents[slot].us  = monoNow().us;
+    encoderEvents[slot].dir = detent;
+    encoderEventHead++;
   }
 }
 
 // --- Interrupt Service Routine for Button ---
+// Only timestamps the edge; gestures.h classifies presses.
 void IRAM_ATTR readButton() {
-  int btnState = digitalRead(ENCODER_SW);
-  unsigned long currentTime = millis();
-  
-  if (btnState == LOW) { 
-    // Only record the time if a press isn't already being tracked
-    if (buttonDownTime == 0) {
-      buttonDownTime = currentTime;
-    }
-  } else { 
-    // Button fully released
-    if (buttonDownTime > 0) {
-      unsigned long pressDuration = currentTime - buttonDownTime;
-      
-      if (pressDuration >= 2000) { 
-        buttonLongPressed = true;
-      } else if (pressDuration > 20) { // Lowered to 20ms for quick taps
-        buttonPressed = true; 
-      }
-      
-      // Reset the timer so it's ready for the next press
-      buttonDownTime = 0; 
-    }
-  }
+  notifyInputEdge();
+  bool down = digitalRead(ENCODER_SW) == LOW;
+  traceRecord(TRACE_BUTTON, down);
+  recordButtonEdge(down);
 }
 
 void initRotary(){
@@ -87,6 +156,7 @@ void initRotary(){
   
   // CRITICAL FIX: Track CHANGE (both press and release) instead of just FALLING
   attachInterrupt(digitalPinToInterrupt(ENCODER_SW), readButton, CHANGE);
+  initGestures();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef SCREEN_LAYERS_H
+#define SCREEN_LAYERS_H
+
+#include <Arduino.h>
+#include "rotarycode.h"
+#include "fixedstring.h"
+
+// =============================================================
+// PREBAKED STATIC SCREEN LAYERS
+// Headers, separators, "< Back" hints and icon frames never
+// change, yet every frame used to redraw them with GFX text and
+// shape calls. Each screen now splits its drawing into a static
+// part (drawXStatic) and the dynamic rest. The first full-frame
+// draw renders the static part once and keeps the 1 KB page-format
+// result; later frames start with one memcpy of it.
+//
+// Layers are baked at runtime from the same GFX calls rather than
+// generated into flash: the font and primitives live in the
+// Adafruit library, which the build doesn't run on the host.
+// A small LRU pool bounds the RAM — boot-only screens (portal,
+// progress) get evicted once the menu screens are in use.
+//
+// RAM: the pool is static, SCREEN_LAYER_SLOTS × 1 KB = 5 KB of
+// .bss at the default, held for the whole run. That works against
+// the heap the lazy BLE/HTTP bring-up (subsystems.h) gives back;
+// build with a smaller SCREEN_LAYER_SLOTS to trade redraws for RAM
+// (the least used screens are then re-baked more often).
+//
+// Verify mode (POST /api/layers?verify=1) redraws the static part
+// on every restore as well and compares it byte for byte with the
+// cached copy, so a layer that went stale or a static draw that
+// reads live state shows up as "mismatches" in GET /api/layers.
+//
+// Offset/overlay draws (slide animations, commit == false) keep
+// drawing the static part with GFX into the shared buffer.
+// =============================================================
+
+#define SCREEN_BUFFER_BYTES  (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
+#ifndef SCREEN_LAYER_SLOTS
+#define SCREEN_LAYER_SLOTS   5     // × SCREEN_BUFFER_BYTES = 5 KB of .bss
+#endif
+static_assert(SCREEN_LAYER_SLOTS >= 1, "the layer pool needs at least one slot");
+
+enum ScreenLayerId {
+  LAYER_MENU,
+  LAYER_VOLUME,
+  LAYER_OBS,
+  LAYER_DOORLOCK,
+  LAYER_PORTAL,
+  LAYER_FIRMWARE,
+  LAYER_BOOT,
+  LAYER_STOPWATCH,
+  LAYER_COUNT
+};
+
+const char* const screenLayerNames[LAYER_COUNT] = {
+  "menu", "volume", "obs", "doorlock", "portal", "firmware", "boot", "stopwatch"
+};
+
+typedef void (*StaticLayerFn)(int yOffset);
+
+struct ScreenLayerStats {
+  uint32_t drawUs;      // GFX cost of the static part (measured when baked)
+  uint32_t restoreUs;   // memcpy cost of the last restore
+  uint32_t restores;
+  uint16_t bakes;       // > 1 means the layer was evicted and rebuilt
+  uint32_t verified;    // restores compared with a fresh draw (verify mode)
+  uint32_t mismatches;  // ... that differed
+  int16_t  firstBadByte; // offset of the first differing byte last time, -1 if none
+};
+
+ScreenLayerStats screenLayerStats[LAYER_COUNT] = {};
+bool screenLayerVerify = false;
+
+static uint8_t  screenLayerCache[SCREEN_LAYER_SLOTS][SCREEN_BUFFER_BYTES];
+static uint8_t  screenLayerOwner[SCREEN_LAYER_SLOTS] = {};   // layer id + 1, 0 = empty
+static uint32_t screenLayerLastUse[SCREEN_LAYER_SLOTS] = {};
+static uint32_t screenLayerUseClock = 0;
+
+// Start a frame: the static layer of 'id' ends up in the buffer.
+// Replaces the clearDisplay() at the top of a screen function.
+inline void beginScreen(ScreenLayerId id, StaticLayerFn drawStatic, int yOffset, bool commit) {
+  if (!commit || yOffset != 0) {
+    if (commit) display.clearDisplay();
+    drawStatic(yOffset);
+    return;
+  }
+
+  uint8_t* frame = display.getBuffer();
+  ScreenLayerStats &stats = screenLayerStats[id];
+  int victim = 0;
+  for (int slot = 0; slot < SCREEN_LAYER_SLOTS; slot++) {
+    if (screenLayerOwner[slot] == id + 1) {
+      uint32_t start = micros();
+      memcpy(frame, screenLayerCache[slot], SCREEN_BUFFER_BYTES);
+      stats.restoreUs = micros() - start;
+      stats.restores++;
+      screenLayerLastUse[slot] = ++screenLayerUseClock;
+      if (screenLayerVerify) {
+        // Full redraw into the frame, compared with the restored copy.
+        // The frame keeps the redraw, so a mismatch never reaches the panel.
+        display.clearDisplay();
+        drawStatic(0);
+        stats.verified++;
+        stats.firstBadByte = -1;
+        for (int i = 0; i < SCREEN_BUFFER_BYTES; i++) {
+          if (frame[i] != screenLayerCache[slot][i]) {
+            stats.firstBadByte = i;
+            stats.mismatches++;
+            break;
+          }
+        }
+      }
+      return;
+    }
+    if (screenLayerLastUse[slot] < screenLayerLastUse[victim]) victim = slot;
+  }
+
+  // Not cached: draw it for real, then keep a copy
+  uint32_t start = micros();
+  display.clearDisplay();
+  drawStatic(0);
+  stats.drawUs = micros() - start;
+  stats.bakes++;
+  memcpy(screenLayerCache[victim], frame, SCREEN_BUFFER_BYTES);
+  screenLayerOwner[victim]   = id + 1;
+  screenLayerLastUse[victim] = ++screenLayerUseClock;
+}
+
+// {"ramBytes":..,"verify":..,"menu":{"drawUs":..,"restoreUs":..,"restores":..,"bakes":..,
+//  "savedMs":..,"verified":..,"mismatches":..,"firstBadByte":..},...}
+// savedMs = restores × (GFX draw − memcpy), i.e. time not spent redrawing.
+template<size_t N>
+inline void screenLayerStatsJson(FixedString<N> &json) {
+  json.appendf("{\"ramBytes\":%u,\"verify\":%s", (unsigned)sizeof(screenLayerCache),
+               screenLayerVerify ? "true" : "false");
+  for (int i = 0; i < LAYER_COUNT; i++) {
+    const ScreenLayerStats &s = screenLayerStats[i];
+    uint32_t perFrame = s.drawUs > s.restoreUs ? s.drawUs - s.restoreUs : 0;
+    json.appendf(",\"%s\":{\"drawUs\":%u,\"restoreUs\":%u,\"restores\":%u,\"bakes\":%u,\"savedMs\":%u,"
+                 "\"verified\":%u,\"mismatches\":%u,\"firstBadByte\":%d}",
+                 screenLayerNames[i],
+                 (unsigned)s.drawUs, (unsigned)s.restoreUs, (unsigned)s.restores,
+                 (unsigned)s.bakes, (unsigned)((uint64_t)s.restores * perFrame / 1000),
+                 (unsigned)s.verified, (unsigned)s.mismatches, s.verified ? (int)s.firstBadByte : -1);
+  }
+  json.append('}');
+}
+
+#endif // SCREEN_LAYERS_H
@@ -0,0 +1,378 @@
+#ifndef SCREEN_MIRROR_H
+#define SCREEN_MIRROR_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "fixedstring.h"
+#include "fastssd1306.h"
+#include "knoblog.h"
+#include "mirrorcode.h"
+#include "monotime.h"
+
+// =============================================================
+// SCREEN MIRROR
+// Streams what the OLED shows to a browser, for units in the field.
+// The stream is a plain HTTP response on MIRROR_PORT that never
+// ends: a keyframe, then a message (mirrorcode.h) per frame with
+// only the pages that changed, XORed and run-length coded. The
+// /mirror page on port 80 reads it with fetch() and draws it; the
+// bytes can also be fed straight to tools/mirrorsim.cpp.
+//
+// loop() pays for one memcpy of the frame per display() while a
+// viewer is connected, and a flag check per pass otherwise. The
+// frame observer only copies the frame into mirrorLatest and wakes
+// the mirror task; encoding and the socket writes happen there, at
+// most MIRROR_MAX_FPS times a second, so frames drawn faster than
+// that coalesce. One viewer at a time; a new one replaces it.
+//
+// GET /api/screen is a one-shot PBM of the current frame, and
+// GET /api/mirror has the stream's bytes per frame type.
+// =============================================================
+
+#define MIRROR_PORT            81
+#define MIRROR_MAX_FPS         15
+#define MIRROR_ACCEPT_POLL_MS  250
+#define MIRROR_REQUEST_WAIT_MS 1000   // for the viewer's request headers
+#define MIRROR_TASK_STACK      3072
+
+extern FastSSD1306 display;
+
+struct MirrorStats {
+  uint32_t viewers;        // connections accepted
+  uint32_t keyframes;
+  uint32_t keyBytes;
+  uint32_t keyMax;
+  uint32_t deltas;
+  uint32_t deltaBytes;
+  uint32_t deltaMax;
+  uint32_t dirtyPages;     // pages carried by deltas
+  uint32_t unchanged;      // frames identical to the last one sent
+  uint32_t coalesced;      // replaced by a newer frame before encoding
+  uint32_t sendFails;
+  uint32_t encodeUsTotal;
+  uint32_t encodeUsMax;
+  uint32_t observerUsMax;  // time the observer held up display()
+};
+
+WiFiServer        mirrorServer(MIRROR_PORT);
+WiFiClient        mirrorClient;              // the mirror task's
+MirrorStats       mirrorStats = {};
+static TaskHandle_t      mirrorTask = nullptr;
+static SemaphoreHandle_t mirrorLock = nullptr;   // mirrorLatest*
+static uint8_t*          mirrorLatest = nullptr; // last latched frame
+static uint8_t*          mirrorSent   = nullptr; // what the viewer has
+static uint8_t*          mirrorWork   = nullptr; // frame being encoded
+static uint8_t*          mirrorMsg    = nullptr;
+static uint8_t           mirrorLatestLine = 0;
+static bool              mirrorLatestFresh = false;
+static volatile bool     mirrorViewing = false;  // a viewer is connected
+static volatile bool     mirrorWantKey = false;  // loop(): latch the current buffer
+static volatile bool     mirrorQuit    = false;  // stopScreenMirror() asked the task to end
+static bool              mirrorObserving = false;
+volatile uint8_t         mirrorStartLine = 0;    // of the last latched frame
+
+// FastSSD1306 frame observer, on the drawing thread
+inline void mirrorFrame(const uint8_t* frame, size_t len, uint8_t startLine) {
+  mirrorStartLine = startLine;
+  if (!mirrorViewing || len != MIRROR_FRAME_BYTES) return;
+  uint32_t start = micros();
+  xSemaphoreTake(mirrorLock, portMAX_DELAY);
+  if (mirrorLatestFresh) mirrorStats.coalesced++;
+  memcpy(mirrorLatest, frame, MIRROR_FRAME_BYTES);
+  mirrorLatestLine  = startLine;
+  mirrorLatestFresh = true;
+  xSemaphoreGive(mirrorLock);
+  xTaskNotifyGive(mirrorTask);
+  uint32_t held = micros() - start;
+  if (held > mirrorStats.observerUsMax) mirrorStats.observerUsMax = held;
+}
+
+// From loop(): a new viewer needs a keyframe now, not at the next
+// redraw (a menu left alone doesn't redraw)
+inline void mirrorTick() {
+  if (!mirrorWantKey) return;
+  mirrorWantKey = false;
+  mirrorFrame(display.getBuffer(), MIRROR_FRAME_BYTES, mirrorStartLine);
+}
+
+// -------------------
+// Mirror task
+// -------------------
+static bool mirrorSend(const uint8_t* p, size_t n) {
+  if (mirrorClient.write(p, n) == n) return true;
+  mirrorStats.sendFails++;
+  mirrorClient.stop();
+  return false;
+}
+
+// Skip the viewer's request headers, answer with the stream header
+static bool mirrorAccept(WiFiClient client) {
+  if (mirrorClient.connected()) mirrorClient.stop();
+  mirrorClient = client;
+  mirrorClient.setNoDelay(true);
+  MonoTime start = monoNow();
+  uint8_t seen = 0;   // of "\r\n\r\n"
+  while (seen < 4 && since(start) < msecs(MIRROR_REQUEST_WAIT_MS)) {
+    int c = mirrorClient.read();
+    if (c < 0) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    seen = (c == (seen & 1 ? '\n' : '\r')) ? seen + 1 : (c == '\r' ? 1 : 0);
+  }
+  static const char header[] =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: application/octet-stream\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "Cache-Control: no-store\r\n"
+      "Connection: close\r\n\r\n";
+  if (seen < 4 || !mirrorSend((const uint8_t*)header, sizeof(header) - 1)) {
+    mirrorClient.stop();
+    return false;
+  }
+  mirrorStats.viewers++;
+  KLOG_INFO(KLOG_TAG_NET, "Mirror: viewer connected");
+  return true;
+}
+
+static void mirrorLoop() {
+  bool     keyNext = true;
+  uint8_t  sentLine = 0;
+  MonoTime lastSentAt = {};
+  while (!mirrorQuit) {
+    if (mirrorServer.hasClient()) {
+      mirrorViewing = false;
+      if (mirrorAccept(mirrorServer.accept())) {
+        keyNext = true;
+        mirrorViewing = true;
+        mirrorWantKey = true;
+      }
+    }
+    if (!mirrorViewing || !mirrorClient.connected()) {
+      if (mirrorViewing) KLOG_INFO(KLOG_TAG_NET, "Mirror: viewer left");
+      mirrorViewing = false;
+      vTaskDelay(pdMS_TO_TICKS(MIRROR_ACCEPT_POLL_MS));
+      continue;
+    }
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MIRROR_ACCEPT_POLL_MS))) continue;
+
+    Duration gap = since(lastSentAt);
+    if (gap < msecs(1000 / MIRROR_MAX_FPS)) vTaskDelay(pdMS_TO_TICKS(1000 / MIRROR_MAX_FPS - gap.toMs()));
+
+    // Encode from a private copy so display() is never held up
+    uint8_t* frame = mirrorWork;
+    xSemaphoreTake(mirrorLock, portMAX_DELAY);
+    bool fresh = mirrorLatestFresh;
+    memcpy(frame, mirrorLatest, MIRROR_FRAME_BYTES);
+    uint8_t line = mirrorLatestLine;
+    mirrorLatestFresh = false;
+    xSemaphoreGive(mirrorLock);
+    if (!fresh) continue;
+
+    uint32_t start = micros();
+    size_t n = mirrorEncode(frame, keyNext ? nullptr : mirrorSent, line, mirrorMsg);
+    uint32_t us = micros() - start;
+    mirrorStats.encodeUsTotal += us;
+    if (us > mirrorStats.encodeUsMax) mirrorStats.encodeUsMax = us;
+
+    uint8_t mask = mirrorMsg[2];
+    if (!keyNext && mask == 0 && line == sentLine) {
+      mirrorStats.unchanged++;
+      continue;
+    }
+    if (!mirrorSend(mirrorMsg, n)) continue;
+    mirrorWork = mirrorSent;   // frame is what the viewer has now
+    mirrorSent = frame;
+    sentLine   = line;
+    lastSentAt = monoNow();
+    if (keyNext) {
+      mirrorStats.keyframes++;
+      mirrorStats.keyBytes += n;
+      if (n > mirrorStats.keyMax) mirrorStats.keyMax = n;
+    } else {
+      mirrorStats.deltas++;
+      mirrorStats.deltaBytes += n;
+      if (n > mirrorStats.deltaMax) mirrorStats.deltaMax = n;
+      mirrorStats.dirtyPages += __builtin_popcount(mask);
+    }
+    keyNext = false;
+  }
+}
+
+static void mirrorTaskEntry(void*) {
+  mirrorLoop();
+  mirrorViewing = false;
+  mirrorClient.stop();
+  mirrorServer.end();
+  mirrorTask = nullptr;
+  vTaskDelete(nullptr);
+}
+
+static void mirrorFreeBuffers() {
+  free(mirrorLatest);
+  free(mirrorSent);
+  free(mirrorWork);
+  free(mirrorMsg);
+  mirrorLatest = mirrorSent = mirrorWork = mirrorMsg = nullptr;
+}
+
+// After WiFi is up. The buffers are taken here so a viewer never
+// fails for memory later.
+inline void initScreenMirror() {
+  if (mirrorTask) return;
+  mirrorQuit   = false;
+  mirrorLatest = (uint8_t*)malloc(MIRROR_FRAME_BYTES);
+  mirrorSent   = (uint8_t*)malloc(MIRROR_FRAME_BYTES);
+  mirrorWork   = (uint8_t*)malloc(MIRROR_FRAME_BYTES);
+  mirrorMsg    = (uint8_t*)malloc(MIRROR_MSG_MAX);
+  if (!mirrorLock) mirrorLock = xSemaphoreCreateMutex();
+  if (!mirrorObserving) mirrorObserving = display.addFrameObserver(mirrorFrame);
+  if (!mirrorLatest || !mirrorSent || !mirrorWork || !mirrorMsg || !mirrorLock ||
+      !mirrorObserving) {
+    mirrorFreeBuffers();
+    KLOG_ERROR(KLOG_TAG_NET, "Mirror: no memory, disabled");
+    return;
+  }
+  mirrorServer.begin();
+  mirrorServer.setNoDelay(true);
+  if (xTaskCreate(mirrorTaskEntry, "mirror", MIRROR_TASK_STACK, nullptr, 1, &mirrorTask) != pdPASS) {
+    mirrorServer.end();
+    mirrorFreeBuffers();
+    KLOG_ERROR(KLOG_TAG_NET, "Mirror: no task, disabled");
+  }
+}
+
+// From loop() (the observer runs there too, so it can't be copying
+// while the buffers go). The task sees the flag within a poll.
+inline void stopScreenMirror() {
+  if (!mirrorTask) return;
+  mirrorQuit = true;
+  Deadline giveUp = Deadline::after(msecs(MIRROR_REQUEST_WAIT_MS + 2 * MIRROR_ACCEPT_POLL_MS));
+  while (mirrorTask && !giveUp.expired()) vTaskDelay(pdMS_TO_TICKS(10));
+  if (mirrorTask) {
+    KLOG_WARN(KLOG_TAG_NET, "Mirror: task didn't stop, buffers kept");
+    return;
+  }
+  mirrorFreeBuffers();
+}
+
+template<size_t N>
+inline void mirrorStatsJson(FixedString<N> &json) {
+  const MirrorStats &s = mirrorStats;
+  uint32_t frames = s.keyframes + s.deltas;
+  json.appendf("{\"port\":%u,\"viewing\":%s,\"viewers\":%u,\"maxFps\":%u,"
+               "\"keyframes\":%u,\"keyBytes\":%u,\"keyAvg\":%u,\"keyMax\":%u,"
+               "\"deltas\":%u,\"deltaBytes\":%u,\"deltaAvg\":%u,\"deltaMax\":%u,"
+               "\"dirtyPagesAvg10\":%u,\"unchanged\":%u,\"coalesced\":%u,\"sendFails\":%u,"
+               "\"rawBytes\":%u,\"encodeUsAvg\":%u,\"encodeUsMax\":%u,\"observerUsMax\":%u}",
+               (unsigned)MIRROR_PORT, mirrorViewing ? "true" : "false", (unsigned)s.viewers,
+               (unsigned)MIRROR_MAX_FPS, (unsigned)s.keyframes, (unsigned)s.keyBytes,
+               (unsigned)(s.keyframes ? s.keyBytes / s.keyframes : 0), (unsigned)s.keyMax,
+               (unsigned)s.deltas, (unsigned)s.deltaBytes,
+               (unsigned)(s.deltas ? s.deltaBytes / s.deltas : 0), (unsigned)s.deltaMax,
+               (unsigned)(s.deltas ? s.dirtyPages * 10 / s.deltas : 0), (unsigned)s.unchanged,
+               (unsigned)s.coalesced, (unsigned)s.sendFails,
+               (unsigned)(frames * MIRROR_FRAME_BYTES),
+               (unsigned)(frames ? s.encodeUsTotal / frames : 0), (unsigned)s.encodeUsMax,
+               (unsigned)s.observerUsMax);
+}
+
+// -------------------
+// Viewer page
+// -------------------
+const char MIRROR_PAGE[] PROGMEM = R"rawliteral(<!DOCTYPE html>
+<html>
+<head>
+  <title>Knob screen</title>
+  <meta name='viewport' content='width=device-width, initial-scale=1'>
+  <style>
+    body { font-family: Arial; background: #222; color: #ccc; text-align: center; padding: 20px; }
+    canvas { width: 512px; max-width: 100%; image-rendering: pixelated; border: 2px solid #444; }
+  </style>
+</head>
+<body>
+  <canvas id='c' width='128' height='64'></canvas>
+  <p id='s'>connecting...</p>
+  <script>
+    const g = document.getElementById('c').getContext('2d');
+    const s = document.getElementById('s');
+    const f = new Uint8Array(1024);
+    let line = 0, frames = 0, bytes = 0;
+
+    function apply(m) {
+      if (m[0] == 0) f.fill(0);
+      line = m[1] & 63;
+      let i = 5;
+      for (let p = 0; p < 8; p++) {
+        if (!((m[2] >> p) & 1)) continue;
+        const d = p * 128;
+        for (let col = 0; col < 128;) {
+          const t = m[i++];
+          let n;
+          if (t < 128) {
+            n = t + 1;
+          } else if (t < 192) {
+            n = (t & 63) + 1;
+            for (let k = 0; k < n; k++) f[d + col + k] ^= m[i + k];
+            i += n;
+          } else {
+            n = (t & 63) + 2;
+            const b = m[i++];
+            for (let k = 0; k < n; k++) f[d + col + k] ^= b;
+          }
+          col += n;
+        }
+      }
+    }
+
+    function draw() {
+      const img = g.createImageData(128, 64);
+      for (let y = 0; y < 64; y++) {
+        const r = (y + line) & 63;
+        for (let x = 0; x < 128; x++) {
+          const v = (f[(r >> 3) * 128 + x] >> (r & 7)) & 1 ? 255 : 0;
+          const o = (y * 128 + x) * 4;
+          img.data[o] = img.data[o + 1] = img.data[o + 2] = v;
+          img.data[o + 3] = 255;
+        }
+      }
+      g.putImageData(img, 0, 0);
+    }
+
+    async function run() {
+      try {
+        const r = await fetch('http://' + location.hostname + ':81/');
+        const rd = r.body.getReader();
+        let buf = new Uint8Array(0);
+        for (;;) {
+          const { value, done } = await rd.read();
+          if (done) break;
+          const b = new Uint8Array(buf.length + value.length);
+          b.set(buf);
+          b.set(value, buf.length);
+          buf = b;
+          while (buf.length >= 5) {
+            const len = 5 + (buf[3] | (buf[4] << 8));
+            if (buf.length < len) break;
+            apply(buf.subarray(0, len));
+            buf = buf.slice(len);
+            frames++;
+            bytes += len;
+          }
+          draw();
+          s.textContent = frames + ' frames, ' + bytes + ' bytes';
+        }
+      } catch (e) {}
+      s.textContent = 'disconnected, retrying...';
+      setTimeout(run, 2000);
+    }
+    run();
+  </script>
+</body>
+</html>
+)rawliteral";
+
+#endif // SCREEN_MIRROR_H
@@ -0,0 +1,113 @@
+#ifndef SLIDE_TRANSITION_H
+#define SLIDE_TRANSITION_H
+
+#include <Arduino.h>
+#include "rotarycode.h"
+#include "screenlayers.h"
+
+// =============================================================
+// START-LINE SLIDE TRANSITIONS
+// The standby/wake slides used to redraw both screens at an offset
+// and push the whole 1 KB buffer every 15 ms frame. Instead, both
+// screens are rendered once up front, and the slide is done by the
+// SSD1306 display start line: panel row r shows GDDRAM row
+// (r + S) mod 64. If GDDRAM row g holds the outgoing screen's row
+// g on one side of a boundary and the incoming screen's row g on
+// the other, then moving S and the boundary together looks
+// exactly like the two screens sliding. Each frame only rewrites
+// the pages the boundary crossed, plus one start-line command.
+//
+//   SLIDE_DOWN  outgoing moves down, incoming enters from the top
+//               (progress p: S = 64 - p, rows >= 64 - p incoming)
+//   SLIDE_UP    outgoing moves up, incoming enters from the bottom
+//               (progress p: S = p, rows < p incoming)
+// =============================================================
+
+#define SLIDE_ROWS   SCREEN_HEIGHT
+#define SLIDE_PAGES  (SCREEN_HEIGHT / 8)
+
+enum SlideDirection {
+  SLIDE_DOWN,
+  SLIDE_UP
+};
+
+struct SlideStats {
+  uint32_t transitions;
+  uint32_t frames;
+  uint32_t pagesSent;     // GDDRAM pages written by slide frames
+  uint32_t renderUs;      // one-off rendering of both screens
+  uint32_t composeUs;     // per-frame work, summed
+};
+
+SlideStats slideStats = {};
+
+static uint8_t slideFrom[SCREEN_BUFFER_BYTES];   // outgoing screen
+static uint8_t slideTo[SCREEN_BUFFER_BYTES];     // incoming screen
+static SlideDirection slideDirection = SLIDE_DOWN;
+static uint8_t slideBoundary = 0;                 // first row of the second region
+static uint32_t slideRenderStart = 0;
+
+// Bits of a page that show the incoming screen for a boundary.
+inline uint8_t slideIncomingMask(uint8_t page, uint8_t boundary) {
+  int firstRow = page * 8;
+  uint8_t below;   // rows >= boundary
+  if (boundary <= firstRow)          below = 0xFF;
+  else if (boundary >= firstRow + 8) below = 0x00;
+  else                               below = (uint8_t)(0xFF << (boundary - firstRow));
+  return slideDirection == SLIDE_DOWN ? below : (uint8_t)~below;
+}
+
+// Call with the outgoing screen in the buffer, then draw the
+// incoming screen (at offset 0) and call slideBegin().
+inline void slideCaptureFrom() {
+  slideRenderStart = micros();
+  memcpy(slideFrom, display.getBuffer(), SCREEN_BUFFER_BYTES);
+  display.clearDisplay();
+}
+
+inline void slideBegin(SlideDirection direction) {
+  memcpy(slideTo, display.getBuffer(), SCREEN_BUFFER_BYTES);
+  slideDirection = direction;
+  slideBoundary  = (direction == SLIDE_DOWN) ? SLIDE_ROWS : 0;
+
+  // Start from a known GDDRAM state: the outgoing screen, unscrolled
+  memcpy(display.getBuffer(), slideFrom, SCREEN_BUFFER_BYTES);
+  display.displayPages(0, SLIDE_PAGES - 1, 0);
+
+  slideStats.transitions++;
+  slideStats.renderUs += micros() - slideRenderStart;
+}
+
+// progress: rows slid so far, 0..SCREEN_HEIGHT
+inline void slideStep(int progress) {
+  uint32_t start = micros();
+  if (progress < 0) progress = 0;
+  if (progress > SLIDE_ROWS) progress = SLIDE_ROWS;
+
+  uint8_t boundary = (slideDirection == SLIDE_DOWN) ? SLIDE_ROWS - progress : progress;
+  uint8_t lo = min(boundary, slideBoundary);
+  uint8_t hi = max(boundary, slideBoundary);   // rows [lo, hi) changed side
+  slideBoundary = boundary;
+
+  // Always resend the boundary page so the start line has a carrier
+  uint8_t firstPage = min<int>(lo / 8, SLIDE_PAGES - 1);
+  uint8_t lastPage  = (hi > lo) ? (hi - 1) / 8 : firstPage;
+
+  uint8_t* frame = display.getBuffer();
+  for (uint8_t page = firstPage; page <= lastPage; page++) {
+    uint8_t mask = slideIncomingMask(page, boundary);
+    int base = page * SCREEN_WIDTH;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+      frame[base + x] = (slideTo[base + x] & mask) | (slideFrom[base + x] & ~mask);
+    }
+  }
+
+  uint8_t startLine = boundary % SLIDE_ROWS;   // = 64 - p (down) or p (up), mod 64
+  display.displayPages(firstPage, lastPage, startLine);
+
+  slideStats.frames++;
+  slideStats.pagesSent += lastPage - firstPage + 1;
+  slideStats.composeUs += micros() - start;
+}
+
+#endif // SLIDE_TRANSITION_H
@@ -0,0 +1,94 @@
+#ifndef SPAN_FILL_H
+#define SPAN_FILL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// SPAN FILLS ON A PAGE-MAJOR BUFFER
+// The SSD1306 buffer is WIDTH bytes per 8-pixel page, bit 0 the
+// top row of the page. A rectangle is one mask per page applied
+// across its columns: whole bytes for full pages, 32-bit words
+// across the aligned middle of each span.
+//
+// Colours are the SSD1306 ones: 0 black, 1 white, 2 inverse;
+// anything else draws nothing.
+//
+// No Arduino dependencies: FastSSD1306 (fastssd1306.h) draws with
+// these, tools/spanfill.cpp compares them byte for byte with the
+// stock Adafruit column and line loops.
+// =============================================================
+
+#define SPAN_BLACK   0
+#define SPAN_WHITE   1
+#define SPAN_INVERSE 2
+
+// Clip [pos, pos+len) to [0, limit). False if nothing is left.
+inline bool spanClip(int16_t &pos, int16_t &len, int16_t limit) {
+  if (pos < 0) {
+    len += pos;
+    pos = 0;
+  }
+  if (pos + len > limit) len = limit - pos;
+  return len > 0;
+}
+
+struct SpanOpSet   { template<typename T> static T apply(T v, T m) { return v | m; } };
+struct SpanOpClear { template<typename T> static T apply(T v, T m) { return v & ~m; } };
+struct SpanOpFlip  { template<typename T> static T apply(T v, T m) { return v ^ m; } };
+
+// Bytes up to a word boundary, then whole words, then the tail.
+template<typename Op>
+inline void spanApply(uint8_t* p, int16_t len, uint8_t mask) {
+  while (len > 0 && ((uintptr_t)p & 3)) {
+    *p = Op::apply(*p, mask);
+    p++;
+    len--;
+  }
+  uint32_t mask32 = mask * 0x01010101u;
+  uint32_t* word = (uint32_t*)p;
+  for (; len >= 4; len -= 4, word++) {
+    *word = Op::apply(*word, mask32);
+  }
+  p = (uint8_t*)word;
+  while (len-- > 0) {
+    *p = Op::apply(*p, mask);
+    p++;
+  }
+}
+
+// Apply 'mask' in 'color' to len consecutive bytes of one page.
+inline void spanFill(uint8_t* p, int16_t len, uint8_t mask, uint16_t color) {
+  if (mask == 0xFF && (color == SPAN_WHITE || color == SPAN_BLACK)) {
+    memset(p, color == SPAN_WHITE ? 0xFF : 0x00, len);
+    return;
+  }
+  switch (color) {
+    case SPAN_WHITE:   spanApply<SpanOpSet>(p, len, mask);   break;
+    case SPAN_BLACK:   spanApply<SpanOpClear>(p, len, mask); break;
+    case SPAN_INVERSE: spanApply<SpanOpFlip>(p, len, mask);  break;
+  }
+}
+
+inline void spanFillRect(uint8_t* buffer, int16_t width, int16_t height,
+                         int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (!spanClip(x, w, width) || !spanClip(y, h, height)) return;
+
+  int16_t lastY     = y + h - 1;
+  int16_t firstPage = y >> 3;
+  int16_t lastPage  = lastY >> 3;
+  for (int16_t page = firstPage; page <= lastPage; page++) {
+    uint8_t mask = 0xFF;
+    if (page == firstPage) mask &= (uint8_t)(0xFF << (y & 7));
+    if (page == lastPage)  mask &= (uint8_t)(0xFF >> (7 - (lastY & 7)));
+    spanFill(&buffer[page * width + x], w, mask, color);
+  }
+}
+
+inline void spanHLine(uint8_t* buffer, int16_t width, int16_t height,
+                      int16_t x, int16_t y, int16_t w, uint16_t color) {
+  if (y < 0 || y >= height || !spanClip(x, w, width)) return;
+  spanFill(&buffer[(y >> 3) * width + x], w, (uint8_t)(1 << (y & 7)), color);
+}
+
+#endif // SPAN_FILL_H
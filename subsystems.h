@@ -0,0 +1,122 @@
+#ifndef SUBSYSTEMS_H
+#define SUBSYSTEMS_H
+
+#include <Arduino.h>
+#include "customHttpLogging.h"
+#include "fixedstring.h"
+#include "knoblog.h"
+#include "monotime.h"
+
+// =============================================================
+// SUBSYSTEM BRING-UP
+// What boot and the big stacks cost, for GET /api/subsystems:
+//
+//  - boot: time since reset and free heap at each setup() phase,
+//    logged as one line when setup() is done
+//  - BLE (blelogic.h) and the HTTP stack (webserver.h: web server,
+//    mDNS, screen mirror) start on first use rather than at boot,
+//    and may stop again once idle. Each start and stop records how
+//    long it took and the heap it took or gave back, and logs it
+//    through KLOG: they run inside loop(), so no Serial wait there
+//
+// Free heap is read before and after, so anything another task
+// allocated meanwhile lands in the figure: compare several starts
+// rather than trusting one.
+// =============================================================
+
+#define SUBSYS_BOOT_PHASES 10
+
+struct BootPhase {
+  const char* name;
+  uint32_t    atMs;       // since reset
+  uint32_t    freeHeap;
+};
+
+struct Subsystem {
+  const char* name;
+  bool        up;
+  uint32_t    starts;
+  uint32_t    stops;
+  uint32_t    startMs;       // last start
+  int32_t     startHeap;     // bytes the last start took
+  int32_t     stopHeap;      // bytes the last stop gave back
+  uint32_t    heapBefore;    // free heap as the current start/stop began
+  MonoTime    began;
+  MonoTime    upSince;
+};
+
+BootPhase bootPhases[SUBSYS_BOOT_PHASES];
+uint8_t   bootPhaseCount = 0;
+uint32_t  bootDoneMs     = 0;
+uint32_t  bootDoneHeap   = 0;
+
+// At the start of each setup() phase
+inline void bootPhase(const char* name) {
+  if (bootPhaseCount == SUBSYS_BOOT_PHASES) return;
+  bootPhases[bootPhaseCount++] = { name, (uint32_t)monoNow().ms(), ESP.getFreeHeap() };
+}
+
+inline void subsysStartBegin(Subsystem &s) {
+  s.heapBefore = ESP.getFreeHeap();
+  s.began      = monoNow();
+}
+
+inline void subsysStartDone(Subsystem &s) {
+  s.up        = true;
+  s.starts++;
+  s.startMs   = (uint32_t)since(s.began).toMs();
+  s.startHeap = (int32_t)s.heapBefore - (int32_t)ESP.getFreeHeap();
+  s.upSince   = monoNow();
+  KLOG_INFO(KLOG_TAG_SYS, "SUBSYS: %s up in %u ms, took %ld bytes", s.name, (unsigned)s.startMs,
+            (long)s.startHeap);
+}
+
+inline void subsysStopBegin(Subsystem &s) {
+  s.heapBefore = ESP.getFreeHeap();
+}
+
+inline void subsysStopDone(Subsystem &s) {
+  s.up       = false;
+  s.stops++;
+  s.stopHeap = (int32_t)ESP.getFreeHeap() - (int32_t)s.heapBefore;
+  KLOG_INFO(KLOG_TAG_SYS, "SUBSYS: %s down after %u s, gave back %ld bytes", s.name,
+            (unsigned)(since(s.upSince) / 1_s), (long)s.stopHeap);
+}
+
+template<size_t N>
+inline void subsysJson(FixedString<N> &json, const Subsystem &s) {
+  json.appendf("\"%s\":{\"up\":%s,\"starts\":%u,\"stops\":%u,\"startMs\":%u,"
+               "\"startHeap\":%ld,\"stopHeap\":%ld,\"upS\":%u}",
+               s.name, s.up ? "true" : "false", (unsigned)s.starts, (unsigned)s.stops,
+               (unsigned)s.startMs, (long)s.startHeap, (long)s.stopHeap,
+               s.up ? (unsigned)(since(s.upSince) / 1_s) : 0u);
+}
+
+template<size_t N>
+inline void bootPhasesJson(FixedString<N> &json) {
+  json.appendf("\"boot\":{\"ms\":%u,\"freeHeap\":%u,\"phases\":[",
+               (unsigned)bootDoneMs, (unsigned)bootDoneHeap);
+  for (uint8_t i = 0; i < bootPhaseCount; i++) {
+    json.appendf("%s{\"name\":\"%s\",\"ms\":%u,\"freeHeap\":%u}", i ? "," : "",
+                 bootPhases[i].name, (unsigned)bootPhases[i].atMs, (unsigned)bootPhases[i].freeHeap);
+  }
+  json.append("]}");
+}
+
+// End of setup(): one line with where the time and the heap went
+inline void bootReport(const Subsystem &ble, const Subsystem &http) {
+  bootDoneMs   = (uint32_t)monoNow().ms();
+  bootDoneHeap = ESP.getFreeHeap();
+  FixedString<320> line;
+  for (uint8_t i = 0; i < bootPhaseCount; i++) {
+    uint32_t endMs   = i + 1 < bootPhaseCount ? bootPhases[i + 1].atMs : bootDoneMs;
+    uint32_t endHeap = i + 1 < bootPhaseCount ? bootPhases[i + 1].freeHeap : bootDoneHeap;
+    line.appendf("%s%s %ums/%ldB", i ? ", " : "", bootPhases[i].name,
+                 (unsigned)(endMs - bootPhases[i].atMs),
+                 (long)bootPhases[i].freeHeap - (long)endHeap);
+  }
+  printLogf("BOOT: %u ms, free=%u, ble=%s, http=%s: %s", (unsigned)bootDoneMs,
+            (unsigned)bootDoneHeap, ble.up ? "up" : "lazy", http.up ? "up" : "lazy", line.c_str());
+}
+
+#endif // SUBSYSTEMS_H
@@ -0,0 +1,257 @@
+#ifndef TIMER_SERVICE_H
+#define TIMER_SERVICE_H
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include <time.h>
+#include "globals.h"
+#include "fixedstring.h"
+#include "timerwheel.h"
+#include "knoblog.h"
+#include "monotime.h"
+
+// =============================================================
+// TIMER SERVICE
+// Every countdown and alarm on the knob lives in one timing wheel
+// (timerwheel.h), advanced once per loop() pass whatever mode is
+// in front. The Timer mode's countdown is one entry; more can be
+// created over HTTP; the hourly chime is a recurring entry.
+//
+// Wall-clock entries (alarms at HH:MM, the chime) are kept on
+// monotonic time like the rest and re-aimed by a once-a-minute
+// clock watch if NTP moves the clock, so they still fire at the
+// right minute after a sync or a long time offline.
+//
+// A firing countdown or alarm only raises timerAlarmPending; loop()
+// switches to the TIME UP screen when no animation is running.
+// =============================================================
+
+#define TIMER_POOL_SIZE       32
+#define TIMER_LABEL_MAX       13     // 12 chars + NUL, fits the alarm screen
+#define TIMER_CLOCK_WATCH_MS  60000
+#define TIMER_WALL_DRIFT_MS   2000   // re-aim wall-clock entries beyond this
+#define TIMER_HOUR_MS         3600000UL
+#define TIMER_DAY_MS          86400000UL
+
+enum TimerKind : uint8_t {
+  TIMER_KIND_KNOB = 1,      // the Timer mode's countdown
+  TIMER_KIND_COUNTDOWN,     // created over HTTP
+  TIMER_KIND_ALARM,         // wall clock HH:MM
+  TIMER_KIND_CHIME,         // top of every hour
+  TIMER_KIND_CLOCK_WATCH
+};
+
+const char* const timerKindNames[] = { "", "knob", "countdown", "alarm", "chime", "watch" };
+
+struct TimerExtra {
+  char    label[TIMER_LABEL_MAX];
+  int16_t minuteOfDay;      // ALARM: local minute it rings at
+};
+
+TimerWheel<TIMER_POOL_SIZE> timerWheel;
+TimerExtra timerExtra[TIMER_POOL_SIZE];
+
+TimerId chimeTimerId = 0;
+
+bool timerAlarmPending = false;
+char timerAlarmLabel[TIMER_LABEL_MAX] = "";
+
+uint32_t timerAdvanceUsMax = 0;
+
+extern void playHourlyChime();
+
+inline uint64_t timerNowMs() {
+  return monoNow().ms();
+}
+
+// Printable and JSON-safe: labels come in over HTTP
+inline void copyTimerLabel(char* dst, const char* src) {
+  size_t n = 0;
+  for (; *src && n < TIMER_LABEL_MAX - 1; src++) {
+    if (*src >= ' ' && *src <= '~' && *src != '"' && *src != '\\') dst[n++] = *src;
+  }
+  dst[n] = '\0';
+}
+
+// -------------------
+// Wall clock
+// -------------------
+inline bool wallClockValid() {
+  return time(nullptr) > 1600000000;   // set by NTP, not the 1970 default
+}
+
+// ms from now to the next local secondOfDay (a day ahead if it's now)
+inline uint64_t msUntilSecondOfDay(uint32_t secondOfDay) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  struct tm local;
+  time_t secs = tv.tv_sec;
+  localtime_r(&secs, &local);
+  int32_t into  = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+  int32_t delta = (int32_t)secondOfDay - into;
+  if (delta <= 0) delta += 86400;
+  return (uint64_t)delta * 1000 - tv.tv_usec / 1000;
+}
+
+inline uint64_t msUntilNextHour() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  struct tm local;
+  time_t secs = tv.tv_sec;
+  localtime_r(&secs, &local);
+  return (uint64_t)(3600 - local.tm_min * 60 - local.tm_sec) * 1000 - tv.tv_usec / 1000;
+}
+
+// Where a wall-clock entry should be due, or 0 if it isn't one
+inline uint64_t wallClockDeadlineMs(const TimerNode &n, uint16_t index) {
+  if (n.kind == TIMER_KIND_CHIME) return timerNowMs() + msUntilNextHour();
+  if (n.kind == TIMER_KIND_ALARM) {
+    return timerNowMs() + msUntilSecondOfDay(timerExtra[index].minuteOfDay * 60);
+  }
+  return 0;
+}
+
+// Arm the chime once there is a clock; re-aim anything that drifted.
+inline void syncWallClockTimers() {
+  if (!wallClockValid()) return;
+  if (!timerWheel.find(chimeTimerId)) {
+    chimeTimerId = timerWheel.schedule(timerNowMs() + msUntilNextHour(), TIMER_HOUR_MS,
+                                       TIMER_KIND_CHIME, 0);
+    if (chimeTimerId) copyTimerLabel(timerExtra[timerWheel.poolIndex(chimeTimerId)].label, "Chime");
+  }
+  timerWheel.forEach([](TimerId id, const TimerNode &n) {
+    uint64_t want = wallClockDeadlineMs(n, timerWheel.poolIndex(id));
+    if (!want) return;
+    uint64_t due = timerWheel.deadlineMs(n);
+    if (due <= timerNowMs() + TIMER_WALL_DRIFT_MS) return;   // about to ring: let it
+    int64_t off = (int64_t)due - (int64_t)want;
+    if (off > TIMER_WALL_DRIFT_MS || off < -TIMER_WALL_DRIFT_MS) {
+      KLOG_INFO(KLOG_TAG_TIMER, "Timers: %s %u re-aimed by %lld ms", timerKindNames[n.kind],
+                (unsigned)id, (long long)-off);
+      timerWheel.reschedule(id, want);
+    }
+  });
+}
+
+// -------------------
+// Firing
+// -------------------
+inline void raiseTimerAlarm(const char* label) {
+  strcpy(timerAlarmLabel, label);
+  timerAlarmPending = true;
+}
+
+inline void onTimerFired(TimerId id, const TimerNode &n) {
+  const TimerExtra &extra = timerExtra[timerWheel.poolIndex(id)];
+  switch (n.kind) {
+    case TIMER_KIND_KNOB:
+      knobTimerId = 0;
+      raiseTimerAlarm(extra.label);
+      break;
+    case TIMER_KIND_COUNTDOWN:
+    case TIMER_KIND_ALARM:
+      raiseTimerAlarm(extra.label);
+      break;
+    case TIMER_KIND_CHIME:
+      playHourlyChime();
+      KLOG_INFO(KLOG_TAG_TIMER, "Hourly chime");
+      break;
+    case TIMER_KIND_CLOCK_WATCH:
+      syncWallClockTimers();
+      break;
+  }
+}
+
+// Once per loop() pass
+inline void timerServiceTick() {
+  uint32_t start = micros();
+  timerWheel.advance(timerNowMs(), onTimerFired);
+  uint32_t took = micros() - start;
+  if (took > timerAdvanceUsMax) timerAdvanceUsMax = took;
+}
+
+// How long standby may sleep before the earliest deadline
+inline uint32_t timerServiceIdleMs() {
+  uint64_t next = timerWheel.nextExpiryMs();
+  if (next == UINT64_MAX) return UINT32_MAX;
+  uint64_t now = timerNowMs();
+  if (next <= now) return 0;
+  return next - now > UINT32_MAX ? UINT32_MAX : (uint32_t)(next - now);
+}
+
+// -------------------
+// Creating and cancelling
+// -------------------
+inline TimerId startCountdown(uint32_t ms, uint32_t repeatMs, const char* label,
+                              TimerKind kind = TIMER_KIND_COUNTDOWN) {
+  TimerId id = timerWheel.schedule(timerNowMs() + ms, repeatMs, kind, 0);
+  if (!id) return 0;
+  TimerExtra &extra = timerExtra[timerWheel.poolIndex(id)];
+  copyTimerLabel(extra.label, label);
+  extra.minuteOfDay = -1;
+  return id;
+}
+
+// Rings at local hh:mm; daily repeats. 0 without a clock or room.
+inline TimerId startAlarm(int minuteOfDay, bool daily, const char* label) {
+  if (!wallClockValid() || minuteOfDay < 0 || minuteOfDay >= 24 * 60) return 0;
+  TimerId id = timerWheel.schedule(timerNowMs() + msUntilSecondOfDay(minuteOfDay * 60),
+                                   daily ? TIMER_DAY_MS : 0, TIMER_KIND_ALARM, 0);
+  if (!id) return 0;
+  TimerExtra &extra = timerExtra[timerWheel.poolIndex(id)];
+  copyTimerLabel(extra.label, label);
+  extra.minuteOfDay = minuteOfDay;
+  return id;
+}
+
+inline bool cancelTimer(TimerId id) {
+  if (id == knobTimerId) knobTimerId = 0;
+  return timerWheel.cancel(id);
+}
+
+// Time left, or -1 if the id is gone (fired or cancelled)
+inline int64_t timerRemainingMs(TimerId id) {
+  const TimerNode* n = timerWheel.find(id);
+  if (!n) return -1;
+  int64_t left = (int64_t)timerWheel.deadlineMs(*n) - (int64_t)timerNowMs();
+  return left > 0 ? left : 0;
+}
+
+// {"timers":[{"id":..,"kind":"..","label":"..","inMs":..,"everyMs":..,"at":"07:30"},...],...}
+template<size_t N>
+inline void timersJson(FixedString<N> &json) {
+  json.append("{\"timers\":[");
+  bool first = true;
+  uint64_t now = timerNowMs();
+  timerWheel.forEach([&](TimerId id, const TimerNode &n) {
+    if (n.kind == TIMER_KIND_CLOCK_WATCH) return;
+    const TimerExtra &extra = timerExtra[timerWheel.poolIndex(id)];
+    uint64_t due = timerWheel.deadlineMs(n);
+    json.appendf("%s{\"id\":%u,\"kind\":\"%s\",\"label\":\"%s\",\"inMs\":%llu,\"everyMs\":%u",
+                 first ? "" : ",", (unsigned)id, timerKindNames[n.kind], extra.label,
+                 (unsigned long long)(due > now ? due - now : 0),
+                 (unsigned)(n.period * TIMER_WHEEL_TICK_MS));
+    if (n.kind == TIMER_KIND_ALARM) {
+      json.appendf(",\"at\":\"%02d:%02d\"", extra.minuteOfDay / 60, extra.minuteOfDay % 60);
+    }
+    json.append('}');
+    first = false;
+  });
+  const TimerWheelStats &st = timerWheel.stats();
+  json.appendf("],\"capacity\":%u,\"active\":%u,\"maxActive\":%u,\"scheduled\":%u,"
+               "\"fired\":%u,\"cancelled\":%u,\"cascaded\":%u,\"poolFull\":%u,"
+               "\"advanceUsMax\":%u,\"clock\":%s}",
+               (unsigned)timerWheel.capacity(), (unsigned)st.active, (unsigned)st.maxActive,
+               (unsigned)st.scheduled, (unsigned)st.fired, (unsigned)st.cancelled,
+               (unsigned)st.cascaded, (unsigned)st.poolFull, (unsigned)timerAdvanceUsMax,
+               wallClockValid() ? "true" : "false");
+}
+
+inline void initTimerService() {
+  timerWheel.begin(timerNowMs());
+  timerWheel.schedule(timerNowMs() + TIMER_CLOCK_WATCH_MS, TIMER_CLOCK_WATCH_MS,
+                      TIMER_KIND_CLOCK_WATCH, 0);
+  syncWallClockTimers();
+}
+
+#endif // TIMER_SERVICE_H
@@ -0,0 +1,313 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// HIERARCHICAL TIMING WHEEL
+// Many concurrent timers over a fixed node pool: O(1) schedule and
+// cancel, and advance() costs the same whatever the number of
+// timers waiting — only due slots are touched.
+//
+// Time is counted in ticks of TIMER_WHEEL_TICK_MS. Four levels of
+// 64 slots cover 64^4 ticks (~46 h at 10 ms); a timer sits in the
+// level of the highest tick digit where it differs from "now", and
+// drops one level each time that slot comes round (a cascade).
+// Anything further out waits in an overflow list that is re-filed
+// every top-level rotation.
+//
+// Per-level occupancy bitmaps let advance() jump over empty ticks
+// (a sleeping device catches up in one call) and nextExpiryMs()
+// give the exact earliest deadline, so the caller can sleep until
+// then and wake once.
+//
+// No Arduino dependencies: timerservice.h runs it on the device,
+// tools/timersim.cpp drives it with thousands of timers.
+// =============================================================
+
+#define TIMER_WHEEL_TICK_MS  10
+#define TIMER_WHEEL_LEVELS   4
+#define TIMER_WHEEL_BITS     6
+#define TIMER_WHEEL_SLOTS    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_SPAN_BITS (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)
+
+// Index + 16-bit generation, so a stale id never cancels a reused
+// node. 0 is never a valid id.
+typedef uint32_t TimerId;
+
+struct TimerNode {
+  uint64_t expires;   // tick
+  uint32_t period;    // ticks, 0 = one-shot
+  uint32_t arg;       // owner's data
+  uint16_t next, prev;
+  uint16_t gen;
+  uint16_t where;     // list the node is on
+  uint8_t  kind;      // owner's type, 0 = free
+};
+
+struct TimerWheelStats {
+  uint32_t scheduled;
+  uint32_t cancelled;
+  uint32_t fired;
+  uint32_t cascaded;    // node moves between levels
+  uint32_t ticks;       // ticks with work (cascade or expiry)
+  uint16_t active;
+  uint16_t maxActive;
+  uint16_t poolFull;
+};
+
+template<uint16_t Capacity>
+class TimerWheel {
+  static_assert(Capacity > 0 && Capacity < 0xFFFF, "pool indices are 16-bit");
+
+ public:
+  static constexpr uint16_t NIL = 0xFFFF;
+
+  void begin(uint64_t nowMs) {
+    memset(heads_, 0xFF, sizeof(heads_));
+    memset(occupied_, 0, sizeof(occupied_));
+    memset(&stats_, 0, sizeof(stats_));
+    freeHead_ = NIL;
+    for (uint16_t i = Capacity; i-- > 0;) {
+      nodes_[i].kind = 0;
+      nodes_[i].gen  = 1;
+      nodes_[i].next = freeHead_;
+      freeHead_      = i;
+    }
+    cur_ = nowMs / TIMER_WHEEL_TICK_MS;
+  }
+
+  // Fire at atMs (late deadlines fire on the next advance), then
+  // every periodMs if non-zero. kind must be non-zero. 0 when the
+  // pool is full.
+  TimerId schedule(uint64_t atMs, uint32_t periodMs, uint8_t kind, uint32_t arg) {
+    if (freeHead_ == NIL) {
+      stats_.poolFull++;
+      return 0;
+    }
+    uint16_t i = freeHead_;
+    freeHead_  = nodes_[i].next;
+    TimerNode &n = nodes_[i];
+    n.expires = (atMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    n.period  = periodMs ? (periodMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS : 0;
+    n.arg     = arg;
+    n.kind    = kind;
+    file(i);
+    stats_.scheduled++;
+    if (++stats_.active > stats_.maxActive) stats_.maxActive = stats_.active;
+    return idOf(i);
+  }
+
+  bool cancel(TimerId id) {
+    uint16_t i = indexOf(id);
+    if (i == NIL) return false;
+    unlink(i);
+    release(i);
+    stats_.cancelled++;
+    return true;
+  }
+
+  // Move a live timer to a new deadline, keeping its id.
+  bool reschedule(TimerId id, uint64_t atMs) {
+    uint16_t i = indexOf(id);
+    if (i == NIL) return false;
+    unlink(i);
+    nodes_[i].expires = (atMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    file(i);
+    return true;
+  }
+
+  // Pool slot of a live id (0..Capacity-1) for per-timer side data
+  static uint16_t poolIndex(TimerId id) { return (uint16_t)(id & 0xFFFF); }
+
+  const TimerNode* find(TimerId id) const {
+    uint16_t i = indexOf(id);
+    return i == NIL ? nullptr : &nodes_[i];
+  }
+
+  uint64_t deadlineMs(const TimerNode &n) const { return n.expires * TIMER_WHEEL_TICK_MS; }
+
+  // Walk active timers (unordered): fn(TimerId, const TimerNode&)
+  template<class Fn>
+  void forEach(Fn fn) const {
+    for (uint16_t i = 0; i < Capacity; i++) {
+      if (nodes_[i].kind) fn(idOf(i), nodes_[i]);
+    }
+  }
+
+  // Run every timer due by nowMs: fn(TimerId, const TimerNode&).
+  // A one-shot is freed before its callback, a periodic one already
+  // re-armed, so the callback may schedule or cancel freely.
+  // Returns the number fired.
+  template<class Fn>
+  uint16_t advance(uint64_t nowMs, Fn fire) {
+    uint64_t now = nowMs / TIMER_WHEEL_TICK_MS;
+    uint16_t fired = 0;
+    while (cur_ <= now) {
+      uint64_t t = nextWorkTick();
+      if (t > now) {
+        cur_ = now + 1;   // nothing due in between: skip it
+        break;
+      }
+      fired += runTick(t, fire);
+    }
+    return fired;
+  }
+
+  // Earliest deadline (ms), or UINT64_MAX with nothing scheduled.
+  uint64_t nextExpiryMs() const {
+    uint64_t best = UINT64_MAX;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+      uint64_t pending = occupied_[level] >> digit(cur_, level);
+      if (!pending) continue;
+      uint16_t slot = level * TIMER_WHEEL_SLOTS + digit(cur_, level) + __builtin_ctzll(pending);
+      // The first busy slot of a level holds that level's earliest
+      for (uint16_t i = heads_[slot]; i != NIL; i = nodes_[i].next) {
+        if (nodes_[i].expires < best) best = nodes_[i].expires;
+      }
+    }
+    for (uint16_t i = heads_[OVERFLOW]; i != NIL; i = nodes_[i].next) {
+      if (nodes_[i].expires < best) best = nodes_[i].expires;
+    }
+    return best == UINT64_MAX ? best : best * TIMER_WHEEL_TICK_MS;
+  }
+
+  const TimerWheelStats &stats() const { return stats_; }
+  static constexpr uint16_t capacity() { return Capacity; }
+
+ private:
+  static constexpr uint16_t OVERFLOW = TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS;
+  static constexpr uint64_t DIGIT_MASK = TIMER_WHEEL_SLOTS - 1;
+
+  static uint8_t digit(uint64_t tick, uint8_t level) {
+    return (uint8_t)((tick >> (level * TIMER_WHEEL_BITS)) & DIGIT_MASK);
+  }
+
+  TimerId idOf(uint16_t i) const { return ((TimerId)nodes_[i].gen << 16) | i; }
+
+  uint16_t indexOf(TimerId id) const {
+    uint16_t i = (uint16_t)(id & 0xFFFF);
+    if (i >= Capacity || !nodes_[i].kind || nodes_[i].gen != (uint16_t)(id >> 16)) return NIL;
+    return i;
+  }
+
+  // Put node i on the list its deadline belongs to, relative to cur_.
+  void file(uint16_t i) {
+    TimerNode &n = nodes_[i];
+    if (n.expires < cur_) n.expires = cur_;
+    uint64_t diff = n.expires ^ cur_;
+    uint16_t where;
+    if (diff >> TIMER_WHEEL_SPAN_BITS) {
+      where = OVERFLOW;
+    } else {
+      uint8_t level = diff ? (63 - __builtin_clzll(diff)) / TIMER_WHEEL_BITS : 0;
+      where = level * TIMER_WHEEL_SLOTS + digit(n.expires, level);
+      occupied_[level] |= 1ULL << digit(n.expires, level);
+    }
+    n.where = where;
+    n.prev  = NIL;
+    n.next  = heads_[where];
+    if (n.next != NIL) nodes_[n.next].prev = i;
+    heads_[where] = i;
+  }
+
+  void unlink(uint16_t i) {
+    TimerNode &n = nodes_[i];
+    if (n.prev != NIL) nodes_[n.prev].next = n.next;
+    else               heads_[n.where] = n.next;
+    if (n.next != NIL) nodes_[n.next].prev = n.prev;
+    if (n.where != OVERFLOW && heads_[n.where] == NIL) {
+      occupied_[n.where / TIMER_WHEEL_SLOTS] &= ~(1ULL << (n.where % TIMER_WHEEL_SLOTS));
+    }
+  }
+
+  void release(uint16_t i) {
+    TimerNode &n = nodes_[i];
+    n.kind = 0;
+    if (++n.gen == 0) n.gen = 1;
+    n.next    = freeHead_;
+    freeHead_ = i;
+    stats_.active--;
+  }
+
+  // First tick >= cur_ with a cascade or an expiry to do.
+  uint64_t nextWorkTick() const {
+    uint64_t best = UINT64_MAX;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+      uint8_t shift = level * TIMER_WHEEL_BITS;
+      uint64_t pending = occupied_[level] >> digit(cur_, level);
+      if (!pending) continue;
+      uint64_t slot = digit(cur_, level) + __builtin_ctzll(pending);
+      uint64_t base = cur_ >> (shift + TIMER_WHEEL_BITS) << (shift + TIMER_WHEEL_BITS);
+      uint64_t t    = base | (slot << shift);
+      if (t < cur_) t = cur_;
+      if (t < best) best = t;
+    }
+    if (heads_[OVERFLOW] != NIL) {
+      uint64_t wrap = ((cur_ >> TIMER_WHEEL_SPAN_BITS) + 1) << TIMER_WHEEL_SPAN_BITS;
+      if (wrap < best) best = wrap;
+    }
+    return best;
+  }
+
+  // Move everything on list 'where' down, relative to cur_ == t.
+  void refile(uint16_t where) {
+    uint16_t i = heads_[where];
+    heads_[where] = NIL;
+    if (where != OVERFLOW) {
+      occupied_[where / TIMER_WHEEL_SLOTS] &= ~(1ULL << (where % TIMER_WHEEL_SLOTS));
+    }
+    while (i != NIL) {
+      uint16_t next = nodes_[i].next;
+      file(i);
+      stats_.cascaded++;
+      i = next;
+    }
+  }
+
+  template<class Fn>
+  uint16_t runTick(uint64_t t, Fn &fire) {
+    cur_ = t;
+    stats_.ticks++;
+    // Highest level first, so nodes can fall more than one level
+    if ((t & ((1ULL << TIMER_WHEEL_SPAN_BITS) - 1)) == 0) refile(OVERFLOW);
+    for (uint8_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+      if (t & ((1ULL << (level * TIMER_WHEEL_BITS)) - 1)) continue;
+      refile(level * TIMER_WHEEL_SLOTS + digit(t, level));
+    }
+
+    // New deadlines from callbacks land from t + 1 on, never in the
+    // slot being drained
+    cur_ = t + 1;
+    uint16_t slot  = digit(t, 0);
+    uint16_t fired = 0;
+    while (heads_[slot] != NIL) {
+      uint16_t i = heads_[slot];
+      unlink(i);
+      TimerNode &n = nodes_[i];
+      TimerId id = idOf(i);
+      stats_.fired++;
+      fired++;
+      if (n.period) {
+        n.expires += n.period;
+        file(i);
+        fire(id, (const TimerNode&)n);
+      } else {
+        TimerNode copy = n;
+        release(i);
+        fire(id, (const TimerNode&)copy);
+      }
+    }
+    return fired;
+  }
+
+  TimerNode       nodes_[Capacity];
+  uint16_t        heads_[OVERFLOW + 1];
+  uint64_t        occupied_[TIMER_WHEEL_LEVELS];
+  uint16_t        freeHead_ = NIL;
+  uint64_t        cur_      = 0;   // next tick to run
+  TimerWheelStats stats_    = {};
+};
+
+#endif // TIMER_WHEEL_H
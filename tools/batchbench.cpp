@@ -0,0 +1,341 @@
+// =============================================================
+// batchbench — one batched request vs. the same work endpoint by endpoint
+//
+//   g++ -O2 -std=c++17 -Wall -pthread -o batchbench tools/batchbench.cpp
+//   ./batchbench [-H host] [-p port] [-n runs]   (default knobcontroller.local, 80, 20)
+//   ./batchbench --sim [-n runs] [--sim-serve-us us] [--sim-ui-us us]
+//
+// Runs against a real knob on the LAN. Each run does one small
+// automation twice and times it end to end:
+//
+//   separate:  stopwatch start, create a timer, stopwatch stop, then
+//              read back /api/timers, /api/heap and /api/power
+//   batched:   POST /api/batch with the three commands, then
+//              GET /api/state
+//
+// The timer each run creates is cancelled afterwards (not timed).
+// Every request is a fresh connection, as the knob's WebServer
+// closes it after each response. Prints the median and worst
+// wall-clock time of each, and how many round trips they took.
+//
+// --sim serves a stand-in on 127.0.0.1 shaped like the firmware
+// (as loadtest --sim does): one loop thread that serves at most one
+// request per pass (WebServer::handleClient), --sim-serve-us per
+// request, then --sim-ui-us of UI work and delay(10). It answers
+// the endpoints above with the firmware's JSON shapes and parses
+// batches line by line. What it shows is the round-trip cost of
+// the single-threaded server; absolute numbers are this machine's.
+// =============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char* host = "knobcontroller.local";
+static const char* port = "80";
+static addrinfo*   addr = nullptr;
+
+typedef std::chrono::steady_clock Clock;
+
+// -------------------
+// Stand-in knob (--sim)
+// -------------------
+struct SimKnob {
+  int       listenFd = -1;
+  uint16_t  port     = 0;
+  unsigned  uiUs     = 1000;
+  unsigned  serveUs  = 2000;   // handler + send, per request
+  unsigned  nextTimer = 1;
+  unsigned  activeTimers = 0;
+  bool      stopwatch = false;
+  std::atomic<bool> stop{ false };
+  std::thread loopThread;
+  char      portText[8] = "";
+};
+
+static void busyFor(unsigned us) {
+  Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+  while (Clock::now() < end) {
+  }
+}
+
+// POST /api/batch: the firmware's result shape, one entry per line
+static std::string simBatch(SimKnob &k, const std::string &body) {
+  std::string results;
+  size_t count = 0, start = 0;
+  for (size_t i = 0; i <= body.size(); i++) {
+    if (i < body.size() && body[i] != '\n' && body[i] != ';') continue;
+    std::string line = body.substr(start, i - start);
+    start = i + 1;
+    if (line.empty()) continue;
+    std::string verb = line.substr(0, line.find(' '));
+    results += std::string(count++ ? "," : "") + "{\"cmd\":\"" + verb + "\",\"ok\":true";
+    if (verb == "timer") {
+      results += ",\"id\":" + std::to_string(k.nextTimer++);
+      k.activeTimers++;
+    } else if (verb == "stopwatch") {
+      k.stopwatch = line.find("start") != std::string::npos;
+    }
+    results += "}";
+  }
+  return "{\"applied\":true,\"applyUs\":40,\"results\":[" + results + "]}";
+}
+
+// One handleClient(): at most one waiting connection, served to the end
+static void simHandleClient(SimKnob &k) {
+  int fd = accept(k.listenFd, nullptr, nullptr);
+  if (fd < 0) return;
+  timeval tv = { 2, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string req;
+  char buf[512];
+  size_t split;
+  while ((split = req.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    req.append(buf, n);
+  }
+  size_t want = 0;
+  size_t cl = req.find("Content-Length: ");
+  if (cl != std::string::npos) want = strtoul(req.c_str() + cl + 16, nullptr, 10);
+  while (split != std::string::npos && req.size() < split + 4 + want) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    req.append(buf, n);
+  }
+  std::string method = req.substr(0, req.find(' '));
+  size_t p0 = req.find(' ') + 1;
+  std::string path = req.substr(p0, req.find(' ', p0) - p0);
+  std::string payload = split == std::string::npos ? std::string() : req.substr(split + 4);
+
+  std::string status = "200 OK", body;
+  if (path == "/api/stopwatch/start" || path == "/api/stopwatch/stop") {
+    k.stopwatch = path == "/api/stopwatch/start";
+    body = "{\"ok\":true}";
+  } else if (path.compare(0, 11, "/api/timers") == 0 && method == "POST") {
+    body = "{\"id\":" + std::to_string(k.nextTimer++) + "}";
+    k.activeTimers++;
+  } else if (path.compare(0, 11, "/api/timers") == 0 && method == "DELETE") {
+    if (k.activeTimers) k.activeTimers--;
+    body = "{\"ok\":true}";
+  } else if (path == "/api/timers") {
+    body = "{\"active\":" + std::to_string(k.activeTimers) + ",\"timers\":[]}";
+  } else if (path == "/api/heap") {
+    body = "{\"free\":181240,\"largest\":110580,\"fragPct\":38,\"minFree\":170112,"
+           "\"bootFree\":196400,\"worstFragPct\":41}";
+  } else if (path == "/api/power") {
+    body = "{\"standby\":false,\"passes\":0,\"wakes\":0}";
+  } else if (path == "/api/batch" && method == "POST") {
+    body = simBatch(k, payload);
+  } else if (path == "/api/state") {
+    body = std::string("{\"mode\":\"menu\",\"stopwatch\":{\"running\":") +
+           (k.stopwatch ? "true" : "false") + "},\"timer\":{\"active\":" +
+           std::to_string(k.activeTimers) + "}}";
+  } else {
+    status = "404 Not Found";
+    body   = "Not Found";
+  }
+  busyFor(k.serveUs);
+  std::string resp = "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                     std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+  send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+  close(fd);
+}
+
+static void simLoop(SimKnob &k) {
+  while (!k.stop) {
+    simHandleClient(k);   // server.handleClient()
+    busyFor(k.uiUs);      // the state machine and drawing
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));   // delay(10)
+  }
+}
+
+static bool simStart(SimKnob &k) {
+  k.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(k.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port        = 0;
+  socklen_t len = sizeof(a);
+  if (bind(k.listenFd, (sockaddr*)&a, sizeof(a)) != 0 || listen(k.listenFd, 16) != 0 ||
+      getsockname(k.listenFd, (sockaddr*)&a, &len) != 0) {
+    perror("sim");
+    return false;
+  }
+  fcntl(k.listenFd, F_SETFL, O_NONBLOCK);
+  k.port = ntohs(a.sin_port);
+  snprintf(k.portText, sizeof(k.portText), "%u", (unsigned)k.port);
+  k.loopThread = std::thread(simLoop, std::ref(k));
+  return true;
+}
+
+static void simStop(SimKnob &k) {
+  k.stop = true;
+  k.loopThread.join();
+  close(k.listenFd);
+}
+
+// -------------------
+// Client
+// -------------------
+// One HTTP/1.0 request; returns the status (0 on a socket error), body in 'body'
+static int request(const char* method, const std::string &path, const std::string &payload,
+                   std::string &body) {
+  int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (fd < 0) return 0;
+  if (connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+    close(fd);
+    return 0;
+  }
+  std::string req = std::string(method) + " " + path + " HTTP/1.0\r\nHost: " + host +
+                    "\r\nConnection: close\r\n";
+  if (!payload.empty()) {
+    // text/plain: a form-encoded body never reaches the handler
+    req += "Content-Type: text/plain\r\nContent-Length: " + std::to_string(payload.size()) + "\r\n";
+  }
+  req += "\r\n" + payload;
+  if (send(fd, req.data(), req.size(), 0) != (ssize_t)req.size()) {
+    close(fd);
+    return 0;
+  }
+  std::string resp;
+  char buf[1024];
+  for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;) resp.append(buf, n);
+  close(fd);
+
+  size_t split = resp.find("\r\n\r\n");
+  body = split == std::string::npos ? std::string() : resp.substr(split + 4);
+  int status = 0;
+  if (sscanf(resp.c_str(), "HTTP/%*s %d", &status) != 1) return 0;
+  return status;
+}
+
+// Every "id":N in a response, in order
+static std::vector<unsigned> ids(const std::string &json) {
+  std::vector<unsigned> out;
+  for (size_t at = 0; (at = json.find("\"id\":", at)) != std::string::npos; at += 5) {
+    out.push_back(strtoul(json.c_str() + at + 5, nullptr, 10));
+  }
+  return out;
+}
+
+static double msSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool check(int status, const char* what) {
+  if (status >= 200 && status < 300) return true;
+  fprintf(stderr, "%s failed (status %d)\n", what, status);
+  return false;
+}
+
+// Returns the timer to cancel afterwards, or 0 on failure
+static unsigned runSeparate(double &ms) {
+  std::string body;
+  unsigned timer = 0;
+  Clock::time_point start = Clock::now();
+  if (!check(request("GET", "/api/stopwatch/start", "", body), "stopwatch start")) return 0;
+  if (!check(request("POST", "/api/timers?in=300&label=bench", "", body), "timer")) return 0;
+  if (!ids(body).empty()) timer = ids(body)[0];
+  if (!check(request("GET", "/api/stopwatch/stop", "", body), "stopwatch stop")) return 0;
+  if (!check(request("GET", "/api/timers", "", body), "timers")) return 0;
+  if (!check(request("GET", "/api/heap", "", body), "heap")) return 0;
+  if (!check(request("GET", "/api/power", "", body), "power")) return 0;
+  ms = msSince(start);
+  return timer;
+}
+
+static unsigned runBatched(double &ms) {
+  std::string body;
+  unsigned timer = 0;
+  Clock::time_point start = Clock::now();
+  if (!check(request("POST", "/api/batch", "stopwatch start\ntimer 300 bench\nstopwatch stop",
+                     body), "batch")) {
+    fprintf(stderr, "%s\n", body.c_str());
+    return 0;
+  }
+  if (!ids(body).empty()) timer = ids(body)[0];
+  if (!check(request("GET", "/api/state", "", body), "state")) return 0;
+  ms = msSince(start);
+  return timer;
+}
+
+static void report(const char* name, std::vector<double> &ms, int trips) {
+  std::sort(ms.begin(), ms.end());
+  printf("%-9s %d round trips  median %7.1f ms  worst %7.1f ms\n", name, trips,
+         ms[ms.size() / 2], ms.back());
+}
+
+int main(int argc, char** argv) {
+  int runs = 20;
+  bool sim = false;
+  SimKnob knob;
+  for (int i = 1; i < argc; i++) {
+    bool more = i + 1 < argc;
+    if (strcmp(argv[i], "--sim") == 0)                       sim = true;
+    else if (strcmp(argv[i], "-H") == 0 && more)             host = argv[++i];
+    else if (strcmp(argv[i], "-p") == 0 && more)             port = argv[++i];
+    else if (strcmp(argv[i], "-n") == 0 && more)             runs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--sim-serve-us") == 0 && more) knob.serveUs = (unsigned)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--sim-ui-us") == 0 && more)    knob.uiUs = (unsigned)atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: batchbench [-H host] [-p port] [-n runs]\n"
+                      "                  [--sim [--sim-serve-us us] [--sim-ui-us us]]\n");
+      return 1;
+    }
+  }
+  if (runs < 1) runs = 1;
+
+  if (sim) {
+    if (!simStart(knob)) return 1;
+    host = "127.0.0.1";
+    port = knob.portText;
+  }
+
+  addrinfo hints = {};
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (int err = getaddrinfo(host, port, &hints, &addr)) {
+    fprintf(stderr, "%s: %s\n", host, gai_strerror(err));
+    return 1;
+  }
+
+  std::vector<double> separate, batched;
+  std::string body;
+  for (int i = 0; i < runs; i++) {
+    double ms = 0;
+    unsigned timer = runSeparate(ms);
+    if (!timer) return 1;
+    separate.push_back(ms);
+    request("DELETE", "/api/timers?id=" + std::to_string(timer), "", body);
+
+    timer = runBatched(ms);
+    if (!timer) return 1;
+    batched.push_back(ms);
+    request("DELETE", "/api/timers?id=" + std::to_string(timer), "", body);
+  }
+
+  if (sim) simStop(knob);
+  report("separate", separate, 6);
+  report("batched", batched, 2);
+  printf("speedup   %.1fx\n", separate[separate.size() / 2] / batched[batched.size() / 2]);
+  if (sim && knob.activeTimers) {
+    fprintf(stderr, "FAIL: %u timers left behind\n", knob.activeTimers);
+    return 1;
+  }
+  freeaddrinfo(addr);
+  return 0;
+}
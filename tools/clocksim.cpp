@@ -0,0 +1,247 @@
+// =============================================================
+// clocksim — run the knob's timing patterns across the 32-bit wrap
+//
+//   g++ -O2 -std=c++17 -o clocksim tools/clocksim.cpp
+//   ./clocksim
+//
+// Builds monotime.h with KNOB_VIRTUAL_CLOCK, so time only moves
+// when the simulation says so, and starts the clock just before
+// 2^32 ms — where millis() wraps after 49.7 days of uptime:
+//
+//  - Deadline and since() patterns as the firmware uses them
+//    (buzzer 40/150 ms, volume animation, message overlay, OBS and
+//    door idle release, standby timeout, 1 s redraw, 2 min BLE
+//    wake key) armed before, at and after the wrap fire exactly
+//    on time; the old "millis() >= endTime" form is run alongside
+//    and its errors reported
+//  - a uint32 micros() stamp (wrap at 71.6 min) against a MonoTime
+//    one for the wake-latency measurement
+//  - the pure modules fed MonoTime::ms32() (MQTT outbox retry and
+//    ack time, encoder acceleration) give the same results across
+//    the wrap as at boot, and the timing wheel fed the 64-bit ms
+//    fires its timers on time past 2^32 ms
+//
+// Exits non-zero if a check fails (the legacy rows are expected
+// to be wrong and don't count).
+// =============================================================
+
+#define KNOB_VIRTUAL_CLOCK
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../monotime.h"
+#include "../mqttcode.h"
+#include "../encoderaccel.h"
+#include "../timerwheel.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static const MonoTime WRAP = { (int64_t)(1ULL << 32) * 1000 };   // millis() == 0 again
+static const Duration STEP = 1_ms;                                  // loop() granularity
+static const Duration GIVE_UP = 60_s;
+
+// -------------------
+// Deadline / since() patterns
+// -------------------
+struct Pattern {
+  const char* name;
+  Duration    length;
+  bool        deadline;   // Deadline (end time) or since(start) idle test
+};
+
+static const Pattern PATTERNS[] = {
+  { "buzzer click",   40_ms,            true  },
+  { "buzzer beep",    150_ms,           true  },
+  { "volume anim",    300_ms,           true  },
+  { "message",        5_s,              true  },
+  { "OBS/door idle",  500_ms,           false },
+  { "redraw",         1000_ms,          false },
+  { "standby",        10_s,             false },
+  { "BLE wake key",   secs(2 * 60),     false },
+};
+
+// How long the pattern takes to fire when armed at t, or -1 if it
+// never does within GIVE_UP
+static int64_t fireAfterMs(const Pattern &p, MonoTime t) {
+  monoSet(t);
+  Deadline end;
+  MonoTime start = monoNow();
+  if (p.deadline) end.arm(p.length);
+  while (since(start) < p.length + GIVE_UP) {
+    if (p.deadline ? end.expired() : since(start) >= p.length) return since(start).toMs();
+    monoAdvance(STEP);
+  }
+  return -1;
+}
+
+// The pre-MonoTime form: end = millis() + length, fire on millis() >= end
+static int64_t legacyFireAfterMs(const Pattern &p, MonoTime t) {
+  monoSet(t);
+  uint32_t end = monoNow().ms32() + (uint32_t)p.length.toMs();
+  MonoTime start = monoNow();
+  while (since(start) < p.length + GIVE_UP) {
+    if (monoNow().ms32() >= end) return since(start).toMs();
+    monoAdvance(STEP);
+  }
+  return -1;
+}
+
+static void patterns() {
+  printf("%-14s %9s %9s %9s   %s\n", "pattern", "length", "armed at", "fired", "legacy millis() >= end");
+  for (const Pattern &p : PATTERNS) {
+    const Duration offsets[] = { Duration{ 0 } - p.length / 2, Duration{ 0 } - 1_ms, 0_ms, 1_ms };
+    for (Duration off : offsets) {
+      int64_t got    = fireAfterMs(p, WRAP + off);
+      int64_t legacy = p.deadline ? legacyFireAfterMs(p, WRAP + off) : got;
+      char what[96];
+      snprintf(what, sizeof(what), "%s armed at wrap%+lldms fired after %lldms", p.name,
+               (long long)off.toMs(), (long long)got);
+      check(got == p.length.toMs(), what);
+
+      char legacyText[32];
+      if (!p.deadline)       snprintf(legacyText, sizeof(legacyText), "(difference, ok)");
+      else if (legacy < 0)   snprintf(legacyText, sizeof(legacyText), "never");
+      else if (legacy == got) snprintf(legacyText, sizeof(legacyText), "ok");
+      else                   snprintf(legacyText, sizeof(legacyText), "after %lldms", (long long)legacy);
+      printf("%-14s %7lldms %+7lldms %7lldms   %s\n", p.name, (long long)p.length.toMs(),
+             (long long)off.toMs(), (long long)got, legacyText);
+    }
+  }
+}
+
+// Volume animation: elapsed = length - remaining must rise steadily
+static void animation() {
+  monoSet(WRAP - 150_ms);
+  Deadline end;
+  end.arm(300_ms);
+  int64_t last = -1;
+  bool steady = true;
+  while (!end.expired()) {
+    int64_t elapsed = 300 - end.remaining().toMs();
+    if (elapsed < last || elapsed > 300) steady = false;
+    last = elapsed;
+    monoAdvance(STEP);
+  }
+  check(steady && last == 299, "volume animation progress across the wrap");
+  check(end.remaining() == 0_ms, "remaining() clamps at 0");
+  end.cancel();
+  check(!end.expired(), "cancelled deadline never expires");
+}
+
+// -------------------
+// Wake latency: edge stamp from long ago
+// -------------------
+static void wakeLatency() {
+  // Last input 72 minutes ago, wake now: 32-bit micros() has wrapped once
+  MonoTime edge = WRAP;
+  monoSet(edge + secs(72 * 60));
+  uint32_t legacyUs = (uint32_t)monoNow().us - (uint32_t)edge.us;
+  Duration latency  = monoNow() - edge;
+  printf("\nwake latency, input 72 min ago: MonoTime %lld s, uint32 micros() %lu s\n",
+         (long long)(latency / 1_s), (unsigned long)(legacyUs / 1000000UL));
+  check(latency == secs(72 * 60), "MonoTime latency past the micros() wrap");
+  check(MonoTime{ 0 } < edge && edge - 1_us < edge, "MonoTime ordering");
+}
+
+// -------------------
+// Pure modules fed ms32()
+// -------------------
+struct OutboxRun {
+  bool     earlyRetry;
+  bool     retryDue;
+  uint32_t ackMs;
+};
+
+static OutboxRun outboxRun(MonoTime t0) {
+  static MqttOutbox<4> box;
+  box = MqttOutbox<4>();
+  OutboxRun r = {};
+  monoSet(t0);
+  const uint8_t payload[] = "1";
+  box.push("knob/door", payload, 1, 1, false, monoNow().ms32());
+  box.markSent(box.next(monoNow().ms32(), 2000), monoNow().ms32());
+  monoAdvance(1500_ms);
+  r.earlyRetry = box.next(monoNow().ms32(), 2000) != nullptr;
+  monoAdvance(600_ms);
+  MqttOutMsg* m = box.next(monoNow().ms32(), 2000);
+  r.retryDue = m != nullptr;
+  if (m) box.markSent(m, monoNow().ms32());
+  monoAdvance(250_ms);
+  if (m) box.ack(m->id, monoNow().ms32());
+  r.ackMs = box.stats().ackMsMax;
+  return r;
+}
+
+static std::vector<int> accelRun(MonoTime t0) {
+  EncoderAccel accel;
+  std::vector<int> out;
+  monoSet(t0);
+  // A slow start, a fast spin, a pause, the other way
+  const int gaps[] = { 200, 150, 90, 40, 20, 20, 20, 20, 20, 500, 30, 30, 30 };
+  const int8_t dirs[] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1 };
+  for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++) {
+    monoAdvance(msecs(gaps[i]));
+    out.push_back(accel.step(monoNow().ms32(), dirs[i], ACCEL_TIMER));
+  }
+  return out;
+}
+
+static void pureModules() {
+  OutboxRun boot = outboxRun(MonoTime{ 0 } + 10_s);
+  OutboxRun wrap = outboxRun(WRAP - 1_s);
+  check(!wrap.earlyRetry, "MQTT outbox: no retry before retryMs across the wrap");
+  check(wrap.retryDue, "MQTT outbox: retry due after retryMs across the wrap");
+  check(wrap.ackMs == boot.ackMs && wrap.ackMs == 2350, "MQTT outbox: ack time across the wrap");
+
+  check(accelRun(MonoTime{ 0 } + 10_s) == accelRun(WRAP - 300_ms),
+        "encoder acceleration identical across the wrap");
+}
+
+// Timing wheel on the 64-bit ms clock: timers set before 2^32 ms
+// fire on time after it
+static void wheel() {
+  static TimerWheel<16> w;
+  monoSet(WRAP - 5_s);
+  w.begin(monoNow().ms());
+  const int64_t delays[] = { 1000, 4990, 5000, 5010, 60000 };
+  for (int64_t d : delays) w.schedule(monoNow().ms() + d, 0, 1, (uint32_t)d);
+  w.schedule(monoNow().ms() + 2000, 2000, 2, 0);   // every 2 s
+
+  MonoTime start = monoNow();
+  int late = 0, fired = 0, beats = 0;
+  while (since(start) < 71_s) {
+    monoAdvance(10_ms);
+    uint64_t now = monoNow().ms();
+    w.advance(now, [&](TimerId, const TimerNode &n) {
+      if (n.kind == 2) {
+        beats++;
+        return;
+      }
+      fired++;
+      uint64_t due = (uint64_t)(start.ms() + n.arg);
+      if (now < due || now - due > TIMER_WHEEL_TICK_MS) late++;
+    });
+  }
+  check(fired == 5 && late == 0, "timing wheel one-shots on time across 2^32 ms");
+  check(beats == 35, "timing wheel periodic timer across 2^32 ms");
+}
+
+int main() {
+  printf("virtual clock starts at 2^32 ms (millis() wraps, day %.1f)\n\n",
+         (double)WRAP.ms() / 86400000.0);
+  patterns();
+  animation();
+  wakeLatency();
+  pureModules();
+  wheel();
+  printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+// =============================================================
+// corobench — check the mode coroutine scheduler, time a resume
+//
+//   g++ -O2 -std=c++17 -pthread -o corobench tools/corobench.cpp
+//   ./corobench [-n resumes]   (default 2000000)
+//
+// Uses the device's corocode.h on a virtual clock (monotime.h with
+// KNOB_VIRTUAL_CLOCK):
+//
+//  - sleeps, inputs, input-or-timeout, stop in the middle of a
+//    sleep and restart behave as the knob's modes rely on
+//  - the OBS turn (chord down, 20 ms, release; 500 ms idle ends the
+//    turn) sends one chord per turn at the expected times, and the
+//    TIME UP beep keeps its 500 ms beat under a jittery loop
+//
+// Then it times, on this machine:
+//
+//  - a resume (tick() running a body that yields straight back)
+//  - a skipped check (tick() over a task still asleep)
+//  - post() into a task waiting for input
+//  - for scale, a switch between two threads through a condition
+//    variable, the host's nearest thing to a FreeRTOS task switch
+//
+// and prints the RAM each frame takes against a FreeRTOS task with
+// the stacks the firmware gives its own tasks.
+//
+// Exits non-zero if a check fails.
+// =============================================================
+
+#define KNOB_VIRTUAL_CLOCK
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../monotime.h"
+#include "../corocode.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// What the bodies did, as "t:event" entries
+static std::string events;
+
+static void logEvent(const char* what) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%lld:%s ", (long long)monoNow().ms(), what);
+  events += buf;
+}
+
+static void runFor(CoScheduler<8> &s, Duration d, Duration step = 1_ms) {
+  MonoTime end = monoNow() + d;
+  while (monoNow() < end) {
+    monoAdvance(step);
+    s.tick(monoNow());
+  }
+}
+
+// -------------------
+// Behaviour
+// -------------------
+void sleeperBody(CoTask &t);
+struct Sleeper : CoTask {
+  Sleeper() : CoTask("sleeper", sleeperBody) {}
+};
+
+void sleeperBody(CoTask &t) {
+  CO_BEGIN(t);
+  logEvent("a");
+  CO_SLEEP(t, 100_ms);
+  logEvent("b");
+  CO_YIELD(t);
+  logEvent("c");
+  CO_AWAIT_INPUT_FOR(t, 50_ms);
+  logEvent(coTimedOut(t) ? "timeout" : "input");
+  CO_AWAIT_INPUT(t);
+  logEvent(coInput(t) == 7 ? "seven" : "other");
+  CO_END(t);
+}
+
+static void basics() {
+  CoScheduler<8> s;
+  Sleeper t;
+  monoSet(MonoTime{ 0 });
+  events.clear();
+  check(!s.running(t), "not running before start");
+  s.start(t);
+  runFor(s, 200_ms);
+  check(events == "0:a 100:b 101:c 151:timeout ", "sleep, yield, input timeout");
+  s.post(t, 7);
+  check(events == "0:a 100:b 101:c 151:timeout 200:seven ", "post resumes a waiting task at once");
+  check(!s.running(t), "finished after CO_END");
+  s.tick(monoNow());
+  check(s.size() == 0, "finished task leaves the list");
+
+  s.post(t, 1);
+  check(s.stats().postsDropped == 1, "post to a stopped task is dropped");
+
+  events.clear();
+  s.start(t);
+  runFor(s, 50_ms);
+  s.stop(t);
+  runFor(s, 200_ms);
+  check(events == "200:a ", "stop in the middle of a sleep");
+  s.start(t);
+  check(events == "200:a 450:a ", "restart runs from the top");
+  s.stop(t);
+  s.tick(monoNow());
+}
+
+// The knob's OBS turn, as in the sketch, against a logging keyboard
+void obsBody(CoTask &t);
+struct ObsTurn : CoTask {
+  int8_t dir  = 0;
+  bool   held = false;
+  ObsTurn() : CoTask("obs", obsBody) {}
+};
+
+void obsBody(CoTask &t) {
+  ObsTurn &f = static_cast<ObsTurn&>(t);
+  CO_BEGIN(t);
+  for (;;) {
+    CO_AWAIT_INPUT(t);
+    f.dir = coInput(t) > 0 ? 1 : -1;
+    logEvent(f.dir == 1 ? "press-K" : "press-J");
+    f.held = true;
+    CO_SLEEP(t, 20_ms);
+    logEvent("release");
+    f.held = false;
+    do {
+      CO_AWAIT_INPUT_FOR(t, 500_ms);
+    } while (!coTimedOut(t));
+    logEvent("idle");
+  }
+  CO_END(t);
+}
+
+static void obsTurn() {
+  CoScheduler<8> s;
+  ObsTurn t;
+  monoSet(MonoTime{ 0 });
+  events.clear();
+  s.start(t);
+  // A turn right: steps every 30 ms for 150 ms, then one left after a pause
+  for (int i = 0; i < 5; i++) {
+    s.post(t, 1);
+    runFor(s, 30_ms);
+  }
+  runFor(s, 600_ms);
+  s.post(t, -1);
+  runFor(s, 5_ms);
+  check(t.held, "chord held during its 20 ms");
+  s.stop(t);   // the sketch releases a held chord here
+  runFor(s, 100_ms);
+  check(events == "0:press-K 20:release 620:idle 750:press-J ", "OBS turn: one chord per turn");
+}
+
+// TIME UP beep with a loop that comes round late now and then
+void beepBody(CoTask &t);
+struct Beep : CoTask {
+  bool     on = false;
+  MonoTime next;
+  int      edges = 0;
+  int      late  = 0;
+  Beep() : CoTask("beep", beepBody) {}
+};
+
+void beepBody(CoTask &t) {
+  Beep &f = static_cast<Beep&>(t);
+  CO_BEGIN(t);
+  f.on   = true;
+  f.next = monoNow();
+  for (;;) {
+    f.edges++;
+    if ((monoNow() - f.next) > 40_ms) f.late++;
+    f.next = f.next + 500_ms;
+    CO_SLEEP_UNTIL(t, f.next);
+    f.on = !f.on;
+  }
+  CO_END(t);
+}
+
+static void beep() {
+  CoScheduler<8> s;
+  Beep t;
+  monoSet(MonoTime{ 0 });
+  s.start(t);
+  uint32_t rng = 12345;
+  MonoTime end = monoNow() + 60_s;
+  while (monoNow() < end) {
+    rng = rng * 1103515245u + 12345u;
+    // Mostly 1 ms passes, sometimes a 30 ms display flush
+    monoAdvance((rng >> 16) % 50 == 0 ? 30_ms : 1_ms);
+    s.tick(monoNow());
+  }
+  check(t.edges == 121 && t.late == 0, "beep keeps a 500 ms beat without drift");
+}
+
+// -------------------
+// Timing
+// -------------------
+void yielderBody(CoTask &t) {
+  CO_BEGIN(t);
+  for (;;) CO_YIELD(t);
+  CO_END(t);
+}
+
+void waiterBody(CoTask &t) {
+  CO_BEGIN(t);
+  for (;;) CO_AWAIT_INPUT(t);
+  CO_END(t);
+}
+
+static double nsPer(std::chrono::steady_clock::time_point start, long n) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+static double threadSwitchNs(long n) {
+  std::mutex m;
+  std::condition_variable cv;
+  bool ping = true;
+  std::thread other([&] {
+    for (long i = 0; i < n; i++) {
+      std::unique_lock<std::mutex> lock(m);
+      cv.wait(lock, [&] { return !ping; });
+      ping = true;
+      cv.notify_one();
+    }
+  });
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; i++) {
+    std::unique_lock<std::mutex> lock(m);
+    ping = false;
+    cv.notify_one();
+    cv.wait(lock, [&] { return ping; });
+  }
+  double ns = nsPer(start, 2 * n);
+  other.join();
+  return ns;
+}
+
+static void timing(long n) {
+  CoScheduler<8> s;
+  CoTask yielders[4] = { { "y0", yielderBody }, { "y1", yielderBody },
+                         { "y2", yielderBody }, { "y3", yielderBody } };
+  for (CoTask &t : yielders) s.start(t);
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < n / 4; i++) s.tick(monoNow());
+  double resumeNs = nsPer(start, n);
+  for (CoTask &t : yielders) s.stop(t);
+  s.tick(monoNow());
+
+  Sleeper sleepers[4];
+  monoSet(MonoTime{ 0 });
+  for (Sleeper &t : sleepers) s.start(t);   // all asleep for 100 ms
+  start = std::chrono::steady_clock::now();
+  for (long i = 0; i < n / 4; i++) s.tick(monoNow());
+  double skipNs = nsPer(start, n);
+  for (Sleeper &t : sleepers) s.stop(t);
+  s.tick(monoNow());
+
+  CoTask waiter("waiter", waiterBody);
+  s.start(waiter);
+  start = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; i++) s.post(waiter, (int16_t)i);
+  double postNs = nsPer(start, n);
+
+  long switches = n / 50 > 20000 ? 20000 : n / 50;
+  double threadNs = threadSwitchNs(switches);
+
+  printf("\n%-34s %10s\n", "per operation (this host)", "ns");
+  printf("%-34s %10.1f\n", "resume (yield and back)", resumeNs);
+  printf("%-34s %10.1f\n", "skip a sleeping task", skipNs);
+  printf("%-34s %10.1f\n", "post into a waiting task", postNs);
+  printf("%-34s %10.1f   (%.0fx a resume)\n", "thread switch (condition variable)", threadNs,
+         threadNs / resumeNs);
+}
+
+static void memory() {
+  // ESP-IDF 4.4 TCB on the C3, and the stacks this firmware gives its tasks
+  const unsigned tcb = 344;
+  printf("\n%-34s %10s\n", "RAM per coroutine / task", "bytes");
+  printf("%-34s %10u\n", "CoTask (scheduler state)", (unsigned)sizeof(CoTask));
+  printf("%-34s %10u\n", "OBS turn frame", (unsigned)sizeof(ObsTurn));
+  printf("%-34s %10u\n", "beep frame", (unsigned)sizeof(Beep));
+  printf("%-34s %10u\n", "scheduler slot", (unsigned)sizeof(CoTask*));
+  printf("%-34s %10u   (TCB + 3072 stack, as oledFlush/mirror)\n", "FreeRTOS task, small", tcb + 3072);
+  printf("%-34s %10u   (TCB + 4096 stack, as mqttConnect)\n", "FreeRTOS task, network", tcb + 4096);
+}
+
+int main(int argc, char** argv) {
+  long n = 2000000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) n = strtol(argv[i + 1], nullptr, 10);
+  }
+  if (n < 1000) n = 1000;
+
+  basics();
+  obsTurn();
+  beep();
+  timing(n);
+  memory();
+  printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
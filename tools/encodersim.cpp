@@ -0,0 +1,184 @@
+// =============================================================
+// encodersim — replay and simulate encoder acceleration
+//
+//   g++ -O2 -std=c++17 -Wall -o encodersim tools/encodersim.cpp
+//   ./encodersim                       simulate reaching targets
+//   ./encodersim trace.txt [start]     replay a recorded trace
+//
+// Uses the device's encoderaccel.h unchanged (EncoderDetent and
+// EncoderAccel), so a replayed trace gives exactly the values the
+// knob would show.
+//
+// Trace format: one CLK edge per line, "<millis> <+1|-1>", starting
+// at a detent (every second edge lands on one). Lines starting
+// with # are ignored.
+//
+// The simulation drives a simple operator model towards a set of
+// timer targets (1..99 min, starting at 1). The operator spins
+// fast while far away, slows down as the value gets close, pauses
+// to read the screen after overshooting and then corrects. Each
+// click is two edges through EncoderDetent, as in the ISR. It
+// reports the clicks and time needed with the old fixed mapping
+// (one minute per click) and with ACCEL_TIMER.
+// =============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../encoderaccel.h"
+
+static const int TIMER_MIN = 1;
+static const int TIMER_MAX = 99;
+
+static int clampTimer(int v) {
+  return v < TIMER_MIN ? TIMER_MIN : (v > TIMER_MAX ? TIMER_MAX : v);
+}
+
+// -------------------
+// Value mappings under test
+// -------------------
+struct Mapping {
+  virtual ~Mapping() {}
+  virtual void reset(int start) = 0;
+  virtual int  step(uint32_t ms, int8_t dir) = 0;   // one detent; returns new value
+};
+
+// Old behaviour: timerMinutes = counter / 2, one minute per click
+struct LinearMapping : Mapping {
+  int value = TIMER_MIN;
+  void reset(int start) override { value = start; }
+  int step(uint32_t, int8_t dir) override {
+    value = clampTimer(value + dir);
+    return value;
+  }
+};
+
+struct AccelMapping : Mapping {
+  EncoderAccel accel;
+  const AccelCurve &curve;
+  int value = TIMER_MIN;
+  explicit AccelMapping(const AccelCurve &c) : curve(c) {}
+  void reset(int start) override { accel.reset(); value = start; }
+  int step(uint32_t ms, int8_t dir) override {
+    value = clampTimer(value + accel.step(ms, dir, curve));
+    return value;
+  }
+};
+
+// -------------------
+// Operator model
+// -------------------
+// Click interval chosen from the distance left, with a reaction pause
+// after every direction change.
+static uint32_t operatorIntervalMs(int remaining) {
+  if (remaining > 30) return 30;    // flick
+  if (remaining > 10) return 70;    // brisk
+  if (remaining > 3)  return 160;   // deliberate
+  return 360;                       // single clicks
+}
+
+static const uint32_t OPERATOR_REACTION_MS = 350;
+static const int      OPERATOR_MAX_STEPS   = 1000;
+
+struct Result {
+  int      steps;
+  uint32_t ms;
+  int      reversals;
+  bool     reached;
+};
+
+static Result reachTarget(Mapping &m, int start, int target) {
+  Result r = {0, 0, 0, false};
+  m.reset(start);
+  EncoderDetent detent;
+  int value = start;
+  int8_t lastDir = 0;
+  uint32_t t = 1000;
+  while (r.steps < OPERATOR_MAX_STEPS) {
+    if (value == target) {
+      r.reached = true;
+      break;
+    }
+    int8_t dir = value < target ? 1 : -1;
+    int remaining = dir > 0 ? target - value : value - target;
+    if (lastDir != 0 && dir != lastDir) {
+      t += OPERATOR_REACTION_MS;
+      r.reversals++;
+    }
+    uint32_t interval = operatorIntervalMs(remaining);
+    t += interval;
+    // The click's two edges: off the rest level halfway, back on it
+    if (detent.edge(dir, false) != 0 || detent.edge(dir, true) != dir) {
+      fprintf(stderr, "encodersim: edge pair didn't make one detent\n");
+      exit(1);
+    }
+    value = m.step(t, dir);
+    lastDir = dir;
+    r.steps++;
+  }
+  r.ms = t - 1000;
+  return r;
+}
+
+static void simulate() {
+  const int targets[] = { 5, 10, 25, 30, 45, 60, 90, 99 };
+  LinearMapping linear;
+  AccelMapping  accel(ACCEL_TIMER);
+
+  printf("target | linear: clicks   ms rev | accel: clicks   ms rev\n");
+  printf("-------+-------------------------+------------------------\n");
+  long linSteps = 0, accSteps = 0, linMs = 0, accMs = 0;
+  for (int target : targets) {
+    Result a = reachTarget(linear, TIMER_MIN, target);
+    Result b = reachTarget(accel, TIMER_MIN, target);
+    printf("  %3d  |        %5d %5u %3d |       %5d %5u %3d%s\n", target,
+           a.steps, (unsigned)a.ms, a.reversals,
+           b.steps, (unsigned)b.ms, b.reversals,
+           (a.reached && b.reached) ? "" : "  (not reached)");
+    linSteps += a.steps;
+    accSteps += b.steps;
+    linMs    += a.ms;
+    accMs    += b.ms;
+  }
+  printf("-------+-------------------------+------------------------\n");
+  printf(" total |        %5ld %5ld     |       %5ld %5ld\n", linSteps, linMs, accSteps, accMs);
+}
+
+static int replay(const char* path, int start) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "encodersim: cannot open %s\n", path);
+    return 1;
+  }
+  AccelMapping accel(ACCEL_TIMER);
+  accel.reset(start);
+  EncoderDetent detent;
+  char line[64];
+  int edges = 0, steps = 0, value = start;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    unsigned long ms;
+    int dir;
+    if (sscanf(line, "%lu %d", &ms, &dir) != 2 || (dir != 1 && dir != -1)) {
+      fprintf(stderr, "encodersim: bad line: %s", line);
+      fclose(f);
+      return 1;
+    }
+    // Edges alternate CLK levels; the trace starts at a detent
+    int8_t click = detent.edge((int8_t)dir, ++edges % 2 == 0);
+    if (!click) continue;
+    value = accel.step((uint32_t)ms, click);
+    printf("%10lu %+d  interval=%3u  value=%d\n", ms, click,
+           (unsigned)accel.accel.smoothedIntervalMs(), value);
+    steps++;
+  }
+  fclose(f);
+  printf("%d edges, %d clicks, final value %d\n", edges, steps, value);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2) return replay(argv[1], argc >= 3 ? atoi(argv[2]) : TIMER_MIN);
+  simulate();
+  return 0;
+}
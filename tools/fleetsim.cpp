@@ -0,0 +1,589 @@
+// =============================================================
+// fleetsim — a fleet of knobs checking for updates after a power cut
+//
+//   g++ -O2 -std=c++17 -Wall -pthread -o fleetsim tools/fleetsim.cpp
+//   ./fleetsim [options]
+//
+//     -n devices        fleet size                      (500)
+//     --hours h         simulated time                  (12)
+//     --latency ms      version reply time, median      (150)
+//     --fail p          version/download failure rate   (0.02)
+//     --capacity c      version requests in flight before
+//                       the server answers 503          (8)
+//     --retry-after s   Retry-After on a 503, 0 = none  (30)
+//     --size kb         firmware image                  (1200)
+//     --bandwidth kbps  server egress, shared by all
+//                       downloads in flight             (4000)
+//     --publish s       new firmware appears at         (0)
+//     --seed n
+//     --loopback        answer over HTTP on 127.0.0.1 (below)
+//
+// Every knob boots at t=0 and runs the device's own check schedule
+// (otaschedule.h: boot jitter, jittered re-checks, full-jitter
+// backoff, Retry-After with spread) against a simulated server:
+// replies take a lognormal-ish time around the median, fail at the
+// given rate (a 500, a cut-off body or one without "data"), and
+// past the in-flight capacity come back 503 at once. Each answer
+// goes through otaReadReply(), the knob's own reading of status,
+// Retry-After and JSON body; a knob that reads a version newer
+// than its own (isVersionNewer) downloads it at its share of the
+// egress bandwidth, reboots (5 s) and starts its schedule again.
+//
+// --loopback puts a mock firmware server on 127.0.0.1: every check
+// is a real HTTP/1.0 GET of OTA_VERSION_PATH with the knob's MAC,
+// as HTTPClient sends it with useHTTP10, and the reply's status
+// line, headers and body come back over the socket. The run must
+// come out the same as in-process. (HTTPClient itself is the ESP32
+// library and stays on the device.)
+//
+// The same fleet then runs the schedule the sketch had before it:
+// one check straight after boot, retried every 30 s on failure,
+// Retry-After ignored. For each it reports the backend's request
+// rate (per second and per minute), 503s, download concurrency and
+// time-to-updated across the fleet.
+//
+// Checks (exit non-zero on failure): every first check lands inside
+// the boot jitter window, no knob comes back before a Retry-After,
+// no backoff exceeds its cap, every failed answer reads as a
+// failure, the whole fleet updates, and the staggered schedule's
+// peak request rate is a fraction of the old one's. With
+// --loopback: every request is the knob's version URL, and the
+// staggered run matches the in-process one.
+// =============================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../otaschedule.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+struct Config {
+  int    devices      = 500;
+  double hours        = 12;
+  double latencyMs    = 150;
+  double failRate     = 0.02;
+  int    capacity     = 8;
+  int    retryAfterS  = 30;
+  double sizeKb       = 1200;
+  double bandwidthKbs = 4000;
+  double publishS     = 0;
+  uint64_t seed       = 1;
+  bool   loopback     = false;
+};
+
+static uint64_t rngState = 1;
+
+static uint32_t next32() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState >> 16);
+}
+
+static double uniform() { return (next32() + 0.5) / 4294967296.0; }
+
+// Arduino random(0, max) stand-in for the schedule
+static uint32_t randomMs(uint32_t maxMs) {
+  return maxMs ? (uint32_t)(((uint64_t)next32() * maxMs) >> 32) : 0;
+}
+
+// -------------------
+// Schedules under test
+// -------------------
+struct Policy {
+  const char* name;
+  bool        staggered;
+};
+
+typedef FixedString<16> Version;   // autoupdatelogic.h's VersionString
+
+struct Device {
+  OtaSchedule sched;
+  char        mac[18]       = "";
+  Version     version       = "1.0.0";
+  Version     offered;             // being downloaded
+  bool        updated       = false;
+  int64_t     updatedAt     = -1;
+  int64_t     notBefore     = 0;   // Retry-After given by the server ends here
+  int         checks        = 0;
+};
+
+static uint32_t firstCheck(const Policy &p, Device &d) {
+  return p.staggered ? otaFirstCheckMs(d.sched, randomMs) : 0;
+}
+
+static uint32_t nextCheck(const Policy &p, Device &d, OtaCheckResult r, uint32_t retryAfterMs) {
+  if (p.staggered) return otaNextCheckMs(d.sched, r, retryAfterMs, randomMs);
+  return r == OTA_CHECK_UP_TO_DATE ? OTA_RECHECK_INTERVAL_MS : 30000;
+}
+
+// -------------------
+// The server's answers, read the knob's way
+// -------------------
+// One reply of the version endpoint
+struct Answer {
+  int         status;
+  uint32_t    retryAfterS;   // 0: no Retry-After header
+  std::string body;
+};
+
+// A failed check, one of the ways a real one goes wrong
+static Answer failedAnswer() {
+  switch (next32() % 3) {
+    case 0:  return { 500, 0, "{\"error\":\"internal\"}" };
+    case 1:  return { 200, 0, "{\"success\":true,\"data\":\"1.0" };   // cut off
+    default: return { 200, 0, "{\"success\":false,\"error\":\"unknown device\"}" };
+  }
+}
+
+static Answer versionAnswer(const char* version) {
+  return { 200, 0, std::string("{\"success\":true,\"data\":\"") + version + "\"}" };
+}
+
+// In-process: the body straight from memory
+struct MemBody {
+  const std::string &s;
+  size_t i = 0;
+  explicit MemBody(const std::string &str) : s(str) {}
+  int available() { return (int)(s.size() - i); }
+  size_t readBytes(uint8_t* out, size_t want) {
+    size_t n = std::min(want, s.size() - i);
+    memcpy(out, s.data() + i, n);
+    i += n;
+    return n;
+  }
+};
+
+// --loopback: a mock firmware server on 127.0.0.1. One request at a
+// time, as the simulation asks them; each connection gets 'reply'
+// and leaves its request line behind.
+struct MockServer {
+  int               listenFd = -1;
+  uint16_t          port     = 0;
+  std::thread       thread;
+  std::mutex        lock;
+  std::string       reply;
+  std::string       lastRequest;
+  std::atomic<bool> stop{ false };
+  long              served   = 0;
+};
+
+static void mockServe(MockServer &m) {
+  for (;;) {
+    int fd = accept(m.listenFd, nullptr, nullptr);
+    if (fd < 0) continue;
+    if (m.stop) {
+      close(fd);
+      return;
+    }
+    std::string request;
+    char buf[512];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) break;
+      request.append(buf, (size_t)n);
+    }
+    std::string reply;
+    {
+      std::lock_guard<std::mutex> g(m.lock);
+      m.lastRequest = request.substr(0, request.find("\r\n"));
+      reply = m.reply;
+      m.served++;
+    }
+    for (size_t off = 0; off < reply.size();) {
+      ssize_t n = send(fd, reply.data() + off, reply.size() - off, MSG_NOSIGNAL);
+      if (n <= 0) break;
+      off += (size_t)n;
+    }
+    shutdown(fd, SHUT_WR);
+    close(fd);
+  }
+}
+
+static bool mockStart(MockServer &m) {
+  m.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(m.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(a);
+  if (bind(m.listenFd, (sockaddr*)&a, sizeof(a)) != 0 || listen(m.listenFd, 16) != 0 ||
+      getsockname(m.listenFd, (sockaddr*)&a, &len) != 0) {
+    perror("mock server");
+    return false;
+  }
+  m.port   = ntohs(a.sin_port);
+  m.thread = std::thread(mockServe, std::ref(m));
+  return true;
+}
+
+static int connectMock(const MockServer &m) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port        = htons(m.port);
+  if (connect(fd, (sockaddr*)&a, sizeof(a)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void mockStop(MockServer &m) {
+  m.stop = true;
+  int fd = connectMock(m);   // wakes accept()
+  if (fd >= 0) close(fd);
+  m.thread.join();
+  close(m.listenFd);
+}
+
+// The body off the socket, as JsonReader has it off the WiFiClient
+struct SocketBody {
+  int fd;
+  int available() {
+    int n = 0;
+    return ioctl(fd, FIONREAD, &n) == 0 ? n : 0;
+  }
+  size_t readBytes(uint8_t* out, size_t want) {
+    ssize_t n = recv(fd, out, want, 0);
+    return n > 0 ? (size_t)n : 0;
+  }
+};
+
+static std::string httpReply(const Answer &a) {
+  char head[256];
+  int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n", a.status,
+                   a.status == 200 ? "OK" : a.status == 503 ? "Service Unavailable" : "Error");
+  if (a.retryAfterS) n += snprintf(head + n, sizeof(head) - n, "Retry-After: %u\r\n", (unsigned)a.retryAfterS);
+  snprintf(head + n, sizeof(head) - n,
+           "Content-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+           a.body.size());
+  return head + a.body;
+}
+
+struct Loopback {
+  MockServer server;
+  long       badRequests = 0;   // not the knob's version URL
+  long       socketErrors = 0;
+};
+
+// One version check over HTTP: the knob's request, the server's
+// status line and headers, then otaReadReply() on the socket
+static OtaCheckResult askLoopback(Loopback &lb, const Answer &a, const Device &d, Version &latest,
+                                  uint32_t &retryAfterMs) {
+  {
+    std::lock_guard<std::mutex> g(lb.server.lock);
+    lb.server.reply = httpReply(a);
+  }
+  int fd = connectMock(lb.server);
+  if (fd < 0) {
+    lb.socketErrors++;
+    return OTA_CHECK_FAILED;
+  }
+  char request[256];
+  snprintf(request, sizeof(request),
+           "GET " OTA_VERSION_PATH "%s HTTP/1.0\r\nHost: 127.0.0.1\r\n"
+           "User-Agent: ESP32HTTPClient\r\nConnection: close\r\n\r\n", d.mac);
+  send(fd, request, strlen(request), MSG_NOSIGNAL);
+
+  // Status line and headers, a byte at a time up to the blank line
+  std::string line, retryAfter;
+  int status = 0;
+  int32_t length = -1;
+  bool first = true;
+  char c;
+  while (recv(fd, &c, 1, 0) == 1) {
+    if (c != '\n') {
+      if (c != '\r') line += c;
+      continue;
+    }
+    if (line.empty()) break;
+    if (first) {
+      sscanf(line.c_str(), "HTTP/%*d.%*d %d", &status);
+      first = false;
+    } else if (!strncasecmp(line.c_str(), "Retry-After:", 12)) {
+      retryAfter = line.substr(12);
+    } else if (!strncasecmp(line.c_str(), "Content-Length:", 15)) {
+      length = atoi(line.c_str() + 15);
+    }
+    line.clear();
+  }
+  SocketBody body = { fd };
+  OtaCheckResult r = otaReadReply(status, retryAfter.empty() ? nullptr : retryAfter.c_str(), body,
+                                  length, latest, retryAfterMs);
+  close(fd);
+
+  std::string want = std::string("GET " OTA_VERSION_PATH) + d.mac + " HTTP/1.0";
+  std::lock_guard<std::mutex> g(lb.server.lock);
+  if (lb.server.lastRequest != want) lb.badRequests++;
+  return r;
+}
+
+// The knob's reading of one answer, in-process or over loopback
+static OtaCheckResult ask(Loopback* lb, const Answer &a, const Device &d, Version &latest,
+                          uint32_t &retryAfterMs) {
+  if (lb) return askLoopback(*lb, a, d, latest, retryAfterMs);
+  MemBody body(a.body);
+  char hint[12] = "";
+  if (a.retryAfterS) snprintf(hint, sizeof(hint), "%u", (unsigned)a.retryAfterS);
+  return otaReadReply(a.status, hint[0] ? hint : nullptr, body, (int32_t)a.body.size(), latest,
+                      retryAfterMs);
+}
+
+// -------------------
+// Simulation
+// -------------------
+enum EventType : uint8_t { EV_CHECK, EV_REPLY, EV_DOWNLOADED, EV_BOOT };
+
+struct Event {
+  int64_t   at;      // ms
+  int       device;
+  EventType type;
+  bool operator<(const Event &o) const { return at > o.at; }   // earliest first
+};
+
+struct Report {
+  long    requests       = 0;
+  long    rejected       = 0;   // 503
+  long    failed         = 0;
+  int     peakPerSecond  = 0;
+  int     peakPerMinute  = 0;
+  int     peakInFlight   = 0;
+  int     peakDownloads  = 0;
+  long    downloads      = 0;
+  std::vector<int64_t> updatedAt;
+  int     notUpdated     = 0;
+  int64_t firstCheckMax  = 0;
+  int     earlyRetries   = 0;   // came back before Retry-After
+  uint32_t longestBackoff = 0;
+  long    servedFailures = 0;   // failed answers the server gave
+  long    misread        = 0;   // answers the knob read as something else
+};
+
+static Report run(const Config &cfg, const Policy &policy, Loopback* lb) {
+  rngState = cfg.seed * 0x9E3779B97F4A7C15ull + 1;
+  const int64_t endMs     = (int64_t)(cfg.hours * 3600e3);
+  const int64_t publishMs = (int64_t)(cfg.publishS * 1e3);
+  std::vector<Device> dev(cfg.devices);
+  std::priority_queue<Event> q;
+  Report rep;
+  for (int i = 0; i < cfg.devices; i++) {
+    snprintf(dev[i].mac, sizeof(dev[i].mac), "24:6F:28:%02X:%02X:%02X", (i >> 16) & 0xFF,
+             (i >> 8) & 0xFF, i & 0xFF);
+  }
+
+  std::vector<int> perSecond((size_t)(endMs / 1000) + 1, 0);
+  int inFlight = 0, downloads = 0;
+
+  for (int i = 0; i < cfg.devices; i++) {
+    int64_t at = firstCheck(policy, dev[i]);
+    rep.firstCheckMax = std::max(rep.firstCheckMax, at);
+    q.push({ at, i, EV_CHECK });
+  }
+
+  auto schedule = [&](int i, int64_t now, OtaCheckResult r, uint32_t retryAfterMs) {
+    uint32_t delay = nextCheck(policy, dev[i], r, retryAfterMs);
+    if (r == OTA_CHECK_FAILED && delay > rep.longestBackoff) rep.longestBackoff = delay;
+    q.push({ now + delay, i, EV_CHECK });
+  };
+
+  // Reply time: median latency, spread by a factor of about e^0.5
+  auto replyMs = [&]() {
+    double z = sqrt(-2 * log(uniform())) * cos(6.283185307 * uniform());
+    return (int64_t)(cfg.latencyMs * exp(0.5 * z)) + 1;
+  };
+
+  while (!q.empty() && q.top().at < endMs) {
+    Event e = q.top();
+    q.pop();
+    Device &d = dev[e.device];
+    switch (e.type) {
+      case EV_CHECK:
+        rep.requests++;
+        d.checks++;
+        perSecond[e.at / 1000]++;
+        if (e.at < d.notBefore) rep.earlyRetries++;
+        if (inFlight >= cfg.capacity) {
+          rep.rejected++;
+          uint32_t hint = (uint32_t)cfg.retryAfterS * 1000;
+          if (policy.staggered) d.notBefore = e.at + hint;
+          Version latest;
+          uint32_t retryAfterMs = 0;
+          OtaCheckResult r = ask(lb, { 503, (uint32_t)cfg.retryAfterS, "" }, d, latest, retryAfterMs);
+          if (r != OTA_CHECK_THROTTLED || retryAfterMs != hint) rep.misread++;
+          schedule(e.device, e.at, r, retryAfterMs);
+          break;
+        }
+        inFlight++;
+        rep.peakInFlight = std::max(rep.peakInFlight, inFlight);
+        q.push({ e.at + replyMs(), e.device, EV_REPLY });
+        break;
+
+      case EV_REPLY: {
+        inFlight--;
+        bool fail = uniform() < cfg.failRate;
+        rep.servedFailures += fail;
+        Answer a = fail ? failedAnswer() : versionAnswer(e.at >= publishMs ? "1.0.1" : "1.0.0");
+        Version latest;
+        uint32_t retryAfterMs = 0;
+        OtaCheckResult r = ask(lb, a, d, latest, retryAfterMs);
+        if ((r == OTA_CHECK_FAILED) != fail) rep.misread++;
+        if (r == OTA_CHECK_UP_TO_DATE && isVersionNewer(d.version.c_str(), latest.c_str())) {
+          // Newer firmware: download at this knob's share of the egress
+          d.offered = latest;
+          downloads++;
+          rep.downloads++;
+          rep.peakDownloads = std::max(rep.peakDownloads, downloads);
+          double kbs = cfg.bandwidthKbs / downloads;
+          q.push({ e.at + (int64_t)(cfg.sizeKb / kbs * 1000), e.device, EV_DOWNLOADED });
+        } else {
+          rep.failed += r == OTA_CHECK_FAILED;
+          schedule(e.device, e.at, r, retryAfterMs);
+        }
+        break;
+      }
+
+      case EV_DOWNLOADED:
+        downloads--;
+        if (uniform() < cfg.failRate) {
+          rep.failed++;
+          schedule(e.device, e.at, OTA_CHECK_FAILED, 0);
+        } else {
+          d.version   = d.offered;
+          d.updated   = true;
+          d.updatedAt = e.at;
+          rep.updatedAt.push_back(e.at);
+          q.push({ e.at + 5000, e.device, EV_BOOT });
+        }
+        break;
+
+      case EV_BOOT:
+        q.push({ e.at + firstCheck(policy, d), e.device, EV_CHECK });
+        break;
+    }
+  }
+
+  for (size_t s = 0; s < perSecond.size(); s++) {
+    rep.peakPerSecond = std::max(rep.peakPerSecond, perSecond[s]);
+    if (s % 60 == 0) {
+      int minute = 0;
+      for (size_t k = s; k < s + 60 && k < perSecond.size(); k++) minute += perSecond[k];
+      rep.peakPerMinute = std::max(rep.peakPerMinute, minute);
+    }
+  }
+  for (const Device &d : dev) rep.notUpdated += !d.updated;
+  std::sort(rep.updatedAt.begin(), rep.updatedAt.end());
+  return rep;
+}
+
+static double pctS(const std::vector<int64_t> &v, double p) {
+  if (v.empty()) return NAN;
+  size_t k = (size_t)std::min<double>(v.size() - 1, ceil(p * v.size()) - 1);
+  return v[k] / 1000.0;
+}
+
+static void print(const Policy &p, const Report &r) {
+  printf("%-26s %9ld %7ld %7ld %7d %7d %7d %7d %8.0f %8.0f %8.0f %5d\n", p.name, r.requests,
+         r.rejected, r.failed, r.peakPerSecond, r.peakPerMinute, r.peakInFlight, r.peakDownloads,
+         pctS(r.updatedAt, 0.5), pctS(r.updatedAt, 0.9), pctS(r.updatedAt, 1.0), r.notUpdated);
+}
+
+int main(int argc, char** argv) {
+  Config cfg;
+  for (int i = 1; i < argc; i++) {
+    const char* k = argv[i];
+    if (!strcmp(k, "--loopback")) {
+      cfg.loopback = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      fprintf(stderr, "%s needs a value\n", k);
+      return 2;
+    }
+    double v = atof(argv[++i]);
+    if      (!strcmp(k, "-n"))            cfg.devices      = (int)v;
+    else if (!strcmp(k, "--hours"))       cfg.hours        = v;
+    else if (!strcmp(k, "--latency"))     cfg.latencyMs    = v;
+    else if (!strcmp(k, "--fail"))        cfg.failRate     = v;
+    else if (!strcmp(k, "--capacity"))    cfg.capacity     = (int)v;
+    else if (!strcmp(k, "--retry-after")) cfg.retryAfterS  = (int)v;
+    else if (!strcmp(k, "--size"))        cfg.sizeKb       = v;
+    else if (!strcmp(k, "--bandwidth"))   cfg.bandwidthKbs = v;
+    else if (!strcmp(k, "--publish"))     cfg.publishS     = v;
+    else if (!strcmp(k, "--seed"))        cfg.seed         = (uint64_t)v;
+    else {
+      fprintf(stderr, "unknown option %s\n", k);
+      return 2;
+    }
+  }
+  if (cfg.devices < 1 || cfg.capacity < 1 || cfg.bandwidthKbs <= 0) {
+    fprintf(stderr, "need at least one device, capacity and bandwidth\n");
+    return 2;
+  }
+
+  printf("%d knobs, %.0f h, reply %.0f ms, fail %.0f%%, capacity %d, Retry-After %d s, "
+         "image %.0f kB at %.0f kB/s shared, published at %.0f s\n\n",
+         cfg.devices, cfg.hours, cfg.latencyMs, cfg.failRate * 100, cfg.capacity, cfg.retryAfterS,
+         cfg.sizeKb, cfg.bandwidthKbs, cfg.publishS);
+  printf("%-26s %9s %7s %7s %7s %7s %7s %7s %8s %8s %8s %5s\n", "schedule", "requests", "503",
+         "failed", "peak/s", "peak/m", "inflt", "dl", "upd p50", "upd p90", "upd max", "stuck");
+
+  Policy staggered = { "staggered (otaschedule.h)", true };
+  Policy oldSched  = { "check at boot, 30 s retry", false };
+  Loopback lb;
+  if (cfg.loopback && !mockStart(lb.server)) return 1;
+  Loopback* via = cfg.loopback ? &lb : nullptr;
+  Report a = run(cfg, staggered, via);
+  Report b = run(cfg, oldSched, via);
+  print(staggered, a);
+  print(oldSched, b);
+  printf("\n(updated times in seconds after the power cut; inflt = version requests in flight,\n"
+         " dl = downloads in flight, stuck = knobs not updated by the end)\n");
+  if (cfg.loopback) {
+    mockStop(lb.server);
+    Report same = run(cfg, staggered, nullptr);
+    bool matches = same.requests == a.requests && same.rejected == a.rejected &&
+                   same.failed == a.failed && same.updatedAt == a.updatedAt;
+    printf("\nloopback: %ld GETs served on 127.0.0.1:%u, %ld not the version URL, %ld socket errors;\n"
+           "staggered run %s the in-process one\n",
+           lb.server.served, (unsigned)lb.server.port, lb.badRequests, lb.socketErrors,
+           matches ? "matches" : "differs from");
+    check(lb.server.served == a.requests + b.requests, "every check reached the mock server");
+    check(lb.badRequests == 0 && lb.socketErrors == 0, "every request is the knob's version URL");
+    check(matches, "over HTTP the run comes out as in-process");
+  }
+
+  check(a.firstCheckMax < (int64_t)OTA_BOOT_JITTER_MAX_MS, "first checks inside the boot jitter window");
+  check(a.earlyRetries == 0, "no knob comes back before Retry-After");
+  check(a.longestBackoff <= OTA_BACKOFF_MAX_MS, "backoff stays under its cap");
+  check(a.misread == 0 && b.misread == 0 && a.servedFailures > 0, "every failed answer reads as a failure");
+  check(a.notUpdated == 0, "the whole fleet updates");
+  if (cfg.devices >= 100) {
+    check(a.peakPerSecond * 4 <= b.peakPerSecond, "staggering cuts the peak request rate by 4x or more");
+  }
+  printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
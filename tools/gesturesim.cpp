@@ -0,0 +1,257 @@
+// =============================================================
+// gesturesim — the button recognizer against scripted presses
+//
+//   g++ -O2 -std=c++17 -Wall -o gesturesim tools/gesturesim.cpp
+//   ./gesturesim [-v]   (-v lists what each script produced)
+//
+// Runs the device's gesturecode.h the way gestures.h does: button
+// edges are timestamped as they happen and handed over, with the
+// encoder counter, on the next 10 ms tick, followed by the tick's
+// deadlines.
+//
+//  - scripts: click, long press, double click, two slow clicks,
+//    click with the double-click window, chord, consumed press,
+//    hold-repeat and pure contact bounce, each with the gestures
+//    it must give
+//  - random sessions: 20000 clicks, long presses and double clicks
+//    with 0-3 contact bounces on every edge; each must come out as
+//    the gesture that was played, and nothing else
+//  - latency from the deciding edge to the gesture, per kind
+//
+// Exits non-zero if any gesture is missing, extra or wrong.
+// =============================================================
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../gesturecode.h"
+
+static const uint32_t TICK_MS = 10;   // GESTURE_TICK_US
+
+// A scripted input: button down/up, a detent turned (counter += 2),
+// or loop() consuming the press
+enum InputKind { IN_DOWN, IN_UP, IN_TURN, IN_CONSUME };
+
+struct Input {
+  uint32_t  ms;
+  InputKind kind;
+};
+
+struct Fired {
+  uint32_t ms;
+  uint8_t  bits;
+};
+
+static const char* gestureName(uint8_t bit) {
+  switch (bit) {
+    case GESTURE_DOWN:   return "down";
+    case GESTURE_CLICK:  return "click";
+    case GESTURE_LONG:   return "long";
+    case GESTURE_DOUBLE: return "double";
+    case GESTURE_REPEAT: return "repeat";
+    default:             return "?";
+  }
+}
+
+// The gestures.h loop: edges since the last tick, then the deadlines
+static std::vector<Fired> run(uint8_t mask, const std::vector<Input> &inputs, uint32_t endMs) {
+  GestureRecognizer g;
+  g.mask = mask;
+  std::vector<Fired> out;
+  int counter = 0;
+  size_t next = 0;
+  std::vector<Input> ring;   // edges waiting for the tick
+  for (uint32_t now = 0; now <= endMs; now++) {
+    for (; next < inputs.size() && inputs[next].ms == now; next++) {
+      const Input &in = inputs[next];
+      if (in.kind == IN_TURN)         counter += 2;
+      else if (in.kind == IN_CONSUME) g.consumed = true;
+      else                            ring.push_back(in);
+    }
+    if (now % TICK_MS) continue;
+    uint8_t bits = 0;
+    for (const Input &e : ring) bits |= g.edge(e.ms, e.kind == IN_DOWN, counter);
+    ring.clear();
+    bits |= g.tick(now, counter);
+    if (bits) out.push_back({ now, bits });
+  }
+  return out;
+}
+
+static std::string describe(const std::vector<Fired> &fired) {
+  std::string s;
+  for (const Fired &f : fired) {
+    for (uint8_t bit = 1; bit; bit <<= 1) {
+      if (!(f.bits & bit)) continue;
+      if (!s.empty()) s += ' ';
+      s += gestureName(bit);
+    }
+  }
+  return s;
+}
+
+// -------------------
+// Scripts
+// -------------------
+struct Script {
+  const char*        name;
+  uint8_t            mask;
+  std::vector<Input> inputs;
+  const char*        expect;
+};
+
+static const uint8_t MASK_BASIC  = GESTURE_CLICK | GESTURE_LONG;
+static const uint8_t MASK_DOUBLE = GESTURE_CLICK | GESTURE_LONG | GESTURE_DOUBLE;
+
+static bool runScripts(bool verbose) {
+  const Script scripts[] = {
+    { "click", MASK_BASIC, { { 3, IN_DOWN }, { 123, IN_UP } }, "down click" },
+    { "click, bouncy contacts", MASK_BASIC,
+      { { 3, IN_DOWN }, { 4, IN_UP }, { 6, IN_DOWN }, { 150, IN_UP }, { 151, IN_DOWN }, { 153, IN_UP } },
+      "down click" },
+    { "long press", MASK_BASIC, { { 3, IN_DOWN }, { 2600, IN_UP } }, "down long" },
+    { "double click", MASK_DOUBLE,
+      { { 3, IN_DOWN }, { 100, IN_UP }, { 200, IN_DOWN }, { 290, IN_UP } }, "down down double" },
+    { "two slow clicks", MASK_DOUBLE,
+      { { 3, IN_DOWN }, { 100, IN_UP }, { 500, IN_DOWN }, { 600, IN_UP } }, "down click down click" },
+    { "double click, mode ignores doubles", MASK_BASIC,
+      { { 3, IN_DOWN }, { 100, IN_UP }, { 200, IN_DOWN }, { 290, IN_UP } }, "down click down click" },
+    { "chord", MASK_BASIC | GESTURE_CHORD,
+      { { 3, IN_DOWN }, { 300, IN_TURN }, { 2500, IN_UP } }, "down" },
+    { "turn while held, no chords", MASK_BASIC,
+      { { 3, IN_DOWN }, { 300, IN_TURN }, { 600, IN_UP } }, "down click" },
+    { "consumed press", MASK_BASIC,
+      { { 3, IN_DOWN }, { 30, IN_CONSUME }, { 2500, IN_UP } }, "down" },
+    { "hold-repeat", GESTURE_CLICK | GESTURE_REPEAT, { { 0, IN_DOWN }, { 1000, IN_UP } },
+      "down repeat repeat repeat repeat repeat" },
+    { "short tap with repeat", GESTURE_CLICK | GESTURE_REPEAT, { { 0, IN_DOWN }, { 200, IN_UP } },
+      "down click" },
+    { "contact bounce only", MASK_DOUBLE, { { 3, IN_DOWN }, { 8, IN_UP } }, "" },
+  };
+
+  int failures = 0;
+  for (const Script &s : scripts) {
+    std::string got = describe(run(s.mask, s.inputs, s.inputs.back().ms + 1000));
+    bool ok = got == s.expect;
+    if (!ok) {
+      printf("FAIL %-36s got \"%s\", want \"%s\"\n", s.name, got.c_str(), s.expect);
+      failures++;
+    } else if (verbose) {
+      printf("  ok %-36s %s\n", s.name, got.c_str());
+    }
+  }
+  printf("scripts: %zu, %d failed\n", sizeof(scripts) / sizeof(scripts[0]), failures);
+  return failures == 0;
+}
+
+// -------------------
+// Random sessions
+// -------------------
+static uint32_t rng = 88172645u;
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+static uint32_t between(uint32_t lo, uint32_t hi) { return lo + next() % (hi - lo + 1); }
+
+// One clean edge plus 0-3 bounces, all within the debounce time
+static void addEdge(std::vector<Input> &in, uint32_t ms, bool down) {
+  in.push_back({ ms, down ? IN_DOWN : IN_UP });
+  uint32_t t = ms;
+  for (uint32_t n = next() % 4; n; n--) {
+    t += between(1, 3);
+    in.push_back({ t, down ? IN_UP : IN_DOWN });
+    t += between(1, 3);
+    in.push_back({ t, down ? IN_DOWN : IN_UP });
+  }
+}
+
+struct Latency {
+  const char* name;
+  std::vector<uint32_t> ms;
+  explicit Latency(const char* n) : name(n) {}
+  void print() const {
+    if (ms.empty()) return;
+    std::vector<uint32_t> s = ms;
+    std::sort(s.begin(), s.end());
+    printf("  %-28s %6zu  p50 %4u ms  max %4u ms\n", name, s.size(), s[s.size() / 2], s.back());
+  }
+};
+
+static bool runRandom(int presses) {
+  Latency clickLat{ "click (no double window)" }, clickDblLat{ "click (double window)" },
+          longLat{ "long (from press)" }, doubleLat{ "double" };
+  int wrong = 0;
+  for (int i = 0; i < presses; i++) {
+    uint8_t mask = (next() & 1) ? MASK_DOUBLE : MASK_BASIC;
+    int kind = next() % 3;   // 0 click, 1 long, 2 double
+    if (kind == 2 && mask != MASK_DOUBLE) kind = 0;
+    std::vector<Input> in;
+    uint32_t t = between(0, 9), decide = 0;
+    uint8_t want = 0;
+    if (kind == 0) {
+      addEdge(in, t, true);
+      decide = t + between(40, 350);
+      addEdge(in, decide, false);
+      want = GESTURE_CLICK;
+    } else if (kind == 1) {
+      addEdge(in, t, true);
+      decide = t;
+      addEdge(in, t + between(GESTURE_LONG_MS + 50, GESTURE_LONG_MS + 1500), false);
+      want = GESTURE_LONG;
+    } else {
+      addEdge(in, t, true);
+      uint32_t up = t + between(40, 150);
+      addEdge(in, up, false);
+      uint32_t down2 = up + between(40, GESTURE_DOUBLE_WINDOW_MS - 30);
+      addEdge(in, down2, true);
+      decide = down2 + between(40, 150);
+      addEdge(in, decide, false);
+      want = GESTURE_DOUBLE;
+    }
+    std::sort(in.begin(), in.end(), [](const Input &a, const Input &b) { return a.ms < b.ms; });
+    std::vector<Fired> fired = run(mask, in, in.back().ms + 1000);
+
+    uint8_t got = 0;
+    uint32_t at = 0;
+    int count = 0;
+    for (const Fired &f : fired) {
+      uint8_t g = f.bits & (GESTURE_CLICK | GESTURE_LONG | GESTURE_DOUBLE);
+      if (!g) continue;
+      got |= g;
+      at = f.ms;
+      count++;
+    }
+    if (got != want || count != 1) {
+      if (wrong++ < 5) {
+        printf("FAIL random press %d: played %s, got \"%s\"\n", i, gestureName(want),
+               describe(fired).c_str());
+      }
+      continue;
+    }
+    uint32_t lat = at - decide;
+    if (want == GESTURE_CLICK) (mask == MASK_DOUBLE ? clickDblLat : clickLat).ms.push_back(lat);
+    if (want == GESTURE_LONG)   longLat.ms.push_back(lat);
+    if (want == GESTURE_DOUBLE) doubleLat.ms.push_back(lat);
+  }
+  printf("random: %d presses with bouncy contacts, %d wrong\n", presses, wrong);
+  printf("latency (deciding edge to gesture, %u ms tick):\n", (unsigned)TICK_MS);
+  clickLat.print();
+  clickDblLat.print();
+  longLat.print();
+  doubleLat.print();
+  return wrong == 0;
+}
+
+int main(int argc, char** argv) {
+  bool verbose = argc >= 2 && strcmp(argv[1], "-v") == 0;
+  bool ok = runScripts(verbose);
+  ok &= runRandom(20000);
+  printf("\n%s\n", ok ? "all checks passed" : "FAILED");
+  return ok ? 0 : 1;
+}
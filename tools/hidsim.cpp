@@ -0,0 +1,276 @@
+// =============================================================
+// hidsim — check the composite HID report map and count reports
+//
+//   g++ -O2 -std=c++17 -o hidsim tools/hidsim.cpp
+//   ./hidsim
+//
+// Uses the device's hidreports.h unchanged:
+//
+//  - parses hidReportMap like a host would and checks each report
+//    id's input size and the dial's range and units
+//  - checks the report encoding: ASCII and modifier keys, the
+//    six-key limit, media bits, dial packing for every delta and
+//    splitting of long turns
+//  - replays volume gestures through loop()'s handling with a mock
+//    sink: media keys (a tap per pass) against the dial (one report
+//    with the whole turn), counting reports, the time they hold
+//    loop() (HID_REPORT_GAP_MS each, as blehid.h waits) and the
+//    volume steps the host ends up applying
+//
+// Exits non-zero if a check fails.
+// =============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../hidreports.h"
+
+static const uint32_t REPORT_GAP_MS = 7;    // blehid.h HID_REPORT_GAP_MS
+static const uint32_t LOOP_MS       = 5;    // a loop() pass without reports
+static const int      STEPS_PER_DETENT = 2;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// -------------------
+// Report map
+// -------------------
+struct MapInfo {
+  uint32_t inputBits[4]  = {};
+  uint32_t outputBits[4] = {};
+  int      depth         = 0;
+  bool     balanced      = true;
+  int32_t  dialMin = 0, dialMax = 0;
+  uint32_t dialBits = 0, dialUnit = 0;
+  bool     dialRelative = false;
+};
+
+static int32_t itemValue(const uint8_t* p, uint8_t n, bool sign) {
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < n; i++) v |= (uint32_t)p[i] << (8 * i);
+  if (sign && n && n < 4 && (v & (1u << (8 * n - 1)))) v |= ~0u << (8 * n);
+  return (int32_t)v;
+}
+
+static MapInfo parseMap(const uint8_t* map, size_t len) {
+  MapInfo info;
+  uint32_t size = 0, count = 0, id = 0, usagePage = 0, unit = 0;
+  int32_t  logMin = 0, logMax = 0;
+  std::vector<uint32_t> usages;
+  for (size_t i = 0; i < len;) {
+    uint8_t b = map[i];
+    uint8_t n = (b & 3) == 3 ? 4 : (b & 3);
+    const uint8_t* data = map + i + 1;
+    uint8_t item = b & 0xFC;
+    uint32_t u = (uint32_t)itemValue(data, n, false);
+    int32_t  s = itemValue(data, n, true);
+    switch (item) {
+      case 0x04: usagePage = u; break;   // Usage Page
+      case 0x14: logMin = s; break;      // Logical Minimum
+      case 0x24: logMax = s; break;      // Logical Maximum
+      case 0x64: unit = u; break;        // Unit
+      case 0x74: size = u; break;        // Report Size
+      case 0x84: id = u; break;          // Report ID
+      case 0x94: count = u; break;       // Report Count
+      case 0x08: usages.push_back((usagePage << 16) | u); break;
+      case 0x80:                         // Input
+        if (id < 4) info.inputBits[id] += size * count;
+        if (id == HID_REPORT_DIAL && !usages.empty() && usages.back() == 0x00010037) {
+          info.dialMin = logMin;
+          info.dialMax = logMax;
+          info.dialBits = size;
+          info.dialUnit = unit;
+          info.dialRelative = (u & 0x04) != 0;
+        }
+        usages.clear();
+        break;
+      case 0x90:                         // Output
+        if (id < 4) info.outputBits[id] += size * count;
+        usages.clear();
+        break;
+      case 0xA0: info.depth++; usages.clear(); break;   // Collection
+      case 0xC0:                                        // End Collection
+        if (--info.depth < 0) info.balanced = false;
+        break;
+    }
+    i += 1 + n;
+  }
+  if (info.depth != 0) info.balanced = false;
+  return info;
+}
+
+static void checkMap() {
+  MapInfo m = parseMap(hidReportMap, sizeof(hidReportMap));
+  printf("report map: %zu bytes, input bits keyboard %u media %u dial %u, output bits keyboard %u\n",
+         sizeof(hidReportMap), m.inputBits[1], m.inputBits[2], m.inputBits[3], m.outputBits[1]);
+  check(m.balanced, "collections balance");
+  check(m.inputBits[HID_REPORT_KEYBOARD] == 8 * sizeof(HidKeyReport), "keyboard report is 8 bytes");
+  check(m.inputBits[HID_REPORT_MEDIA] == 16, "media report is 2 bytes");
+  check(m.inputBits[HID_REPORT_DIAL] == 16, "dial report is 2 bytes");
+  check(m.outputBits[HID_REPORT_KEYBOARD] == 8, "LED output is 1 byte");
+  check(m.dialBits == 15 && m.dialRelative, "dial is a 15-bit relative field");
+  check(m.dialMin == -HID_DIAL_MAX && m.dialMax == HID_DIAL_MAX, "dial range is +-HID_DIAL_MAX");
+  check(m.dialUnit == 0x14, "dial unit is degrees");
+}
+
+// -------------------
+// Mock sink
+// -------------------
+struct Sent {
+  uint8_t id;
+  uint8_t data[8];
+  uint8_t len;
+};
+
+struct MockSink {
+  std::vector<Sent> reports;
+
+  static void sink(void* ctx, uint8_t id, const uint8_t* data, uint8_t len) {
+    Sent s = { id, {}, len };
+    memcpy(s.data, data, len);
+    ((MockSink*)ctx)->reports.push_back(s);
+  }
+};
+
+static void checkEncoding() {
+  MockSink mock;
+  HidReportState hid(MockSink::sink, &mock);
+
+  hid.press('A');
+  check(mock.reports.size() == 1 && mock.reports[0].id == HID_REPORT_KEYBOARD, "press sends a keyboard report");
+  check(hid.keys().modifiers == 0x02 && hid.keys().keys[0] == 0x04, "'A' is shift + a");
+  hid.release('A');
+  check(hid.keys().modifiers == 0 && hid.keys().keys[0] == 0, "release clears key and shift");
+
+  hid.press(0x83);   // KEY_LEFT_GUI
+  check(hid.keys().modifiers == 0x08, "KEY_LEFT_GUI sets the GUI modifier");
+  hid.press(0xDA);   // KEY_UP_ARROW
+  check(hid.keys().keys[0] == 0xDA - 136, "KEY_UP_ARROW is usage 0x52");
+  hid.releaseAll();
+  check(hid.keys().modifiers == 0 && hid.keys().keys[0] == 0, "releaseAll clears");
+
+  const char* six = "abcdef";
+  for (const char* c = six; *c; c++) hid.press((uint8_t)*c);
+  check(hid.press('g') == 0, "a seventh key is refused");
+  check(hid.press(0x1B) == 0, "a character with no key is refused");
+  hid.releaseAll();
+
+  mock.reports.clear();
+  const uint8_t volUp[2] = { 32, 0 };
+  hid.writeMedia(volUp);
+  check(mock.reports.size() == 2 && mock.reports[0].data[0] == 32 && mock.reports[1].data[0] == 0,
+        "a media tap is press + release");
+
+  bool packOk = true;
+  for (int d = -HID_DIAL_MAX; d <= HID_DIAL_MAX; d++) {
+    for (int b = 0; b < 2; b++) {
+      uint8_t r[2];
+      hidPackDial(r, b, (int16_t)d);
+      if (hidDialDelta(r) != d || (r[0] & 1) != b) packOk = false;
+    }
+  }
+  check(packOk, "dial packing round-trips every delta");
+
+  mock.reports.clear();
+  check(hid.rotate(9000) == 3, "a 900 degree turn is split in three");
+  int32_t sum = 0;
+  for (const Sent &s : mock.reports) sum += hidDialDelta(s.data);
+  check(sum == 9000, "split reports add up");
+  check(hid.rotate(0) == 0, "no turn, no report");
+}
+
+// -------------------
+// Volume gestures
+// -------------------
+struct Gesture {
+  const char* name;
+  int         detents;
+  uint32_t    ms;   // over this long, evenly
+};
+
+static const Gesture gestures[] = {
+  { "one detent",              1,   0 },
+  { "slow turn, 5 detents",    5, 1500 },
+  { "medium turn, 10 detents", 10, 600 },
+  { "fast spin, 20 detents",   20, 250 },
+  { "spin back, -30 detents", -30, 300 },
+};
+
+struct Outcome {
+  uint32_t reports;
+  uint32_t busyMs;        // loop() held in report gaps
+  int32_t  hostSteps;     // volume steps the host applied
+  uint32_t passes;
+};
+
+// loop()'s volume handling: per pass, whatever the counter moved
+static Outcome runGesture(const Gesture &g, bool dial) {
+  MockSink mock;
+  HidReportState hid(MockSink::sink, &mock);
+  int steps = g.detents * STEPS_PER_DETENT;
+  int n = abs(steps), dir = steps > 0 ? 1 : -1;
+
+  Outcome out = {};
+  uint32_t t = 0;
+  int seen = 0;
+  int32_t dialTenths = 0;
+  for (;;) {
+    int arrived = n <= 1 || g.ms == 0 ? n : (int)((uint64_t)t * (n - 1) / g.ms) + 1;
+    if (arrived > n) arrived = n;
+    int delta = (arrived - seen) * dir;
+    size_t before = mock.reports.size();
+    if (delta) {
+      out.passes++;
+      if (dial) {
+        hid.rotate(delta * HID_DIAL_TENTHS_PER_STEP);
+      } else {
+        const uint8_t up[2] = { 32, 0 }, down[2] = { 64, 0 };
+        hid.writeMedia(delta > 0 ? up : down);
+        out.hostSteps += delta > 0 ? 1 : -1;
+      }
+      seen = arrived;
+    }
+    uint32_t sent = (uint32_t)(mock.reports.size() - before);
+    out.busyMs += sent * REPORT_GAP_MS;
+    t += LOOP_MS + sent * REPORT_GAP_MS;
+    if (seen == n && t > g.ms) break;
+  }
+  out.reports = (uint32_t)mock.reports.size();
+  if (dial) {
+    for (const Sent &s : mock.reports) dialTenths += hidDialDelta(s.data);
+    out.hostSteps = dialTenths / (STEPS_PER_DETENT * HID_DIAL_TENTHS_PER_STEP);
+  }
+  return out;
+}
+
+static void compareGestures() {
+  printf("\n%-26s %-22s %-22s\n", "gesture", "media keys", "dial");
+  printf("%-26s %-22s %-22s\n", "", "reports  busy  steps", "reports  busy  steps");
+  uint32_t mediaReports = 0, dialReports = 0;
+  for (const Gesture &g : gestures) {
+    Outcome k = runGesture(g, false);
+    Outcome d = runGesture(g, true);
+    mediaReports += k.reports;
+    dialReports  += d.reports;
+    printf("%-26s %5u %5ums %6d   %5u %5ums %6d\n", g.name, k.reports, k.busyMs, k.hostSteps,
+           d.reports, d.busyMs, d.hostSteps);
+    check(d.hostSteps == g.detents, "the dial conveys every detent");
+    check(d.reports <= k.reports, "the dial never sends more reports");
+  }
+  printf("total reports: media keys %u, dial %u\n", mediaReports, dialReports);
+}
+
+int main() {
+  checkMap();
+  checkEncoding();
+  compareGestures();
+  printf("\n%s (%d failed)\n", failures ? "FAILED" : "all checks passed", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+// =============================================================
+// hscompress — heatshrink-format compressor for OTA transport
+//
+//   g++ -O2 -std=c++17 -o hscompress tools/hscompress.cpp
+//   ./hscompress [-w 10] [-l 4] in.bin out.hs     compress + report
+//   ./hscompress -d [-w 10] [-l 4] in.hs out.bin  decompress
+//
+// Serve out.hs with "Content-Encoding: heatshrink-<w>-<l>" (and
+// "X-Decoded-Length: <size of in.bin>" for raw images). The output
+// is bit-compatible with the heatshrink CLI using the same -w/-l,
+// and is decoded on the device by HeatshrinkStream
+// (heatshrinkstream.h), whose RAM cost is one 2^w byte window.
+//
+// Decoding here (-d, and the round-trip check) runs that same class
+// over a minimal host Stream, so the report's decode throughput and
+// peak RAM (the object's sizeof plus its static window) are the
+// device decoder's, not a copy's.
+// =============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static const int MAX_CHAIN = 256;   // match candidates examined per position
+
+static bool readFile(const char* path, Bytes &out) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) return false;
+  out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  return true;
+}
+
+static bool writeFile(const char* path, const Bytes &data) {
+  std::ofstream f(path, std::ios::binary);
+  f.write((const char*)data.data(), data.size());
+  return (bool)f;
+}
+
+// -------------------
+// MSB-first bit writer
+// -------------------
+struct BitWriter {
+  Bytes   &out;
+  uint32_t acc   = 0;
+  int      nbits = 0;
+
+  explicit BitWriter(Bytes &o) : out(o) {}
+
+  void put(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      acc = (acc << 1) | ((value >> i) & 1);
+      if (++nbits == 8) {
+        out.push_back((uint8_t)acc);
+        acc = 0;
+        nbits = 0;
+      }
+    }
+  }
+
+  void flush() {
+    if (nbits > 0) out.push_back((uint8_t)(acc << (8 - nbits)));
+    acc = 0;
+    nbits = 0;
+  }
+};
+
+// -------------------
+// Greedy LZSS with 2-byte hash chains
+// -------------------
+static Bytes compress(const Bytes &in, int w, int l) {
+  const size_t window   = (size_t)1 << w;
+  const size_t maxLen   = (size_t)1 << l;
+  // A back-reference costs 1+w+l bits, a literal 9 bits per byte.
+  const size_t minLen   = (size_t)(1 + w + l) / 9 + 1;
+
+  std::vector<int32_t> head(65536, -1);
+  std::vector<int32_t> prev(in.size(), -1);
+  auto key = [&](size_t i) { return (in[i] << 8) | in[i + 1]; };
+
+  Bytes out;
+  BitWriter bw(out);
+  size_t i = 0;
+  auto insert = [&](size_t pos) {
+    if (pos + 1 < in.size()) {
+      int k = key(pos);
+      prev[pos] = head[k];
+      head[k]   = (int32_t)pos;
+    }
+  };
+
+  while (i < in.size()) {
+    size_t bestLen = 0, bestDist = 0;
+    if (i + 1 < in.size()) {
+      int32_t cand = head[key(i)];
+      for (int chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++, cand = prev[cand]) {
+        size_t dist = i - cand;
+        if (dist > window) break;
+        size_t len = 0;
+        while (len < maxLen && i + len < in.size() && in[cand + len] == in[i + len]) len++;
+        if (len > bestLen) {
+          bestLen  = len;
+          bestDist = dist;
+          if (len == maxLen) break;
+        }
+      }
+    }
+
+    if (bestLen >= minLen) {
+      bw.put(0, 1);
+      bw.put((uint32_t)(bestDist - 1), w);
+      bw.put((uint32_t)(bestLen - 1), l);
+      for (size_t k = 0; k < bestLen; k++) insert(i + k);
+      i += bestLen;
+    } else {
+      bw.put(1, 1);
+      bw.put(in[i], 8);
+      insert(i);
+      i++;
+    }
+  }
+  bw.flush();
+  return out;
+}
+
+// -------------------
+// Decoder: the device's HeatshrinkStream over a host Stream
+// -------------------
+// Just the part of Arduino's Print/Stream that HeatshrinkStream
+// uses, with the same members, so sizeof comes out as on the knob
+// (bar pointer width)
+class Stream {
+ public:
+  virtual ~Stream() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length) = 0;
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+
+ protected:
+  int           write_error  = 0;
+  unsigned long _timeout     = 1000;
+  unsigned long _startMillis = 0;
+};
+
+#include "../heatshrinkstream.h"
+
+// The compressed body, as the HTTP stream hands it over
+class MemStream : public Stream {
+ public:
+  explicit MemStream(const Bytes &b) : data_(b) {}
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return (int)(data_.size() - pos_); }
+  int read() override { return pos_ < data_.size() ? data_[pos_++] : -1; }
+  int peek() override { return pos_ < data_.size() ? data_[pos_] : -1; }
+  using Stream::readBytes;
+  size_t readBytes(char* buffer, size_t length) override {
+    size_t n = std::min(length, data_.size() - pos_);
+    memcpy(buffer, &data_[pos_], n);
+    pos_ += n;
+    return n;
+  }
+
+ private:
+  const Bytes &data_;
+  size_t pos_ = 0;
+};
+
+static const size_t DECODE_CHUNK = 1024;   // DELTA_CHUNK_SIZE: what the installer asks for per read
+
+static Bytes decompress(const Bytes &in, int w, int l, size_t sizeHint) {
+  MemStream src(in);
+  HeatshrinkStream hs(src, (uint32_t)in.size(), (uint8_t)w, (uint8_t)l);
+  Bytes out;
+  out.reserve(sizeHint);
+  uint8_t chunk[DECODE_CHUNK];
+  while (size_t n = hs.readBytes(chunk, sizeof(chunk))) out.insert(out.end(), chunk, chunk + n);
+  return out;
+}
+
+int main(int argc, char** argv) {
+  int w = 10, l = 4;
+  bool decode = false;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    if (strcmp(argv[argi], "-d") == 0) decode = true;
+    else if (strcmp(argv[argi], "-w") == 0 && argi + 1 < argc) w = atoi(argv[++argi]);
+    else if (strcmp(argv[argi], "-l") == 0 && argi + 1 < argc) l = atoi(argv[++argi]);
+    else break;
+  }
+  if (argc - argi != 2 || w < 4 || w > 11 || l < 3 || l >= w) {
+    fprintf(stderr, "usage: hscompress [-d] [-w 4..11] [-l 3..w-1] in out\n");
+    return 2;
+  }
+
+  Bytes in;
+  if (!readFile(argv[argi], in)) {
+    fprintf(stderr, "hscompress: cannot read %s\n", argv[argi]);
+    return 1;
+  }
+
+  if (decode) {
+    writeFile(argv[argi + 1], decompress(in, w, l, in.size() * 2));
+    return 0;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  Bytes packed = compress(in, w, l);
+  auto t1 = std::chrono::steady_clock::now();
+  const int rounds = 5;
+  Bytes check;
+  for (int r = 0; r < rounds; r++) check = decompress(packed, w, l, in.size());
+  auto t2 = std::chrono::steady_clock::now();
+
+  // Trailing zero-padding can decode as extra literal bits only if
+  // they form a whole token, which 1..7 pad bits never do.
+  if (check != in) {
+    fprintf(stderr, "hscompress: internal error — output does not round-trip\n");
+    return 1;
+  }
+  writeFile(argv[argi + 1], packed);
+
+  double decodeSec = std::chrono::duration<double>(t2 - t1).count() / rounds;
+  printf("encoding   : heatshrink-%d-%d\n", w, l);
+  printf("input      : %zu bytes\n", in.size());
+  printf("output     : %zu bytes (%.1f%% of input, ratio %.2f:1)\n",
+         packed.size(), 100.0 * packed.size() / in.size(), (double)in.size() / packed.size());
+  printf("compress   : %.1f ms\n", std::chrono::duration<double, std::milli>(t1 - t0).count());
+  printf("decompress : %.1f MB/s on this host\n", in.size() / decodeSec / 1e6);
+  printf("device RAM : %zu bytes = HeatshrinkStream %zu + static window %zu (no image buffer;\n"
+         "             sizeof on this host, ESP32 pointers are 4 bytes)\n",
+         sizeof(HeatshrinkStream) + sizeof(heatshrinkWindow), sizeof(HeatshrinkStream),
+         sizeof(heatshrinkWindow));
+  return 0;
+}
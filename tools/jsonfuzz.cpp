@@ -0,0 +1,383 @@
+// =============================================================
+// jsonfuzz — check, fuzz and time the streaming JSON reader
+//
+//   g++ -O2 -std=c++17 -Wall -o jsonfuzz tools/jsonfuzz.cpp
+//   ./jsonfuzz [-n documents]   (default 200000)
+//
+//   (add -fsanitize=address,undefined to run the fuzz under ASan)
+//
+// Uses the device's jsoncode.h over an in-memory stream that hands
+// out bytes in random-sized pieces, as a socket does:
+//
+//  - a table of documents that must parse or must fail, including
+//    trailing commas after nested containers ("[[],]")
+//  - a differential fuzz: seed documents (OTA version replies and
+//    generated ones) mutated byte by byte and fed to both the reader
+//    and a plain recursive-descent parser written here from the
+//    JSON grammar. They must agree on accept or reject, the reader
+//    must never return more tokens than there are bytes, and the
+//    paths and values of a parsed OTA reply must be the right ones.
+//  - the time to pull "data" out of a typical OTA reply
+//
+// Exits non-zero if a check fails.
+// =============================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../jsoncode.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    if (failures < 20) printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static uint32_t rng = 88172645u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// -------------------
+// Input
+// -------------------
+// Bytes in random-sized pieces, like a WiFiClient
+struct MemStream {
+  const uint8_t* p;
+  size_t         n;
+  size_t         i = 0;
+  bool           chunky;
+
+  MemStream(const std::string &s, bool chunky) : p((const uint8_t*)s.data()), n(s.size()), chunky(chunky) {}
+
+  int available() {
+    size_t left = n - i;
+    if (!chunky || left == 0) return (int)left;
+    return (int)(next() % (left + 1));   // sometimes nothing yet
+  }
+
+  size_t readBytes(uint8_t* out, size_t want) {
+    size_t k = want < n - i ? want : n - i;
+    memcpy(out, p + i, k);
+    i += k;
+    return k;
+  }
+};
+
+typedef BasicJsonReader<MemStream> Reader;
+
+// Accepted = reached JSON_END. Counts tokens so a loop shows up.
+static bool readerAccepts(const std::string &doc, bool chunky, bool withLength, size_t &tokens) {
+  MemStream in(doc, chunky);
+  Reader json(in, withLength ? (int32_t)doc.size() : -1);
+  tokens = 0;
+  for (;;) {
+    JsonToken t = json.next();
+    if (t == JSON_END)   return true;
+    if (t == JSON_ERROR) return false;
+    if (++tokens > doc.size() + 2) return false;
+  }
+}
+
+// -------------------
+// Reference parser
+// -------------------
+// Straight from the grammar, with the reader's limits: containers
+// nest at most JSON_MAX_DEPTH deep, and whatever follows the top
+// value is never read.
+struct RefParser {
+  const std::string &s;
+  size_t i     = 0;
+  int    depth = 0;
+
+  explicit RefParser(const std::string &s) : s(s) {}
+
+  int get()  { return i < s.size() ? (uint8_t)s[i++] : -1; }
+  int peek() { return i < s.size() ? (uint8_t)s[i] : -1; }
+
+  int getSkippingWs() {
+    int c;
+    do c = get(); while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    return c;
+  }
+
+  static bool isHex(int c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+  }
+
+  bool hex4(uint32_t &v) {
+    v = 0;
+    for (int k = 0; k < 4; k++) {
+      int c = get();
+      if (!isHex(c)) return false;
+      v = v * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return true;
+  }
+
+  bool string() {   // after the opening quote
+    for (;;) {
+      int c = get();
+      if (c < 0x20) return false;   // end of input too
+      if (c == '"') return true;
+      if (c != '\\') continue;
+      c = get();
+      if (c == 'u') {
+        uint32_t v;
+        if (!hex4(v)) return false;
+        if (v >= 0xDC00 && v <= 0xDFFF) return false;
+        if (v >= 0xD800 && v < 0xDC00) {
+          uint32_t lo;
+          if (get() != '\\' || get() != 'u' || !hex4(lo)) return false;
+          if (lo < 0xDC00 || lo > 0xDFFF) return false;
+        }
+      } else if (!strchr("\"\\/bfnrt", c) || c == 0) {
+        return false;
+      }
+    }
+  }
+
+  bool digits() {
+    if (peek() < '0' || peek() > '9') return false;
+    while (peek() >= '0' && peek() <= '9') i++;
+    return true;
+  }
+
+  bool number(int c) {   // first char consumed
+    if (c == '-') c = get();
+    if (c == '0') {
+      // one zero, nothing more
+    } else if (c >= '1' && c <= '9') {
+      while (peek() >= '0' && peek() <= '9') i++;
+    } else {
+      return false;
+    }
+    if (peek() == '.') {
+      i++;
+      if (!digits()) return false;
+    }
+    if (peek() == 'e' || peek() == 'E') {
+      i++;
+      if (peek() == '+' || peek() == '-') i++;
+      if (!digits()) return false;
+    }
+    return true;
+  }
+
+  bool literal(const char* rest) {
+    for (const char* p = rest; *p; p++) {
+      if (get() != *p) return false;
+    }
+    return true;
+  }
+
+  bool value(int c) {
+    switch (c) {
+      case '{': {
+        if (depth >= JSON_MAX_DEPTH) return false;
+        depth++;
+        c = getSkippingWs();
+        if (c == '}') { depth--; return true; }
+        for (;;) {
+          if (c != '"' || !string()) return false;
+          if (getSkippingWs() != ':') return false;
+          if (!value(getSkippingWs())) return false;
+          c = getSkippingWs();
+          if (c == '}') { depth--; return true; }
+          if (c != ',') return false;
+          c = getSkippingWs();
+        }
+      }
+      case '[': {
+        if (depth >= JSON_MAX_DEPTH) return false;
+        depth++;
+        c = getSkippingWs();
+        if (c == ']') { depth--; return true; }
+        for (;;) {
+          if (!value(c)) return false;
+          c = getSkippingWs();
+          if (c == ']') { depth--; return true; }
+          if (c != ',') return false;
+          c = getSkippingWs();
+        }
+      }
+      case '"': return string();
+      case 't': return literal("rue");
+      case 'f': return literal("alse");
+      case 'n': return literal("ull");
+      default:  return c == '-' || (c >= '0' && c <= '9') ? number(c) : false;
+    }
+  }
+
+  bool accepts() { return value(getSkippingWs()); }
+};
+
+// -------------------
+// Fixed cases
+// -------------------
+static void table() {
+  static const char* good[] = {
+    "{}", "[]", " [ ] ", "0", "-0.5e+3", "\"a\\u00e9\\ud83d\\ude00\"", "true", "null",
+    "[[],[]]", "{\"a\":{},\"b\":[]}", "[1,[2,[3]],{\"x\":null}]", "{\"data\":\"1.4.2\"}",
+    "[[[[[[[[]]]]]]]]",   // JSON_MAX_DEPTH containers
+    "12 trailing text is never read",
+  };
+  static const char* bad[] = {
+    "", "[", "{", "[1,]", "{\"a\":1,}", "[[],]", "{\"a\":{},}", "[{},]", "[[1],]",
+    "{\"a\":[],}", "[,]", "{,}", "[1 2]", "{\"a\" 1}", "{1:2}", "[01]", "[1.]", "[.5]",
+    "[-]", "[1e]", "\"\\x\"", "\"\\ud800\"", "\"\\udc00\"", "\"tab\there\"", "tru", "[nul]",
+    "[[[[[[[[[]]]]]]]]]",  // one past JSON_MAX_DEPTH
+    "[}", "{]", "]", "}",
+  };
+  size_t tokens;
+  for (const char* d : good) {
+    char what[96];
+    snprintf(what, sizeof(what), "accepts %.60s", d);
+    check(readerAccepts(d, true, true, tokens), what);
+    check(RefParser(d).accepts(), what);
+  }
+  for (const char* d : bad) {
+    char what[96];
+    snprintf(what, sizeof(what), "rejects %.60s", d);
+    check(!readerAccepts(d, true, true, tokens), what);
+    check(!RefParser(d).accepts(), what);
+  }
+}
+
+// Paths and values of an OTA reply
+static void otaReply() {
+  std::string doc =
+      "{ \"device\": {\"model\": \"knob-c3\", \"ids\": [7, 9]},\n"
+      "  \"notes\": \"line\\nbreak \\\"quoted\\\"\",\n"
+      "  \"data\" : \"1.4.2\", \"size\": 123456 }";
+  MemStream in(doc, true);
+  Reader json(in);
+  std::string seen;
+  for (JsonToken t = json.next(); t != JSON_END && t != JSON_ERROR; t = json.next()) {
+    if (t == JSON_STRING || t == JSON_NUMBER) {
+      seen += json.path();
+      seen += '=';
+      seen.append(json.text().ptr, json.text().len);
+      seen += ';';
+    }
+  }
+  check(seen == "device.model=knob-c3;device.ids.0=7;device.ids.1=9;"
+                "notes=line\nbreak \"quoted\";data=1.4.2;size=123456;",
+        "OTA reply paths and values");
+
+  MemStream in2(doc, true);
+  Reader json2(in2, (int32_t)doc.size());
+  FixedString<16> version;
+  check(json2.findString("data", version) && version == "1.4.2", "findString(data)");
+  check(json2.bytesRead() < doc.size(), "findString stops reading once found");
+}
+
+// -------------------
+// Differential fuzz
+// -------------------
+static std::string generate(int depth) {
+  static const char* scalars[] = { "0", "-12", "3.25e-2", "true", "false", "null", "\"v\"",
+                                   "\"\\u00fc\\n\"", "\"1.4.2\"", "\"\"" };
+  uint32_t r = next() % 10;
+  if (depth >= JSON_MAX_DEPTH + 1 || r < 5) return scalars[next() % 10];
+  std::string out;
+  int n = (int)(next() % 4);
+  if (r < 8) {
+    out = "[";
+    for (int k = 0; k < n; k++) out += (k ? "," : "") + generate(depth + 1);
+    return out + "]";
+  }
+  out = "{";
+  for (int k = 0; k < n; k++) out += std::string(k ? "," : "") + "\"k" + std::to_string(k) + "\":" + generate(depth + 1);
+  return out + "}";
+}
+
+static std::string mutate(std::string d) {
+  static const char alphabet[] = "{}[],:\"\\u0123456789-+.eEtrufalsn \t\n\x01\xff";
+  int edits = 1 + (int)(next() % 4);
+  for (int k = 0; k < edits; k++) {
+    size_t at = d.empty() ? 0 : next() % (d.size() + 1);
+    char c = alphabet[next() % (sizeof(alphabet) - 1)];
+    switch (next() % 4) {
+      case 0: if (at < d.size()) d[at] = c; break;
+      case 1: d.insert(d.begin() + at, c); break;
+      case 2: if (at < d.size()) d.erase(at, 1); break;
+      default: {
+        size_t len = next() % 8;
+        if (at + len <= d.size()) d.insert(at, d.substr(at, len));
+        break;
+      }
+    }
+  }
+  return d;
+}
+
+static void fuzz(long n) {
+  std::vector<std::string> seeds = {
+    "{\"data\":\"1.4.2\"}",
+    "{\"status\":\"ok\",\"data\":\"2.0.0-rc1\",\"url\":\"http:\\/\\/x\\/fw.bin\"}",
+    "{\"device\":{\"model\":\"knob\",\"ids\":[1,2,3]},\"data\":\"1.0\"}",
+    "[[],{},[[]],{\"a\":{}}]",
+  };
+  long accepted = 0, disagreed = 0;
+  for (long k = 0; k < n; k++) {
+    std::string base = (k & 1) ? seeds[next() % seeds.size()] : generate(0);
+    std::string doc  = (k % 8 == 0) ? base : mutate(base);
+    size_t tokens;
+    bool got  = readerAccepts(doc, k & 2, k & 4, tokens);
+    bool want = RefParser(doc).accepts();
+    check(tokens <= doc.size() + 1, "no more tokens than bytes");
+    if (got != want) {
+      if (disagreed < 5) printf("  reader %s, reference %s: %s\n", got ? "accepts" : "rejects",
+                                want ? "accepts" : "rejects", doc.c_str());
+      disagreed++;
+    }
+    accepted += got;
+  }
+  check(disagreed == 0, "reader agrees with the reference parser");
+  printf("fuzz: %ld documents, %ld accepted, %ld disagreements\n", n, accepted, disagreed);
+}
+
+// -------------------
+// Timing
+// -------------------
+static void timing() {
+  std::string doc = "{\"status\":\"ok\",\"channel\":\"stable\",\"data\":\"1.4.2\",\"size\":1048576,"
+                    "\"sha256\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\"}";
+  const long n = 200000;
+  long found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long k = 0; k < n; k++) {
+    MemStream in(doc, false);
+    Reader json(in, (int32_t)doc.size());
+    FixedString<16> version;
+    found += json.findString("data", version);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+  check(found == n, "timing run found the version");
+  printf("findString(\"data\") in a %zu-byte reply: %.0f ns (this host), reader object %zu bytes\n",
+         doc.size(), ns, sizeof(Reader));
+}
+
+int main(int argc, char** argv) {
+  long n = 200000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) n = strtol(argv[i + 1], nullptr, 10);
+  }
+  table();
+  otaReply();
+  fuzz(n);
+  timing();
+  printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
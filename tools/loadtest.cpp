@@ -0,0 +1,612 @@
+// =============================================================
+// loadtest — concurrent HTTP load on the knob, with loop() jitter
+//
+//   g++ -O2 -std=c++17 -pthread -o loadtest tools/loadtest.cpp
+//   ./loadtest [-H host] [-p port] [-d seconds] [-C client]... [--probe hz]
+//              [-o run.json] [--compare baseline.json]
+//   ./loadtest --sim [...]        against a stand-in knob on this machine
+//
+// A client is  name@rate:mix  — rate in requests/s (0 = back to
+// back), mix a comma list of  [METHOD ]path[=weight]. Without -C,
+// the three a knob on a desk sees at once:
+//
+//   automation@5:/api/stopwatch/start,/api/stopwatch/stop
+//   browser@2:/=1,/api/state=3
+//   scraper@1:/api/heap,/api/power,/api/loop
+//
+// Each client is a thread with a fresh connection per request (the
+// knob's WebServer closes after each response). With a rate the
+// requests go out on a fixed schedule and latency counts from the
+// scheduled time, so a server that stalls shows in the percentiles
+// instead of just slowing the client down.
+//
+// The run is bracketed by POST /api/loop?reset=1&probe=hz and
+// GET /api/loop (loopmonitor.h): loop() period p50/p99/p99.9 and
+// encoder steps (real and synthetic) that the UI saw late or
+// missed while the server was busy.
+//
+// Results are one JSON object (-o file, else stdout; the summary
+// goes to stderr) to keep per release. --compare reads an earlier
+// one and flags: p99 latency up more than 25%, throughput down more
+// than 10%, loop period p99 up more than 25%, or missed steps.
+// Exit status: 0 fine, 1 failed requests or no target, 2 regression.
+//
+// --sim serves a stand-in on 127.0.0.1 shaped like the firmware:
+// one loop thread serving at most one request per pass from inside
+// loop() (as WebServer::handleClient does), then --sim-ui-us of UI
+// work and delay(10), with the same /api/loop and probe. It checks
+// the harness and shows how the single-threaded server shares the
+// loop; its absolute numbers are this machine's, not the ESP32's.
+// =============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../latencyhist.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string host = "knobcontroller.local";
+static std::string port = "80";
+static addrinfo*   addr = nullptr;
+
+static double msBetween(Clock::time_point a, Clock::time_point b) {
+  return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// -------------------
+// HTTP client
+// -------------------
+// One request on a fresh connection; status, or 0 on a socket error or timeout
+static int request(const std::string &method, const std::string &path, std::string *body = nullptr) {
+  int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (fd < 0) return 0;
+  timeval tv = { 5, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  if (connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+    close(fd);
+    return 0;
+  }
+  std::string req = method + " " + path + " HTTP/1.0\r\nHost: " + host +
+                    "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) {
+    close(fd);
+    return 0;
+  }
+  std::string resp;
+  char buf[1024];
+  ssize_t n;
+  while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) resp.append(buf, n);
+  close(fd);
+  if (n < 0 || resp.compare(0, 5, "HTTP/") != 0) return 0;
+  size_t sp = resp.find(' ');
+  int status = sp == std::string::npos ? 0 : atoi(resp.c_str() + sp + 1);
+  if (body) {
+    size_t start = resp.find("\r\n\r\n");
+    *body = start == std::string::npos ? "" : resp.substr(start + 4);
+  }
+  return status;
+}
+
+// -------------------
+// Clients
+// -------------------
+struct Target {
+  std::string method;
+  std::string path;
+  unsigned    weight;
+};
+
+struct Sample {
+  uint16_t target;
+  bool     ok;
+  double   ms;
+};
+
+struct Client {
+  std::string         name;
+  double              rate = 0;   // requests/s, 0 = back to back
+  std::vector<Target> mix;
+  unsigned            totalWeight = 0;
+  std::vector<Sample> samples;
+};
+
+static bool parseClient(const std::string &spec, Client &c) {
+  size_t at = spec.find('@'), colon = spec.find(':');
+  if (at == std::string::npos || colon == std::string::npos || colon < at) return false;
+  c.name = spec.substr(0, at);
+  c.rate = atof(spec.substr(at + 1, colon - at - 1).c_str());
+  std::stringstream list(spec.substr(colon + 1));
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    Target t = { "GET", "", 1 };
+    size_t sp = item.find(' ');
+    if (sp != std::string::npos) {
+      t.method = item.substr(0, sp);
+      item     = item.substr(sp + 1);
+    }
+    size_t eq = item.rfind('=');
+    if (eq != std::string::npos && item.find('?') == std::string::npos) {
+      t.weight = (unsigned)atoi(item.c_str() + eq + 1);
+      item     = item.substr(0, eq);
+    }
+    if (item.empty() || item[0] != '/' || t.weight == 0) return false;
+    t.path = item;
+    c.totalWeight += t.weight;
+    c.mix.push_back(t);
+  }
+  return !c.mix.empty();
+}
+
+static void runClient(Client &c, Clock::time_point start, Clock::time_point end, uint32_t seed) {
+  uint32_t rng = seed | 1;
+  auto interval = c.rate > 0 ? std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(1.0 / c.rate))
+                             : Clock::duration::zero();
+  Clock::time_point due = start;
+  for (;;) {
+    if (c.rate > 0) {
+      if (due >= end) break;
+      std::this_thread::sleep_until(due);
+    } else {
+      due = Clock::now();
+      if (due >= end) break;
+    }
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    unsigned pick = rng % c.totalWeight;
+    uint16_t i = 0;
+    while (pick >= c.mix[i].weight) pick -= c.mix[i++].weight;
+
+    int status = request(c.mix[i].method, c.mix[i].path);
+    c.samples.push_back({ i, status >= 200 && status < 400, msBetween(due, Clock::now()) });
+    due += interval;
+  }
+}
+
+// -------------------
+// Results
+// -------------------
+struct Summary {
+  size_t n = 0, errors = 0;
+  double p50 = 0, p99 = 0, p999 = 0, max = 0, rps = 0;
+};
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t rank = (size_t)(p * sorted.size() + 0.999999);
+  if (rank < 1) rank = 1;
+  return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static Summary summarize(const std::vector<const Sample*> &samples, double seconds) {
+  Summary s;
+  std::vector<double> ms;
+  for (const Sample* x : samples) {
+    s.n++;
+    if (!x->ok) s.errors++;
+    ms.push_back(x->ms);
+  }
+  std::sort(ms.begin(), ms.end());
+  s.p50  = percentile(ms, 0.50);
+  s.p99  = percentile(ms, 0.99);
+  s.p999 = percentile(ms, 0.999);
+  s.max  = ms.empty() ? 0 : ms.back();
+  s.rps  = seconds > 0 ? (s.n - s.errors) / seconds : 0;
+  return s;
+}
+
+static std::string summaryJson(const Summary &s) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "\"requests\":%zu,\"errors\":%zu,\"errorRate\":%.4f,\"rps\":%.2f,"
+           "\"latencyMs\":{\"p50\":%.2f,\"p99\":%.2f,\"p999\":%.2f,\"max\":%.2f}",
+           s.n, s.errors, s.n ? (double)s.errors / s.n : 0.0, s.rps, s.p50, s.p99, s.p999, s.max);
+  return buf;
+}
+
+// A number at "key": after 'from' in a flat JSON text; NaN if absent
+static double jsonNumber(const std::string &json, const std::string &key, size_t from = 0) {
+  size_t k = json.find("\"" + key + "\":", from);
+  if (k == std::string::npos) return NAN;
+  return atof(json.c_str() + k + key.size() + 3);
+}
+
+static size_t jsonObject(const std::string &json, const std::string &key) {
+  size_t k = json.find("\"" + key + "\":{");
+  return k == std::string::npos ? std::string::npos : k;
+}
+
+// -------------------
+// Stand-in knob (--sim)
+// -------------------
+#define SIM_RING 32   // ENCODER_EVENT_RING
+
+struct SimKnob {
+  int          listenFd = -1;
+  uint16_t     port     = 0;
+  unsigned     uiUs     = 1000;
+  unsigned     serveUs  = 2000;   // handler + send, per request
+  std::atomic<bool>     stop{ false };
+  std::atomic<unsigned> probeHz{ 0 };
+  std::atomic<uint8_t>  probeHead{ 0 };
+  std::atomic<int64_t>  probeRing[SIM_RING];
+  std::thread  loopThread, probeThread;
+
+  LatencyHist<100> periodHist{ 500 };
+  LatencyHist<100> probeLagHist{ 500 };
+  uint32_t probeSteps = 0, probeLate = 0, probeMissed = 0;
+  uint8_t  probeTail = 0;
+  bool     firstPass = true;
+  Clock::time_point lastPass;
+};
+
+static int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void busyFor(unsigned us) {
+  Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+  while (Clock::now() < end) {
+  }
+}
+
+static std::string simLoopJson(const SimKnob &k) {
+  auto hist = [](const char* key, const LatencyHist<100> &h) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "\"%s\":{\"n\":%u,\"avg\":%u,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}",
+             key, h.count(), h.avgUs(), h.percentileUs(500), h.percentileUs(990),
+             h.percentileUs(999), h.maxUs());
+    return std::string(buf);
+  };
+  char mid[200];
+  snprintf(mid, sizeof(mid), ",\"steps\":0,\"stepsLate\":0,\"stepsMissed\":0,");
+  char probe[200];
+  snprintf(probe, sizeof(probe), ",\"probeHz\":%u,\"probeSteps\":%u,\"probeLate\":%u,\"probeMissed\":%u,",
+           k.probeHz.load(), k.probeSteps, k.probeLate, k.probeMissed);
+  return "{" + hist("periodUs", k.periodHist) + mid + hist("stepLagUs", LatencyHist<100>(500)) +
+         probe + hist("probeLagUs", k.probeLagHist) + ",\"lateMs\":50}";
+}
+
+static std::string simQuery(const std::string &path, const char* key) {
+  size_t q = path.find(std::string(key) + "=");
+  if (q == std::string::npos) return "";
+  size_t e = path.find('&', q);
+  return path.substr(q + strlen(key) + 1, e == std::string::npos ? std::string::npos : e - q - strlen(key) - 1);
+}
+
+// One handleClient(): at most one waiting connection, served to the end
+static void simHandleClient(SimKnob &k) {
+  int fd = accept(k.listenFd, nullptr, nullptr);
+  if (fd < 0) return;
+  timeval tv = { 2, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string req;
+  char buf[512];
+  while (req.find("\r\n\r\n") == std::string::npos) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    req.append(buf, n);
+  }
+  std::string method = req.substr(0, req.find(' '));
+  size_t p0 = req.find(' ') + 1;
+  std::string path = req.substr(p0, req.find(' ', p0) - p0);
+
+  std::string status = "200 OK", type = "application/json", body;
+  if (path == "/") {
+    type = "text/plain";
+    body = "Knobby OS Running";
+  } else if (path.compare(0, 9, "/api/loop") == 0) {
+    if (method == "POST") {
+      if (simQuery(path, "reset") == "1") {
+        k.periodHist.reset();
+        k.probeLagHist.reset();
+        k.probeSteps = k.probeLate = k.probeMissed = 0;
+        k.firstPass = true;
+      }
+      std::string hz = simQuery(path, "probe");
+      if (!hz.empty()) k.probeHz = (unsigned)atoi(hz.c_str());
+    }
+    body = simLoopJson(k);
+  } else if (path.compare(0, 5, "/api/") == 0) {
+    body = "{\"ok\":true}";
+  } else {
+    status = "404 Not Found";
+    type   = "text/plain";
+    body   = "Not Found";
+  }
+  busyFor(k.serveUs);
+  std::string resp = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                     "\r\nContent-Length: " + std::to_string(body.size()) +
+                     "\r\nConnection: close\r\n\r\n" + body;
+  send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+  close(fd);
+}
+
+static void simLoop(SimKnob &k) {
+  while (!k.stop) {
+    // loopMonitorTick()
+    Clock::time_point now = Clock::now();
+    if (!k.firstPass) {
+      k.periodHist.add((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - k.lastPass).count());
+    }
+    k.firstPass = false;
+    k.lastPass  = now;
+    uint8_t head = k.probeHead;
+    uint8_t n = head - k.probeTail;
+    k.probeTail = head;
+    if (n > SIM_RING) {
+      k.probeMissed += n - SIM_RING;
+      n = SIM_RING;
+    }
+    int64_t t = nowUs();
+    for (uint8_t i = 0; i < n; i++) {
+      int64_t lag = t - k.probeRing[(uint8_t)(head - n + i) % SIM_RING];
+      if (lag < 0) lag = 0;
+      k.probeLagHist.add((uint32_t)lag);
+      k.probeSteps++;
+      if (lag > 50000) k.probeLate++;
+    }
+
+    simHandleClient(k);   // server.handleClient()
+    busyFor(k.uiUs);      // the state machine and drawing
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));   // delay(10)
+  }
+}
+
+static void simProbe(SimKnob &k) {
+  Clock::time_point next = Clock::now();
+  while (!k.stop) {
+    unsigned hz = k.probeHz;
+    if (!hz) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      next = Clock::now();
+      continue;
+    }
+    next += std::chrono::microseconds(1000000 / hz);
+    std::this_thread::sleep_until(next);
+    uint8_t h = k.probeHead;
+    k.probeRing[h % SIM_RING] = nowUs();
+    k.probeHead = (uint8_t)(h + 1);
+  }
+}
+
+static bool simStart(SimKnob &k) {
+  k.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(k.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port        = 0;
+  socklen_t len = sizeof(a);
+  if (bind(k.listenFd, (sockaddr*)&a, sizeof(a)) != 0 || listen(k.listenFd, 16) != 0 ||
+      getsockname(k.listenFd, (sockaddr*)&a, &len) != 0) {
+    perror("sim");
+    return false;
+  }
+  fcntl(k.listenFd, F_SETFL, O_NONBLOCK);
+  k.port = ntohs(a.sin_port);
+  k.loopThread  = std::thread(simLoop, std::ref(k));
+  k.probeThread = std::thread(simProbe, std::ref(k));
+  return true;
+}
+
+static void simStop(SimKnob &k) {
+  k.stop = true;
+  k.loopThread.join();
+  k.probeThread.join();
+  close(k.listenFd);
+}
+
+// -------------------
+// Compare with a baseline run
+// -------------------
+static int compare(const std::string &now, const std::string &base) {
+  struct Check {
+    const char* object;
+    const char* key;
+    const char* sub;
+    double      limit;   // allowed ratio now/base
+    bool        higherIsBad;
+  };
+  const Check checks[] = {
+    { "total", "p99", "latencyMs", 1.25, true },
+    { "total", "rps", nullptr,     0.90, false },
+    { "loop",  "p99", "periodUs",  1.25, true },
+  };
+  int regressions = 0;
+  fprintf(stderr, "\ncompared with baseline:\n");
+  for (const Check &c : checks) {
+    size_t a = jsonObject(now, c.object), b = jsonObject(base, c.object);
+    if (a == std::string::npos || b == std::string::npos) continue;
+    if (c.sub) {
+      a = now.find("\"" + std::string(c.sub) + "\":", a);
+      b = base.find("\"" + std::string(c.sub) + "\":", b);
+    }
+    double x = jsonNumber(now, c.key, a), y = jsonNumber(base, c.key, b);
+    if (std::isnan(x) || std::isnan(y) || y <= 0) continue;
+    bool bad = c.higherIsBad ? x > y * c.limit : x < y * c.limit;
+    fprintf(stderr, "  %-5s %-9s %-4s %10.2f -> %10.2f  %s\n", c.object, c.sub ? c.sub : "", c.key, y, x,
+            bad ? "REGRESSION" : "ok");
+    regressions += bad;
+  }
+  size_t l = jsonObject(now, "loop");
+  if (l != std::string::npos) {
+    double missed = jsonNumber(now, "stepsMissed", l) + jsonNumber(now, "probeMissed", l);
+    if (missed > 0) {
+      fprintf(stderr, "  loop  missed steps %.0f  REGRESSION\n", missed);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+// -------------------
+// Main
+// -------------------
+static void usage() {
+  fprintf(stderr, "usage: loadtest [-H host] [-p port] [-d seconds] [-C name@rate:mix]... [--probe hz]\n"
+                  "                [-o out.json] [--compare base.json]\n"
+                  "                [--sim [--sim-ui-us us] [--sim-serve-us us]]\n");
+}
+
+int main(int argc, char** argv) {
+  double seconds = 20;
+  unsigned probeHz = 100;
+  bool sim = false;
+  std::string outPath, basePath;
+  std::vector<std::string> specs;
+  SimKnob knob;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--sim")                       sim = true;
+    else if (a == "-H" && more)             host = argv[++i];
+    else if (a == "-p" && more)             port = argv[++i];
+    else if (a == "-d" && more)             seconds = atof(argv[++i]);
+    else if (a == "-C" && more)             specs.push_back(argv[++i]);
+    else if (a == "--probe" && more)        probeHz = (unsigned)atoi(argv[++i]);
+    else if (a == "-o" && more)             outPath = argv[++i];
+    else if (a == "--compare" && more)      basePath = argv[++i];
+    else if (a == "--sim-ui-us" && more)    knob.uiUs = (unsigned)atoi(argv[++i]);
+    else if (a == "--sim-serve-us" && more) knob.serveUs = (unsigned)atoi(argv[++i]);
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (specs.empty()) {
+    specs = { "automation@5:/api/stopwatch/start,/api/stopwatch/stop",
+              "browser@2:/=1,/api/state=3",
+              "scraper@1:/api/heap,/api/power,/api/loop" };
+  }
+  std::vector<Client> clients(specs.size());
+  for (size_t i = 0; i < specs.size(); i++) {
+    if (!parseClient(specs[i], clients[i])) {
+      fprintf(stderr, "bad client: %s\n", specs[i].c_str());
+      return 1;
+    }
+  }
+
+  if (sim) {
+    if (!simStart(knob)) return 1;
+    host = "127.0.0.1";
+    port = std::to_string(knob.port);
+  }
+  addrinfo hints = {};
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &addr);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", host.c_str(), gai_strerror(err));
+    return 1;
+  }
+
+  std::string loopJson;
+  bool haveLoop = request("POST", "/api/loop?reset=1&probe=" + std::to_string(probeHz)) == 200;
+  if (!haveLoop) fprintf(stderr, "no /api/loop on %s: request stats only\n", host.c_str());
+
+  Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+  Clock::time_point end   = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < clients.size(); i++) {
+    threads.emplace_back(runClient, std::ref(clients[i]), start, end, (uint32_t)(0x9E3779B9u * (i + 1)));
+  }
+  for (std::thread &t : threads) t.join();
+  double took = msBetween(start, Clock::now()) / 1000.0;
+
+  if (haveLoop) {
+    request("GET", "/api/loop", &loopJson);
+    request("POST", "/api/loop?probe=0");
+  }
+  if (sim) simStop(knob);
+
+  // Per client, per endpoint, overall
+  std::string json = "{\"target\":\"" + (sim ? std::string("sim") : host) + "\",\"seconds\":" +
+                     std::to_string(seconds) + ",\"clients\":[";
+  std::vector<const Sample*> all;
+  fprintf(stderr, "%-30s %7s %6s %8s %9s %9s %9s %9s\n", "", "reqs", "errs", "req/s", "p50 ms",
+          "p99 ms", "p99.9 ms", "max ms");
+  auto line = [](const std::string &name, const Summary &s) {
+    fprintf(stderr, "%-30.30s %7zu %6zu %8.1f %9.2f %9.2f %9.2f %9.2f\n", name.c_str(), s.n, s.errors,
+            s.rps, s.p50, s.p99, s.p999, s.max);
+  };
+  for (size_t i = 0; i < clients.size(); i++) {
+    Client &c = clients[i];
+    std::vector<const Sample*> mine;
+    for (const Sample &x : c.samples) {
+      mine.push_back(&x);
+      all.push_back(&x);
+    }
+    Summary s = summarize(mine, took);
+    line(c.name, s);
+    char rate[32];
+    snprintf(rate, sizeof(rate), "%.2f", c.rate);
+    json += std::string(i ? "," : "") + "{\"name\":\"" + c.name + "\",\"rate\":" + rate + "," +
+            summaryJson(s) + ",\"endpoints\":[";
+    for (size_t t = 0; t < c.mix.size(); t++) {
+      std::vector<const Sample*> ep;
+      for (const Sample &x : c.samples) {
+        if (x.target == t) ep.push_back(&x);
+      }
+      Summary e = summarize(ep, took);
+      line("  " + c.mix[t].method + " " + c.mix[t].path, e);
+      json += std::string(t ? "," : "") + "{\"method\":\"" + c.mix[t].method + "\",\"path\":\"" +
+              c.mix[t].path + "\"," + summaryJson(e) + "}";
+    }
+    json += "]}";
+  }
+  Summary total = summarize(all, took);
+  line("total", total);
+  json += "],\"total\":{" + summaryJson(total) + "}";
+  json += ",\"loop\":" + (loopJson.empty() ? std::string("null") : loopJson) + "}\n";
+
+  if (!loopJson.empty()) {
+    size_t p = jsonObject(loopJson, "periodUs");
+    size_t g = jsonObject(loopJson, "probeLagUs");
+    fprintf(stderr, "\nloop period   p50 %.1f ms  p99 %.1f ms  p99.9 %.1f ms  max %.1f ms\n",
+            jsonNumber(loopJson, "p50", p) / 1000, jsonNumber(loopJson, "p99", p) / 1000,
+            jsonNumber(loopJson, "p999", p) / 1000, jsonNumber(loopJson, "max", p) / 1000);
+    fprintf(stderr, "probe steps   %.0f  late %.0f  missed %.0f  lag p99 %.1f ms\n",
+            jsonNumber(loopJson, "probeSteps"), jsonNumber(loopJson, "probeLate"),
+            jsonNumber(loopJson, "probeMissed"), jsonNumber(loopJson, "p99", g) / 1000);
+    fprintf(stderr, "knob steps    %.0f  late %.0f  missed %.0f\n", jsonNumber(loopJson, "steps"),
+            jsonNumber(loopJson, "stepsLate"), jsonNumber(loopJson, "stepsMissed"));
+  }
+
+  if (outPath.empty()) {
+    fputs(json.c_str(), stdout);
+  } else {
+    std::ofstream(outPath) << json;
+  }
+
+  int status = (total.n == 0 || total.errors > 0) ? 1 : 0;
+  if (!basePath.empty()) {
+    std::ifstream in(basePath);
+    std::stringstream base;
+    base << in.rdbuf();
+    if (base.str().empty()) {
+      fprintf(stderr, "%s: no baseline\n", basePath.c_str());
+      return 1;
+    }
+    if (compare(json, base.str()) > 0 && status == 0) status = 2;
+  }
+  return status;
+}
@@ -0,0 +1,285 @@
+// =============================================================
+// logdecode — turn the knob's binary log into text
+//
+//   g++ -O2 -std=c++17 -o logdecode tools/logdecode.cpp
+//   curl -o knob.klog "http://knobcontroller.local/api/log?raw=1"
+//   ./logdecode firmware.elf knob.klog
+//   ./logdecode --selftest          packed vs printf, no device
+//
+// Records (knoblogcode.h) hold the address of their call site, not
+// text. The site is a KlogSite in the firmware's flash rodata, so
+// this reads the ELF the device runs (the build's .elf, not the
+// .bin), finds the site and its format string there and expands
+// the arguments with the device's own klogExpand(). The download's
+// anchor address must point at "knoblog anchor", or the ELF is
+// from another build.
+//
+// --selftest packs sample calls with the device's packers, decodes
+// them through the same lookup and compares with snprintf; it also
+// prints bytes per record against bytes of text.
+// =============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../knoblogcode.h"
+
+static const char* const ANCHOR_TEXT = "knoblog anchor";
+static const uint32_t FILE_MAGIC   = 0x474F4C4B;   // knoblog.h
+static const uint32_t FILE_VERSION = 1;
+static const size_t   FILE_HEADER  = 16;
+
+// -------------------
+// Firmware image: loadable sections by address
+// -------------------
+struct Section {
+  uint32_t addr;
+  std::vector<uint8_t> bytes;
+};
+
+struct Image {
+  std::vector<Section> sections;
+
+  const uint8_t* at(uint32_t addr, size_t n) const {
+    for (const Section &s : sections) {
+      if (addr >= s.addr && addr - s.addr + n <= s.bytes.size()) return s.bytes.data() + (addr - s.addr);
+    }
+    return nullptr;
+  }
+
+  // NUL-terminated string at addr, or null
+  const char* str(uint32_t addr) const {
+    for (const Section &s : sections) {
+      if (addr < s.addr || addr - s.addr >= s.bytes.size()) continue;
+      const uint8_t* p = s.bytes.data() + (addr - s.addr);
+      if (memchr(p, 0, s.bytes.size() - (addr - s.addr))) return (const char*)p;
+    }
+    return nullptr;
+  }
+
+  // KlogSite as the 32-bit device lays it out: u32 fmt, u8 level, u8 tag
+  bool site(uint32_t addr, const char*& fmt, uint8_t& level, uint8_t& tag) const {
+    const uint8_t* p = at(addr, 6);
+    if (!p) return false;
+    fmt   = str((uint32_t)klogGetLE(p, 4));
+    level = p[4];
+    tag   = p[5];
+    return fmt != nullptr;
+  }
+};
+
+static bool loadElf(const char* path, Image &img) {
+  std::ifstream in(path, std::ios::binary);
+  std::vector<uint8_t> f((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (f.size() < 52 || memcmp(f.data(), "\x7f" "ELF", 4) != 0 || f[4] != 1 || f[5] != 1) {
+    fprintf(stderr, "%s: not a little-endian ELF32 file\n", path);
+    return false;
+  }
+  uint32_t shoff = (uint32_t)klogGetLE(&f[0x20], 4);
+  uint16_t shentsize = (uint16_t)klogGetLE(&f[0x2E], 2);
+  uint16_t shnum = (uint16_t)klogGetLE(&f[0x30], 2);
+  for (uint16_t i = 0; i < shnum; i++) {
+    size_t sh = (size_t)shoff + (size_t)i * shentsize;
+    if (sh + 40 > f.size()) break;
+    uint32_t type   = (uint32_t)klogGetLE(&f[sh + 4], 4);
+    uint32_t flags  = (uint32_t)klogGetLE(&f[sh + 8], 4);
+    uint32_t addr   = (uint32_t)klogGetLE(&f[sh + 12], 4);
+    uint32_t offset = (uint32_t)klogGetLE(&f[sh + 16], 4);
+    uint32_t size   = (uint32_t)klogGetLE(&f[sh + 20], 4);
+    const uint32_t SHT_PROGBITS = 1, SHF_ALLOC = 2;
+    if (type != SHT_PROGBITS || !(flags & SHF_ALLOC) || !addr || (size_t)offset + size > f.size()) continue;
+    img.sections.push_back({ addr, std::vector<uint8_t>(f.begin() + offset, f.begin() + offset + size) });
+  }
+  if (img.sections.empty()) {
+    fprintf(stderr, "%s: no loadable sections\n", path);
+    return false;
+  }
+  return true;
+}
+
+// -------------------
+// Decoding
+// -------------------
+// One record to "[    12.345] I ble: text"; false if it can't be read
+static bool decodeRecord(const Image &img, const uint8_t* rec, size_t len, std::string &line) {
+  if (len < KLOG_HEADER_BYTES) return false;
+  const char* fmt;
+  uint8_t level, tag;
+  uint32_t siteAddr = (uint32_t)klogGetLE(rec + 1, 4);
+  uint32_t ms = (uint32_t)klogGetLE(rec + 5, 4);
+  char head[48];
+  snprintf(head, sizeof(head), "[%6u.%03u] ", ms / 1000, ms % 1000);
+  line = head;
+  if (!img.site(siteAddr, fmt, level, tag)) {
+    snprintf(head, sizeof(head), "? unknown site 0x%08x", siteAddr);
+    line += head;
+    return false;
+  }
+  char text[512];
+  klogExpand(fmt, rec + KLOG_HEADER_BYTES, len - KLOG_HEADER_BYTES, text, sizeof(text));
+  snprintf(head, sizeof(head), "%c %s: ", level <= KLOG_LEVEL_DEBUG ? klogLevelLetters[level] : '?',
+           klogTagName(tag));
+  line += head;
+  line += text;
+  return true;
+}
+
+// Walk a run of records; returns how many failed
+static size_t decodeRecords(const Image &img, const uint8_t* p, size_t n, std::vector<std::string> &out) {
+  size_t bad = 0, pos = 0;
+  while (pos < n) {
+    uint8_t len = p[pos];
+    if (len < KLOG_HEADER_BYTES || pos + len > n) {
+      fprintf(stderr, "malformed record at byte %zu\n", pos);
+      return bad + 1;
+    }
+    std::string line;
+    if (!decodeRecord(img, p + pos, len, line)) bad++;
+    out.push_back(line);
+    pos += len;
+  }
+  return bad;
+}
+
+// -------------------
+// Self test
+// -------------------
+struct SampleSite {
+  const char* fmt;
+  uint8_t level, tag;
+};
+
+static const SampleSite sampleSites[] = {
+  { ANCHOR_TEXT, 0, 0 },
+  { "Sent key: %c", KLOG_LEVEL_INFO, KLOG_TAG_BLE },
+  { "DoorLock: Open failed (%d)", KLOG_LEVEL_WARN, KLOG_TAG_NET },
+  { "Timers: %s %u re-aimed by %lld ms", KLOG_LEVEL_INFO, KLOG_TAG_TIMER },
+  { "Hourly chime", KLOG_LEVEL_INFO, KLOG_TAG_TIMER },
+  { "HTTP pool: unsupported URL %s", KLOG_LEVEL_ERROR, KLOG_TAG_NET },
+  { "heap %08x, %5.2f%% used, %-6s|", KLOG_LEVEL_DEBUG, KLOG_TAG_SYS },
+};
+static const size_t SAMPLE_COUNT = sizeof(sampleSites) / sizeof(sampleSites[0]);
+static const uint32_t SITE_BASE = 0x3C000100;   // flash rodata on the C3
+static const uint32_t TEXT_BASE = 0x3C010000;
+
+// A fake ELF: the sites and their strings at device addresses
+static Image sampleImage() {
+  Section sites = { SITE_BASE, std::vector<uint8_t>(SAMPLE_COUNT * 8, 0) };
+  Section text  = { TEXT_BASE, {} };
+  for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+    klogPutLE(&sites.bytes[i * 8], TEXT_BASE + text.bytes.size(), 4);
+    sites.bytes[i * 8 + 4] = sampleSites[i].level;
+    sites.bytes[i * 8 + 5] = sampleSites[i].tag;
+    const char* s = sampleSites[i].fmt;
+    text.bytes.insert(text.bytes.end(), s, s + strlen(s) + 1);
+  }
+  Image img;
+  img.sections.push_back(sites);
+  img.sections.push_back(text);
+  return img;
+}
+
+struct Sample {
+  std::vector<uint8_t> bytes;
+  std::string expected;   // what printf makes of the same call
+};
+
+template<typename... Args>
+static Sample pack(size_t site, uint32_t ms, const char* fmt, Args... args) {
+  Sample s;
+  size_t len = KLOG_HEADER_BYTES + klogArgsBytes(args...);
+  s.bytes.resize(len);
+  s.bytes[0] = (uint8_t)len;
+  klogPutLE(&s.bytes[1], SITE_BASE + site * 8, 4);
+  klogPutLE(&s.bytes[5], ms, 4);
+  klogPutArgs(&s.bytes[KLOG_HEADER_BYTES], args...);
+  char text[512];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-security"
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  snprintf(text, sizeof(text), fmt, args...);
+#pragma GCC diagnostic pop
+  s.expected = text;
+  return s;
+}
+
+static bool selftest() {
+  Image img = sampleImage();
+  const char* longUrl = "http://192.168.1.40:8123/api/services/lock/unlock?entity=front";
+  std::vector<Sample> samples;
+  samples.push_back(pack(1, 1200, sampleSites[1].fmt, 'q'));
+  samples.push_back(pack(2, 5400, sampleSites[2].fmt, -11));
+  samples.push_back(pack(3, 61000, sampleSites[3].fmt, "chime", 7u, -1234LL));
+  samples.push_back(pack(4, 3600000, sampleSites[4].fmt));
+  samples.push_back(pack(5, 3600001, sampleSites[5].fmt, longUrl));
+  samples.push_back(pack(6, 4000000, sampleSites[6].fmt, 0xBEEFu, 41.5f, "ab"));
+
+  // %s keeps KLOG_STR_MAX chars
+  samples[4].expected = std::string("HTTP pool: unsupported URL ") + std::string(longUrl, KLOG_STR_MAX);
+
+  std::vector<uint8_t> stream;
+  for (const Sample &s : samples) stream.insert(stream.end(), s.bytes.begin(), s.bytes.end());
+  std::vector<std::string> lines;
+  size_t bad = decodeRecords(img, stream.data(), stream.size(), lines);
+
+  size_t mismatches = 0, recordBytes = 0, textBytes = 0;
+  for (size_t i = 0; i < samples.size() && i < lines.size(); i++) {
+    std::string text = lines[i].substr(lines[i].find(": ") + 2);
+    recordBytes += samples[i].bytes.size();
+    textBytes   += samples[i].expected.size() + 2;   // println's CR LF
+    printf("%-56s %3zu B vs %3zu B\n", lines[i].c_str(), samples[i].bytes.size(),
+           samples[i].expected.size() + 2);
+    if (text != samples[i].expected) {
+      printf("  MISMATCH: expected \"%s\"\n", samples[i].expected.c_str());
+      mismatches++;
+    }
+  }
+  const char* fmt;
+  uint8_t level, tag;
+  bool anchor = img.site(SITE_BASE, fmt, level, tag) && strcmp(fmt, ANCHOR_TEXT) == 0;
+  printf("selftest: %zu records, %zu bad, %zu mismatches, anchor %s\n", lines.size(), bad,
+         mismatches, anchor ? "ok" : "MISSING");
+  printf("          %.1f bytes per record vs %.1f bytes of text\n",
+         (double)recordBytes / samples.size(), (double)textBytes / samples.size());
+  return !bad && !mismatches && anchor && lines.size() == samples.size();
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "--selftest") == 0) return selftest() ? 0 : 1;
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s firmware.elf log | --selftest\n", argv[0]);
+    return 2;
+  }
+  Image img;
+  if (!loadElf(argv[1], img)) return 1;
+
+  std::ifstream in(argv[2], std::ios::binary);
+  std::vector<uint8_t> log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (log.size() < FILE_HEADER || klogGetLE(&log[0], 4) != FILE_MAGIC ||
+      klogGetLE(&log[4], 2) != FILE_VERSION) {
+    fprintf(stderr, "%s: not a knob log (GET /api/log?raw=1)\n", argv[2]);
+    return 1;
+  }
+  uint32_t anchorAddr = (uint32_t)klogGetLE(&log[8], 4);
+  uint32_t bytes = (uint32_t)klogGetLE(&log[12], 4);
+  const char* fmt;
+  uint8_t level, tag;
+  if (!img.site(anchorAddr, fmt, level, tag) || strcmp(fmt, ANCHOR_TEXT) != 0) {
+    fprintf(stderr, "%s doesn't match the firmware that wrote %s\n", argv[1], argv[2]);
+    return 1;
+  }
+  if (bytes > log.size() - FILE_HEADER) {
+    fprintf(stderr, "%s: truncated\n", argv[2]);
+    return 1;
+  }
+
+  std::vector<std::string> lines;
+  size_t bad = decodeRecords(img, log.data() + FILE_HEADER, bytes, lines);
+  for (const std::string &l : lines) puts(l.c_str());
+  fprintf(stderr, "%zu records in %u bytes, %zu undecodable\n", lines.size(), bytes, bad);
+  return bad ? 1 : 0;
+}
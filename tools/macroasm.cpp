@@ -0,0 +1,445 @@
+// =============================================================
+// macroasm — assemble a macro mode for the knob
+//
+//   g++ -O2 -std=c++17 -o macroasm tools/macroasm.cpp
+//   ./macroasm prog.km > prog.hex      assemble to hex
+//   ./macroasm --bench [prog.km]       interpreter cost per instruction
+//
+// Upload the hex to a slot (0..3):
+//   curl -H "Content-Type: text/plain" --data-binary @prog.hex
+//        "http://knobcontroller.local/api/macros?slot=0"     (one line)
+// The content type matters: WebServer only keeps a non-form body.
+//
+// Uses the device's macrocode.h, so the verifier that accepts the
+// image here is the one the knob runs before storing it.
+//
+// Source format, one statement per line, # starts a comment:
+//
+//   name OBS                    menu/header name (max 10 chars)
+//   on enter|left|right|press   start the handler for an event
+//   label:                      jump target
+//   key K / down K / up K       K = 'c' (one char) or a key name
+//   release
+//   chord K K ...               up to 6 keys, held 20 ms
+//   media NAME                  next prev stop play mute volup voldown ...
+//   type "text"
+//   delay MS
+//   http "http://host/path"     r3 = status
+//   line L "text"               L = 0..3
+//   linereg L rN                append the register to line L
+//   clear
+//   set rN V / add rN V         V: -128..127 for add
+//   jmp label / jz rN label / jnz rN label
+//   end
+//
+// A handler that doesn't end in end/jmp gets an end appended.
+// =============================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../macrocode.h"
+
+struct NamedKey {
+  const char* name;
+  uint8_t     code;   // BleKeyboard.h values
+};
+
+static const NamedKey KEYS[] = {
+  { "ctrl", 0x80 },   { "shift", 0x81 },  { "alt", 0x82 },     { "gui", 0x83 },
+  { "rctrl", 0x84 },  { "rshift", 0x85 }, { "ralt", 0x86 },    { "rgui", 0x87 },
+  { "up", 0xDA },     { "down", 0xD9 },   { "left", 0xD8 },    { "right", 0xD7 },
+  { "backspace", 0xB2 }, { "tab", 0xB3 }, { "enter", 0xB0 },   { "esc", 0xB1 },
+  { "insert", 0xD1 }, { "delete", 0xD4 }, { "pageup", 0xD3 },  { "pagedown", 0xD6 },
+  { "home", 0xD2 },   { "end", 0xD5 },    { "capslock", 0xC1 }, { "space", ' ' },
+  { "f1", 0xC2 },  { "f2", 0xC3 },  { "f3", 0xC4 },  { "f4", 0xC5 },  { "f5", 0xC6 },
+  { "f6", 0xC7 },  { "f7", 0xC8 },  { "f8", 0xC9 },  { "f9", 0xCA },  { "f10", 0xCB },
+  { "f11", 0xCC }, { "f12", 0xCD },
+};
+
+struct NamedMedia {
+  const char* name;
+  uint8_t     lo, hi;   // MediaKeyReport
+};
+
+static const NamedMedia MEDIA[] = {
+  { "next", 1, 0 },     { "prev", 2, 0 },       { "stop", 4, 0 },     { "play", 8, 0 },
+  { "mute", 16, 0 },    { "volup", 32, 0 },     { "voldown", 64, 0 }, { "home", 128, 0 },
+  { "computer", 0, 1 }, { "calculator", 0, 2 }, { "bookmarks", 0, 4 }, { "search", 0, 8 },
+  { "browserstop", 0, 16 }, { "back", 0, 32 }, { "config", 0, 64 },  { "email", 0, 128 },
+};
+
+static const char* EVENT_NAMES[MACRO_EVENT_COUNT] = { "enter", "left", "right", "press" };
+
+// -------------------
+// Lexing
+// -------------------
+struct Line {
+  int                      number;
+  std::vector<std::string> words;   // a quoted string keeps only its opening quote, as a marker
+};
+
+static bool fail(int line, const char* msg, const std::string &what = "") {
+  fprintf(stderr, "line %d: %s%s%s\n", line, msg, what.empty() ? "" : ": ", what.c_str());
+  return false;
+}
+
+static bool splitLine(const std::string &text, int number, Line &out) {
+  out.number = number;
+  out.words.clear();
+  size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') { i++; continue; }
+    if (c == '#') break;
+    if (c == '"') {
+      std::string s = "\"";
+      for (i++; i < text.size() && text[i] != '"'; i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) i++;
+        s += text[i];
+      }
+      if (i >= text.size()) return fail(number, "unterminated string");
+      i++;
+      out.words.push_back(s);
+      continue;
+    }
+    if (c == '\'' && i + 2 < text.size() && text[i + 2] == '\'') {
+      out.words.push_back(text.substr(i, 3));
+      i += 3;
+      continue;
+    }
+    size_t start = i;
+    while (i < text.size() && !strchr(" \t\r\n#", text[i])) i++;
+    out.words.push_back(text.substr(start, i - start));
+  }
+  return true;
+}
+
+// -------------------
+// Assembly
+// -------------------
+struct Fixup {
+  size_t      at;      // code offset of the u16
+  std::string label;
+  int         line;
+};
+
+struct Assembler {
+  std::string                name;
+  std::vector<uint8_t>       code;
+  uint16_t                   handlers[MACRO_EVENT_COUNT];
+  std::vector<std::string>   labelNames;
+  std::vector<uint16_t>      labelOffsets;
+  std::vector<Fixup>         fixups;
+  size_t                     lastOp = SIZE_MAX;   // offset of the previous instruction
+
+  Assembler() {
+    for (auto &h : handlers) h = MACRO_NO_HANDLER;
+  }
+
+  void op(uint8_t opcode) {
+    lastOp = code.size();
+    code.push_back(opcode);
+  }
+  void u8(uint8_t v) { code.push_back(v); }
+  void u16(uint16_t v) { code.push_back(v & 0xFF); code.push_back(v >> 8); }
+
+  bool endsHandler() const {
+    return lastOp != SIZE_MAX && (code[lastOp] == MOP_END || code[lastOp] == MOP_JMP);
+  }
+
+  void closeHandler() {
+    bool open = false;
+    for (auto h : handlers) open |= (h != MACRO_NO_HANDLER);
+    if (open && !endsHandler()) op(MOP_END);
+  }
+};
+
+static bool parseInt(const std::string &s, long lo, long hi, long &out) {
+  char* end;
+  out = strtol(s.c_str(), &end, 0);
+  return !s.empty() && *end == '\0' && out >= lo && out <= hi;
+}
+
+static bool parseKey(const Line &l, const std::string &w, uint8_t &out) {
+  if (w.size() == 3 && w[0] == '\'') { out = (uint8_t)w[1]; return true; }
+  for (const NamedKey &k : KEYS) {
+    if (w == k.name) { out = k.code; return true; }
+  }
+  return fail(l.number, "unknown key", w);
+}
+
+static bool parseReg(const Line &l, const std::string &w, uint8_t &out) {
+  if (w.size() == 2 && w[0] == 'r' && w[1] >= '0' && w[1] < '0' + MACRO_REGS) {
+    out = w[1] - '0';
+    return true;
+  }
+  return fail(l.number, "expected r0..r3", w);
+}
+
+static bool parseString(const Line &l, const std::string &w, size_t maxLen, std::string &out) {
+  if (w.empty() || w[0] != '"') return fail(l.number, "expected a quoted string", w);
+  out = w.substr(1);
+  if (out.size() > maxLen) return fail(l.number, "string too long", w.substr(1));
+  return true;
+}
+
+static bool assembleLine(Assembler &as, const Line &l) {
+  const std::vector<std::string> &w = l.words;
+  const std::string &m = w[0];
+  size_t argc = w.size() - 1;
+  auto want = [&](size_t n) {
+    return argc == n ? true : fail(l.number, "wrong number of operands for", m);
+  };
+
+  if (m.back() == ':' && w.size() == 1) {
+    std::string label = m.substr(0, m.size() - 1);
+    for (const std::string &existing : as.labelNames) {
+      if (existing == label) return fail(l.number, "duplicate label", label);
+    }
+    as.labelNames.push_back(label);
+    as.labelOffsets.push_back((uint16_t)as.code.size());
+    as.lastOp = SIZE_MAX;   // fall-through target: next handler can't rely on it
+    return true;
+  }
+  if (m == "name") {
+    if (!want(1)) return false;
+    as.name = w[1][0] == '"' ? w[1].substr(1) : w[1];
+    if (as.name.empty() || as.name.size() > MACRO_NAME_MAX) return fail(l.number, "name must be 1..10 chars");
+    for (char c : as.name) {
+      if (c < ' ' || c > '~' || c == '"' || c == '\\') return fail(l.number, "name: printable, no \" or \\");
+    }
+    return true;
+  }
+  if (m == "on") {
+    if (!want(1)) return false;
+    for (int e = 0; e < MACRO_EVENT_COUNT; e++) {
+      if (w[1] != EVENT_NAMES[e]) continue;
+      if (as.handlers[e] != MACRO_NO_HANDLER) return fail(l.number, "handler defined twice", w[1]);
+      as.closeHandler();
+      as.handlers[e] = (uint16_t)as.code.size();
+      as.lastOp = SIZE_MAX;
+      return true;
+    }
+    return fail(l.number, "unknown event", w[1]);
+  }
+
+  uint8_t a, b;
+  long v;
+  std::string s;
+  if (m == "end" || m == "release" || m == "clear") {
+    if (!want(0)) return false;
+    as.op(m == "end" ? MOP_END : m == "release" ? MOP_RELEASE : MOP_CLEAR);
+  } else if (m == "key" || m == "down" || m == "up") {
+    if (!want(1) || !parseKey(l, w[1], a)) return false;
+    as.op(m == "key" ? MOP_KEY : m == "down" ? MOP_DOWN : MOP_UP);
+    as.u8(a);
+  } else if (m == "chord") {
+    if (argc == 0 || argc > MACRO_CHORD_MAX) return fail(l.number, "chord takes 1..6 keys");
+    as.op(MOP_CHORD);
+    as.u8((uint8_t)argc);
+    for (size_t i = 1; i <= argc; i++) {
+      if (!parseKey(l, w[i], a)) return false;
+      as.u8(a);
+    }
+  } else if (m == "media") {
+    if (!want(1)) return false;
+    const NamedMedia* found = nullptr;
+    for (const NamedMedia &k : MEDIA) {
+      if (w[1] == k.name) found = &k;
+    }
+    if (!found) return fail(l.number, "unknown media key", w[1]);
+    as.op(MOP_MEDIA);
+    as.u8(found->lo);
+    as.u8(found->hi);
+  } else if (m == "type") {
+    if (!want(1) || !parseString(l, w[1], 255, s)) return false;
+    if (s.empty()) return fail(l.number, "empty text");
+    as.op(MOP_TYPE);
+    as.u8((uint8_t)s.size());
+    as.code.insert(as.code.end(), s.begin(), s.end());
+  } else if (m == "delay") {
+    if (!want(1) || !parseInt(w[1], 0, 65535, v)) return fail(l.number, "delay takes 0..65535 ms");
+    as.op(MOP_DELAY);
+    as.u16((uint16_t)v);
+  } else if (m == "http") {
+    if (!want(1) || !parseString(l, w[1], MACRO_URL_MAX - 1, s)) return false;
+    if (s.compare(0, 7, "http://") != 0) return fail(l.number, "only http:// URLs", s);
+    as.op(MOP_HTTP);
+    as.u8((uint8_t)s.size());
+    as.code.insert(as.code.end(), s.begin(), s.end());
+  } else if (m == "line") {
+    if (!want(2) || !parseInt(w[1], 0, MACRO_LINES - 1, v)) return fail(l.number, "line takes 0..3 and text");
+    if (!parseString(l, w[2], MACRO_LINE_LEN, s)) return false;
+    as.op(MOP_LINE);
+    as.u8((uint8_t)v);
+    as.u8((uint8_t)s.size());
+    as.code.insert(as.code.end(), s.begin(), s.end());
+  } else if (m == "linereg") {
+    if (!want(2) || !parseInt(w[1], 0, MACRO_LINES - 1, v)) return fail(l.number, "linereg takes 0..3 and a register");
+    if (!parseReg(l, w[2], b)) return false;
+    as.op(MOP_LINEREG);
+    as.u8((uint8_t)v);
+    as.u8(b);
+  } else if (m == "set" || m == "add") {
+    bool add = (m == "add");
+    if (!want(2) || !parseReg(l, w[1], a)) return false;
+    if (!parseInt(w[2], add ? -128 : -32768, add ? 127 : 32767, v)) return fail(l.number, "value out of range", w[2]);
+    as.op(add ? MOP_ADD : MOP_SET);
+    as.u8(a);
+    if (add) as.u8((uint8_t)(int8_t)v);
+    else     as.u16((uint16_t)(int16_t)v);
+  } else if (m == "jmp") {
+    if (!want(1)) return false;
+    as.op(MOP_JMP);
+    as.fixups.push_back({ as.code.size(), w[1], l.number });
+    as.u16(0);
+  } else if (m == "jz" || m == "jnz") {
+    if (!want(2) || !parseReg(l, w[1], a)) return false;
+    as.op(m == "jz" ? MOP_JZ : MOP_JNZ);
+    as.u8(a);
+    as.fixups.push_back({ as.code.size(), w[2], l.number });
+    as.u16(0);
+  } else {
+    return fail(l.number, "unknown instruction", m);
+  }
+  return true;
+}
+
+static bool assemble(FILE* in, std::vector<uint8_t> &image) {
+  Assembler as;
+  char buf[512];
+  int number = 0;
+  Line l;
+  while (fgets(buf, sizeof(buf), in)) {
+    number++;
+    if (!splitLine(buf, number, l)) return false;
+    if (l.words.empty()) continue;
+    if (!assembleLine(as, l)) return false;
+  }
+  as.closeHandler();
+
+  for (const Fixup &f : as.fixups) {
+    size_t i = 0;
+    while (i < as.labelNames.size() && as.labelNames[i] != f.label) i++;
+    if (i == as.labelNames.size()) return fail(f.line, "unknown label", f.label);
+    as.code[f.at]     = as.labelOffsets[i] & 0xFF;
+    as.code[f.at + 1] = as.labelOffsets[i] >> 8;
+  }
+  if (as.name.empty()) return fail(number, "missing 'name'");
+
+  image = { (uint8_t)MACRO_MAGIC0, (uint8_t)MACRO_MAGIC1, MACRO_VERSION, (uint8_t)as.name.size() };
+  image.insert(image.end(), as.name.begin(), as.name.end());
+  for (uint16_t h : as.handlers) {
+    image.push_back(h & 0xFF);
+    image.push_back(h >> 8);
+  }
+  image.insert(image.end(), as.code.begin(), as.code.end());
+  if (image.size() > MACRO_MAX_PROGRAM) {
+    fprintf(stderr, "program is %zu bytes, the limit is %d\n", image.size(), MACRO_MAX_PROGRAM);
+    return false;
+  }
+
+  MacroProgram program;
+  const char* err = macroVerify(image.data(), (uint16_t)image.size(), program);
+  if (err) {
+    fprintf(stderr, "verifier rejected the image: %s\n", err);
+    return false;
+  }
+  return true;
+}
+
+// -------------------
+// Benchmark
+// -------------------
+// A host that does nothing, so the time is dispatch alone. HTTP
+// completes immediately; tick() is given a clock far enough ahead
+// that delays and chords are always over.
+struct NullHost {
+  uint32_t calls = 0;
+  void keyTap(uint8_t) { calls++; }
+  void keyDown(uint8_t) { calls++; }
+  void keyUp(uint8_t) { calls++; }
+  void releaseAll() { calls++; }
+  void media(uint8_t, uint8_t) { calls++; }
+  void type(const char*, uint8_t) { calls++; }
+  void httpStart(const char*, uint8_t) { calls++; }
+  bool httpPoll(int16_t &status) { status = 200; return true; }
+  void setLine(uint8_t, const char*, uint8_t) { calls++; }
+  void appendLine(uint8_t, int16_t) { calls++; }
+  void clearLines() { calls++; }
+};
+
+// Arithmetic loop used when no program is given: 3 instructions
+// per iteration, stays under MACRO_STEPS_PER_EVENT.
+static const char* BENCH_SOURCE =
+  "name bench\n"
+  "on right\n"
+  "  set r1 600\n"
+  "loop:\n"
+  "  add r2 1\n"
+  "  add r1 -1\n"
+  "  jnz r1 loop\n"
+  "  linereg 0 r2\n";
+
+static int bench(const std::vector<uint8_t> &image) {
+  MacroProgram program;
+  macroVerify(image.data(), (uint16_t)image.size(), program);
+  NullHost host;
+  MacroMachine<NullHost> vm(host);
+  vm.load(program);
+
+  const int rounds = 20000;
+  uint32_t now = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    for (int e = 0; e < MACRO_EVENT_COUNT; e++) vm.post((MacroEvent)e, 1);
+    while (vm.busy()) {
+      now += 100000;
+      vm.tick(now);
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  const MacroStats &st = vm.stats();
+  printf("%u events, %u instructions, %u aborted, %u budget hits\n",
+         (unsigned)st.events, (unsigned)st.steps, (unsigned)st.aborted, (unsigned)st.budgetHits);
+  printf("%.1f ns/instruction, %.2f us/event (host)\n",
+         st.steps ? ns / st.steps : 0.0, st.events ? ns / st.events / 1000.0 : 0.0);
+  printf("budget %d instructions per loop() pass\n", MACRO_STEPS_PER_TICK);
+  return 0;
+}
+
+static void printHex(const std::vector<uint8_t> &image) {
+  for (size_t i = 0; i < image.size(); i++) {
+    printf("%02x%s", image[i], (i % 32 == 31 || i + 1 == image.size()) ? "\n" : "");
+  }
+}
+
+int main(int argc, char** argv) {
+  bool benchMode = argc >= 2 && strcmp(argv[1], "--bench") == 0;
+  const char* path = argc >= (benchMode ? 3 : 2) ? argv[benchMode ? 2 : 1] : nullptr;
+  if (!path && !benchMode) {
+    fprintf(stderr, "usage: macroasm prog.km > prog.hex\n"
+                    "       macroasm --bench [prog.km]\n");
+    return 1;
+  }
+
+  FILE* in = path ? fopen(path, "r") : fmemopen((void*)BENCH_SOURCE, strlen(BENCH_SOURCE), "r");
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  std::vector<uint8_t> image;
+  bool ok = assemble(in, image);
+  fclose(in);
+  if (!ok) return 1;
+
+  if (benchMode) return bench(image);
+  printHex(image);
+  fprintf(stderr, "%zu of %d bytes\n", image.size(), MACRO_MAX_PROGRAM);
+  return 0;
+}
@@ -0,0 +1,374 @@
+// =============================================================
+// mirrorsim — check the screen mirror encoding, measure its size
+//
+//   g++ -O2 -std=c++17 -o mirrorsim tools/mirrorsim.cpp
+//   ./mirrorsim                          checks + bytes per screen type
+//   ./mirrorsim -H knob.local [-n 100] [-o last.pbm]
+//                                        read the live stream (port 81)
+//
+// Uses the device's mirrorcode.h unchanged:
+//
+//  - random frames and random edits round-trip through encode and
+//    decode, messages never exceed MIRROR_MSG_MAX and cut or
+//    corrupted messages are refused
+//  - drawn sequences like the knob's screens (volume bar, menu
+//    cursor, standby clock, a slide transition, noise as the worst
+//    case) report keyframe and delta sizes against the raw 1 KB
+//    frame a full-frame stream would send
+//
+// With -H it connects to the knob's mirror port, decodes what
+// arrives and prints the bytes per frame type; -o writes the last
+// frame as a PBM (what /api/screen returns).
+//
+// Exits non-zero if a check fails.
+// =============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../mirrorcode.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// -------------------
+// Drawing
+// -------------------
+struct Frame {
+  uint8_t b[MIRROR_FRAME_BYTES] = {};
+
+  void pixel(int x, int y, bool on) {
+    if (x < 0 || x >= MIRROR_WIDTH || y < 0 || y >= MIRROR_HEIGHT) return;
+    uint8_t &v = b[(y >> 3) * MIRROR_WIDTH + x];
+    v = on ? (v | (1 << (y & 7))) : (v & ~(1 << (y & 7)));
+  }
+  void rect(int x, int y, int w, int h, bool on) {
+    for (int j = y; j < y + h; j++) {
+      for (int i = x; i < x + w; i++) pixel(i, j, on);
+    }
+  }
+  // A 5x7 stand-in glyph per character: fixed bits from its code
+  void text(int x, int y, const char* s, int size = 1, bool on = true) {
+    for (; *s; s++, x += 6 * size) {
+      uint32_t bits = (uint32_t)*s * 2654435761u;
+      for (int c = 0; c < 5; c++) {
+        for (int r = 0; r < 7; r++) {
+          if ((bits >> ((c * 7 + r) % 32)) & 1) rect(x + c * size, y + r * size, size, size, on);
+        }
+      }
+    }
+  }
+  void clear() { memset(b, 0, sizeof(b)); }
+};
+
+// -------------------
+// Round trips
+// -------------------
+static bool roundTrip(const uint8_t* frame, const uint8_t* prev, uint8_t line, uint8_t* viewer,
+                      size_t* bytes = nullptr) {
+  uint8_t msg[MIRROR_MSG_MAX];
+  size_t n = mirrorEncode(frame, prev, line, msg);
+  if (bytes) *bytes = n;
+  uint8_t got = 0xFF;
+  return n <= MIRROR_MSG_MAX && mirrorDecode(msg, n, viewer, got) && got == line &&
+         memcmp(viewer, frame, MIRROR_FRAME_BYTES) == 0;
+}
+
+static void checkCodec() {
+  std::mt19937 rng(46);
+  Frame cur, viewer;
+  bool ok = true;
+  size_t worst = 0;
+
+  // Noise: the largest a message can get
+  for (int i = 0; i < 200; i++) {
+    Frame noise;
+    for (uint8_t &v : noise.b) v = (uint8_t)rng();
+    size_t n;
+    ok &= roundTrip(noise.b, nullptr, 0, viewer.b, &n);
+    if (n > worst) worst = n;
+  }
+  check(ok, "random keyframes round-trip");
+  check(worst <= MIRROR_MSG_MAX, "keyframes fit MIRROR_MSG_MAX");
+
+  // Random edits of every kind against the viewer's copy
+  ok = true;
+  roundTrip(cur.b, nullptr, 0, viewer.b);
+  for (int i = 0; i < 5000; i++) {
+    Frame prev = cur;
+    switch (rng() % 4) {
+      case 0: cur.pixel(rng() % 128, rng() % 64, rng() & 1); break;
+      case 1: cur.rect(rng() % 128, rng() % 64, rng() % 40, rng() % 20, rng() & 1); break;
+      case 2: cur.b[rng() % MIRROR_FRAME_BYTES] = (uint8_t)rng(); break;
+      case 3: for (int k = 0; k < 70; k++) cur.b[256 + k] = (uint8_t)(rng() % 3); break;
+    }
+    ok &= roundTrip(cur.b, prev.b, (uint8_t)(rng() % 64), viewer.b);
+  }
+  check(ok, "random deltas round-trip");
+
+  // Runs at the token limits
+  Frame edge;
+  memset(edge.b, 0xFF, 65);
+  memset(edge.b + 65, 0xAA, 66);
+  for (int i = 131; i < 128 + 64 + 1; i++) edge.b[i] = (uint8_t)(i | 1);
+  check(roundTrip(edge.b, nullptr, 0, viewer.b), "runs at the token limits round-trip");
+
+  // Unchanged frame: header only, no pages
+  uint8_t msg[MIRROR_MSG_MAX];
+  size_t n = mirrorEncode(cur.b, cur.b, 7, msg);
+  check(n == MIRROR_HEADER_BYTES && msg[2] == 0, "an unchanged frame is just the header");
+
+  // Malformed input is refused
+  Frame text;
+  text.text(4, 4, "Volume", 2);
+  n = mirrorEncode(text.b, nullptr, 0, msg);
+  uint8_t line;
+  check(!mirrorDecode(msg, n - 1, viewer.b, line), "a cut message is refused");
+  msg[3]--;
+  check(!mirrorDecode(msg, n - 1, viewer.b, line), "a cut page is refused");
+  msg[3]++;
+  msg[MIRROR_HEADER_BYTES] = 0x7F;   // 128 zeros, then more tokens for the same page
+  check(!mirrorDecode(msg, n, viewer.b, line), "a page overrun is refused");
+
+  // PBM rows: lit is 0 (white), with the start line applied
+  Frame dot;
+  dot.pixel(0, 10, true);
+  uint8_t row[16];
+  mirrorPbmRow(dot.b, 0, 10, row);
+  check(row[0] == 0x7F && row[1] == 0xFF, "PBM row has the lit pixel as 0");
+  mirrorPbmRow(dot.b, 8, 2, row);
+  check(row[0] == 0x7F, "PBM applies the start line");
+}
+
+// -------------------
+// Screen sequences
+// -------------------
+struct Sequence {
+  const char* name;
+  std::vector<Frame> frames;
+  std::vector<uint8_t> lines;
+};
+
+static Sequence volumeBar() {
+  Sequence s = { "volume turn (30 steps)", {}, {} };
+  for (int v = 40; v < 70; v++) {
+    Frame f;
+    f.text(30, 2, "Volume", 2);
+    f.rect(4, 40, 120, 12, true);
+    f.rect(6, 42, 116, 8, false);
+    f.rect(6, 42, v * 116 / 100, 8, true);
+    char num[8];
+    snprintf(num, sizeof(num), "%d%%", v);
+    f.text(50, 54, num);
+    s.frames.push_back(f);
+    s.lines.push_back(0);
+  }
+  return s;
+}
+
+static Sequence menuCursor() {
+  static const char* items[] = { "Volume", "Timer", "Stopwatch", "Door Lock", "Macros" };
+  Sequence s = { "menu cursor (20 moves)", {}, {} };
+  for (int i = 0; i < 20; i++) {
+    Frame f;
+    int sel = i % 5;
+    for (int k = 0; k < 5; k++) {
+      bool hi = k == sel;
+      if (hi) f.rect(0, 12 * k, 128, 12, true);
+      f.text(6, 12 * k + 2, items[k], 1, !hi);
+    }
+    s.frames.push_back(f);
+    s.lines.push_back(0);
+  }
+  return s;
+}
+
+static Sequence standbyClock() {
+  Sequence s = { "standby clock (60 minutes)", {}, {} };
+  for (int m = 0; m < 60; m++) {
+    Frame f;
+    char t[8];
+    snprintf(t, sizeof(t), "12:%02d", m);
+    f.text(20, 16, t, 3);
+    f.text(28, 54, "Mon 19 Oct");
+    f.rect(0, 0, 128, 1, true);
+    s.frames.push_back(f);
+    s.lines.push_back(0);
+  }
+  return s;
+}
+
+// slidetransition.h scrolls with the start line, redrawing the
+// incoming page rows as they come into view
+static Sequence slide() {
+  Sequence s = { "slide transition (16 frames)", {}, {} };
+  Frame f;
+  f.text(6, 4, "Timer", 2);
+  f.text(6, 30, "05:00", 3);
+  for (int i = 1; i <= 16; i++) {
+    int line = i * 4;
+    int row  = (line + 60) & 63;
+    f.rect(0, row, 128, 4, false);
+    f.text(6, row, "Stopwatch");
+    s.frames.push_back(f);
+    s.lines.push_back((uint8_t)(line & 63));
+  }
+  return s;
+}
+
+static Sequence noise() {
+  Sequence s = { "noise (worst case, 10)", {}, {} };
+  std::mt19937 rng(7);
+  for (int i = 0; i < 10; i++) {
+    Frame f;
+    for (uint8_t &v : f.b) v = (uint8_t)rng();
+    s.frames.push_back(f);
+    s.lines.push_back(0);
+  }
+  return s;
+}
+
+static void compareSequences() {
+  printf("%-30s %8s %10s %10s %8s %10s\n", "sequence", "key B", "delta avg", "delta max",
+         "pages", "vs raw");
+  Sequence seqs[] = { volumeBar(), menuCursor(), standbyClock(), slide(), noise() };
+  for (Sequence &s : seqs) {
+    Frame viewer;
+    size_t key = 0, total = 0, max = 0, pages = 0;
+    bool ok = roundTrip(s.frames[0].b, nullptr, s.lines[0], viewer.b, &key);
+    total = key;
+    for (size_t i = 1; i < s.frames.size(); i++) {
+      size_t n;
+      uint8_t msg[MIRROR_MSG_MAX];
+      mirrorEncode(s.frames[i].b, s.frames[i - 1].b, s.lines[i], msg);
+      pages += __builtin_popcount(msg[2]);
+      ok &= roundTrip(s.frames[i].b, s.frames[i - 1].b, s.lines[i], viewer.b, &n);
+      total += n;
+      if (n > max) max = n;
+    }
+    size_t deltas = s.frames.size() - 1;
+    size_t raw = s.frames.size() * MIRROR_FRAME_BYTES;
+    printf("%-30s %8zu %10zu %10zu %8.1f %9.1f%%\n", s.name, key, (total - key) / deltas, max,
+           (double)pages / deltas, 100.0 * total / raw);
+    check(ok, "sequence round-trips");
+  }
+}
+
+// -------------------
+// Live stream
+// -------------------
+static int tcpConnect(const char* host, int port) {
+  addrinfo hints = {};
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addr = nullptr;
+  std::string p = std::to_string(port);
+  if (getaddrinfo(host, p.c_str(), &hints, &addr)) return -1;
+  int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addr);
+  return fd;
+}
+
+static int live(const char* host, int frames, const char* pbmPath) {
+  int fd = tcpConnect(host, 81);
+  if (fd < 0) {
+    fprintf(stderr, "can't connect to %s:81\n", host);
+    return 1;
+  }
+  std::string req = std::string("GET / HTTP/1.1\r\nHost: ") + host + "\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+
+  std::string buf;
+  bool headers = false;
+  Frame screen;
+  uint8_t line = 0;
+  size_t counts[2] = {}, bytes[2] = {}, maxes[2] = {};
+  int got = 0;
+  char chunk[4096];
+  while (got < frames) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) break;
+    buf.append(chunk, n);
+    if (!headers) {
+      size_t end = buf.find("\r\n\r\n");
+      if (end == std::string::npos) continue;
+      buf.erase(0, end + 4);
+      headers = true;
+    }
+    while (buf.size() >= MIRROR_HEADER_BYTES && got < frames) {
+      size_t len = MIRROR_HEADER_BYTES + ((uint8_t)buf[3] | ((uint8_t)buf[4] << 8));
+      if (buf.size() < len) break;
+      uint8_t type = (uint8_t)buf[0];
+      if (!mirrorDecode((const uint8_t*)buf.data(), len, screen.b, line)) {
+        fprintf(stderr, "bad message after %d frames\n", got);
+        close(fd);
+        return 1;
+      }
+      counts[type]++;
+      bytes[type] += len;
+      if (len > maxes[type]) maxes[type] = len;
+      buf.erase(0, len);
+      got++;
+    }
+  }
+  close(fd);
+
+  printf("%d frames from %s\n", got, host);
+  static const char* names[] = { "keyframes", "deltas" };
+  for (int t = 0; t < 2; t++) {
+    printf("  %-10s %6zu  avg %6zu B  max %6zu B\n", names[t], counts[t],
+           counts[t] ? bytes[t] / counts[t] : 0, maxes[t]);
+  }
+  if (got) {
+    printf("  total %zu B vs %zu B as raw frames\n", bytes[0] + bytes[1],
+           (size_t)got * MIRROR_FRAME_BYTES);
+  }
+  if (pbmPath && got) {
+    FILE* f = fopen(pbmPath, "wb");
+    if (!f) {
+      perror(pbmPath);
+      return 1;
+    }
+    fputs(MIRROR_PBM_HEADER, f);
+    for (int y = 0; y < MIRROR_HEIGHT; y++) {
+      uint8_t row[MIRROR_WIDTH / 8];
+      mirrorPbmRow(screen.b, line, y, row);
+      fwrite(row, 1, sizeof(row), f);
+    }
+    fclose(f);
+  }
+  return got ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  const char* host = nullptr;
+  const char* pbm = nullptr;
+  int frames = 100;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "-H") == 0)      host   = argv[++i];
+    else if (strcmp(argv[i], "-n") == 0) frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-o") == 0) pbm    = argv[++i];
+  }
+  if (host) return live(host, frames, pbm);
+
+  checkCodec();
+  compareSequences();
+  printf("\n%s (%d failed)\n", failures ? "FAILED" : "all checks passed", failures);
+  return failures ? 1 : 0;
+}
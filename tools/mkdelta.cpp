@@ -0,0 +1,481 @@
+// =============================================================
+// mkdelta — build / apply firmware deltas for the knob's OTA
+//
+//   g++ -O2 -std=c++17 -o mkdelta tools/mkdelta.cpp
+//   ./mkdelta old.bin new.bin out.delta      build a delta
+//   ./mkdelta --apply old.bin in.delta out.bin  apply (round-trip check)
+//   ./mkdelta --selftest                        synthetic releases, no files
+//
+// Serve out.delta with "Content-Type: application/x-knob-delta"
+// to devices whose ?from= version matches old.bin. The header names
+// old.bin by its SHA-256, so a device running anything else refuses
+// the delta and asks again for the full image. The format is
+// documented in deltaupdate.h; this tool and the device-side
+// applier must stay in sync.
+//
+// --selftest lays out a synthetic firmware image (functions calling
+// each other through absolute addresses, a string table, data) and
+// builds deltas for the release pairs seen in practice: a version
+// bump, a small patch, an insertion that moves every later address,
+// and a swapped library. Each delta must round-trip, a wrong base or
+// a flipped byte must be refused, and the table shows delta size
+// against the full image plus the host build/apply time.
+// =============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static const size_t HEADER_SIZE = 76;  // "KDL2" + oldSize + newSize + old and new SHA-256
+static const size_t WINDOW    = 32;  // bytes hashed per lookup
+static const size_t STRIDE    = 4;   // old image indexed every STRIDE bytes
+static const size_t MIN_MATCH = 24;  // shorter runs cost more as a COPY op than as literals
+
+// -------------------
+// SHA-256 (FIPS 180-4), enough for the header digest
+// -------------------
+struct Sha256 {
+  uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  uint8_t  block[64];
+  size_t   used = 0;
+  uint64_t total = 0;
+
+  static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+  void compress(const uint8_t* p) {
+    static const uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+      uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+  }
+
+  void update(const uint8_t* p, size_t n) {
+    total += n;
+    while (n > 0) {
+      size_t take = std::min(n, sizeof(block) - used);
+      memcpy(block + used, p, take);
+      used += take; p += take; n -= take;
+      if (used == sizeof(block)) { compress(block); used = 0; }
+    }
+  }
+
+  void finish(uint8_t out[32]) {
+    uint64_t bits = total * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (used != 56) update(&pad, 1);
+    uint8_t len[8];
+    for (int i = 0; i < 8; i++) len[i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(len, 8);
+    for (int i = 0; i < 8; i++) {
+      out[4 * i] = h[i] >> 24; out[4 * i + 1] = h[i] >> 16; out[4 * i + 2] = h[i] >> 8; out[4 * i + 3] = h[i];
+    }
+  }
+};
+
+// -------------------
+// File helpers
+// -------------------
+static bool readFile(const char* path, Bytes &out) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) return false;
+  out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  return true;
+}
+
+static bool writeFile(const char* path, const Bytes &data) {
+  std::ofstream f(path, std::ios::binary);
+  f.write((const char*)data.data(), data.size());
+  return (bool)f;
+}
+
+static void putU32(Bytes &out, uint32_t v) {
+  for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// -------------------
+// Diff
+// -------------------
+static uint64_t windowHash(const uint8_t* p) {
+  uint64_t h = 1469598103934665603ULL;   // FNV-1a over the window
+  for (size_t i = 0; i < WINDOW; i++) h = (h ^ p[i]) * 1099511628211ULL;
+  return h;
+}
+
+struct Stats { size_t copies = 0, copyBytes = 0, adds = 0, addBytes = 0; };
+
+static void flushLiterals(Bytes &out, const Bytes &img, size_t from, size_t to, Stats &st) {
+  if (to <= from) return;
+  out.push_back('A');
+  putU32(out, (uint32_t)(to - from));
+  out.insert(out.end(), img.begin() + from, img.begin() + to);
+  st.adds++;
+  st.addBytes += to - from;
+}
+
+static Bytes makeDelta(const Bytes &oldImg, const Bytes &newImg, Stats &st) {
+  // Open-addressed index: window hash -> old offset (first wins)
+  size_t slots = 1;
+  while (slots < oldImg.size() / STRIDE * 2) slots <<= 1;
+  std::vector<uint64_t> keys(slots, 0);
+  std::vector<uint32_t> offs(slots, UINT32_MAX);
+  for (size_t o = 0; o + WINDOW <= oldImg.size(); o += STRIDE) {
+    uint64_t h = windowHash(&oldImg[o]);
+    size_t s = h & (slots - 1);
+    while (offs[s] != UINT32_MAX && keys[s] != h) s = (s + 1) & (slots - 1);
+    if (offs[s] == UINT32_MAX) { keys[s] = h; offs[s] = (uint32_t)o; }
+  }
+  auto lookup = [&](const uint8_t* p) -> int64_t {
+    uint64_t h = windowHash(p);
+    size_t s = h & (slots - 1);
+    while (offs[s] != UINT32_MAX) {
+      if (keys[s] == h) return offs[s];
+      s = (s + 1) & (slots - 1);
+    }
+    return -1;
+  };
+  auto matchLen = [&](size_t o, size_t n) {
+    size_t len = 0;
+    while (o + len < oldImg.size() && n + len < newImg.size() && oldImg[o + len] == newImg[n + len]) len++;
+    return len;
+  };
+
+  Bytes out(HEADER_SIZE, 0);
+  size_t literalStart = 0;
+  size_t n = 0;
+  int64_t lastDelta = 0;  // old - new offset of the previous copy
+
+  while (n < newImg.size()) {
+    size_t bestLen = 0, bestOld = 0;
+
+    // 1) Same relative offset as the previous copy — catches in-place edits
+    int64_t cand = (int64_t)n + lastDelta;
+    if (cand >= 0 && (size_t)cand < oldImg.size()) {
+      size_t l = matchLen((size_t)cand, n);
+      if (l >= MIN_MATCH) { bestLen = l; bestOld = (size_t)cand; }
+    }
+    // 2) Hash lookup
+    if (bestLen == 0 && n + WINDOW <= newImg.size()) {
+      int64_t o = lookup(&newImg[n]);
+      if (o >= 0) {
+        size_t l = matchLen((size_t)o, n);
+        if (l >= MIN_MATCH) { bestLen = l; bestOld = (size_t)o; }
+      }
+    }
+
+    if (bestLen == 0) { n++; continue; }
+
+    // Extend backwards into the pending literal run
+    while (n > literalStart && bestOld > 0 && oldImg[bestOld - 1] == newImg[n - 1]) {
+      n--; bestOld--; bestLen++;
+    }
+    flushLiterals(out, newImg, literalStart, n, st);
+    out.push_back('C');
+    putU32(out, (uint32_t)bestOld);
+    putU32(out, (uint32_t)bestLen);
+    st.copies++;
+    st.copyBytes += bestLen;
+
+    lastDelta    = (int64_t)bestOld - (int64_t)n;
+    n           += bestLen;
+    literalStart = n;
+  }
+  flushLiterals(out, newImg, literalStart, newImg.size(), st);
+  out.push_back('E');
+
+  // Header
+  uint8_t oldSha[32], newSha[32];
+  Sha256 oldHasher, newHasher;
+  oldHasher.update(oldImg.data(), oldImg.size());
+  oldHasher.finish(oldSha);
+  newHasher.update(newImg.data(), newImg.size());
+  newHasher.finish(newSha);
+  Bytes header;
+  header.insert(header.end(), { 'K', 'D', 'L', '2' });
+  putU32(header, (uint32_t)oldImg.size());
+  putU32(header, (uint32_t)newImg.size());
+  header.insert(header.end(), oldSha, oldSha + 32);
+  header.insert(header.end(), newSha, newSha + 32);
+  memcpy(out.data(), header.data(), header.size());
+  return out;
+}
+
+// Mirrors applyDeltaStream() in deltaupdate.h. Null, or what's wrong.
+static const char* applyDelta(const Bytes &oldImg, const Bytes &delta, Bytes &out) {
+  if (delta.size() < HEADER_SIZE || memcmp(delta.data(), "KDL2", 4) != 0) return "not a KDL2 delta";
+  uint32_t oldSize = getU32(&delta[4]);
+  uint32_t newSize = getU32(&delta[8]);
+  if (oldSize > oldImg.size()) return "base image too short";
+  uint8_t sha[32];
+  Sha256 baseHasher;
+  baseHasher.update(oldImg.data(), oldSize);
+  baseHasher.finish(sha);
+  if (memcmp(sha, &delta[12], 32) != 0) return "made for another base image";
+  const char* corrupt = "delta corrupt";
+  size_t p = HEADER_SIZE;
+  out.clear();
+  while (p < delta.size()) {
+    uint8_t op = delta[p++];
+    if (op == 'E') break;
+    if (op == 'C') {
+      if (p + 8 > delta.size()) return corrupt;
+      uint32_t off = getU32(&delta[p]), len = getU32(&delta[p + 4]);
+      p += 8;
+      if ((uint64_t)off + len > oldSize) return corrupt;
+      out.insert(out.end(), oldImg.begin() + off, oldImg.begin() + off + len);
+    } else if (op == 'A') {
+      if (p + 4 > delta.size()) return corrupt;
+      uint32_t len = getU32(&delta[p]);
+      p += 4;
+      if (p + len > delta.size()) return corrupt;
+      out.insert(out.end(), delta.begin() + p, delta.begin() + p + len);
+      p += len;
+    } else {
+      return corrupt;
+    }
+  }
+  if (out.size() != newSize) return "wrong image size";
+  Sha256 hasher;
+  hasher.update(out.data(), out.size());
+  hasher.finish(sha);
+  return memcmp(sha, &delta[44], 32) == 0 ? nullptr : "SHA-256 mismatch";
+}
+
+// -------------------
+// Self-test: synthetic releases
+// -------------------
+static uint32_t rngState = 0x2545F491;
+
+static uint32_t next32() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+// A function is its body plus the spots holding absolute addresses
+// of other functions (literal pool), patched when the image is laid out
+struct Function {
+  Bytes body;
+  std::vector<std::pair<size_t, size_t>> calls;   // body offset, callee index
+};
+
+struct Firmware {
+  std::vector<Function> code;
+  std::string version = "1.4.2";
+  std::string built   = "Oct 19 2026 09:12:44";
+  Bytes strings, data;
+};
+
+static const uint32_t FLASH_BASE = 0x400D0000;
+
+static Function randomFunction(size_t functions) {
+  // Instructions drawn from a skewed alphabet, as compiled code is
+  static const uint8_t common[] = { 0x36, 0x41, 0x00, 0x0c, 0x1d, 0xf0, 0x22, 0xa0, 0x81, 0xe0, 0x08, 0x20 };
+  Function f;
+  size_t len = 64 + next32() % 320;
+  for (size_t i = 0; i < len; i++) {
+    f.body.push_back(next32() % 4 ? common[next32() % sizeof(common)] : (uint8_t)next32());
+  }
+  size_t pool = len & ~(size_t)3;
+  for (int c = next32() % 6; c > 0; c--) {
+    f.calls.push_back({ pool, next32() % functions });
+    f.body.insert(f.body.end(), 4, 0);
+    pool += 4;
+  }
+  return f;
+}
+
+static Firmware randomFirmware(size_t functions) {
+  Firmware fw;
+  for (size_t i = 0; i < functions; i++) fw.code.push_back(randomFunction(functions));
+  static const char* words[] = { "OTA: ", "BLE ", "WiFi ", "volume ", "timer ", "macro ",
+                                 "failed", "connected", "%d", "%s\n", "knob", "screen " };
+  while (fw.strings.size() < 48 * 1024) {
+    const char* w = words[next32() % 12];
+    fw.strings.insert(fw.strings.end(), w, w + strlen(w));
+    if (next32() % 4 == 0) fw.strings.push_back(0);
+  }
+  for (size_t i = 0; i < 96 * 1024; i++) fw.data.push_back(next32() % 3 ? 0 : (uint8_t)next32());
+  return fw;
+}
+
+static Bytes layout(const Firmware &fw) {
+  std::vector<uint32_t> addr;
+  uint32_t at = FLASH_BASE;
+  for (const Function &f : fw.code) {
+    addr.push_back(at);
+    at += (uint32_t)f.body.size();
+  }
+  Bytes img;
+  for (const Function &f : fw.code) {
+    size_t start = img.size();
+    img.insert(img.end(), f.body.begin(), f.body.end());
+    for (const auto &c : f.calls) {
+      for (int i = 0; i < 4; i++) img[start + c.first + i] = (uint8_t)(addr[c.second] >> (8 * i));
+    }
+  }
+  img.insert(img.end(), fw.version.begin(), fw.version.end());
+  img.push_back(0);
+  img.insert(img.end(), fw.built.begin(), fw.built.end());
+  img.push_back(0);
+  img.insert(img.end(), fw.strings.begin(), fw.strings.end());
+  img.insert(img.end(), fw.data.begin(), fw.data.end());
+  return img;
+}
+
+static bool selftest() {
+  const size_t functions = 4000;
+  Firmware base = randomFirmware(functions);
+  Bytes oldImg = layout(base);
+
+  struct Release { const char* name; Firmware fw; };
+  std::vector<Release> releases;
+
+  Firmware bump = base;
+  bump.version = "1.4.3";
+  bump.built   = "Oct 21 2026 17:03:09";
+  releases.push_back({ "version bump", bump });
+
+  Firmware patch = bump;   // a fix inside one function, same size
+  for (size_t i = 0; i < 40; i++) patch.code[functions / 2].body[i] ^= 0x5a;
+  releases.push_back({ "small patch", patch });
+
+  Firmware grown = bump;   // 220 bytes added mid-image: every later address moves
+  Function &f = grown.code[functions / 2];
+  for (int i = 0; i < 220; i++) f.body.insert(f.body.begin() + 16, (uint8_t)next32());
+  for (auto &c : f.calls) c.first += 220;
+  releases.push_back({ "insertion", grown });
+
+  Firmware lib = bump;     // a library rebuilt: 300 functions replaced
+  for (size_t i = functions / 4; i < functions / 4 + 300; i++) lib.code[i] = randomFunction(functions);
+  releases.push_back({ "library change", lib });
+
+  int failed = 0;
+  printf("base image: %zu bytes, %zu functions\n\n", oldImg.size(), functions);
+  printf("%-16s %9s %9s %7s %8s %8s %9s\n",
+         "release", "full", "delta", "ratio", "copies", "build", "apply");
+  for (const Release &r : releases) {
+    Bytes newImg = layout(r.fw);
+    auto t0 = std::chrono::steady_clock::now();
+    Stats st;
+    Bytes delta = makeDelta(oldImg, newImg, st);
+    auto t1 = std::chrono::steady_clock::now();
+    Bytes out;
+    const char* err = applyDelta(oldImg, delta, out);
+    auto t2 = std::chrono::steady_clock::now();
+    printf("%-16s %9zu %9zu %6.2f%% %8zu %6.1fms %7.1fms\n", r.name, newImg.size(), delta.size(),
+           100.0 * delta.size() / newImg.size(), st.copies,
+           std::chrono::duration<double, std::milli>(t1 - t0).count(),
+           std::chrono::duration<double, std::milli>(t2 - t1).count());
+    if (err || out != newImg) {
+      printf("  FAIL: does not round-trip (%s)\n", err ? err : "image differs");
+      failed++;
+    }
+    if (delta.size() * 4 > newImg.size()) {
+      printf("  FAIL: delta over a quarter of the full image\n");
+      failed++;
+    }
+    // The device must refuse a delta for another base, or a damaged one
+    if (!applyDelta(newImg, delta, out)) {
+      printf("  FAIL: applied on the wrong base image\n");
+      failed++;
+    }
+    Bytes damaged = delta;
+    damaged[(HEADER_SIZE + damaged.size()) / 2] ^= 1;
+    if (!applyDelta(oldImg, damaged, out)) {
+      printf("  FAIL: a flipped byte went unnoticed\n");
+      failed++;
+    }
+  }
+  printf("\n(build and apply are host times; the knob applies at flash write speed)\n");
+  printf("%s\n", failed ? "FAILED" : "all checks passed");
+  return failed == 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "--selftest") == 0) return selftest() ? 0 : 1;
+  if (argc == 5 && strcmp(argv[1], "--apply") == 0) {
+    Bytes oldImg, delta, out;
+    if (!readFile(argv[2], oldImg) || !readFile(argv[3], delta)) {
+      fprintf(stderr, "mkdelta: cannot read input\n");
+      return 1;
+    }
+    if (const char* err = applyDelta(oldImg, delta, out)) {
+      fprintf(stderr, "mkdelta: %s\n", err);
+      return 1;
+    }
+    writeFile(argv[4], out);
+    printf("applied: %zu bytes, SHA-256 OK\n", out.size());
+    return 0;
+  }
+  if (argc != 4) {
+    fprintf(stderr, "usage: mkdelta old.bin new.bin out.delta\n"
+                    "       mkdelta --apply old.bin in.delta out.bin\n"
+                    "       mkdelta --selftest\n");
+    return 2;
+  }
+
+  Bytes oldImg, newImg;
+  if (!readFile(argv[1], oldImg) || !readFile(argv[2], newImg)) {
+    fprintf(stderr, "mkdelta: cannot read input\n");
+    return 1;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  Stats st;
+  Bytes delta = makeDelta(oldImg, newImg, st);
+  auto t1 = std::chrono::steady_clock::now();
+
+  Bytes check;
+  if (applyDelta(oldImg, delta, check)) {
+    fprintf(stderr, "mkdelta: internal error — delta does not round-trip\n");
+    return 1;
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  writeFile(argv[3], delta);
+
+  printf("full image : %zu bytes\n", newImg.size());
+  printf("delta      : %zu bytes (%.1f%% of full)\n", delta.size(), 100.0 * delta.size() / newImg.size());
+  printf("ops        : %zu copy (%zu bytes), %zu literal (%zu bytes)\n",
+         st.copies, st.copyBytes, st.adds, st.addBytes);
+  printf("build      : %.1f ms, host apply: %.1f ms\n",
+         std::chrono::duration<double, std::milli>(t1 - t0).count(),
+         std::chrono::duration<double, std::milli>(t2 - t1).count());
+  return 0;
+}
@@ -0,0 +1,624 @@
+// =============================================================
+// mqttbench — broker stand-in and MQTT vs. HTTP-per-action timing
+//
+//   g++ -O2 -std=c++17 -pthread -o mqttbench tools/mqttbench.cpp
+//   ./mqttbench --broker [-p 1883]       run a minimal local broker
+//   ./mqttbench --selftest [-n 500]      codec checks + loopback bench
+//   ./mqttbench -b broker [-H knob] [-n 50]
+//                                        against a real knob
+//
+// Uses the device's mqttcode.h for every packet, on both sides.
+//
+// --broker is a stand-in for mosquitto, enough for the knob and
+// this tool: QoS 0/1 (no QoS 2), retained messages, last will,
+// + and # filters, keep-alive pings, packets up to MQTT_PACKET_MAX.
+// Point MQTT_BROKER_HOST at the machine running it.
+//
+// --selftest checks the packet writer, the byte-at-a-time parser,
+// topic matching and the outbox's bounds and drop order, then runs
+// the stand-in broker on loopback and measures:
+//   - publish-to-delivery latency through the broker, QoS 0 and 1
+//   - messages/s for a burst of QoS 0 publishes
+//   - the old model: one HTTP request on a new TCP connection per
+//     action, against a loopback server that answers at once
+// Loopback numbers are a floor for both; the gap is the per-action
+// connection setup, which a LAN and the knob's stack only widen.
+//
+// Against a knob (-b): round trips knob/ping -> knob/pong through
+// the broker, and GET /api/state on a new connection each time (the
+// per-action HTTP model), median and worst of each.
+// =============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../mqttcode.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// -------------------
+// Sockets
+// -------------------
+static int tcpConnect(const char* host, int port) {
+  addrinfo hints = {};
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addr = nullptr;
+  std::string p = std::to_string(port);
+  if (getaddrinfo(host, p.c_str(), &hints, &addr)) return -1;
+  int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addr);
+  if (fd >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+// Listening socket on port (0: any); the port chosen goes in port
+static int tcpListen(int &port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in sa = {};
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port        = htons(port);
+  if (bind(fd, (sockaddr*)&sa, sizeof(sa)) < 0 || listen(fd, 64) < 0) {
+    close(fd);
+    return -1;
+  }
+  socklen_t len = sizeof(sa);
+  getsockname(fd, (sockaddr*)&sa, &len);
+  port = ntohs(sa.sin_port);
+  return fd;
+}
+
+static bool sendAll(int fd, const void* p, size_t n) {
+  const char* c = (const char*)p;
+  while (n) {
+    ssize_t w = send(fd, c, n, MSG_NOSIGNAL);
+    if (w <= 0) return false;
+    c += w;
+    n -= w;
+  }
+  return true;
+}
+
+static bool sendPacket(int fd, MqttPacket p) {
+  return p.len && sendAll(fd, p.data, p.len);
+}
+
+// -------------------
+// Broker stand-in
+// -------------------
+struct BrokerClient {
+  int fd;
+  MqttParser in;
+  std::vector<std::pair<std::string, uint8_t>> subs;
+  std::string willTopic, willPayload;
+  bool connected = false;
+};
+
+class Broker {
+ public:
+  explicit Broker(int listenFd) : listen_(listenFd) {}
+
+  void run(const std::atomic<bool> &stop) {
+    while (!stop) {
+      std::vector<pollfd> fds = { { listen_, POLLIN, 0 } };
+      for (BrokerClient* c : clients_) fds.push_back({ c->fd, POLLIN, 0 });
+      if (poll(fds.data(), fds.size(), 100) <= 0) continue;
+      if (fds[0].revents & POLLIN) {
+        int fd = accept(listen_, nullptr, nullptr);
+        if (fd >= 0) {
+          int one = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          clients_.push_back(new BrokerClient{ fd, {}, {}, {}, {} });
+        }
+      }
+      std::vector<BrokerClient*> snapshot = clients_;
+      for (size_t i = 0; i < snapshot.size(); i++) {
+        if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) service(snapshot[i]);
+      }
+    }
+    for (BrokerClient* c : clients_) {
+      close(c->fd);
+      delete c;
+    }
+    clients_.clear();
+  }
+
+ private:
+  void service(BrokerClient* c) {
+    uint8_t buf[4096];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      drop(c, true);
+      return;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+      if (c->in.feed(buf[i]) && !handle(c)) {
+        drop(c, true);
+        return;
+      }
+    }
+  }
+
+  bool handle(BrokerClient* c) {
+    uint8_t out[MQTT_PACKET_MAX + 16];
+    const uint8_t* b = c->in.body();
+    size_t len = c->in.length();
+    switch (c->in.type()) {
+      case MQTT_CONNECT: {
+        // "MQTT", level, flags, keep-alive, client id, [will topic, will payload]
+        if (len < 10) return false;
+        uint8_t flags = b[7];
+        size_t pos = 10;
+        std::string field[3];
+        for (int f = 0; f < ((flags & 0x04) ? 3 : 1); f++) {
+          if (pos + 2 > len) return false;
+          size_t fl = (b[pos] << 8) | b[pos + 1];
+          if (pos + 2 + fl > len) return false;
+          field[f].assign((const char*)b + pos + 2, fl);
+          pos += 2 + fl;
+        }
+        c->willTopic   = field[1];
+        c->willPayload = field[2];
+        c->connected   = true;
+        uint8_t ack[4] = { MQTT_CONNACK << 4, 2, 0, 0 };
+        return sendAll(c->fd, ack, sizeof(ack));
+      }
+      case MQTT_SUBSCRIBE: {
+        if (len < 5) return false;
+        size_t fl = (b[2] << 8) | b[3];
+        if (4 + fl + 1 > len) return false;
+        std::string filter((const char*)b + 4, fl);
+        uint8_t qos = b[4 + fl] > 1 ? 1 : b[4 + fl];
+        c->subs.push_back({ filter, qos });
+        uint8_t ack[5] = { MQTT_SUBACK << 4, 3, b[0], b[1], qos };
+        if (!sendAll(c->fd, ack, sizeof(ack))) return false;
+        for (auto &r : retained_) {
+          if (mqttTopicMatches(filter.c_str(), r.first.data(), r.first.size())) {
+            deliver(c, r.first, r.second, qos, true);
+          }
+        }
+        return true;
+      }
+      case MQTT_PUBLISH: {
+        MqttPublish msg;
+        if (!mqttParsePublish(c->in, msg)) return false;
+        if (msg.qos == 1 && !sendPacket(c->fd, mqttIdPacket(out, sizeof(out), MQTT_PUBACK, msg.id))) {
+          return false;
+        }
+        std::string topic(msg.topic, msg.topicLen);
+        std::string payload((const char*)msg.payload, msg.payloadLen);
+        if (msg.retain) {
+          if (payload.empty()) retained_.erase(topic);
+          else                 retained_[topic] = payload;
+        }
+        route(topic, payload, msg.qos);
+        return true;
+      }
+      case MQTT_PINGREQ: {
+        uint8_t resp[2] = { MQTT_PINGRESP << 4, 0 };
+        return sendAll(c->fd, resp, sizeof(resp));
+      }
+      case MQTT_DISCONNECT:
+        c->willTopic.clear();   // a clean goodbye: no will
+        drop(c, false);
+        return true;
+      default:   // PUBACK from subscribers: nothing is kept to resend
+        return true;
+    }
+  }
+
+  void route(const std::string &topic, const std::string &payload, uint8_t qos) {
+    std::vector<BrokerClient*> snapshot = clients_;
+    for (BrokerClient* c : snapshot) {
+      for (auto &s : c->subs) {
+        if (!mqttTopicMatches(s.first.c_str(), topic.data(), topic.size())) continue;
+        deliver(c, topic, payload, std::min(qos, s.second), false);
+        break;
+      }
+    }
+  }
+
+  void deliver(BrokerClient* c, const std::string &topic, const std::string &payload, uint8_t qos,
+               bool retain) {
+    static uint8_t out[65536];
+    if (++nextId_ == 0) nextId_ = 1;
+    sendPacket(c->fd, mqttPublishPacket(out, sizeof(out), topic.c_str(),
+                                        (const uint8_t*)payload.data(), payload.size(), qos,
+                                        retain, nextId_));
+  }
+
+  void drop(BrokerClient* c, bool will) {
+    auto it = std::find(clients_.begin(), clients_.end(), c);
+    if (it == clients_.end()) return;
+    clients_.erase(it);
+    close(c->fd);
+    if (will && c->connected && !c->willTopic.empty()) {
+      retained_[c->willTopic] = c->willPayload;
+      route(c->willTopic, c->willPayload, 0);
+    }
+    delete c;
+  }
+
+  int listen_;
+  std::vector<BrokerClient*> clients_;
+  std::map<std::string, std::string> retained_;
+  uint16_t nextId_ = 0;
+};
+
+// -------------------
+// Bench client
+// -------------------
+class Client {
+ public:
+  bool open(const char* host, int port, const char* id) {
+    fd_ = tcpConnect(host, port);
+    if (fd_ < 0) return false;
+    uint8_t buf[256];
+    if (!sendPacket(fd_, mqttConnectPacket(buf, sizeof(buf), id, 60))) return false;
+    return waitFor(MQTT_CONNACK, 2000);
+  }
+
+  bool subscribe(const char* filter, uint8_t qos) {
+    uint8_t buf[256];
+    return sendPacket(fd_, mqttSubscribePacket(buf, sizeof(buf), ++id_, filter, qos)) &&
+           waitFor(MQTT_SUBACK, 2000);
+  }
+
+  bool publish(const char* topic, const void* payload, size_t len, uint8_t qos) {
+    uint8_t buf[1024];
+    if (++id_ == 0) id_ = 1;
+    return sendPacket(fd_, mqttPublishPacket(buf, sizeof(buf), topic, (const uint8_t*)payload,
+                                             len, qos, false, id_));
+  }
+
+  // Next packet of the given type within ms (others are handled or skipped)
+  bool waitFor(uint8_t type, int ms) {
+    auto start = Clock::now();
+    for (;;) {
+      while (pos_ < got_) {
+        if (!in_.feed(buf_[pos_++])) continue;
+        if (in_.type() == MQTT_PUBLISH) {
+          MqttPublish msg;
+          if (mqttParsePublish(in_, msg) && msg.qos == 1) {
+            uint8_t ack[8];
+            sendPacket(fd_, mqttIdPacket(ack, sizeof(ack), MQTT_PUBACK, msg.id));
+          }
+        }
+        if (in_.type() == type) return true;
+      }
+      int left = ms - (int)msSince(start);
+      if (left <= 0) return false;
+      pollfd p = { fd_, POLLIN, 0 };
+      if (poll(&p, 1, left) <= 0) return false;
+      ssize_t n = recv(fd_, buf_, sizeof(buf_), 0);
+      if (n <= 0) return false;
+      got_ = n;
+      pos_ = 0;
+    }
+  }
+
+  const MqttParser &last() const { return in_; }
+
+  void close() {
+    if (fd_ >= 0) {
+      uint8_t buf[4];
+      sendPacket(fd_, mqttEmptyPacket(buf, sizeof(buf), MQTT_DISCONNECT));
+      ::close(fd_);
+    }
+    fd_ = -1;
+  }
+
+ private:
+  int        fd_ = -1;
+  uint16_t   id_ = 0;
+  MqttParser in_;
+  uint8_t    buf_[8192];
+  size_t     got_ = 0, pos_ = 0;
+};
+
+// -------------------
+// Samples
+// -------------------
+struct Summary {
+  double median, p99, worst;
+};
+
+static Summary summarize(std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  if (v.empty()) return { 0, 0, 0 };
+  return { v[v.size() / 2], v[std::min(v.size() - 1, v.size() * 99 / 100)], v.back() };
+}
+
+static void printSummary(const char* name, const std::vector<double> &ms, double perSecond) {
+  Summary s = summarize(ms);
+  printf("%-30s median %7.3f ms  p99 %7.3f ms  worst %7.3f ms  %8.0f /s\n", name, s.median,
+         s.p99, s.worst, perSecond);
+}
+
+// -------------------
+// Codec checks
+// -------------------
+static void checkCodec() {
+  uint8_t buf[600];
+  const char* text = "{\"delta\":3,\"counter\":17,\"state\":\"volume\"}";
+  MqttPacket p = mqttPublishPacket(buf, sizeof(buf), "knob/knob", (const uint8_t*)text,
+                                   strlen(text), 1, true, 0x1234);
+  MqttParser parser;
+  bool done = false;
+  for (size_t i = 0; i < p.len; i++) done = parser.feed(p.data[i]);
+  MqttPublish msg;
+  check(done && mqttParsePublish(parser, msg), "publish parses");
+  check(msg.qos == 1 && msg.retain && msg.id == 0x1234, "publish flags and id");
+  check(std::string(msg.topic, msg.topicLen) == "knob/knob", "publish topic");
+  check(std::string((const char*)msg.payload, msg.payloadLen) == text, "publish payload");
+
+  // 200-byte body: a two-byte remaining length
+  std::string big(200, 'x');
+  p = mqttPublishPacket(buf, sizeof(buf), "t", (const uint8_t*)big.data(), big.size(), 0, false, 0);
+  check(p.data[1] == ((3 + 200) % 128 | 0x80) && p.data[2] == (3 + 200) / 128, "remaining length varint");
+  done = false;
+  for (size_t i = 0; i < p.len; i++) done = parser.feed(p.data[i]);
+  check(done && mqttParsePublish(parser, msg) && msg.payloadLen == 200, "long publish parses");
+  check(mqttPublishPacket(buf, 16, "t", (const uint8_t*)big.data(), big.size(), 0, false, 0).len == 0,
+        "too big for the buffer gives an empty packet");
+
+  p = mqttEmptyPacket(buf, sizeof(buf), MQTT_PINGREQ);
+  check(p.len == 2 && parser.feed(p.data[0]) == false && parser.feed(p.data[1]) &&
+        parser.type() == MQTT_PINGREQ, "zero-length packet");
+
+  check(mqttTopicMatches("knob/+/result", "knob/door/result", 16), "+ matches a level");
+  check(!mqttTopicMatches("knob/+", "knob/a/b", 8), "+ stops at /");
+  check(mqttTopicMatches("knob/#", "knob/a/b", 8), "# matches the rest");
+  check(!mqttTopicMatches("knob/cmd", "knob/cmd/result", 15), "no prefix match");
+
+  // Outbox: bounded, QoS 0 dropped first, PUBACK and resend
+  MqttOutbox<4> box;
+  const uint8_t one[1] = { '1' };
+  box.push("a", one, 1, 1, false, 0);
+  box.push("b", one, 1, 0, false, 1);
+  box.push("c", one, 1, 1, false, 2);
+  box.push("d", one, 1, 0, false, 3);
+  box.push("e", one, 1, 1, false, 4);   // full: drops "b"
+  check(box.size() == 4 && box.stats().dropped == 1, "outbox is bounded");
+  std::string order;
+  for (MqttOutMsg* m; (m = box.next(10, 5000)) != nullptr;) {
+    order += m->topic;
+    box.markSent(m, 10);
+  }
+  check(order == "acde", "oldest QoS 0 dropped, rest in order");
+  check(box.size() == 3, "QoS 1 kept until acked");
+  MqttOutMsg* again = box.next(6000, 5000);
+  check(again && again->topic[0] == 'a', "unacked QoS 1 due again after the retry time");
+  check(box.ack(1, 20) && box.size() == 2, "PUBACK frees the slot");
+  check(!box.ack(1, 20), "a second PUBACK is ignored");
+  box.resendAll();
+  check(box.next(21, 5000) != nullptr && box.next(21, 5000)->dup, "reconnect resends with DUP");
+  char longTopic[MQTT_TOPIC_MAX + 8];
+  memset(longTopic, 't', sizeof(longTopic) - 1);
+  longTopic[sizeof(longTopic) - 1] = '\0';
+  check(!box.push(longTopic, one, 1, 0, false, 0) && box.stats().rejected == 1, "long topic rejected");
+}
+
+// -------------------
+// Loopback bench
+// -------------------
+static void latency(const char* host, int port, uint8_t qos, int runs, std::vector<double> &ms,
+                    double &perSecond) {
+  Client sub, pub;
+  if (!sub.open(host, port, "bench-sub") || !pub.open(host, port, "bench-pub") ||
+      !sub.subscribe("bench/echo", 1)) {
+    check(false, "bench clients connect");
+    return;
+  }
+  auto all = Clock::now();
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    uint32_t seq = i;
+    pub.publish("bench/echo", &seq, sizeof(seq), qos);
+    if (!sub.waitFor(MQTT_PUBLISH, 2000)) {
+      check(false, "delivery through the broker");
+      break;
+    }
+    ms.push_back(msSince(start));
+    if (qos) pub.waitFor(MQTT_PUBACK, 2000);
+  }
+  perSecond = runs / (msSince(all) / 1000.0);
+  sub.close();
+  pub.close();
+}
+
+static double burst(const char* host, int port, int count) {
+  Client sub, pub;
+  if (!sub.open(host, port, "burst-sub") || !pub.open(host, port, "burst-pub") ||
+      !sub.subscribe("bench/burst", 0)) {
+    return 0;
+  }
+  const char* payload = "{\"delta\":1,\"counter\":1,\"state\":\"volume\"}";
+  std::atomic<int> got(0);
+  std::thread reader([&]() {
+    while (got < count && sub.waitFor(MQTT_PUBLISH, 2000)) got++;
+  });
+  auto start = Clock::now();
+  for (int i = 0; i < count; i++) pub.publish("bench/burst", payload, strlen(payload), 0);
+  reader.join();
+  double s = msSince(start) / 1000.0;
+  check(got == count, "burst fully delivered");
+  sub.close();
+  pub.close();
+  return got / s;
+}
+
+// One request per new connection, as the knob's automations do now
+static void httpPerAction(const char* host, int port, const char* path, int runs,
+                          std::vector<double> &ms, double &perSecond) {
+  std::string req = std::string("GET ") + path + " HTTP/1.0\r\nHost: " + host +
+                    "\r\nConnection: close\r\n\r\n";
+  auto all = Clock::now();
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    int fd = tcpConnect(host, port);
+    if (fd < 0 || !sendAll(fd, req.data(), req.size())) {
+      check(false, "http request");
+      if (fd >= 0) close(fd);
+      return;
+    }
+    char buf[2048];
+    while (recv(fd, buf, sizeof(buf), 0) > 0) {}
+    close(fd);
+    ms.push_back(msSince(start));
+  }
+  perSecond = runs / (msSince(all) / 1000.0);
+}
+
+static void httpServer(int fd, const std::atomic<bool> &stop) {
+  const char resp[] = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n{\"state\":\"menu\"}";
+  while (!stop) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0) continue;
+    int c = accept(fd, nullptr, nullptr);
+    if (c < 0) continue;
+    char buf[1024];
+    recv(c, buf, sizeof(buf), 0);
+    sendAll(c, resp, sizeof(resp) - 1);
+    close(c);
+  }
+}
+
+static int selftest(int runs) {
+  checkCodec();
+  printf("codec: %s\n\n", failures ? "FAILED" : "ok");
+
+  int mqttPort = 0, httpPort = 0;
+  int mqttFd = tcpListen(mqttPort), httpFd = tcpListen(httpPort);
+  if (mqttFd < 0 || httpFd < 0) {
+    printf("can't listen on loopback\n");
+    return 1;
+  }
+  std::atomic<bool> stop(false);
+  Broker broker(mqttFd);
+  std::thread brokerThread([&]() { broker.run(stop); });
+  std::thread httpThread([&]() { httpServer(httpFd, stop); });
+
+  std::vector<double> q0, q1, http;
+  double q0Rate = 0, q1Rate = 0, httpRate = 0;
+  latency("127.0.0.1", mqttPort, 0, runs, q0, q0Rate);
+  latency("127.0.0.1", mqttPort, 1, runs, q1, q1Rate);
+  double burstRate = burst("127.0.0.1", mqttPort, runs * 10);
+  httpPerAction("127.0.0.1", httpPort, "/api/state", runs, http, httpRate);
+
+  stop = true;
+  brokerThread.join();
+  httpThread.join();
+  close(mqttFd);
+  close(httpFd);
+
+  printf("loopback, %d actions each\n", runs);
+  printSummary("MQTT QoS 0 publish->delivery", q0, q0Rate);
+  printSummary("MQTT QoS 1 publish->delivery", q1, q1Rate);
+  printSummary("HTTP request per action", http, httpRate);
+  printf("%-30s %8.0f messages/s (QoS 0, %d in flight)\n", "MQTT burst", burstRate, runs * 10);
+  printf("\n%s (%d failed)\n", failures ? "FAILED" : "all checks passed", failures);
+  return failures ? 1 : 0;
+}
+
+// -------------------
+// Against a knob
+// -------------------
+static int device(const char* broker, int brokerPort, const char* knob, int runs) {
+  Client c;
+  if (!c.open(broker, brokerPort, "mqttbench") || !c.subscribe("knob/pong", 0)) {
+    fprintf(stderr, "can't reach the broker at %s:%d\n", broker, brokerPort);
+    return 1;
+  }
+  std::vector<double> mqtt, http;
+  double mqttRate = 0, httpRate = 0;
+  auto all = Clock::now();
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    std::string seq = std::to_string(i);
+    c.publish("knob/ping", seq.data(), seq.size(), 0);
+    if (!c.waitFor(MQTT_PUBLISH, 3000)) {
+      fprintf(stderr, "no pong from the knob (is it connected to %s?)\n", broker);
+      return 1;
+    }
+    mqtt.push_back(msSince(start));
+  }
+  mqttRate = runs / (msSince(all) / 1000.0);
+  c.close();
+  printSummary("MQTT ping -> pong via broker", mqtt, mqttRate);
+
+  if (knob) {
+    httpPerAction(knob, 80, "/api/state", runs, http, httpRate);
+    printSummary("HTTP GET /api/state", http, httpRate);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int port = 1883, runs = 0;
+  const char* broker = nullptr;
+  const char* knob = nullptr;
+  bool runBroker = false, test = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--broker") == 0)        runBroker = true;
+    else if (strcmp(argv[i], "--selftest") == 0) test = true;
+    else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) port = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) runs = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) broker = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "-H") == 0) knob = argv[++i];
+  }
+
+  if (runBroker) {
+    int fd = tcpListen(port);
+    if (fd < 0) {
+      fprintf(stderr, "can't listen on port %d\n", port);
+      return 1;
+    }
+    printf("broker stand-in on port %d\n", port);
+    std::atomic<bool> stop(false);
+    Broker(fd).run(stop);
+    return 0;
+  }
+  if (test) return selftest(runs > 0 ? runs : 500);
+  if (broker) return device(broker, port, knob, runs > 0 ? runs : 50);
+
+  fprintf(stderr, "usage: %s --broker [-p port] | --selftest [-n runs] | -b broker [-p port] [-H knob] [-n runs]\n",
+          argv[0]);
+  return 2;
+}
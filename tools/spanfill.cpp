@@ -0,0 +1,224 @@
+// =============================================================
+// spanfill — check the span fills against the stock library, time them
+//
+//   g++ -O2 -std=c++17 -Wall -o spanfill tools/spanfill.cpp
+//   ./spanfill [-n calls]   (default 2000000)
+//
+// Runs the device's spanfill.h (what FastSSD1306 draws fillRect and
+// drawFastHLine with) next to the stock code it replaces, copied
+// below from Adafruit_GFX 1.11 / Adafruit_SSD1306 2.5 for rotation
+// 0: GFX fillRect as one drawFastVLine per column, and the
+// SSD1306's own drawFastVLineInternal / drawFastHLineInternal.
+//
+//  - random rectangles and lines, all three colours, partly or
+//    wholly off screen, negative sizes: the two 128x64 buffers must
+//    stay identical byte for byte after every call
+//  - the fills one menu and one volume frame make, timed both ways
+//
+// Exits non-zero if the buffers ever differ.
+// =============================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../spanfill.h"
+
+static const int16_t WIDTH  = 128;
+static const int16_t HEIGHT = 64;
+static const size_t  FRAME  = WIDTH * HEIGHT / 8;
+
+// -------------------
+// Stock (Adafruit) reference, rotation 0
+// -------------------
+struct Stock {
+  uint8_t* buffer;
+
+  void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    if ((y >= 0) && (y < HEIGHT)) {
+      if (x < 0) {
+        w += x;
+        x = 0;
+      }
+      if ((x + w) > WIDTH) w = (WIDTH - x);
+      if (w > 0) {
+        uint8_t *pBuf = &buffer[(y / 8) * WIDTH + x], mask = 1 << (y & 7);
+        switch (color) {
+          case SPAN_WHITE:   while (w--) { *pBuf++ |= mask; } break;
+          case SPAN_BLACK:   mask = ~mask; while (w--) { *pBuf++ &= mask; } break;
+          case SPAN_INVERSE: while (w--) { *pBuf++ ^= mask; } break;
+        }
+      }
+    }
+  }
+
+  void drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uint16_t color) {
+    if ((x >= 0) && (x < WIDTH)) {
+      if (__y < 0) {
+        __h += __y;
+        __y = 0;
+      }
+      if ((__y + __h) > HEIGHT) __h = (HEIGHT - __y);
+      if (__h > 0) {
+        uint8_t y = __y, h = __h;
+        uint8_t* pBuf = &buffer[(y / 8) * WIDTH + x];
+        uint8_t mod = (y & 7);
+        if (mod) {
+          mod = 8 - mod;
+          static const uint8_t premask[8] = { 0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE };
+          uint8_t mask = premask[mod];
+          if (h < mod) mask &= (0XFF >> (mod - h));
+          switch (color) {
+            case SPAN_WHITE:   *pBuf |= mask; break;
+            case SPAN_BLACK:   *pBuf &= ~mask; break;
+            case SPAN_INVERSE: *pBuf ^= mask; break;
+          }
+          pBuf += WIDTH;
+        }
+        if (h >= mod) {
+          h -= mod;
+          if (h >= 8) {
+            if (color == SPAN_INVERSE) {
+              do {
+                *pBuf ^= 0xFF;
+                pBuf += WIDTH;
+                h -= 8;
+              } while (h >= 8);
+            } else {
+              uint8_t val = (color != SPAN_BLACK) ? 255 : 0;
+              do {
+                *pBuf = val;
+                pBuf += WIDTH;
+                h -= 8;
+              } while (h >= 8);
+            }
+          }
+          if (h) {
+            mod = h & 7;
+            static const uint8_t postmask[8] = { 0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F };
+            uint8_t mask = postmask[mod];
+            switch (color) {
+              case SPAN_WHITE:   *pBuf |= mask; break;
+              case SPAN_BLACK:   *pBuf &= ~mask; break;
+              case SPAN_INVERSE: *pBuf ^= mask; break;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Adafruit_GFX::fillRect
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t i = x; i < x + w; i++) drawFastVLineInternal(i, y, h, color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    drawFastHLineInternal(x, y, w, color);
+  }
+};
+
+struct Span {
+  uint8_t* buffer;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    spanFillRect(buffer, WIDTH, HEIGHT, x, y, w, h, color);
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    spanHLine(buffer, WIDTH, HEIGHT, x, y, w, color);
+  }
+};
+
+// Word-aligned like the heap buffer Adafruit allocates
+alignas(4) static uint8_t stockBuf[FRAME];
+alignas(4) static uint8_t spanBuf[FRAME];
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// Mostly on screen, some off every edge, some negative sizes
+static int16_t coord(int16_t limit) { return (int16_t)((int)(next() % (limit + 40)) - 20); }
+static int16_t size(int16_t limit)  { return (int16_t)((int)(next() % (limit + 30)) - 6); }
+
+static long compare(long calls) {
+  for (size_t i = 0; i < FRAME; i++) stockBuf[i] = spanBuf[i] = (uint8_t)next();
+  Stock stock = { stockBuf };
+  Span  span  = { spanBuf };
+  long mismatches = 0;
+  for (long n = 0; n < calls; n++) {
+    int16_t x = coord(WIDTH), y = coord(HEIGHT);
+    uint16_t color = next() % 3;
+    if (next() & 1) {
+      int16_t w = size(WIDTH), h = size(HEIGHT);
+      stock.fillRect(x, y, w, h, color);
+      span.fillRect(x, y, w, h, color);
+    } else {
+      int16_t w = size(WIDTH);
+      stock.drawFastHLine(x, y, w, color);
+      span.drawFastHLine(x, y, w, color);
+    }
+    if (memcmp(stockBuf, spanBuf, FRAME) != 0) {
+      if (mismatches < 5) printf("FAIL: buffers differ after call %ld\n", n);
+      mismatches++;
+      memcpy(spanBuf, stockBuf, FRAME);
+    }
+  }
+  return mismatches;
+}
+
+// The fills of a menu frame (highlight bar, title bar, separators)
+// and a volume frame (bar, ticks, speaker as spans)
+template<class Gfx>
+static void frames(Gfx &g) {
+  g.fillRect(0, 0, WIDTH, HEIGHT, SPAN_BLACK);
+  g.fillRect(0, 0, WIDTH, 12, SPAN_WHITE);
+  g.drawFastHLine(0, 13, WIDTH, SPAN_WHITE);
+  for (int i = 0; i < 4; i++) g.drawFastHLine(4, 24 + 10 * i, WIDTH - 8, SPAN_WHITE);
+  g.fillRect(2, 26, WIDTH - 4, 11, SPAN_INVERSE);
+
+  g.fillRect(0, 0, WIDTH, HEIGHT, SPAN_BLACK);
+  g.fillRect(10, 40, 108, 12, SPAN_WHITE);
+  g.fillRect(12, 42, 60, 8, SPAN_BLACK);
+  for (int16_t t = 0; t < 11; t++) g.drawFastHLine(10 + 10 * t, 54, 2, SPAN_WHITE);
+  for (int16_t r = 0; r < 16; r++) g.drawFastHLine(56 - r / 2, 10 + r, r / 2 + 4, SPAN_WHITE);
+}
+
+template<class Gfx>
+static double frameUs(Gfx &g, long n) {
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; i++) {
+    frames(g);
+    asm volatile("" : : "r"(g.buffer) : "memory");
+  }
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / n / 2;
+}
+
+int main(int argc, char** argv) {
+  long calls = 2000000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) calls = strtol(argv[i + 1], nullptr, 10);
+  }
+
+  long mismatches = compare(calls);
+  printf("%ld random fillRect/drawFastHLine calls: %ld mismatches\n", calls, mismatches);
+
+  Stock stock = { stockBuf };
+  Span  span  = { spanBuf };
+  frames(stock);
+  frames(span);
+  bool same = memcmp(stockBuf, spanBuf, FRAME) == 0;
+  if (!same) printf("FAIL: frames differ\n");
+  double stockUs = frameUs(stock, 200000);
+  double spanUs  = frameUs(span, 200000);
+  printf("fills per frame (this host): stock %.2f us, span %.2f us (%.1fx)\n", stockUs, spanUs,
+         stockUs / spanUs);
+
+  bool ok = mismatches == 0 && same;
+  printf("\n%s\n", ok ? "all checks passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// =============================================================
+// standbysim — model the standby sleep schedule and its energy
+//
+//   g++ -O2 -std=c++17 -o standbysim tools/standbysim.cpp
+//   ./standbysim [-p pollMs] [-h hours] [-t]
+//
+//   -p  upper bound on a blocking wait (default STANDBY_POLL_MS)
+//   -h  simulated standby time (default 1 h)
+//   -t  print the first passes and redraws of each schedule
+//
+// Uses the device's powermodel.h, so the wake-up times are the
+// ones standbyIdle() would pick. Three schedules are compared:
+//
+//   old         delay(10) loop at full clock, redraw every second,
+//               full contrast
+//   low-clock   new schedule without power management: blocking
+//               waits at 80 MHz, redraw once a minute, dimmed
+//   light-sleep new schedule with esp_pm automatic light sleep
+//
+// Per-pass costs are estimates at 160 MHz (loop overhead with no
+// request pending, standby redraw incl. the I2C flush) and scale
+// with the clock; replace them with numbers from /api/power.
+// =============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../powermodel.h"
+
+static const uint32_t PASS_US_160   = 350;     // handleClient + WiFi/OTA checks
+static const uint32_t REDRAW_US_160 = 27000;   // draw ~2 ms + flush ~25 ms at 400 kHz I2C
+static const uint32_t OLD_DELAY_MS  = 10;
+static const uint32_t OLD_REDRAW_MS = 1000;
+
+struct Schedule {
+  const char*     name;
+  StandbyIdleMode idle;
+  bool            dimmed;
+  uint32_t        clockMhz;
+  bool            minuteRedraw;   // new schedule
+};
+
+struct SimResult {
+  PowerResidency r;
+  uint32_t passes;
+  uint32_t redraws;
+};
+
+static uint32_t scaled(uint32_t us160, uint32_t mhz) {
+  return (uint32_t)((uint64_t)us160 * 160 / mhz);
+}
+
+static SimResult run(const Schedule &s, uint64_t durationMs, uint32_t pollMs, bool trace) {
+  SimResult res = {};
+  // Start part-way into a minute so the first redraw isn't aligned
+  uint64_t nowUs = 17345ULL * 1000;
+  uint64_t endUs = nowUs + durationMs * 1000;
+  uint64_t lastMinute = nowUs / 1000 / STANDBY_REDRAW_MS;
+  uint64_t lastRedrawUs = nowUs;
+  int traced = 0;
+
+  while (nowUs < endUs) {
+    uint32_t active = scaled(PASS_US_160, s.clockMhz);
+    bool redraw;
+    if (s.minuteRedraw) {
+      uint64_t minute = nowUs / 1000 / STANDBY_REDRAW_MS;
+      redraw = minute != lastMinute;
+      lastMinute = minute;
+    } else {
+      redraw = nowUs - lastRedrawUs >= OLD_REDRAW_MS * 1000ULL;
+    }
+    if (redraw) {
+      active += scaled(REDRAW_US_160, s.clockMhz);
+      lastRedrawUs = nowUs;
+      res.redraws++;
+    }
+    nowUs += active;
+    res.r.activeUs += active;
+    res.passes++;
+
+    uint32_t waitMs = s.minuteRedraw
+        ? standbyWaitMs((uint32_t)((nowUs / 1000) % STANDBY_REDRAW_MS), pollMs)
+        : OLD_DELAY_MS;
+    // First few passes, then only the interesting ones (redraws and
+    // waits cut short by the minute boundary)
+    bool interesting = redraw || (s.minuteRedraw && waitMs < pollMs);
+    if (trace && traced < 12 && (res.passes <= 4 || interesting)) {
+      printf("  %-11s t=%9.3f s  %s  wait %5u ms\n", s.name, nowUs / 1e6,
+             redraw ? "redraw" : "      ", (unsigned)waitMs);
+      traced++;
+    }
+    nowUs += waitMs * 1000ULL;
+    res.r.idleUs += waitMs * 1000ULL;
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  uint32_t pollMs = STANDBY_POLL_MS;
+  double hours = 1.0;
+  bool trace = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)      pollMs = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-h") && i + 1 < argc) hours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t"))                 trace = true;
+    else {
+      fprintf(stderr, "usage: standbysim [-p pollMs] [-h hours] [-t]\n");
+      return 1;
+    }
+  }
+  if (pollMs == 0) pollMs = 1;
+
+  const Schedule schedules[] = {
+    { "old",         IDLE_BUSY_WAIT,   false, 160, false },
+    { "low-clock",   IDLE_LOW_CLOCK,   true,   80, true  },
+    { "light-sleep", IDLE_LIGHT_SLEEP, true,  160, true  },
+  };
+  uint64_t durationMs = (uint64_t)(hours * 3600.0 * 1000.0);
+
+  if (trace) {
+    for (const Schedule &s : schedules) run(s, durationMs, pollMs, true);
+    printf("\n");
+  }
+
+  printf("schedule    |  passes redraws | active %%  | avg mA | mWh/h  | days on 1000 mAh\n");
+  printf("------------+-----------------+-----------+--------+--------+-----------------\n");
+  for (const Schedule &s : schedules) {
+    SimResult res = run(s, durationMs, pollMs, false);
+    uint32_t ua = averageCurrentUa(res.r, s.idle, s.dimmed, POWER_PROFILE_C3);
+    double activePct = 100.0 * res.r.activeUs / (double)(res.r.activeUs + res.r.idleUs);
+    printf("%-11s | %7u %7u | %8.3f  | %6.2f | %6.1f | %8.1f\n", s.name,
+           (unsigned)res.passes, (unsigned)res.redraws, activePct, ua / 1000.0,
+           energyPerHourUwh(ua) / 1000.0, 1000.0 / (ua / 1000.0) / 24.0);
+  }
+  return 0;
+}
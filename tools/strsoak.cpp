@@ -0,0 +1,298 @@
+// =============================================================
+// strsoak — soak the fixed-capacity string layer
+//
+//   g++ -O2 -std=c++17 -Wall -o strsoak tools/strsoak.cpp
+//   ./strsoak [-n rounds]   (default 200)
+//
+// Churns the device's fixedstring.h the way the logging, OTA and
+// portal paths use it (log lines, version URLs, JSON bodies, scan
+// lists) and checks every result against std::string cut at the
+// same capacity:
+//
+//  - contents, length() and the NUL after them
+//  - truncated() set once an append didn't fit and kept until the
+//    string is cleared or assigned, capacity() never exceeded, guard
+//    bytes either side of the object intact
+//  - StrView search and substr at the edges
+//
+// Then the heap: each round builds the same traffic once with
+// FixedString and once with std::string (standing in for Arduino
+// String), counting allocations and the bytes in use after the
+// round. The FixedString rounds must allocate nothing and leave
+// the heap exactly where it was.
+//
+// Exits non-zero if a check fails.
+// =============================================================
+
+#include <malloc.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "../fixedstring.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    if (failures < 20) printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// -------------------
+// Allocation counting
+// -------------------
+static size_t allocations = 0;
+
+void* operator new(size_t n) {
+  allocations++;
+  void* p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static size_t heapInUse() {
+  return mallinfo2().uordblks;
+}
+
+// -------------------
+// Contents against a reference
+// -------------------
+static uint32_t rng = 2463534242u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static std::string randomText(size_t maxLen) {
+  std::string s;
+  size_t n = next() % (maxLen + 1);
+  for (size_t i = 0; i < n; i++) s += (char)(' ' + next() % 95);
+  return s;
+}
+
+// A FixedString with guard bytes either side
+template<size_t N>
+struct Guarded {
+  uint8_t        before[16];
+  FixedString<N> str;
+  uint8_t        after[16];
+  Guarded() {
+    memset(before, 0xA5, sizeof(before));
+    memset(after, 0x5A, sizeof(after));
+  }
+  bool intact() const {
+    for (uint8_t b : before) if (b != 0xA5) return false;
+    for (uint8_t b : after)  if (b != 0x5A) return false;
+    return true;
+  }
+};
+
+template<size_t N>
+static void matches(const Guarded<N> &g, const std::string &ref, bool refTruncated, const char* what) {
+  const FixedString<N> &s = g.str;
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%s (N=%zu)", what, N);
+  check(s.length() == ref.size(), msg);
+  check(s.length() <= FixedString<N>::capacity(), msg);
+  check(memcmp(s.c_str(), ref.data(), ref.size()) == 0, msg);
+  check(s.c_str()[s.length()] == '\0', msg);
+  check(s.truncated() == refTruncated, msg);
+  check(g.intact(), msg);
+}
+
+// One random operation on both
+template<size_t N>
+static void churnOne(Guarded<N> &g, std::string &ref, bool &refTrunc) {
+  const size_t cap = FixedString<N>::capacity();
+  auto add = [&](const std::string &t) {
+    size_t room = cap - ref.size();
+    if (t.size() > room) refTrunc = true;
+    ref += t.substr(0, room);
+  };
+  switch (next() % 8) {
+    case 0: {
+      std::string t = randomText(N);
+      g.str.append(t.c_str());
+      add(t);
+      break;
+    }
+    case 1: {
+      char c = (char)('a' + next() % 26);
+      g.str += c;
+      add(std::string(1, c));
+      break;
+    }
+    case 2: {
+      unsigned v = next();
+      int w = (int)(next() % 12);
+      g.str.appendf("%*u,", w, v);
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%*u,", w, v);
+      add(buf);
+      break;
+    }
+    case 3: {
+      std::string t = randomText(8);
+      int v = (int)(next() % 2000) - 1000;
+      g.str.appendf("{\"k\":\"%s\",\"v\":%d}", t.c_str(), v);
+      char buf[64];
+      snprintf(buf, sizeof(buf), "{\"k\":\"%s\",\"v\":%d}", t.c_str(), v);
+      add(buf);
+      break;
+    }
+    case 4: {
+      size_t n = next() % (cap + 2);
+      g.str.truncate(n);
+      if (n < ref.size()) ref.resize(n);
+      break;
+    }
+    case 5: {
+      std::string t = randomText(N + 4);
+      g.str = t.c_str();
+      ref.clear();
+      refTrunc = false;
+      add(t);
+      break;
+    }
+    case 6: {
+      g.str.clear();
+      ref.clear();
+      refTrunc = false;
+      break;
+    }
+    default: {
+      // Written through data(), as the MAC and scan-list code do
+      std::string t = randomText(N + 8);
+      snprintf(g.str.data(), N, "%s", t.c_str());
+      g.str.syncLength();
+      ref = t.substr(0, cap);   // cut by the caller, not flagged; the flag stays as it was
+      break;
+    }
+  }
+}
+
+template<size_t N>
+static void churn(long ops) {
+  Guarded<N> g;
+  std::string ref;
+  bool refTrunc = false;
+  for (long i = 0; i < ops; i++) {
+    churnOne(g, ref, refTrunc);
+    matches(g, ref, refTrunc, "churn");
+  }
+}
+
+static void edges() {
+  Guarded<8> g;   // 7 chars
+  g.str.append("1234567");
+  matches(g, "1234567", false, "exactly full");
+  g.str.append("");
+  matches(g, "1234567", false, "empty append when full");
+  g.str.append('x');
+  matches(g, "1234567", true, "one char past full");
+  g.str.clear();
+  g.str.appendf("%s", "abcdefghij");
+  matches(g, "abcdefg", true, "appendf past full");
+  g.str.clear();
+  g.str.appendf("%d", 12345);
+  g.str.appendf("%d", 678);
+  matches(g, "1234567", true, "second appendf cut");
+
+  Guarded<2> one;
+  one.str.append("ab");
+  matches(one, "a", true, "capacity 1");
+
+  StrView v("GET /api/state HTTP/1.1");
+  check(v.indexOf(' ') == 3, "indexOf char");
+  check(v.indexOf(StrView("HTTP")) == 15, "indexOf view");
+  check(v.indexOf(StrView("HTTP/1.1x")) == -1, "needle past the end");
+  check(v.indexOf(' ', 4) == 14, "indexOf from");
+  check(v.substr(4, 10).equals("/api/state"), "substr");
+  check(v.substr(40).len == 0, "substr past the end");
+  check(v.substr(15, 100).equals("HTTP/1.1"), "substr count clipped");
+  check(v.startsWith("GET ") && !v.startsWith("POST"), "startsWith");
+  check(StrView("").indexOf(StrView("a")) == -1, "empty haystack");
+}
+
+// -------------------
+// Heap across rounds
+// -------------------
+// One round of the traffic the device builds: log lines, the OTA
+// URL with the MAC, a JSON body, a scan list
+static void roundFixed(unsigned r) {
+  FixedString<160> line;
+  line.appendf("OTA: Current ver: %s, checking %u", "1.4.2", r);
+  FixedString<128> url;
+  url.append("http://updates.example/api/version?mac=");
+  url.appendf("%02X:%02X:%02X:%02X:%02X:%02X", 0x24, 0x6F, 0x28, r & 0xFF, 0x10, 0x01);
+  FixedString<512> json;
+  json.appendf("{\"state\":%u,\"counter\":%d,\"wifi\":{\"connected\":true,\"rssi\":%d}}", r % 9,
+               (int)(r % 99), -40 - (int)(r % 30));
+  FixedString<640> scan;
+  for (int i = 0; i < 10; i++) scan.appendf("<li>net-%u-%d</li>", r, i);
+  check(line.length() + url.length() + json.length() + scan.length() > 0, "round built");
+}
+
+static void roundString(unsigned r) {
+  std::string line = "OTA: Current ver: " + std::string("1.4.2") + ", checking " + std::to_string(r);
+  std::string url  = std::string("http://updates.example/api/version?mac=") + "24:6F:28:" +
+                    std::to_string(r & 0xFF) + ":10:01";
+  std::string json = "{\"state\":" + std::to_string(r % 9) + ",\"counter\":" + std::to_string(r % 99) +
+                     ",\"wifi\":{\"connected\":true,\"rssi\":" + std::to_string(-40 - (int)(r % 30)) + "}}";
+  std::string scan;
+  for (int i = 0; i < 10; i++) scan += "<li>net-" + std::to_string(r) + "-" + std::to_string(i) + "</li>";
+  check(line.size() + url.size() + json.size() + scan.size() > 0, "round built");
+}
+
+static void heap(long rounds) {
+  roundFixed(0);   // let printf set up whatever it keeps
+  size_t base = heapInUse();
+  size_t fixedAllocs = 0, fixedDrift = 0;
+  for (long r = 1; r <= rounds; r++) {
+    size_t before = allocations;
+    roundFixed((unsigned)r);
+    fixedAllocs += allocations - before;
+    size_t now = heapInUse();
+    size_t drift = now > base ? now - base : base - now;
+    if (drift > fixedDrift) fixedDrift = drift;
+  }
+  check(fixedAllocs == 0, "FixedString rounds allocate nothing");
+  check(fixedDrift == 0, "FixedString rounds leave the heap flat");
+
+  size_t stringAllocs = 0;
+  for (long r = 1; r <= rounds; r++) {
+    size_t before = allocations;
+    roundString((unsigned)r);
+    stringAllocs += allocations - before;
+  }
+
+  printf("\n%-28s %14s %14s\n", "per round", "allocations", "heap drift");
+  printf("%-28s %14.1f %14zu\n", "FixedString", (double)fixedAllocs / rounds, fixedDrift);
+  printf("%-28s %14.1f %14s\n", "std::string (like String)", (double)stringAllocs / rounds, "-");
+}
+
+int main(int argc, char** argv) {
+  long rounds = 200;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-n") == 0) rounds = strtol(argv[i + 1], nullptr, 10);
+  }
+  if (rounds < 1) rounds = 1;
+
+  edges();
+  churn<2>(rounds * 100);
+  churn<16>(rounds * 100);
+  churn<64>(rounds * 100);
+  churn<161>(rounds * 100);
+  printf("churned %ld operations per capacity (1, 15, 63, 160 chars)\n", rounds * 100);
+  heap(rounds);
+  printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
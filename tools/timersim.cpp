@@ -0,0 +1,174 @@
+// =============================================================
+// timersim — check and time the timer wheel with many timers
+//
+//   g++ -O2 -std=c++17 -o timersim tools/timersim.cpp
+//   ./timersim [-h hours] [-s seed]     (default 1 simulated hour)
+//
+// Uses the device's timerwheel.h. For 100 up to 16000 concurrent
+// timers (random one-shots up to 3 h out, some periodic, some
+// cancelled and replaced as they go) it runs the wheel and a plain
+// list — the way the old single countdown polled, one compare per
+// timer per pass — side by side on a 10 ms loop, checks that both
+// fire the same timers at the same tick, and reports the cost per
+// pass. The wheel's cost per pass stays flat as the count grows;
+// the list's grows with it.
+//
+// Also sleeps through long gaps (one advance() per nextExpiryMs())
+// to show a device in standby wakes once per deadline.
+// =============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../timerwheel.h"
+
+static const uint16_t MAX_TIMERS = 16000;
+static const uint32_t LOOP_MS    = 10;
+
+typedef TimerWheel<MAX_TIMERS> Wheel;
+static Wheel wheel;   // ~600 KB, keep it off the stack
+
+static uint32_t rng = 12345;
+static uint32_t nextRandom() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// Reference: every timer in a flat list, scanned each pass
+struct ListTimer {
+  uint64_t due;      // ms, rounded up to a tick like the wheel
+  uint32_t period;
+  uint32_t tag;
+  bool     live;
+};
+
+struct Fired {
+  uint32_t tag;
+  uint64_t atMs;
+};
+
+static uint64_t roundTick(uint64_t ms) {
+  return (ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS * TIMER_WHEEL_TICK_MS;
+}
+
+static double nsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool sameFirings(std::vector<Fired> &a, std::vector<Fired> &b) {
+  auto byTag = [](const Fired &x, const Fired &y) { return x.atMs != y.atMs ? x.atMs < y.atMs : x.tag < y.tag; };
+  std::sort(a.begin(), a.end(), byTag);
+  std::sort(b.begin(), b.end(), byTag);
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].tag != b[i].tag || a[i].atMs != b[i].atMs) return false;
+  }
+  return true;
+}
+
+static bool run(uint16_t count, uint64_t hours) {
+  const uint64_t horizonMs = 3ULL * 3600 * 1000;
+  uint64_t now = 1000;
+  wheel.begin(now);
+
+  std::vector<ListTimer> list;
+  std::vector<TimerId>   ids;
+  uint32_t tag = 0;
+  auto add = [&](uint64_t nowMs) {
+    uint64_t at     = nowMs + 1 + nextRandom() % horizonMs;
+    uint32_t period = (nextRandom() % 8 == 0) ? 1000 + nextRandom() % 600000 : 0;
+    TimerId id = wheel.schedule(at, period, 1, tag);
+    list.push_back({ roundTick(at), period ? (uint32_t)roundTick(period) : 0, tag, true });
+    ids.push_back(id);
+    tag++;
+    return id != 0;
+  };
+  for (uint16_t i = 0; i < count; i++) add(now);
+
+  std::vector<Fired> wheelFired, listFired;
+  double wheelNs = 0, listNs = 0;
+  uint64_t passes = 0;
+  uint32_t replaced = 0;
+
+  for (uint64_t end = now + hours * 3600 * 1000; now < end; now += LOOP_MS) {
+    auto start = std::chrono::steady_clock::now();
+    wheel.advance(now, [&](TimerId, const TimerNode &n) { wheelFired.push_back({ n.arg, now }); });
+    wheelNs += nsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (ListTimer &t : list) {
+      while (t.live && t.due <= now) {
+        listFired.push_back({ t.tag, now });
+        if (t.period) t.due += t.period;
+        else          t.live = false;
+      }
+    }
+    listNs += nsSince(start);
+    passes++;
+
+    // Churn: cancel a random live timer now and then, add a new one
+    if (passes % 16 == 0) {
+      uint32_t victim = nextRandom() % list.size();
+      if (list[victim].live) {
+        bool ok = wheel.cancel(ids[victim]);
+        if (!ok) {
+          fprintf(stderr, "cancel failed for live timer %u\n", victim);
+          return false;
+        }
+        list[victim].live = false;
+        if (!add(now)) break;
+        replaced++;
+      }
+    }
+  }
+
+  bool same = sameFirings(wheelFired, listFired);
+  const TimerWheelStats &st = wheel.stats();
+  printf("%6u timers  fired %7zu  replaced %5u  cascaded %8u  wheel %5.0f ns/pass"
+         "  list %9.0f ns/pass  %s\n",
+         (unsigned)count, wheelFired.size(), (unsigned)replaced, (unsigned)st.cascaded,
+         wheelNs / passes, listNs / passes, same ? "match" : "MISMATCH");
+  return same;
+}
+
+// Standby: wake only at nextExpiryMs() and count the wakes.
+static bool sleepy(uint16_t count) {
+  uint64_t now = 0;
+  wheel.begin(now);
+  for (uint16_t i = 0; i < count; i++) {
+    wheel.schedule(now + 60000 + nextRandom() % (20ULL * 3600 * 1000), 0, 1, i);
+  }
+  uint32_t wakes = 0, fired = 0;
+  for (uint64_t next; (next = wheel.nextExpiryMs()) != UINT64_MAX;) {
+    now = next;
+    wakes++;
+    uint16_t n = wheel.advance(now, [](TimerId, const TimerNode &) {});
+    if (n == 0) {
+      fprintf(stderr, "woke at %llu ms with nothing due\n", (unsigned long long)now);
+      return false;
+    }
+    fired += n;
+  }
+  printf("standby: %u timers over 20 h -> %u wakes, %u fired, %u cascades\n",
+         (unsigned)count, (unsigned)wakes, (unsigned)fired, (unsigned)wheel.stats().cascaded);
+  return fired == count;
+}
+
+int main(int argc, char** argv) {
+  uint64_t hours = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-h") == 0) hours = strtoull(argv[i + 1], nullptr, 10);
+    else if (strcmp(argv[i], "-s") == 0) rng = strtoul(argv[i + 1], nullptr, 10) | 1;
+  }
+
+  const uint16_t counts[] = { 100, 1000, 4000, 16000 };
+  bool ok = true;
+  for (uint16_t count : counts) ok &= run(count, hours);
+  ok &= sleepy(1000);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1323 @@
+// =============================================================
+// tracereplay — read an input trace from the knob and replay it
+//
+//   g++ -O2 -std=c++17 -Wall -o tracereplay tools/tracereplay.cpp
+//   curl -o knob.trace http://knobcontroller.local/api/trace
+//   ./tracereplay knob.trace [-v] [-m macros]
+//   ./tracereplay --selftest          synthetic session, no device
+//
+// -v also lists the records; -m is how many stored macros the
+// knob's menu had (default 0), since the trace doesn't say.
+//
+// Uses the device's tracecode.h to decode, and replays through the
+// device's own code: knobsteps.h (the state machine loop() steps),
+// gesturecode.h and encoderaccel.h, under the virtual clock of
+// monotime.h. Reports:
+//
+//  - handling latency: from each encoder detent and gesture to the
+//    next frame sent to the panel (input to screen), and from each
+//    button edge to the gesture it became
+//  - time spent in each state and the state at the end
+//  - frames: count, distinct screens, the last frame's hash and a
+//    digest over every frame hash in order (same session in, same
+//    digest out)
+//  - outbound HTTP: count, failures, time to first byte
+//  - accel replay: every timer-set session re-run from the recorded
+//    encoder detents through EncoderAccel on the trace's clock; each
+//    value the knob showed must come out the same
+//  - machine replay: from the first menu entry on, the recorded
+//    detents and button edges go through the gesture recognizer and
+//    knobsteps.h in 10 ms passes. The replay's states must follow
+//    the knob's; its gestures must be the knob's; and every screen
+//    it leaves up ("menu 2/5", "timer_set 12") must be the frame
+//    hash the knob sent for that screen everywhere else in the
+//    trace. State changes no recorded input explains (HTTP
+//    stopwatch, messages, HTTP timers' alarms, a wake by half a
+//    detent) are applied as recorded and counted; any other
+//    difference that lasts over a second is a divergence.
+//
+// Exits non-zero on a malformed trace, a replay mismatch, a
+// divergence or a frame that contradicts the replay.
+// =============================================================
+
+#define KNOB_VIRTUAL_CLOCK
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "../monotime.h"
+#include "../tracecode.h"
+#include "../encoderaccel.h"
+#include "../gesturecode.h"
+#include "../knobstate.h"
+
+// AppState order
+static const char* const stateNames[] = {
+  "menu", "standby", "volume", "wake", "timer_set", "timer_running", "timer_paused",
+  "timer_ended", "obs", "doorlock", "stopwatch", "macro", "message",
+  "animating_to_standby", "animating_wake"
+};
+static const uint32_t STATE_COUNT = sizeof(stateNames) / sizeof(stateNames[0]);
+static_assert(STATE_COUNT == STATE_ANIMATING_WAKE + 1, "stateNames out of step with AppState");
+
+static const char* const typeNames[] = {
+  "pad", "sync", "encoder", "button", "gesture", "state", "frame", "net", "clock", "value"
+};
+static const char* const gestureNames[] = { "down", "click", "long", "double" };
+
+static const uint64_t FRAME_WAIT_US = 1000000;   // inputs with no frame this soon don't count
+
+static const char* stateName(uint32_t s) {
+  return s < STATE_COUNT ? stateNames[s] : "?";
+}
+
+// -------------------
+// Latency samples
+// -------------------
+struct Samples {
+  const char* name;
+  std::vector<uint32_t> us;
+  uint32_t noFrame = 0;
+
+  explicit Samples(const char* n) : name(n) {}
+
+  void print() const {
+    if (us.empty() && !noFrame) return;
+    std::vector<uint32_t> s = us;
+    std::sort(s.begin(), s.end());
+    auto pct = [&](int p) { return s.empty() ? 0.0 : s[(s.size() - 1) * p / 100] / 1000.0; };
+    printf("  %-16s %6zu  p50 %7.2f ms  p95 %7.2f ms  max %7.2f ms", name, s.size(),
+           pct(50), pct(95), pct(100));
+    if (noFrame) printf("  (%u without a redraw)", noFrame);
+    printf("\n");
+  }
+};
+
+// -------------------
+// Replay of the timer-set acceleration
+// -------------------
+struct AccelReplay {
+  struct Step {
+    uint64_t us;
+    int8_t   dir;
+    uint8_t  seq;   // ring head mod 256, counted from the session entry
+  };
+  bool            active = false;
+  int             value  = 0;
+  uint8_t         head   = 0;
+  EncoderAccel    accel;
+  std::deque<Step> pending;
+  uint32_t starts = 0, checked = 0, mismatched = 0, lostSteps = 0;
+
+  void stop() {
+    active = false;
+    pending.clear();
+  }
+
+  // The mode recorded its starting value (beginTimerSet) just before
+  // loop() noticed the state change: a change to anything else ends it.
+  void state(uint32_t s) {
+    if (s != STATE_TIMER_SET) stop();
+  }
+
+  // The record only has the head mod 8, which is ambiguous once more
+  // than 8 steps go by without a value change (at 1 or 99): count
+  // the head on from the entry's tail instead, checking it agrees.
+  void step(const TraceRecord &r) {
+    uint8_t seq = r.arg >> 1;
+    if ((head & 7) != seq) {
+      lostSteps++;
+      head = (uint8_t)(head + ((seq - head) & 7));
+    }
+    pending.push_back({ r.us, (int8_t)((r.arg & 1) ? 1 : -1), head++ });
+    if (pending.size() > 255) pending.pop_front();
+  }
+
+  // The knob showed 'shown' after popping steps up to ring tail 'tail'
+  bool check(const TraceRecord &r, bool verbose) {
+    uint32_t shown = r.a;
+    uint8_t  tail  = (uint8_t)r.b;
+    if (!active) {
+      // Entry: the mode flushed the ring (tail = head) and reset the accel
+      active = true;
+      starts++;
+      accel.reset();
+      pending.clear();
+      head  = tail;
+      value = shown;
+      return true;
+    }
+    while (!pending.empty() && pending.front().seq != tail) {
+      const Step &s = pending.front();
+      value += accel.step((uint32_t)(s.us / 1000), s.dir, ACCEL_TIMER);
+      value  = std::max(1, std::min(99, value));
+      pending.pop_front();
+    }
+    checked++;
+    if ((uint32_t)value == shown) return true;
+    mismatched++;
+    if (verbose || mismatched <= 5) {
+      printf("  replay mismatch at %.3f s: knob showed %u, replay gives %d\n",
+             r.us / 1e6, (unsigned)shown, value);
+    }
+    value = shown;   // resync and carry on
+    return false;
+  }
+};
+
+// -------------------
+// The knob on the host
+// -------------------
+// What knobsteps.h needs from the sketch (see its list), minus the
+// hardware. Inputs come from the trace. The frame buffer is a key
+// naming what the draws put in it ("menu 2/5"), marked unstable
+// when the same key doesn't always mean the same pixels (clock,
+// countdown, animation). Timers, the OBS and door turns and the
+// macro VM are reduced to what the steps see of them.
+
+volatile int      counter              = 0;
+int               lastDisplayedCounter = -9999;
+volatile uint32_t inputEdges           = 0;
+volatile bool     buttonPressed        = false;
+volatile bool     buttonLongPressed    = false;
+volatile bool     buttonDoubleClicked  = false;
+bool              timerAlarmPending    = false;
+char              timerAlarmLabel[16]  = "";
+MonoTime          lastKeySendTime      = {};
+bool              macroScreenDirty     = false;
+const char        doorLockOpenUrl[]    = "http://doorlock.local/open";
+
+typedef uint32_t TimerId;
+#define TIMER_KIND_KNOB    1
+#define ENCODER_EVENT_RING 32   // rotarycode.h
+
+struct EncoderEvent {
+  int64_t us;
+  int8_t  dir;
+};
+
+EncoderEvent encoderEvents[ENCODER_EVENT_RING];
+uint8_t      encoderEventHead = 0;
+uint8_t      encoderEventTail = 0;
+EncoderAccel encoderAccel;
+
+bool popEncoderEvent(EncoderEvent &ev) {
+  if ((uint8_t)(encoderEventHead - encoderEventTail) > ENCODER_EVENT_RING) {
+    encoderEventTail = encoderEventHead - ENCODER_EVENT_RING;
+  }
+  if (encoderEventTail == encoderEventHead) return false;
+  ev = encoderEvents[encoderEventTail & (ENCODER_EVENT_RING - 1)];
+  encoderEventTail++;
+  return true;
+}
+
+void flushEncoderEvents() {
+  encoderEventTail = encoderEventHead;
+  encoderAccel.reset();
+}
+
+GestureRecognizer gestures;
+bool buttonHeld = false;
+
+bool isButtonHeld()       { return buttonHeld; }
+void consumeButtonPress() { gestures.consumed = true; }
+
+// Everything the steps record (traceRecord); the self-test also
+// writes it to a ring, as the device would
+TraceRing*               traceOut = nullptr;
+std::vector<TraceRecord> emitted;
+
+void traceRecord(uint8_t type, uint8_t arg, uint32_t a = 0, uint32_t b = 0) {
+  uint64_t us = (uint64_t)monoNow().us;
+  if (traceOut) traceOut->write(us, type, arg, a, b);
+  emitted.push_back({ type, arg, us, a, b });
+}
+
+// -- Screen --
+struct Shown {
+  int64_t     us;
+  std::string key;
+  bool        stable;
+};
+
+struct HostDisplay {
+  std::string        key;              // what the buffer holds
+  bool               stable = true;    // same key, same pixels
+  std::vector<Shown> shown;            // every frame sent
+  uint32_t           unstableFrames = 0;
+  int64_t            corruptFrom = -1;   // self-test: send the menu wrong from then on
+
+  void clearDisplay() {
+    key.clear();
+    stable = true;
+  }
+
+  void display(uint8_t startLine = 0) {
+    shown.push_back({ monoNow().us, key, stable });
+    uint32_t hash = traceHash((const uint8_t*)key.data(), key.size());
+    if (!stable) hash ^= 0x9e3779b9u * ++unstableFrames;
+    if (corruptFrom >= 0 && monoNow().us >= corruptFrom && key.compare(0, 5, "menu ") == 0) hash ^= 1;
+    traceRecord(TRACE_FRAME, 0, startLine, hash);
+  }
+} display;
+
+static void screen(bool commit, bool stable, const char* fmt, ...) {
+  char text[48];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  if (commit) display.clearDisplay();
+  if (!display.key.empty()) display.key += " | ";
+  display.key   += text;
+  display.stable = display.stable && stable;
+  if (commit) display.display();
+}
+
+static bool externalAlarm = false;   // TIME UP for a timer the trace doesn't show
+static int  macroItems    = 0;
+
+int menuItemCount() { return MENU_BUILTIN_COUNT + macroItems; }
+
+// The volume screen animates on every counter step, half detents
+// included, which the trace doesn't hold
+void drawMenu(int = 0, bool commit = true)          { screen(commit, true, "menu %d/%d", menuSelection, menuItemCount()); }
+void drawVolumeScreen(int = 0, bool commit = true)  { screen(commit, false, "volume"); }
+void drawOBSScreen(int action = 0, int = 0, bool commit = true) { screen(commit, true, "obs %d", action); }
+void drawDoorLockScreen(int status = 0, int = 0, bool commit = true) {
+  screen(commit, status == 0, "door %d", status);   // results depend on the network
+}
+void drawMacroScreen(int = 0, bool commit = true)   { screen(commit, false, "macro"); }
+void drawStandbyScreen(int = 0, bool commit = true) { screen(commit, false, "standby"); }
+void drawWakeScreen()                               { screen(true, true, "wake"); }
+void drawTimerSetScreen()                           { screen(true, true, "timer_set %d", timerMinutes); }
+void drawTimerRunningScreen(int seconds)            { screen(true, false, "timer_running %d", seconds); }
+void drawTimerPausedScreen()                        { screen(true, true, "timer_paused %d", pauseSelection); }
+void drawTimerEndedScreen(const char* label = "")   { screen(true, !externalAlarm, "timer_ended %s", label); }
+void drawStopwatchScreen()                          { screen(true, false, "stopwatch"); }
+void drawMessageScreen()                            { screen(true, false, "message"); }
+
+enum SlideDirection { SLIDE_DOWN, SLIDE_UP };
+
+void slideCaptureFrom()          {}
+void slideBegin(SlideDirection)  {}
+void slideStep(int progress) {
+  display.key    = "slide";
+  display.stable = false;
+  display.display((uint8_t)progress);
+}
+
+// -- Modes --
+struct HostOutputs {
+  uint32_t volumeSteps, trackSkips, mutes, obsTurns, doorTurns, countdowns;
+} outputs;
+
+void sendVolumeSteps(int steps) { outputs.volumeSteps += abs(steps); }
+void sendNextTrack()            { outputs.trackSkips++; }
+void sendPrevTrack()            { outputs.trackSkips++; }
+void sendMute()                 { outputs.mutes++; }
+void handleWakeModeLogic()      {}
+void httpPoolPreconnect(const char*) {}
+void buzzerOff()                {}
+void updatePowerSave(bool)      {}
+
+void standbyPass(uint32_t) {
+  if (lastStandbyUpdate == MonoTime{}) {
+    drawStandbyScreen();
+    lastStandbyUpdate = monoNow();
+  }
+}
+
+// obsTurn / doorTurn (the sketch's coroutines): the first detent of
+// a turn acts and redraws, 500 ms without one ends the turn
+struct TurnTask {
+  bool     posted = false;
+  int8_t   dir    = 0;
+  bool     active = false;
+  MonoTime idleAt = {};
+};
+
+TurnTask obsTurn, doorTurn;
+
+struct HostModeTasks {
+  void post(TurnTask &t, int16_t value) {
+    t.posted = true;
+    t.dir    = value > 0 ? 1 : -1;
+  }
+} modeTasks;
+
+#define DOOR_STATUS_UNKNOWN 9   // whatever the request gave
+
+static void turnTasksTick() {
+  if (currentState != STATE_OBS) {
+    obsTurn = {};
+    obsLastDirection = 0;
+  } else if (obsTurn.posted) {
+    obsTurn.posted = false;
+    if (!obsTurn.active) {
+      obsTurn.active   = true;
+      obsLastDirection = obsTurn.dir;
+      outputs.obsTurns++;
+      drawOBSScreen(obsTurn.dir);
+    }
+    obsTurn.idleAt = monoNow() + 500_ms;
+  } else if (obsTurn.active && monoNow() >= obsTurn.idleAt) {
+    obsTurn.active   = false;
+    obsLastDirection = 0;
+    drawOBSScreen(0);
+  }
+
+  if (currentState != STATE_DOORLOCK) {
+    doorTurn = {};
+    doorLastDirection = 0;
+  } else if (doorTurn.posted) {
+    doorTurn.posted = false;
+    if (!doorTurn.active) {
+      doorTurn.active   = true;
+      doorLastDirection = doorTurn.dir;
+      doorLastStatus    = DOOR_STATUS_UNKNOWN;
+      outputs.doorTurns++;
+      drawDoorLockScreen(doorLastStatus);
+    }
+    doorTurn.idleAt = monoNow() + 500_ms;
+  } else if (doorTurn.active && monoNow() >= doorTurn.idleAt) {
+    doorTurn.active   = false;
+    doorLastDirection = 0;
+  }
+}
+
+// A stored macro's program isn't in the trace: turns go nowhere and
+// a press goes back to the menu
+enum { MACRO_EVENT_ENTER, MACRO_EVENT_LEFT, MACRO_EVENT_RIGHT, MACRO_EVENT_PRESS };
+
+struct HostMacroVm {
+  bool open = false;
+  bool loaded() const        { return open; }
+  bool busy() const          { return false; }
+  bool hasHandler(int) const { return false; }
+  bool post(int, int16_t)    { return false; }
+} macroVm;
+
+int8_t macroSlotAt(int index) { return index >= 0 && index < macroItems ? (int8_t)index : -1; }
+bool   openMacro(int8_t slot) { return macroVm.open = slot >= 0; }
+void   closeMacro()           { macroVm.open = false; }
+void   macroTick()            {}
+
+// -- Timers: only the knob's own countdown --
+struct {
+  bool     armed = false;
+  MonoTime due   = {};
+} countdown;
+
+TimerId startCountdown(uint32_t ms, uint32_t, const char*, int) {
+  countdown.armed = true;
+  countdown.due   = monoNow() + msecs(ms);
+  outputs.countdowns++;
+  return 1;
+}
+
+bool cancelTimer(TimerId id) {
+  if (id == knobTimerId) knobTimerId = 0;
+  countdown.armed = false;
+  return true;
+}
+
+int64_t timerRemainingMs(TimerId id) {
+  if (!id || !countdown.armed) return -1;
+  int64_t left = (countdown.due - monoNow()).toMs();
+  return left > 0 ? left : 0;
+}
+
+static void timersTick() {
+  if (countdown.armed && monoNow() >= countdown.due) {
+    countdown.armed   = false;
+    knobTimerId       = 0;
+    timerAlarmPending = true;
+    externalAlarm     = false;
+    strcpy(timerAlarmLabel, "Timer");
+  }
+}
+
+#include "../knobsteps.h"
+
+// -- Driving it --
+static std::deque<std::pair<uint32_t, bool>> buttonEdgeQueue;   // for the next gesture tick
+static int tracedState = -1;
+
+// Every variable back to its boot value
+static void knobReset(int macros) {
+  currentState = STATE_MENU;
+  menuSelection = 0;          lastMenuSelection = -1;
+  pauseSelection = 0;         lastPauseSelection = -1;
+  timerMinutes = 1;           lastTimerMinutes = -1;
+  knobTimerId = 0;            timerRemainingMillis = 0;
+  enteredStandbyFromVolume = enteredStandbyFromDoorLock = false;
+  enteredStandbyFromOBS = enteredStandbyFromMacro = false;
+  obsLastDirection = doorLastDirection = doorLastStatus = 0;
+  stopwatchRunning = false;   stopwatchStartedAt = {};   stopwatchElapsed = 0;
+  messageText[0] = '\0';      messageEnd.cancel();
+  messageReturnState = STATE_MENU;                       messageCounter = 0;
+  animYOffset = 0;            animLastFrameTime = {};
+  postAnimState = STATE_STANDBY;                         preAnimState = STATE_MENU;
+  volumeAnimIndicator = 0;    volumeAnimEnd.cancel();    lastVolAnimFrameTime = {};
+  lastActivityTime = {};      lastStandbyUpdate = {};
+  lastStandbyCounter = 0;     lastDisplayUpdate = {};
+
+  counter = 0;                lastDisplayedCounter = -9999;
+  inputEdges = 0;
+  buttonPressed = buttonLongPressed = buttonDoubleClicked = false;
+  timerAlarmPending = false;  timerAlarmLabel[0] = '\0';
+  lastKeySendTime = {};       macroScreenDirty = false;
+  encoderEventHead = encoderEventTail = 0;
+  encoderAccel.reset();
+  gestures = GestureRecognizer();
+  buttonHeld = false;
+  buttonEdgeQueue.clear();
+  emitted.clear();
+  display = HostDisplay();
+  externalAlarm = false;
+  macroItems    = macros;
+  outputs       = {};
+  obsTurn = doorTurn = {};
+  macroVm = {};
+  countdown.armed = false;
+  tracedState = -1;
+}
+
+// A whole detent, as the replay sees it: both edges at once
+static void knobDetent(uint64_t us, int8_t dir) {
+  encoderEvents[encoderEventHead & (ENCODER_EVENT_RING - 1)] = { (int64_t)us, dir };
+  encoderEventHead++;
+  counter    += 2 * dir;
+  inputEdges += 2;
+}
+
+static void knobButton(uint64_t us, bool down) {
+  buttonHeld = down;
+  inputEdges++;
+  buttonEdgeQueue.push_back({ (uint32_t)(us / 1000), down });
+}
+
+// gestures.h: the flags loop() reads
+static void gestureRaise(uint8_t fired) {
+  if (fired & GESTURE_DOWN) traceRecord(TRACE_GESTURE, TRACE_GESTURE_DOWN);
+  if (fired & GESTURE_LONG) {
+    buttonLongPressed = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_LONG);
+  }
+  if (fired & GESTURE_DOUBLE) {
+    buttonDoubleClicked = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_DOUBLE);
+  }
+  if (fired & GESTURE_CLICK) {
+    buttonPressed = true;
+    traceRecord(TRACE_GESTURE, TRACE_GESTURE_CLICK);
+  }
+}
+
+// gestures.h's 10 ms timer: edges in order, then the deadlines
+static uint8_t gestureTick() {
+  uint8_t fired = 0;
+  while (!buttonEdgeQueue.empty()) {
+    auto e = buttonEdgeQueue.front();
+    buttonEdgeQueue.pop_front();
+    fired |= gestures.edge(e.first, e.second, counter);
+  }
+  return fired | gestures.tick(monoNow().ms32(), counter);
+}
+
+// One loop() pass, in the sketch's order: the top of it (where the
+// state is traced), then, after the web server and the rest, the
+// steps
+static void knobPassTop() {
+  gestures.mask = gesturesForState(currentState);
+  if (currentState != tracedState) {
+    tracedState = currentState;
+    traceRecord(TRACE_STATE, 0, (uint32_t)currentState);
+  }
+}
+
+static bool knobPassSteps() {
+  timersTick();
+  turnTasksTick();
+  return knobStep();
+}
+
+static void knobPass() {
+  knobPassTop();
+  knobPassSteps();
+}
+
+// HTTP mode changes, as batchapi.h makes them
+static void httpLeaveMode() {
+  closeMacro();
+  enteredStandbyFromVolume = enteredStandbyFromDoorLock = false;
+  enteredStandbyFromOBS = enteredStandbyFromMacro = false;
+}
+
+static void httpMenu() {
+  httpLeaveMode();
+  currentState      = STATE_MENU;
+  counter           = 0;
+  lastMenuSelection = -1;
+  lastActivityTime  = monoNow();
+  drawMenu(0, true);
+}
+
+static void httpStopwatch() {
+  httpLeaveMode();
+  stopwatchStartedAt = monoNow();
+  stopwatchRunning   = true;
+  currentState       = STATE_STOPWATCH;
+  lastDisplayUpdate  = {};
+}
+
+static void httpMessage(MonoTime until) {
+  messageEnd.armAt(until);
+  if (currentState != STATE_MESSAGE) {
+    bool animating = currentState == STATE_ANIMATING_TO_STANDBY ||
+                     currentState == STATE_ANIMATING_WAKE;
+    messageReturnState = animating ? postAnimState : currentState;
+    messageCounter     = counter;
+  }
+  currentState = STATE_MESSAGE;
+  drawMessageScreen();
+}
+
+// -------------------
+// Machine replay
+// -------------------
+static const int64_t PASS_US    = 10000;     // loop()'s delay(10); the gesture tick too
+static const int64_t DIVERGE_US = 1000000;   // a state difference longer than this is real
+static const int64_t GESTURE_SLACK_US = 200000;
+static const int64_t SCREEN_SLACK_US  = 100000;   // replay and knob draw this far apart
+
+static const int64_t WAKE_EDGE_US = 20000;   // a detent's two edges are closer than this
+static int8_t wakeEdge = 0;   // the next detent's first edge went into a wake
+static bool   wakeHalf = false;   // or half of one, out and back: take it back after
+
+// When each record took effect in the knob. A state is recorded at
+// the top of the pass after the one that changed it, which followed
+// loop()'s delay(10) -- except out of standby, which doesn't wait.
+// Everything else at its own time.
+static std::vector<int64_t> effectTimes(const std::vector<TraceRecord> &rec, size_t start) {
+  std::vector<int64_t> at(rec.size());
+  uint32_t state = STATE_COUNT;
+  for (size_t i = start; i < rec.size(); i++) {
+    at[i] = (int64_t)rec[i].us;
+    if (rec[i].type != TRACE_STATE) continue;
+    if (state != STATE_STANDBY) at[i] -= PASS_US;
+    state = rec[i].a;
+  }
+  return at;
+}
+
+// A recorded change of state the replay can't reach from the trace:
+// make it happen, just before the pass the knob made it in. True if
+// it was one of those.
+static bool applyExternal(const std::vector<TraceRecord> &rec, const std::vector<int64_t> &at,
+                          size_t i, uint32_t from) {
+  uint32_t to = rec[i].a;
+  if (to == STATE_STOPWATCH && currentState != STATE_STOPWATCH) {
+    httpStopwatch();
+    return true;
+  }
+  if (from == STATE_STOPWATCH && currentState == STATE_STOPWATCH) {
+    if (to == STATE_MENU) {
+      httpMenu();
+    } else {
+      currentState = (AppState)to;
+      redrawState(currentState);
+    }
+    return true;
+  }
+  if (to == STATE_MESSAGE && currentState != STATE_MESSAGE) {
+    // Its timeout isn't recorded: it ends when the knob left it
+    // (a press then ends it the same way)
+    MonoTime until = { INT64_MAX / 2 };
+    for (size_t j = i + 1; j < rec.size(); j++) {
+      if (rec[j].type == TRACE_STATE) {
+        until = { at[j] };
+        break;
+      }
+    }
+    httpMessage(until);
+    return true;
+  }
+  // A press on a message goes back to what was under it
+  bool returning = currentState == STATE_MESSAGE && messageReturnState == (AppState)to;
+  if (to == STATE_TIMER_ENDED && currentState != STATE_TIMER_ENDED && !timerAlarmPending && !returning &&
+      !(countdown.armed && countdown.due - monoNow() <= usecs(DIVERGE_US))) {
+    externalAlarm     = true;
+    timerAlarmPending = true;
+    strcpy(timerAlarmLabel, "?");
+    return true;
+  }
+  if (from == STATE_STANDBY && to == STATE_ANIMATING_WAKE && currentState == STATE_STANDBY &&
+      counter == lastStandbyCounter && !buttonHeld && !buttonPressed && !buttonLongPressed) {
+    // Woken by an edge the trace doesn't have yet: the first of a
+    // detent (its second lands after the wake) or half of one
+    for (size_t j = i + 1; j < rec.size() && rec[j].us <= rec[i].us + WAKE_EDGE_US; j++) {
+      if (rec[j].type == TRACE_BUTTON) break;
+      if (rec[j].type == TRACE_ENCODER) {
+        wakeEdge = (rec[j].arg & 1) ? 1 : -1;
+        break;
+      }
+    }
+    wakeHalf = !wakeEdge;
+    counter  = counter + (wakeEdge ? wakeEdge : 1);
+    return true;
+  }
+  return false;
+}
+
+struct MachineResult {
+  uint32_t passes = 0, transitions = 0, forced = 0, diverged = 0;
+  uint32_t gestures = 0, gestureMismatches = 0;
+  uint32_t screens = 0, distinct = 0, conflicts = 0, missing = 0;
+  bool ok() const { return !diverged && !gestureMismatches && !conflicts && !missing; }
+};
+
+static MachineResult replayMachine(const std::vector<TraceRecord> &rec, int macros, bool verbose,
+                                   bool quiet = false) {
+  MachineResult res;
+  size_t start = 0;
+  while (start < rec.size() && !(rec[start].type == TRACE_STATE && rec[start].a == STATE_MENU)) {
+    start++;
+  }
+  if (start == rec.size()) {
+    if (!quiet) printf("machine replay: no menu entry in the trace, nothing to replay\n");
+    return res;
+  }
+
+  knobReset(macros);
+  wakeEdge = 0;
+  wakeHalf = false;
+  int64_t t0 = (int64_t)rec[start].us, end = (int64_t)rec.back().us;
+  monoSet({ t0 });
+  lastActivityTime = monoNow();
+  for (size_t j = 0; j < start; j++) {
+    // A press already going on: the recognizer times it from its edge
+    if (rec[j].type != TRACE_BUTTON) continue;
+    buttonHeld = rec[j].arg != 0;
+    gestures.edge((uint32_t)(rec[j].us / 1000), buttonHeld, counter);
+  }
+
+  // The knob ran a pass wherever it sent a frame or changed state,
+  // and none in the 10 ms before one (its delay); the replay runs
+  // its passes there, and every 10 ms in between.
+  std::vector<int64_t> at = effectTimes(rec, start);
+  std::vector<size_t> order;
+  std::vector<int64_t> passes = { t0 };
+  for (size_t i = start + 1; i < rec.size(); i++) {
+    order.push_back(i);
+    if (rec[i].type == TRACE_FRAME || rec[i].type == TRACE_STATE) passes.push_back(std::max(at[i], t0));
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return at[a] < at[b]; });
+  std::sort(passes.begin(), passes.end());
+  passes.erase(std::unique(passes.begin(), passes.end()), passes.end());
+  for (size_t p = 0, known = passes.size(); p < known; p++) {
+    int64_t until = p + 1 < known ? passes[p + 1] : end;
+    for (int64_t t = passes[p] + PASS_US; t + PASS_US <= until; t += PASS_US) passes.push_back(t);
+  }
+  std::sort(passes.begin(), passes.end());
+
+  std::vector<TraceRecord> knobGestures, knobFrames, mine;
+  uint32_t knobState = STATE_MENU;
+  int64_t  differentSince = -1;
+  std::vector<uint32_t> skewUs;
+
+  size_t next = 0;
+  int64_t tick = t0, maskAt = INT64_MAX;
+  for (int64_t now : passes) {
+    // The records up to this pass, with the recognizer's own 10 ms
+    // ticks in between (its gestures are only compared; the knob's
+    // drive the flags)
+    for (;;) {
+      int64_t due = next < order.size() ? at[order[next]] : INT64_MAX;
+      if (tick <= now && tick < due) {
+        monoSet({ tick });
+        if (tick >= maskAt) gestures.mask = gesturesForState(currentState);
+        uint8_t fired = gestureTick() & (GESTURE_CLICK | GESTURE_LONG | GESTURE_DOUBLE);
+        if (fired & GESTURE_CLICK)  mine.push_back({ TRACE_GESTURE, TRACE_GESTURE_CLICK, (uint64_t)tick, 0, 0 });
+        if (fired & GESTURE_LONG)   mine.push_back({ TRACE_GESTURE, TRACE_GESTURE_LONG, (uint64_t)tick, 0, 0 });
+        if (fired & GESTURE_DOUBLE) mine.push_back({ TRACE_GESTURE, TRACE_GESTURE_DOUBLE, (uint64_t)tick, 0, 0 });
+        tick += PASS_US;
+        continue;
+      }
+      if (due > now) break;
+      size_t i = order[next++];
+      const TraceRecord &r = rec[i];
+      monoSet({ due });
+      switch (r.type) {
+        case TRACE_ENCODER: {
+          int8_t dir = (r.arg & 1) ? 1 : -1;
+          knobDetent(r.us, dir);
+          if (dir == wakeEdge) counter = counter - dir;   // its first edge is in the wake
+          wakeEdge = 0;
+          break;
+        }
+        case TRACE_BUTTON:  knobButton(r.us, r.arg != 0); break;
+        case TRACE_FRAME:   knobFrames.push_back(r); break;
+        case TRACE_GESTURE:
+          if (r.arg == TRACE_GESTURE_CLICK)  buttonPressed       = true;
+          if (r.arg == TRACE_GESTURE_LONG)   buttonLongPressed   = true;
+          if (r.arg == TRACE_GESTURE_DOUBLE) buttonDoubleClicked = true;
+          if (r.arg != TRACE_GESTURE_DOWN) knobGestures.push_back(r);
+          break;
+        case TRACE_STATE:
+          res.transitions++;
+          if (applyExternal(rec, at, i, knobState)) res.forced++;
+          knobState = r.a;
+          break;
+      }
+    }
+    monoSet({ now });
+    knobPass();
+    res.passes++;
+    if (wakeHalf && currentState != STATE_STANDBY) {
+      // The edge back came after the wake; take it the other way
+      // to the nudge (exact into the menu, which keeps the half
+      // detent; a guess at its direction anywhere else)
+      counter  = counter - 1;
+      wakeHalf = false;
+    }
+    maskAt = now + PASS_US;   // the knob's next pass sets the new state's gestures
+
+    if ((uint32_t)currentState == knobState) {
+      if (differentSince >= 0) skewUs.push_back((uint32_t)(now - differentSince));
+      differentSince = -1;
+    } else if (differentSince < 0) {
+      differentSince = now;
+    } else if (now - differentSince > DIVERGE_US) {
+      res.diverged++;
+      if (verbose || (!quiet && res.diverged <= 5)) {
+        printf("  diverged at %.3f s: knob in %s since %.3f s, replay in %s\n", now / 1e6,
+               stateName(knobState), differentSince / 1e6, stateName(currentState));
+      }
+      if (knobState == STATE_MENU) {
+        httpMenu();
+      } else if (knobState < STATE_COUNT) {
+        currentState = (AppState)knobState;
+        redrawState(currentState);
+      }
+      differentSince = -1;
+    }
+  }
+
+  // Gestures: the same ones, in order, within the slack of two
+  // timers out of phase
+  res.gestures = mine.size();
+  size_t i = 0, j = 0;
+  while (i < mine.size() || j < knobGestures.size()) {
+    if (i < mine.size() && j < knobGestures.size() && mine[i].arg == knobGestures[j].arg &&
+        (int64_t)(mine[i].us - knobGestures[j].us) <= GESTURE_SLACK_US &&
+        (int64_t)(knobGestures[j].us - mine[i].us) <= GESTURE_SLACK_US) {
+      i++;
+      j++;
+      continue;
+    }
+    bool takeMine = j >= knobGestures.size() ||
+                    (i < mine.size() && mine[i].us <= knobGestures[j].us);
+    const TraceRecord &r = takeMine ? mine[i] : knobGestures[j];
+    if ((int64_t)r.us < end - GESTURE_SLACK_US) {   // not one cut off by the trace's end
+      res.gestureMismatches++;
+      if (verbose || (!quiet && res.gestureMismatches <= 5)) {
+        printf("  gesture at %.3f s: %s only in the %s\n", r.us / 1e6,
+               r.arg < 4 ? gestureNames[r.arg] : "?", takeMine ? "replay" : "trace");
+      }
+    }
+    if (takeMine) i++;
+    else          j++;
+  }
+
+  // Screens: a stable draw the replay left up for a while must be
+  // one frame the knob had up over the same span, less the skew
+  // either side. One key, one hash, throughout.
+  auto showing = [&](int64_t us) -> const TraceRecord* {
+    auto after = std::upper_bound(knobFrames.begin(), knobFrames.end(), us,
+                                  [](int64_t t, const TraceRecord &r) { return t < (int64_t)r.us; });
+    return after == knobFrames.begin() ? nullptr : &*(after - 1);
+  };
+  std::map<std::string, uint32_t> hashOf;
+  std::map<uint32_t, std::string> keyOf;
+  const std::vector<Shown> &shown = display.shown;
+  for (size_t d = 0; d < shown.size(); d++) {
+    if (!shown[d].stable) continue;
+    int64_t from = shown[d].us + SCREEN_SLACK_US;
+    int64_t to   = (d + 1 < shown.size() ? shown[d + 1].us : end) - SCREEN_SLACK_US;
+    if (to - from < SCREEN_SLACK_US) continue;   // not up long enough to tell
+    const std::string &key = shown[d].key;
+    const TraceRecord *first = showing(from), *last = showing(to);
+    res.screens++;
+    if (!first || first->b != last->b) {
+      res.missing++;
+      if (verbose || (!quiet && res.missing <= 5)) {
+        printf("  screen \"%s\" at %.3f s: the knob %s\n", key.c_str(), shown[d].us / 1e6,
+               first ? "changed screens meanwhile" : "sent no frame");
+      }
+      continue;
+    }
+    uint32_t hash = last->b;
+    auto h = hashOf.find(key);
+    auto k = keyOf.find(hash);
+    bool clash = (h != hashOf.end() && h->second != hash) || (k != keyOf.end() && k->second != key);
+    if (clash) {
+      res.conflicts++;
+      if (verbose || (!quiet && res.conflicts <= 5)) {
+        printf("  screen \"%s\" at %.3f s: frame %08x, but", key.c_str(), shown[d].us / 1e6,
+               (unsigned)hash);
+        if (h != hashOf.end() && h->second != hash) printf(" it was %08x before", (unsigned)h->second);
+        if (k != keyOf.end() && k->second != key) printf(" that frame was \"%s\" before", k->second.c_str());
+        printf("\n");
+      }
+      continue;
+    }
+    hashOf[key] = hash;
+    keyOf[hash] = key;
+  }
+  res.distinct = hashOf.size();
+
+  if (quiet) return res;
+  std::sort(skewUs.begin(), skewUs.end());
+  printf("machine replay from %.3f s (first menu entry), %u passes:\n", t0 / 1e6,
+         (unsigned)res.passes);
+  printf("  states: %u changes, %u applied as recorded (no input for them), %u diverged",
+         (unsigned)res.transitions, (unsigned)res.forced, (unsigned)res.diverged);
+  if (!skewUs.empty()) {
+    printf("; replay off by p50 %.0f ms, max %.0f ms", skewUs[skewUs.size() / 2] / 1000.0,
+           skewUs.back() / 1000.0);
+  }
+  printf("\n  final state: knob %s, replay %s\n", stateName(knobState), stateName(currentState));
+  printf("  gestures: %u recomputed, %u differ from the knob's\n", (unsigned)res.gestures,
+         (unsigned)res.gestureMismatches);
+  printf("  screens: %u left up, %u distinct, %u contradict the knob's frames, %u missing\n",
+         (unsigned)res.screens, (unsigned)res.distinct, (unsigned)res.conflicts, (unsigned)res.missing);
+  printf("  sent: %u volume steps, %u track skips, %u mutes, %u OBS turns, %u door turns, "
+         "%u countdowns\n", (unsigned)outputs.volumeSteps, (unsigned)outputs.trackSkips,
+         (unsigned)outputs.mutes, (unsigned)outputs.obsTurns, (unsigned)outputs.doorTurns,
+         (unsigned)outputs.countdowns);
+  return res;
+}
+
+// -------------------
+// Report
+// -------------------
+static bool report(const uint8_t* blocks, uint32_t count, int macros, bool verbose) {
+  TraceReader reader(blocks, count);
+  TraceRecord r;
+  std::vector<TraceRecord> all;
+
+  Samples encoderLat("encoder detent"), clickLat("click"), longLat("long press"),
+          doubleLat("double click"), edgeLat("edge to gesture");
+  std::vector<Samples*> waiting;             // inputs waiting for the next frame
+  std::vector<uint64_t> waitingSince;
+  uint64_t lastDownEdge = 0, lastUpEdge = 0;
+
+  uint64_t firstUs = 0, lastUs = 0;
+  uint32_t state = UINT32_MAX;
+  uint64_t stateSince = 0;
+  std::vector<uint64_t> stateUs(STATE_COUNT + 1, 0);
+  uint32_t transitions = 0;
+
+  uint32_t frames = 0, lastHash = 0, digest = 2166136261UL;
+  std::vector<uint32_t> hashes;
+  uint32_t netCount = 0, netFail = 0;
+  std::vector<uint32_t> netMs;
+  uint32_t records = 0, encoderSteps = 0, clockReads = 0;
+  AccelReplay replay;
+
+  auto frameSeen = [&](uint64_t us) {
+    for (size_t i = 0; i < waiting.size(); i++) {
+      uint64_t dt = us - waitingSince[i];
+      if (dt <= FRAME_WAIT_US) waiting[i]->us.push_back((uint32_t)dt);
+      else                     waiting[i]->noFrame++;
+    }
+    waiting.clear();
+    waitingSince.clear();
+  };
+  auto await = [&](Samples &s, uint64_t us) {
+    waiting.push_back(&s);
+    waitingSince.push_back(us);
+  };
+
+  while (reader.next(r)) {
+    if (!records++) firstUs = r.us;
+    lastUs = r.us;
+    if (r.type != TRACE_SYNC) all.push_back(r);
+    if (verbose && r.type == TRACE_GESTURE) {
+      printf("%12.6f  gesture  %s\n", r.us / 1e6, r.arg < 4 ? gestureNames[r.arg] : "?");
+    } else if (verbose && r.type == TRACE_STATE) {
+      printf("%12.6f  state    %s\n", r.us / 1e6, stateName(r.a));
+    } else if (verbose && r.type != TRACE_SYNC) {
+      printf("%12.6f  %-8s arg %2u  %u %u\n", r.us / 1e6, typeNames[r.type], r.arg,
+             (unsigned)r.a, (unsigned)r.b);
+    }
+    switch (r.type) {
+      case TRACE_ENCODER:
+        encoderSteps++;
+        await(encoderLat, r.us);
+        if (replay.active) replay.step(r);
+        break;
+      case TRACE_BUTTON:
+        if (r.arg) lastDownEdge = r.us;
+        else       lastUpEdge   = r.us;
+        break;
+      case TRACE_GESTURE:
+        if (r.arg == TRACE_GESTURE_DOWN && lastDownEdge) {
+          edgeLat.us.push_back((uint32_t)(r.us - lastDownEdge));
+        } else if ((r.arg == TRACE_GESTURE_CLICK || r.arg == TRACE_GESTURE_DOUBLE) && lastUpEdge) {
+          edgeLat.us.push_back((uint32_t)(r.us - lastUpEdge));
+        }
+        if (r.arg == TRACE_GESTURE_CLICK)  await(clickLat, r.us);
+        if (r.arg == TRACE_GESTURE_LONG)   await(longLat, r.us);
+        if (r.arg == TRACE_GESTURE_DOUBLE) await(doubleLat, r.us);
+        break;
+      case TRACE_STATE:
+        if (state != UINT32_MAX) {
+          stateUs[std::min(state, STATE_COUNT)] += r.us - stateSince;
+          transitions++;
+        }
+        state      = r.a;
+        stateSince = r.us;
+        replay.state(state);
+        break;
+      case TRACE_FRAME:
+        frames++;
+        lastHash = r.b;
+        digest   = (digest ^ r.b) * 16777619UL;
+        hashes.push_back(r.b);
+        frameSeen(r.us);
+        break;
+      case TRACE_NET:
+        netCount++;
+        if (!r.arg) netFail++;
+        netMs.push_back(r.b);
+        break;
+      case TRACE_CLOCK:
+        clockReads++;
+        break;
+      case TRACE_VALUE:
+        if (r.arg == TRACE_VALUE_TIMER_MINUTES) replay.check(r, verbose);
+        break;
+    }
+  }
+  if (reader.error()) {
+    fprintf(stderr, "trace: %s after %u records\n", reader.error(), (unsigned)records);
+    return false;
+  }
+  if (!records) {
+    printf("empty trace\n");
+    return true;
+  }
+  if (state != UINT32_MAX) stateUs[std::min(state, STATE_COUNT)] += lastUs - stateSince;
+
+  printf("%u records over %.1f s, %u encoder detents, %u clock reads\n", (unsigned)records,
+         (lastUs - firstUs) / 1e6, (unsigned)encoderSteps, (unsigned)clockReads);
+
+  printf("latency (input to next frame):\n");
+  encoderLat.print();
+  clickLat.print();
+  longLat.print();
+  doubleLat.print();
+  edgeLat.print();
+
+  printf("states (%u transitions):\n", (unsigned)transitions);
+  for (uint32_t s = 0; s <= STATE_COUNT; s++) {
+    if (stateUs[s]) printf("  %-22s %9.1f s\n", s < STATE_COUNT ? stateNames[s] : "?", stateUs[s] / 1e6);
+  }
+  printf("final state: %s\n", state == UINT32_MAX ? "(none recorded)" : stateName(state));
+
+  std::sort(hashes.begin(), hashes.end());
+  size_t distinct = std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+  printf("frames: %u, %zu distinct, last %08x, digest %08x\n", (unsigned)frames, distinct,
+         (unsigned)lastHash, (unsigned)digest);
+
+  if (netCount) {
+    std::sort(netMs.begin(), netMs.end());
+    printf("http: %u requests, %u failed, ttfb p50 %u ms, max %u ms\n", (unsigned)netCount,
+           (unsigned)netFail, (unsigned)netMs[netMs.size() / 2], (unsigned)netMs.back());
+  }
+
+  printf("accel replay: %u timer-set sessions, %u values checked, %u mismatched\n",
+         (unsigned)replay.starts, (unsigned)replay.checked, (unsigned)replay.mismatched);
+  if (replay.lostSteps) printf("  %u encoder records missing from the trace\n", (unsigned)replay.lostSteps);
+
+  MachineResult machine = replayMachine(all, macros, verbose);
+  return replay.mismatched == 0 && machine.ok();
+}
+
+static bool loadTrace(const char* path, std::vector<uint8_t> &blocks, TraceFileHeader &h) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    fprintf(stderr, "%s: can't open\n", path);
+    return false;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(h)) {
+    fprintf(stderr, "%s: too short\n", path);
+    return false;
+  }
+  memcpy(&h, data.data(), sizeof(h));
+  if (h.magic != TRACE_FILE_MAGIC || h.version != TRACE_FILE_VERSION ||
+      h.blockBytes != TRACE_BLOCK_BYTES ||
+      data.size() != sizeof(h) + (size_t)h.blocks * TRACE_BLOCK_BYTES) {
+    fprintf(stderr, "%s: not a version %d knob trace\n", path, TRACE_FILE_VERSION);
+    return false;
+  }
+  blocks.assign(data.begin() + sizeof(h), data.end());
+  return true;
+}
+
+// -------------------
+// Self-test: a synthetic session recorded as the device would
+// -------------------
+static uint32_t rng = 12345;
+static uint32_t nextRandom() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+static uint32_t between(uint32_t lo, uint32_t hi) { return lo + nextRandom() % (hi - lo + 1); }
+
+// What a user and the HTTP API do to the knob, timestamped
+enum InputKind { IN_EDGE_CW, IN_EDGE_CCW, IN_DOWN, IN_UP, IN_STOPWATCH, IN_MENU, IN_MESSAGE };
+
+struct Input {
+  int64_t   us;
+  InputKind kind;
+};
+
+// A random few minutes of use: turns (some given up halfway),
+// clicks, double clicks, long presses, chords, idle spells long
+// enough for standby, and now and then the HTTP stopwatch or a
+// message
+static std::vector<Input> userSession(int64_t start, int64_t length) {
+  std::vector<Input> in;
+  int64_t t = start;
+  auto press = [&](uint32_t holdMs) {
+    in.push_back({ t, IN_DOWN });
+    for (uint32_t n = nextRandom() % 3; n; n--) {   // contact bounce
+      int64_t b = t + 1000 * between(1, 3);
+      in.push_back({ b, IN_UP });
+      in.push_back({ b + 500, IN_DOWN });
+    }
+    t += 1000 * (int64_t)holdMs;
+    in.push_back({ t, IN_UP });
+  };
+  while (t < start + length) {
+    uint32_t pick = nextRandom() % 100;
+    if (pick < 40) {
+      // A turn: edge pairs 1-4 ms apart, detents 5-200 ms apart
+      bool cw = nextRandom() & 1;
+      for (uint32_t n = between(1, 8); n; n--) {
+        bool half = nextRandom() % 12 == 0;
+        in.push_back({ t, cw ? IN_EDGE_CW : IN_EDGE_CCW });
+        t += 1000 * between(1, 4);
+        in.push_back({ t, (cw != half) ? IN_EDGE_CW : IN_EDGE_CCW });
+        t += 1000 * between(5, 200);
+      }
+    } else if (pick < 62) {
+      press(between(60, 250));
+    } else if (pick < 67) {
+      press(between(50, 120));
+      t += 1000 * between(40, 150);
+      press(between(50, 120));
+    } else if (pick < 71) {
+      press(between(GESTURE_LONG_MS + 100, GESTURE_LONG_MS + 1000));
+    } else if (pick < 75) {
+      // Chord: turn with the button held
+      in.push_back({ t, IN_DOWN });
+      t += 1000 * between(100, 300);
+      for (uint32_t n = between(1, 3); n; n--) {
+        in.push_back({ t, IN_EDGE_CW });
+        t += 1000 * between(1, 4);
+        in.push_back({ t, IN_EDGE_CW });
+        t += 1000 * between(50, 200);
+      }
+      in.push_back({ t, IN_UP });
+    } else if (pick < 77) {
+      in.push_back({ t, IN_STOPWATCH });
+      t += 1000 * between(1000, 4000);
+      in.push_back({ t, IN_MENU });
+    } else if (pick < 79) {
+      in.push_back({ t, IN_MESSAGE });
+    } else if (pick < 84) {
+      t += 1000 * between(10500, 14000);   // standby
+    }
+    t += 1000 * between(150, 2500);
+  }
+  std::stable_sort(in.begin(), in.end(), [](const Input &a, const Input &b) { return a.us < b.us; });
+  return in;
+}
+
+struct Recorded {
+  std::vector<uint8_t> blocks;
+  TraceFileHeader      header;
+  uint32_t             edges, detents, passes;
+};
+
+// Runs the session through the same steps as the device does:
+// CLK edges through EncoderDetent into the counter and the detent
+// ring, a loop pass every 10-16 ms (standby straight through, as
+// it sleeps until input instead), the gesture timer 3 ms out of
+// phase with the replay's. From corruptFrom on the menu is drawn
+// wrong; at pass strayState (or the first in the menu after it,
+// with the user idle) the state jumps to volume with no input, as
+// a bug in the steps would.
+static Recorded recordSession(const std::vector<Input> &inputs, int64_t start, int64_t end,
+                              int64_t corruptFrom, int strayState) {
+  static uint8_t mem[48 * TRACE_BLOCK_BYTES];
+  TraceRing ring;
+  ring.begin(mem, sizeof(mem));
+
+  knobReset(0);
+  traceOut = &ring;
+  display.corruptFrom = corruptFrom;
+  monoSet({ start });
+  lastActivityTime = monoNow();
+
+  Recorded out = {};
+  EncoderDetent detent;
+  bool clkAtRest = true;
+  int64_t nextPass = start, nextSteps = INT64_MAX, nextGesture = start + 3000;
+  size_t next = 0;
+  for (int64_t now = start; now < end; now += 500) {
+    monoSet({ now });
+    for (; next < inputs.size() && inputs[next].us <= now; next++) {
+      switch (inputs[next].kind) {
+        case IN_EDGE_CW:
+        case IN_EDGE_CCW: {
+          // readEncoder()
+          int8_t dir = inputs[next].kind == IN_EDGE_CW ? 1 : -1;
+          inputEdges++;
+          counter = counter + dir;
+          clkAtRest = !clkAtRest;
+          out.edges++;
+          if (int8_t d = detent.edge(dir, clkAtRest)) {
+            traceRecord(TRACE_ENCODER, (d > 0) | ((encoderEventHead & 7) << 1));
+            encoderEvents[encoderEventHead & (ENCODER_EVENT_RING - 1)] = { now, d };
+            encoderEventHead++;
+            out.detents++;
+          }
+          break;
+        }
+        case IN_DOWN:
+        case IN_UP:
+          // readButton()
+          traceRecord(TRACE_BUTTON, inputs[next].kind == IN_DOWN);
+          knobButton(now, inputs[next].kind == IN_DOWN);
+          break;
+        case IN_STOPWATCH:
+          httpStopwatch();
+          break;
+        case IN_MENU:
+          if (currentState == STATE_STOPWATCH) httpMenu();
+          break;
+        case IN_MESSAGE:
+          httpMessage(monoNow() + msecs(between(1000, 3000)));
+          break;
+      }
+    }
+    if (now >= nextGesture) {
+      gestureRaise(gestureTick());
+      nextGesture += PASS_US;
+    }
+    if (now >= nextPass) {
+      if (strayState >= 0 && out.passes >= (uint32_t)strayState && currentState == STATE_MENU &&
+          (next == inputs.size() || inputs[next].us > now + 3 * DIVERGE_US / 2)) {
+        strayState   = -1;
+        currentState = STATE_VOLUME;
+        counter = lastDisplayedCounter = 0;
+        drawVolumeScreen();
+      }
+      knobPassTop();
+      out.passes++;
+      // The web server, MQTT and the rest come first, unless standby
+      // is sleeping until input
+      nextSteps = now + (currentState == STATE_STANDBY ? 0 : 1000 * between(0, 6));
+      nextPass  = INT64_MAX;
+    }
+    if (now >= nextSteps) {
+      bool wait = knobPassSteps();
+      nextSteps = INT64_MAX;
+      nextPass  = now + (wait ? PASS_US : 500);
+    }
+  }
+  traceOut = nullptr;
+
+  for (uint32_t i = 0; i < ring.blockCount(); i++) {
+    out.blocks.insert(out.blocks.end(), ring.blockData(i), ring.blockData(i) + TRACE_BLOCK_BYTES);
+  }
+  out.header = ring.header();
+  return out;
+}
+
+static std::vector<TraceRecord> decode(const Recorded &r) {
+  TraceReader reader(r.blocks.data(), r.header.blocks);
+  TraceRecord rec;
+  std::vector<TraceRecord> all;
+  while (reader.next(rec)) {
+    if (rec.type != TRACE_SYNC) all.push_back(rec);
+  }
+  return all;
+}
+
+static bool selftest() {
+  const int64_t start = 1000000, end = start + 240 * 1000000LL;
+  std::vector<Input> inputs = userSession(start, end - start - 2000000);
+
+  Recorded rec = recordSession(inputs, start, end, -1, -1);
+  printf("selftest: %u edges, %u detents, %u passes, %u records, %u blocks kept, %u dropped\n",
+         (unsigned)rec.edges, (unsigned)rec.detents, (unsigned)rec.passes,
+         (unsigned)rec.header.records, (unsigned)rec.header.blocks,
+         (unsigned)rec.header.blocksDropped);
+  bool ok = true;
+  if (rec.detents == 0 || rec.detents * 2 > rec.edges) {
+    printf("FAIL: edge pairs should give at most one detent each\n");
+    ok = false;
+  }
+  ok &= report(rec.blocks.data(), rec.header.blocks, 0, false);
+
+  // The same session with a wrong frame, then with a state change
+  // no input explains: both must be caught
+  MachineResult bad = replayMachine(decode(recordSession(inputs, start, end, (start + end) / 2, -1)), 0, false, true);
+  printf("mutation, the menu drawn wrong from halfway: %u contradicting screens\n", (unsigned)bad.conflicts);
+  ok &= bad.conflicts > 0;
+  bad = replayMachine(decode(recordSession(inputs, start, end, -1, rec.passes / 4)), 0, false, true);
+  printf("mutation, stray state change: %u diverged\n", (unsigned)bad.diverged);
+  ok &= bad.diverged > 0;
+
+  printf("\n%s\n", ok ? "all checks passed" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "--selftest") == 0) return selftest() ? 0 : 1;
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s trace [-v] [-m macros] | --selftest\n", argv[0]);
+    return 2;
+  }
+  bool verbose = false;
+  int macros = 0;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) verbose = true;
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) macros = atoi(argv[++i]);
+  }
+
+  std::vector<uint8_t> blocks;
+  TraceFileHeader h;
+  if (!loadTrace(argv[1], blocks, h)) return 1;
+  printf("%s: %u blocks, %u records recorded, %u blocks overwritten\n", argv[1],
+         (unsigned)h.blocks, (unsigned)h.records, (unsigned)h.blocksDropped);
+  return report(blocks.data(), h.blocks, macros, verbose) ? 0 : 1;
+}
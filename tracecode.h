@@ -0,0 +1,277 @@
+#ifndef TRACE_CODE_H
+#define TRACE_CODE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================
+// INPUT TRACE FORMAT
+// A compact binary log of what the knob saw and did: encoder
+// steps, button edges, recognised gestures, state changes, frame
+// hashes, network results and clock readings. Recorded into a RAM
+// ring on the device (inputtrace.h), read by tools/tracereplay.cpp.
+//
+// The ring is a row of fixed-size blocks. Every block opens with a
+// SYNC record carrying the absolute time; the records after it
+// carry the time since the previous record. When the ring is full
+// the oldest block goes, so what is left still decodes on its own.
+//
+// Record: one byte (type in the low nibble, a 4-bit argument in
+// the high one), varint microseconds since the previous record,
+// then 0-2 varint values:
+//
+//   SYNC     -            absolute us (instead of the delta)
+//   ENCODER  dir + seq<<1 -         (one per detent; seq: ring head, mod 8)
+//   BUTTON   1 = down     -
+//   GESTURE  TraceGesture -
+//   STATE    -            state loop() switched to
+//   FRAME    -            start line, FNV-1a of the frame buffer
+//   NET      1 = ok       zigzag status, ms to first byte
+//   CLOCK    1 = synced   unix seconds read by the clock helper
+//   VALUE    TraceValue   value, encoder ring tail mod 256
+//
+// A 0 byte pads the rest of a block.
+//
+// Pure C++ with no Arduino dependencies, like encoderaccel.h. The
+// device defines TRACE_IRAM as IRAM_ATTR so the ISRs can record.
+// =============================================================
+
+#ifndef TRACE_IRAM
+#define TRACE_IRAM
+#endif
+
+#define TRACE_BLOCK_BYTES  256
+#define TRACE_RECORD_MAX   (1 + 10 + 2 * 5)
+#define TRACE_DELTA_MAX_US (1UL << 28)   // longer gaps open a new block
+#define TRACE_FILE_MAGIC   0x5254424BUL  // "KBTR"
+#define TRACE_FILE_VERSION 1
+
+enum TraceType : uint8_t {
+  TRACE_PAD = 0,
+  TRACE_SYNC,
+  TRACE_ENCODER,
+  TRACE_BUTTON,
+  TRACE_GESTURE,
+  TRACE_STATE,
+  TRACE_FRAME,
+  TRACE_NET,
+  TRACE_CLOCK,
+  TRACE_VALUE,
+  TRACE_TYPE_COUNT
+};
+
+enum TraceGesture : uint8_t {
+  TRACE_GESTURE_DOWN,
+  TRACE_GESTURE_CLICK,
+  TRACE_GESTURE_LONG,
+  TRACE_GESTURE_DOUBLE
+};
+
+enum TraceValue : uint8_t {
+  TRACE_VALUE_TIMER_MINUTES
+};
+
+// Download header, little-endian, in front of the blocks
+struct TraceFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t blockBytes;
+  uint32_t blocks;          // blocks that follow, oldest first
+  uint32_t records;         // recorded since the last clear
+  uint32_t blocksDropped;   // overwritten by newer ones
+};
+
+struct TraceRecord {
+  uint8_t  type;
+  uint8_t  arg;
+  uint64_t us;      // absolute
+  uint32_t a;
+  uint32_t b;
+};
+
+inline uint32_t traceZigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t traceUnzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// FNV-1a over a frame, for comparing screens without storing them
+inline uint32_t traceHash(const uint8_t* data, size_t len) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < len; i++) h = (h ^ data[i]) * 16777619UL;
+  return h;
+}
+
+TRACE_IRAM inline uint8_t traceValueCount(uint8_t type) {
+  switch (type) {
+    case TRACE_STATE:
+    case TRACE_CLOCK: return 1;
+    case TRACE_FRAME:
+    case TRACE_NET:
+    case TRACE_VALUE: return 2;
+    default:          return 0;
+  }
+}
+
+// -------------------
+// Writer (device)
+// -------------------
+class TraceRing {
+ public:
+  // mem: a whole number of blocks
+  void begin(uint8_t* mem, size_t bytes) {
+    mem_    = mem;
+    blocks_ = bytes / TRACE_BLOCK_BYTES;
+    clear();
+  }
+
+  void clear() {
+    if (mem_) memset(mem_, 0, blocks_ * TRACE_BLOCK_BYTES);
+    block_   = 0;
+    used_    = 0;
+    open_    = false;   // the first record opens block 0
+    lastUs_  = 0;
+    records_ = 0;
+  }
+
+  TRACE_IRAM void write(uint64_t us, uint8_t type, uint8_t arg, uint32_t a = 0, uint32_t b = 0) {
+    if (!blocks_) return;
+    uint64_t delta = us - lastUs_;
+    if (!open_ || used_ + TRACE_RECORD_MAX > TRACE_BLOCK_BYTES || delta >= TRACE_DELTA_MAX_US) {
+      if (open_) block_++;
+      open_ = true;
+      uint8_t* start = blockAt(block_);
+      memset(start, 0, TRACE_BLOCK_BYTES);
+      used_ = 0;
+      start[used_++] = TRACE_SYNC;
+      used_ += putVarint(start + used_, us);
+      delta = 0;
+    }
+    uint8_t* p = blockAt(block_) + used_;
+    uint8_t* q = p;
+    *q++ = (uint8_t)(type | (arg << 4));
+    q += putVarint(q, delta);
+    uint8_t n = traceValueCount(type);
+    if (n > 0) q += putVarint(q, a);
+    if (n > 1) q += putVarint(q, b);
+    used_  += q - p;
+    lastUs_ = us;
+    records_++;
+  }
+
+  // Blocks in download order: oldest first, the open one last
+  uint32_t blockCount() const {
+    if (!open_) return 0;
+    return block_ + 1 < blocks_ ? block_ + 1 : blocks_;
+  }
+  const uint8_t* blockData(uint32_t i) const {
+    return blockAt(block_ + 1 - blockCount() + i);
+  }
+  uint32_t records() const { return records_; }
+  uint32_t blocksDropped() const { return open_ && block_ >= blocks_ ? block_ + 1 - blocks_ : 0; }
+  uint32_t capacityBytes() const { return blocks_ * TRACE_BLOCK_BYTES; }
+
+  TraceFileHeader header() const {
+    TraceFileHeader h;
+    h.magic         = TRACE_FILE_MAGIC;
+    h.version       = TRACE_FILE_VERSION;
+    h.blockBytes    = TRACE_BLOCK_BYTES;
+    h.blocks        = blockCount();
+    h.records       = records_;
+    h.blocksDropped = blocksDropped();
+    return h;
+  }
+
+ private:
+  TRACE_IRAM uint8_t* blockAt(uint32_t seq) const {
+    return mem_ + (seq % blocks_) * TRACE_BLOCK_BYTES;
+  }
+
+  static TRACE_IRAM uint8_t putVarint(uint8_t* p, uint64_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+      p[n++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+  }
+
+  uint8_t* mem_    = nullptr;
+  uint32_t blocks_ = 0;
+  uint32_t block_  = 0;   // sequence number of the open block
+  uint16_t used_   = 0;
+  bool     open_   = false;
+  uint64_t lastUs_ = 0;
+  uint32_t records_ = 0;
+};
+
+// -------------------
+// Reader (tools)
+// -------------------
+// Walks the blocks of a download. next() is false at the end or
+// on a malformed record (error() says which).
+class TraceReader {
+ public:
+  TraceReader(const uint8_t* blocks, uint32_t count) : data_(blocks), count_(count) {}
+
+  bool next(TraceRecord &r) {
+    while (block_ < count_) {
+      const uint8_t* b = data_ + block_ * TRACE_BLOCK_BYTES;
+      if (pos_ >= TRACE_BLOCK_BYTES || b[pos_] == TRACE_PAD) {
+        block_++;
+        pos_ = 0;
+        continue;
+      }
+      uint8_t head = b[pos_++];
+      r.type = head & 0x0F;
+      r.arg  = head >> 4;
+      if (r.type >= TRACE_TYPE_COUNT || (pos_ == 1) != (r.type == TRACE_SYNC)) {
+        error_ = "bad record";
+        return false;
+      }
+      uint64_t t;
+      if (!getVarint(b, t)) return false;
+      now_ = r.type == TRACE_SYNC ? t : now_ + t;
+      r.us = now_;
+      r.a = r.b = 0;
+      uint8_t n = traceValueCount(r.type);
+      uint64_t v;
+      if (n > 0) {
+        if (!getVarint(b, v)) return false;
+        r.a = (uint32_t)v;
+      }
+      if (n > 1) {
+        if (!getVarint(b, v)) return false;
+        r.b = (uint32_t)v;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  const char* error() const { return error_; }
+
+ private:
+  bool getVarint(const uint8_t* b, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos_ < TRACE_BLOCK_BYTES; shift += 7) {
+      uint8_t c = b[pos_++];
+      v |= (uint64_t)(c & 0x7F) << shift;
+      if (!(c & 0x80)) return true;
+    }
+    error_ = "truncated record";
+    return false;
+  }
+
+  const uint8_t* data_;
+  uint32_t count_;
+  uint32_t block_ = 0;
+  uint32_t pos_   = 0;
+  uint64_t now_   = 0;
+  const char* error_ = nullptr;
+};
+
+#endif // TRACE_CODE_H
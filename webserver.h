@@ -4,18 +4,29 @@
 #include <WebServer.h>
 #include <ESPmDNS.h>   
 #include "globals.h"
+#include "heapmonitor.h"
+#include "screenlayers.h"
+#include "slidetransition.h"
+#include "powersave.h"
+#include "macrovm.h"
+#include "timerservice.h"
+#include "batchapi.h"
+#include "inputtrace.h"
+#include "knoblog.h"
+#include "mqttclient.h"
+#include "screenmirror.h"
+#include "modetasks.h"
+#include "loopmonitor.h"
+#include "blelogic.h"
+#include "subsystems.h"
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include "fastssd1306.h"
 
 extern WebServer server;  // Declare server if defined elsewhere
 
-extern Adafruit_SSD1306 display;
-
-// Externs needed for stopwatch endpoint handlers
-extern unsigned long lastActivityTime;
-extern volatile int counter;
-extern void drawMenu(int yOffset, bool commit);
+extern FastSSD1306 display;
 
 inline void handleRestart() {
   // Send the HTTP response first so the client isn't left hanging
@@ -35,7 +46,356 @@ inline void handleRestart() {
   ESP.restart();
 }
 
-inline void initWebserver() {
+inline void handleHeapStats() {
+  HeapSample now = sampleHeap();
+  FixedString<192> json;
+  json.appendf("{\"free\":%u,\"largest\":%u,\"fragPct\":%u,\"minFree\":%u,"
+               "\"bootFree\":%u,\"worstFragPct\":%u}",
+               (unsigned)now.freeBytes, (unsigned)now.largestBlock,
+               (unsigned)now.fragmentationPct, (unsigned)now.minFreeEver,
+               (unsigned)heapBaseline.freeBytes, (unsigned)heapWorstFragPct);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// Per-screen cost of the static layer vs. restoring it from cache.
+// POST ?verify=1|0 turns the restore-vs-redraw comparison on or off.
+inline void handleLayerStats() {
+  if (server.method() == HTTP_POST && server.hasArg("verify")) {
+    screenLayerVerify = server.arg("verify") == "1";
+  }
+  FixedString<1536> json;
+  screenLayerStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// Frame pacing of the async OLED flush
+inline void handleDisplayStats() {
+  const OledFrameStats &st = display.frameStats();
+  uint32_t flushed = st.flushed ? st.flushed : 1;
+  FixedString<384> json;
+  json.appendf("{\"i2cClock\":%u,\"submitted\":%u,\"flushed\":%u,\"dropped\":%u,"
+               "\"busErrors\":%u,\"flushUsAvg\":%u,\"flushUsMax\":%u,"
+               "\"latencyUsAvg\":%u,\"latencyUsMax\":%u,\"submitUsMax\":%u,"
+               "\"bytesSent\":%llu,\"slides\":%u,\"slideFrames\":%u,\"slidePages\":%u,"
+               "\"slideRenderUs\":%u,\"slideComposeUs\":%u}",
+               (unsigned)st.i2cClock, (unsigned)st.submitted, (unsigned)st.flushed,
+               (unsigned)st.dropped, (unsigned)st.busErrors,
+               (unsigned)(st.totalFlushUs / flushed), (unsigned)st.maxFlushUs,
+               (unsigned)(st.totalLatencyUs / flushed), (unsigned)st.maxLatencyUs,
+               (unsigned)st.maxSubmitUs, (unsigned long long)st.bytesSent,
+               (unsigned)slideStats.transitions, (unsigned)slideStats.frames,
+               (unsigned)slideStats.pagesSent, (unsigned)slideStats.renderUs,
+               (unsigned)slideStats.composeUs);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/power — standby residency and the energy estimate
+inline void handlePowerStats() {
+  uint32_t avgUa = standbyAverageCurrentUa();
+  FixedString<384> json;
+  json.appendf("{\"lightSleep\":%s,\"standbyEntries\":%u,\"wakes\":%u,\"passes\":%u,"
+               "\"redraws\":%u,\"activeMs\":%llu,\"sleepMs\":%llu,"
+               "\"wakeLatencyUs\":%u,\"wakeLatencyUsMax\":%u,"
+               "\"bleInterval\":%u,\"bleLatency\":%u,\"bleUpdates\":%u,"
+               "\"standbyAvgUa\":%u,\"standbyUwhPerHour\":%u}",
+               powerStats.lightSleep ? "true" : "false",
+               (unsigned)powerStats.standbyEntries, (unsigned)powerStats.wakes,
+               (unsigned)powerStats.passes, (unsigned)powerStats.redraws,
+               (unsigned long long)(powerStats.activeUs / 1000),
+               (unsigned long long)(powerStats.idleUs / 1000),
+               (unsigned)powerStats.lastWakeLatencyUs, (unsigned)powerStats.maxWakeLatencyUs,
+               (unsigned)powerStats.bleInterval, (unsigned)powerStats.bleLatency,
+               (unsigned)powerStats.bleUpdates,
+               (unsigned)avgUa, (unsigned)energyPerHourUwh(avgUa));
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/http — outbound connection pool, per host
+inline void handleHttpPoolStats() {
+  FixedString<1400> json;
+  httpPoolStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/macros — stored macro slots and VM counters
+inline void handleMacroList() {
+  FixedString<640> json;
+  macroStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// The slot about to change is the open mode: fall back to the menu
+// (or wake into it, if in standby).
+inline void leaveMacroSlot(int slot) {
+  if (macroOpenSlot != slot) return;
+  if (currentState == STATE_MACRO) {
+    currentState = STATE_MENU;
+    counter      = 0;
+  }
+  enteredStandbyFromMacro = false;
+}
+
+// POST /api/macros?slot=N with the hex image (tools/macroasm.cpp)
+// as the body. The image is verified before it touches EEPROM.
+inline void handleMacroUpload() {
+  if (!server.hasArg("slot") || !server.hasArg("plain")) {
+    server.send(400, "application/json", "{\"error\":\"need slot and body\"}");
+    return;
+  }
+  int slot = server.arg("slot").toInt();
+  if (slot < 0 || slot >= MACRO_SLOTS) {
+    server.send(400, "application/json", "{\"error\":\"bad slot\"}");
+    return;
+  }
+  const String &body = server.arg("plain");
+  leaveMacroSlot(slot);
+  const char* err = installMacroHex((uint8_t)slot, body.c_str(), body.length());
+  if (err) {
+    FixedString<96> json;
+    json.appendf("{\"error\":\"%s\"}", err);
+    server.send_P(400, "application/json", json.c_str(), json.length());
+    return;
+  }
+  lastMenuSelection = -1;   // menu picks up the new name
+  handleMacroList();
+}
+
+// DELETE /api/macros?slot=N
+inline void handleMacroErase() {
+  int slot = server.hasArg("slot") ? server.arg("slot").toInt() : -1;
+  if (slot < 0 || slot >= MACRO_SLOTS) {
+    server.send(400, "application/json", "{\"error\":\"bad slot\"}");
+    return;
+  }
+  leaveMacroSlot(slot);
+  eraseMacro((uint8_t)slot);
+  lastMenuSelection = -1;
+  handleMacroList();
+}
+
+// GET /api/timers — every countdown/alarm and the wheel's counters
+inline void handleTimerList() {
+  static FixedString<3600> json;   // a full pool; too big for loop()'s stack
+  json.clear();
+  timersJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// POST /api/timers?in=SECONDS[&every=SECONDS]&label=TEXT   countdown
+// POST /api/timers?at=HH:MM[&daily=1]&label=TEXT           alarm
+inline void handleTimerCreate() {
+  const String &labelArg = server.arg("label");
+  FixedString<TIMER_LABEL_MAX> label(server.hasArg("label") ? StrView(labelArg.c_str(), labelArg.length())
+                                                            : StrView("Timer"));
+  TimerId id = 0;
+  if (server.hasArg("in")) {
+    long secs  = server.arg("in").toInt();
+    long every = server.hasArg("every") ? server.arg("every").toInt() : 0;
+    if (secs <= 0 || secs > 7L * 24 * 3600 || every < 0 || every > 7L * 24 * 3600) {
+      server.send(400, "application/json", "{\"error\":\"in/every out of range\"}");
+      return;
+    }
+    id = startCountdown(secs * 1000UL, every * 1000UL, label.c_str());
+  } else if (server.hasArg("at")) {
+    const String &atArg = server.arg("at");
+    StrView at(atArg.c_str(), atArg.length());
+    int colon = at.indexOf(':');
+    uint32_t hh = 0, mm = 0;
+    if (colon < 0 || !batchNumber(at.substr(0, colon), 0, 23, hh) ||
+        !batchNumber(at.substr(colon + 1), 0, 59, mm)) {
+      server.send(400, "application/json", "{\"error\":\"at must be HH:MM\"}");
+      return;
+    }
+    if (!wallClockValid()) {
+      server.send(503, "application/json", "{\"error\":\"clock not synced\"}");
+      return;
+    }
+    id = startAlarm((int)(hh * 60 + mm), server.arg("daily") == "1", label.c_str());
+  } else {
+    server.send(400, "application/json", "{\"error\":\"need in= or at=\"}");
+    return;
+  }
+  if (!id) {
+    server.send(507, "application/json", "{\"error\":\"no free timer\"}");
+    return;
+  }
+  FixedString<48> json;
+  json.appendf("{\"id\":%u}", (unsigned)id);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// DELETE /api/timers?id=N
+inline void handleTimerCancel() {
+  TimerId id = server.hasArg("id") ? (TimerId)strtoul(server.arg("id").c_str(), nullptr, 10) : 0;
+  const TimerNode* n = timerWheel.find(id);
+  if (!n || n->kind == TIMER_KIND_CHIME || n->kind == TIMER_KIND_CLOCK_WATCH || !cancelTimer(id)) {
+    server.send(404, "application/json", "{\"error\":\"no such timer\"}");
+    return;
+  }
+  if (currentState == STATE_TIMER_RUNNING && !knobTimerId) {
+    currentState      = STATE_MENU;   // the knob's own countdown was cancelled
+    counter           = 0;
+    lastMenuSelection = -1;
+  }
+  handleTimerList();
+}
+
+// POST /api/batch — several commands, all or nothing (batchapi.h).
+// Body as text/plain: a form-encoded body never reaches arg("plain").
+inline void handleBatch() {
+  static FixedString<1024> json;   // 16 results; keep it off loop()'s stack
+  json.clear();
+  const String &body = server.arg("plain");
+  int status = runBatch(StrView(body.c_str(), body.length()), json);
+  if (status == 503) server.sendHeader("Retry-After", String(BATCH_BLE_RETRY_S));
+  server.send_P(status, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/state — mode, links, timers, stopwatch, message in one go
+inline void handleDeviceState() {
+  FixedString<640> json;
+  deviceStateJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/trace — the input trace ring (tracecode.h), oldest block
+// first. Recording pauses while it goes out.
+inline void handleTraceDownload() {
+  bool was = pauseInputTrace();
+  TraceFileHeader h = inputTrace.header();
+  server.setContentLength(sizeof(h) + (size_t)h.blocks * TRACE_BLOCK_BYTES);
+  server.send(200, "application/octet-stream", "");
+  server.sendContent((const char*)&h, sizeof(h));
+  for (uint32_t i = 0; i < h.blocks; i++) {
+    server.sendContent((const char*)inputTrace.blockData(i), TRACE_BLOCK_BYTES);
+  }
+  inputTraceOn = was;
+}
+
+// POST /api/trace?on=0|1
+inline void handleTraceControl() {
+  if (server.hasArg("on")) {
+    if (server.arg("on") == "0") pauseInputTrace();
+    else                         inputTraceOn = true;
+  }
+  FixedString<160> json;
+  inputTraceStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// DELETE /api/trace
+inline void handleTraceClear() {
+  clearInputTrace();
+  handleTraceControl();
+}
+
+// GET /api/log           deferred-log stats (knoblog.h)
+// GET /api/log?raw=1     the records, for tools/logdecode.cpp
+inline void handleLog() {
+  if (server.arg("raw") == "1") {
+    KlogFileHeader h = klogHold();
+    server.setContentLength(sizeof(h) + h.bytes);
+    server.send(200, "application/octet-stream", "");
+    server.sendContent((const char*)&h, sizeof(h));
+    klogForEachSpan([](const uint8_t* p, size_t n) { server.sendContent((const char*)p, n); });
+    klogRelease();
+    return;
+  }
+  FixedString<384> json;
+  klogStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/hid, POST /api/hid?dial=0|1: volume as dial reports
+inline void handleHid() {
+  if (server.method() == HTTP_POST && server.hasArg("dial")) {
+    hidDialMode = server.arg("dial") == "1";
+  }
+  FixedString<224> json;
+  hidStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/mqtt
+inline void handleMqtt() {
+  FixedString<640> json;
+  mqttStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/screen — the current frame as a PBM image
+inline void handleScreen() {
+  static uint8_t pbm[sizeof(MIRROR_PBM_HEADER) - 1 + MIRROR_FRAME_BYTES];
+  const size_t head = sizeof(MIRROR_PBM_HEADER) - 1;
+  memcpy(pbm, MIRROR_PBM_HEADER, head);
+  for (int y = 0; y < MIRROR_HEIGHT; y++) {
+    mirrorPbmRow(display.getBuffer(), mirrorStartLine, y, pbm + head + y * (MIRROR_WIDTH / 8));
+  }
+  server.send_P(200, "image/x-portable-bitmap", (const char*)pbm, sizeof(pbm));
+}
+
+// GET /api/mirror — screen stream bandwidth per frame type
+inline void handleMirrorStats() {
+  FixedString<640> json;
+  mirrorStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/loop — loop() period and encoder step lag (loopmonitor.h)
+// POST /api/loop?reset=1&probe=hz: clear the stats, start/stop
+// synthetic steps (tools/loadtest.cpp brackets a run with these)
+inline void handleLoopStats() {
+  if (server.method() == HTTP_POST) {
+    if (server.arg("reset") == "1") loopMonitorReset();
+    if (server.hasArg("probe") && !loopProbeStart((uint16_t)server.arg("probe").toInt())) {
+      server.send(500, "text/plain", "probe timer unavailable");
+      return;
+    }
+  }
+  FixedString<640> json;
+  loopStatsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// GET /api/coroutines — the mode coroutines and scheduler counters
+inline void handleModeTasks() {
+  FixedString<512> json;
+  modeTasksJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+// The web server, mDNS and the screen mirror listen only while
+// WiFi is up: started on connecting (webStackFollow), and stopped
+// once WiFi has been down for HTTP_IDLE_STOP_MS so the sockets,
+// mDNS task and mirror buffers come back. WiFi itself stays up to
+// reconnect, with its credentials left where they are.
+#define HTTP_IDLE_STOP_MS 300000UL   // 0 keeps the stack up offline
+
+Subsystem httpSubsys = { "http" };
+
+template<size_t N>
+inline void subsystemsJson(FixedString<N> &json) {
+  json.append("{");
+  bootPhasesJson(json);
+  json.append(",");
+  subsysJson(json, bleSubsys);
+  json.append(",");
+  subsysJson(json, httpSubsys);
+  json.appendf(",\"freeHeap\":%u,\"bleIdleStopMs\":%u,\"httpIdleStopMs\":%u}",
+               (unsigned)ESP.getFreeHeap(), (unsigned)BLE_IDLE_STOP_MS,
+               (unsigned)HTTP_IDLE_STOP_MS);
+}
+
+// GET /api/subsystems — boot phases, BLE and HTTP start/stop costs
+inline void handleSubsystems() {
+  FixedString<1024> json;
+  subsystemsJson(json);
+  server.send_P(200, "application/json", json.c_str(), json.length());
+}
+
+inline void startWebStack() {
+  if (httpSubsys.up) return;
+  subsysStartBegin(httpSubsys);
   // Start mDNS
   if (!MDNS.begin(hostname)) {     // hostname = knobcontroller.local
     Serial.println("Error setting up MDNS!");
@@ -44,7 +404,36 @@ inline void initWebserver() {
     Serial.print(hostname);
     Serial.println(".local");
   }
+  server.begin();
+  Serial.println("HTTP server started.");
+  initScreenMirror();   // stream on MIRROR_PORT, viewer at /mirror
+  subsysStartDone(httpSubsys);
+}
+
+inline void stopWebStack() {
+  if (!httpSubsys.up) return;
+  subsysStopBegin(httpSubsys);
+  stopScreenMirror();
+  server.stop();
+  MDNS.end();
+  subsysStopDone(httpSubsys);
+}
+
+// Once per loop() pass
+inline void webStackFollow(bool wifiUp) {
+  static MonoTime wifiLostAt = {};
+  if (wifiUp) {
+    startWebStack();
+    wifiLostAt = monoNow();
+    return;
+  }
+#if HTTP_IDLE_STOP_MS
+  if (httpSubsys.up && since(wifiLostAt) >= msecs(HTTP_IDLE_STOP_MS)) stopWebStack();
+#endif
+}
 
+// The routes; nothing listens until startWebStack()
+inline void initWebserver() {
   // Override any lingering config portal routes
   server.on("/", HTTP_GET, []() {
     server.send(200, "text/plain", "Knobby OS Running");
@@ -55,31 +444,50 @@ inline void initWebserver() {
 
   // Register API endpoints
   server.on("/api/restart", HTTP_GET, handleRestart);
+  server.on("/api/heap", HTTP_GET, handleHeapStats);
+  server.on("/api/layers", HTTP_GET, handleLayerStats);
+  server.on("/api/layers", HTTP_POST, handleLayerStats);
+  server.on("/api/display", HTTP_GET, handleDisplayStats);
+  server.on("/api/power", HTTP_GET, handlePowerStats);
+  server.on("/api/http", HTTP_GET, handleHttpPoolStats);
+  server.on("/api/macros", HTTP_GET, handleMacroList);
+  server.on("/api/macros", HTTP_POST, handleMacroUpload);
+  server.on("/api/macros", HTTP_DELETE, handleMacroErase);
+  server.on("/api/timers", HTTP_GET, handleTimerList);
+  server.on("/api/timers", HTTP_POST, handleTimerCreate);
+  server.on("/api/timers", HTTP_DELETE, handleTimerCancel);
+  server.on("/api/batch", HTTP_POST, handleBatch);
+  server.on("/api/state", HTTP_GET, handleDeviceState);
+  server.on("/api/trace", HTTP_GET, handleTraceDownload);
+  server.on("/api/trace", HTTP_POST, handleTraceControl);
+  server.on("/api/trace", HTTP_DELETE, handleTraceClear);
+  server.on("/api/log", HTTP_GET, handleLog);
+  server.on("/api/hid", HTTP_GET, handleHid);
+  server.on("/api/hid", HTTP_POST, handleHid);
+  server.on("/api/mqtt", HTTP_GET, handleMqtt);
+  server.on("/api/screen", HTTP_GET, handleScreen);
+  server.on("/api/mirror", HTTP_GET, handleMirrorStats);
+  server.on("/api/coroutines", HTTP_GET, handleModeTasks);
+  server.on("/api/loop", HTTP_GET, handleLoopStats);
+  server.on("/api/loop", HTTP_POST, handleLoopStats);
+  server.on("/api/subsystems", HTTP_GET, handleSubsystems);
+  server.on("/mirror", HTTP_GET, []() {
+    server.send_P(200, "text/html", MIRROR_PAGE);
+  });
 
   // Stopwatch endpoints
   server.on("/api/stopwatch/start", HTTP_GET, []() {
-    stopwatchElapsed     = 0;
-    stopwatchStartMillis = millis();
-    stopwatchRunning     = true;
-    currentState         = STATE_STOPWATCH;
+    startStopwatch();
     server.send(200, "application/json", "{\"status\":\"stopwatch_started\"}");
-    Serial.println("Stopwatch: Started via HTTP");
+    KLOG_INFO(KLOG_TAG_WEB, "Stopwatch: Started via HTTP");
   });
 
   server.on("/api/stopwatch/stop", HTTP_GET, []() {
-    stopwatchRunning     = false;
-    stopwatchElapsed     = 0;
-    currentState         = STATE_MENU;
-    counter              = 0;
-    lastMenuSelection    = -1;
-    lastActivityTime     = millis();
-    drawMenu(0, true);
+    stopStopwatch();
     server.send(200, "application/json", "{\"status\":\"stopwatch_stopped\"}");
-    Serial.println("Stopwatch: Stopped via HTTP, back to menu");
+    KLOG_INFO(KLOG_TAG_WEB, "Stopwatch: Stopped via HTTP, back to menu");
   });
 
-  server.begin();
-  Serial.println("HTTP server started.");
 }
 
 #endif
\ No newline at end of file